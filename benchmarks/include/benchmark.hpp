@@ -0,0 +1,104 @@
+#pragma once
+
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include <Eigen/Dense>
+
+#include "triangle.hpp"
+#include "Structures/ray.hpp"
+
+/// @brief A benchmark registered in the benchmark executable
+struct Benchmark {
+    std::string name;
+    std::function<void()> run;
+};
+
+/// @brief Get the list of all the registered benchmarks
+/// @return A reference to the list of benchmarks
+inline std::vector<Benchmark>& getBenchmarks() {
+    static std::vector<Benchmark> benchmarks;
+    return benchmarks;
+}
+
+/// @brief Helper registering a benchmark at static initialization time (see the BENCHMARK macro)
+struct BenchmarkRegistrar {
+    BenchmarkRegistrar(const std::string& name, std::function<void()> run) {
+        getBenchmarks().push_back({name, std::move(run)});
+    }
+};
+
+#define BENCHMARK_CONCAT_IMPL(a, b) a##b
+#define BENCHMARK_CONCAT(a, b) BENCHMARK_CONCAT_IMPL(a, b)
+
+/// @brief Declare and register a benchmark, used like a function definition: BENCHMARK("[Group] name") { ... }
+#define BENCHMARK(name) \
+    static void BENCHMARK_CONCAT(benchmark_function_, __LINE__)(); \
+    static BenchmarkRegistrar BENCHMARK_CONCAT(benchmark_registrar_, __LINE__)(name, BENCHMARK_CONCAT(benchmark_function_, __LINE__)); \
+    static void BENCHMARK_CONCAT(benchmark_function_, __LINE__)()
+
+/// @brief Measure the average duration of a function
+/// @param function The function to measure
+/// @param repetitions The number of times the function is called
+/// @return The average duration of one call (in seconds)
+template <typename Function>
+double measureSeconds(Function&& function, unsigned int repetitions = 1) {
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned int i = 0; i < repetitions; ++i) {
+        function();
+    }
+    auto stop = std::chrono::steady_clock::now();
+    return std::chrono::duration<double>(stop - start).count() / repetitions;
+}
+
+/// @brief Generate a cloud of small random triangles, for scenes bigger than the one of main.cpp
+/// @param count The number of triangles to generate
+/// @param center The center of the cube in which the triangles are generated
+/// @param extent The length of the side of the cube in which the triangles are generated
+/// @param triangle_size The length of the side of the cube, centered on the position of a triangle, in which its vertices are generated
+/// @param seed The seed of the random generator, so that runs are reproducible
+/// @return The generated triangles
+inline std::vector<Triangle> makeRandomTriangles(unsigned int count, const Eigen::Vector3d& center, double extent,
+                                                 double triangle_size, unsigned int seed = 42) {
+    std::mt19937 generator(seed);
+    std::uniform_real_distribution<double> unit(-0.5, 0.5);
+    auto randomVector = [&]() { return Eigen::Vector3d(unit(generator), unit(generator), unit(generator)); };
+
+    std::vector<Triangle> triangles;
+    triangles.reserve(count);
+    while (triangles.size() < count) {
+        // The vertices are given relative to the position of the triangle
+        Eigen::Vector3d position = center + extent * randomVector();
+        Eigen::Vector3d p0 = triangle_size * randomVector();
+        Eigen::Vector3d p1 = triangle_size * randomVector();
+        Eigen::Vector3d p2 = triangle_size * randomVector();
+
+        // Skip the (very unlikely) degenerated triangles
+        if ((p1 - p0).cross(p2 - p0).norm() < 1e-9) continue;
+        triangles.emplace_back(position, p0, p1, p2);
+    }
+    return triangles;
+}
+
+/// @brief Generate random rays leaving a sphere around a scene towards its inside
+/// @param count The number of rays to generate
+/// @param radius The radius of the sphere centered on the origin from which the rays leave
+/// @param seed The seed of the random generator, so that runs are reproducible
+/// @return The generated rays, aimed at random points of the cube of side `radius` centered on the origin
+inline std::vector<Ray> makeRandomRays(unsigned int count, double radius, unsigned int seed = 7) {
+    std::mt19937 generator(seed);
+    std::normal_distribution<double> normal;
+    std::uniform_real_distribution<double> unit(-0.5, 0.5);
+
+    std::vector<Ray> rays;
+    rays.reserve(count);
+    for (unsigned int i = 0; i < count; ++i) {
+        Eigen::Vector3d origin = Eigen::Vector3d(normal(generator), normal(generator), normal(generator)).normalized() * radius;
+        Eigen::Vector3d target = Eigen::Vector3d(unit(generator), unit(generator), unit(generator)) * radius;
+        rays.emplace_back(origin, target - origin);
+    }
+    return rays;
+}
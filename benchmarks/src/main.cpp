@@ -0,0 +1,20 @@
+#include <iostream>
+#include <string>
+
+#include "benchmark.hpp"
+
+// Run all the registered benchmarks, or only the ones whose name contains the first command line argument
+//      Example: ./3DRenderer_benchmarks "[Render]"
+int main(int argc, char** argv) {
+    const std::string filter = argc > 1 ? argv[1] : "";
+
+    for (const Benchmark& benchmark : getBenchmarks()) {
+        if (benchmark.name.find(filter) == std::string::npos) continue;
+
+        std::cout << "=== " << benchmark.name << " ===" << std::endl;
+        benchmark.run();
+        std::cout << std::endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,904 @@
+#include <filesystem>
+#include <functional>
+#include <iomanip>
+#include <limits>
+#include <optional>
+#include <thread>
+
+#include "benchmark.hpp"
+#include "Structures/octree.hpp"
+#include "Structures/triangleBlocks.hpp"
+#include "camera.hpp"
+
+namespace {
+    constexpr unsigned int TRIANGLE_COUNT = 200000;
+    constexpr unsigned int RAY_COUNT = 20000;
+
+    /// @brief Measure the build, traversal and teardown of an octree using a given node allocator
+    template <template <typename> class NodeAllocator>
+    void benchmarkAllocator(const std::string& name, const std::vector<Triangle>& triangles, const std::vector<Ray>& rays) {
+        std::optional<Octree<Triangle, NodeAllocator>> octree;
+
+        double build_seconds = measureSeconds([&]() {
+            octree.emplace(16, 1.0, 8, Eigen::Vector3d::Zero());
+            for (const Triangle& triangle : triangles) {
+                octree->insert(&triangle);
+            }
+        });
+
+        octree->finalize();
+
+        unsigned int hits = 0;
+        double trace_seconds = measureSeconds([&]() {
+            for (const Ray& ray : rays) {
+                double hit_distance;
+                hits += octree->traceRay(ray, hit_distance) != nullptr;
+            }
+        });
+
+        double teardown_seconds = measureSeconds([&]() { octree.reset(); });
+
+        std::cout << std::left << std::setw(6) << name << std::right << std::fixed << std::setprecision(1)
+                  << " build: " << std::setw(7) << build_seconds * 1e3 << " ms"
+                  << " | teardown: " << std::setw(6) << teardown_seconds * 1e3 << " ms"
+                  << " | traversal: " << std::setw(6) << rays.size() / trace_seconds * 1e-3 << " krays/s"
+                  << " (" << hits << " hits)" << std::endl;
+    }
+
+    /// @brief Visit the nodes of a flat octree crossed by a ray with the parametric traversal, without testing the objects
+    /// @return The number of nodes visited
+    std::size_t visitParametric(const FlatOctree<Triangle>& octree, std::uint32_t node_index, const Eigen::Vector3d& center, double half_size,
+                                const NodeSlabs& slabs, unsigned char signs, const Ray& ray) {
+        const double enter_distance = std::max(slabs.getEnterDistance(), 0.0);
+        if (enter_distance > slabs.getExitDistance()) return 0;
+
+        const FlatOctreeNode& node = octree.getNodes()[node_index];
+        std::size_t visited = 1;
+        if (node.isLeaf()) return visited;
+
+        const Eigen::Array3d split_distances = getSplitDistances(center, ray, signs);
+        for (unsigned char child = getFirstChild(split_distances, enter_distance); child < 8;) {
+            const NodeSlabs child_slabs = getChildSlabs(slabs, split_distances, child);
+            const unsigned char child_index = child ^ signs;
+            if (node.hasChild(child_index)) {
+                visited += visitParametric(octree, node.getChild(child_index), getChildCenter(center, half_size, child_index), half_size / 2,
+                                           child_slabs, signs, ray);
+            }
+            child = getNextChild(child, child_slabs.exit);
+        }
+        return visited;
+    }
+
+    /// @brief Visit the nodes of a flat octree crossed by a ray like the previous traversal did, without testing the objects:
+    ///        a slab test against the box of each node, then the crossed children found by sorting the distances to the splitting planes
+    /// @return The number of nodes visited
+    std::size_t visitSortedPlanes(const FlatOctree<Triangle>& octree, std::uint32_t node_index, const Eigen::Vector3d& center, double half_size,
+                                  const Ray& ray) {
+        const Box bounding_box{center.array() - half_size, center.array() + half_size};
+        double box_enter_distance, box_exit_distance;
+        if (!bounding_box.intersect(ray, box_enter_distance, box_exit_distance)) return 0;
+
+        const FlatOctreeNode& node = octree.getNodes()[node_index];
+        std::size_t visited = 1;
+        if (node.isLeaf()) return visited;
+
+        // Plane `i` is normal to the axis `2 - i`, so that crossing it flips bit `i` of the child index
+        double plane_distances[3];
+        bool plane_crossed[3];
+        for (int i = 0; i < 3; ++i) {
+            const int axis = 2 - i;
+            const bool parallel = std::fabs(ray.getDirection()[axis]) < std::numeric_limits<double>::epsilon();
+            plane_distances[i] = (center[axis] - ray.getOrigin()[axis]) / (parallel ? 1.0 : ray.getDirection()[axis]);
+            plane_crossed[i] = !parallel && plane_distances[i] <= box_exit_distance &&
+                               (plane_distances[i] > 0 || (plane_distances[i] == 0 && ray.getDirection()[axis] < 0));
+        }
+
+        unsigned char plane_indices[3];
+        unsigned char plane_count = 0;
+        for (int i = 0; i < 3; ++i) {
+            if (!plane_crossed[i]) continue;
+
+            unsigned char rank = 0;
+            for (int j = 0; j < 3; ++j) {
+                rank += plane_crossed[j] && (plane_distances[j] < plane_distances[i] || (plane_distances[j] == plane_distances[i] && j < i));
+            }
+            plane_indices[rank] = i;
+            plane_count++;
+        }
+
+        unsigned char child_index = getBranchIndex(ray.getOrigin(), center);
+        for (unsigned char i = 0; i <= plane_count; ++i) {
+            if (node.hasChild(child_index)) {
+                visited += visitSortedPlanes(octree, node.getChild(child_index), getChildCenter(center, half_size, child_index), half_size / 2, ray);
+            }
+            if (i < plane_count) child_index ^= 1 << plane_indices[i];
+        }
+        return visited;
+    }
+
+    /// @brief Trace the rays of a camera through an octree by blocks of pixels, or one by one if the block holds a single pixel
+    /// @return The number of rays hitting an object
+    template <int N>
+    unsigned int traceCameraRays(const Octree<Triangle>& octree, const std::vector<Ray>& rays, unsigned int width, unsigned int height,
+                                 unsigned int block_width) {
+        unsigned int hits = 0;
+        const unsigned int block_height = N / block_width;
+        for (unsigned int i = 0; i < height; i += block_height) {
+            for (unsigned int j = 0; j < width; j += block_width) {
+                RayPacket<N> packet;
+                for (unsigned int lane = 0; lane < N; ++lane) {
+                    const unsigned int row = i + lane / block_width, column = j + lane % block_width;
+                    if (row < height && column < width) packet.set(lane, rays[row * width + column]);
+                }
+
+                typename RayPacket<N>::Lanes hit_distances;
+                for (const Triangle* hit : octree.traceRays(packet, hit_distances)) {
+                    hits += hit != nullptr;
+                }
+            }
+        }
+        return hits;
+    }
+
+    /// @brief Compare the camera rays traced one by one and by packets of 2x2 and 4x2 pixels
+    void benchmarkPackets(const std::string& scene_name, Octree<Triangle>& octree, unsigned int width, unsigned int height) {
+        Camera camera(Eigen::Vector3d::Zero(), 1.7, 1.7, width, height, 1.0);
+        const std::vector<Ray>& rays = camera.getRays();
+        octree.finalize();
+
+        unsigned int single_hits = 0;
+        const double single_seconds = measureSeconds([&]() {
+            for (const Ray& ray : rays) {
+                double hit_distance;
+                single_hits += octree.traceRay(ray, hit_distance) != nullptr;
+            }
+        });
+
+        unsigned int hits_4 = 0, hits_8 = 0;
+        const double seconds_4 = measureSeconds([&]() { hits_4 = traceCameraRays<4>(octree, rays, width, height, 2); });
+        const double seconds_8 = measureSeconds([&]() { hits_8 = traceCameraRays<8>(octree, rays, width, height, 4); });
+
+        std::cout << scene_name << ", " << rays.size() << " camera rays (" << single_hits << " / " << hits_4 << " / " << hits_8 << " hits):"
+                  << std::fixed << std::setprecision(1) << std::endl
+                  << "  single rays: " << std::setw(8) << rays.size() / single_seconds * 1e-3 << " krays/s" << std::endl
+                  << "  2x2 packets: " << std::setw(8) << rays.size() / seconds_4 * 1e-3 << " krays/s (x"
+                  << std::setprecision(2) << single_seconds / seconds_4 << ")" << std::setprecision(1) << std::endl
+                  << "  4x2 packets: " << std::setw(8) << rays.size() / seconds_8 * 1e-3 << " krays/s (x"
+                  << std::setprecision(2) << single_seconds / seconds_8 << ")" << std::endl;
+    }
+}
+
+// Build, traversal and teardown of the octree with nodes allocated one by one or in an arena
+BENCHMARK("[Octree] node allocators") {
+    std::vector<Triangle> triangles = makeRandomTriangles(TRIANGLE_COUNT, Eigen::Vector3d::Zero(), 20.0, 0.3);
+    std::vector<Ray> rays = makeRandomRays(RAY_COUNT, 15.0);
+
+    benchmarkAllocator<NodeHeap>("heap", triangles, rays);
+    benchmarkAllocator<NodeArena>("arena", triangles, rays);
+}
+
+// Memory per node and ray tracing speed of the pointer-based nodes and of the flat layout
+BENCHMARK("[Octree] flat layout") {
+    std::vector<Triangle> triangles = makeRandomTriangles(TRIANGLE_COUNT, Eigen::Vector3d::Zero(), 20.0, 0.3);
+    std::vector<Ray> rays = makeRandomRays(RAY_COUNT, 15.0);
+
+    Octree<Triangle> octree(16, 1.0, 8, Eigen::Vector3d::Zero());
+    for (const Triangle& triangle : triangles) {
+        octree.insert(&triangle);
+    }
+    double finalize_seconds = measureSeconds([&]() { octree.finalize(); });
+    const FlatOctree<Triangle>& flat_octree = octree.getFlatOctree();
+
+    // Memory of the pointer-based nodes and of the pointers to the objects of their leaves
+    std::size_t node_count = 0;
+    std::function<void(const OctreeNode<Triangle>*)> countNodes = [&](const OctreeNode<Triangle>* node) {
+        node_count++;
+        if (node->total_children_depth == 0) return;
+        for (const OctreeNode<Triangle>* child : node->children) countNodes(child);
+    };
+    countNodes(octree.getRoot());
+    std::size_t node_bytes = node_count * sizeof(OctreeNode<Triangle>) + triangles.size() * sizeof(void*);
+
+    unsigned int node_hits = 0;
+    double node_seconds = measureSeconds([&]() {
+        for (const Ray& ray : rays) {
+            double hit_distance = std::numeric_limits<double>::infinity();
+            node_hits += octree.getRoot()->traceRay(ray, hit_distance, octree.getInsertion()) != nullptr;
+        }
+    });
+
+    unsigned int flat_hits = 0;
+    double flat_seconds = measureSeconds([&]() {
+        for (const Ray& ray : rays) {
+            double hit_distance;
+            flat_hits += octree.traceRay(ray, hit_distance) != nullptr;
+        }
+    });
+
+    std::cout << std::fixed << std::setprecision(1)
+              << "nodes: " << std::setw(8) << node_count << " nodes, " << std::setw(6) << double(node_bytes) / node_count << " bytes/node"
+              << " | " << std::setw(7) << rays.size() / node_seconds * 1e-3 << " krays/s (" << node_hits << " hits)" << std::endl
+              << "flat:  " << std::setw(8) << flat_octree.getNodes().size() << " nodes, " << std::setw(6) << double(flat_octree.bytes()) / flat_octree.getNodes().size() << " bytes/node"
+              << " | " << std::setw(7) << rays.size() / flat_seconds * 1e-3 << " krays/s (" << flat_hits << " hits)"
+              << " | compiled in " << finalize_seconds * 1e3 << " ms" << std::endl;
+
+    // The same octree with its flat nodes packed in 8 bytes
+    Octree<Triangle, NodeArena, CompactFlatOctreeNode> compact_octree(16, 1.0, 8, Eigen::Vector3d::Zero());
+    for (const Triangle& triangle : triangles) {
+        compact_octree.insert(&triangle);
+    }
+    compact_octree.finalize();
+    const FlatOctree<Triangle, CompactFlatOctreeNode>& compact_flat_octree = compact_octree.getFlatOctree();
+
+    unsigned int compact_hits = 0;
+    double compact_seconds = measureSeconds([&]() {
+        for (const Ray& ray : rays) {
+            double hit_distance;
+            compact_hits += compact_octree.traceRay(ray, hit_distance) != nullptr;
+        }
+    });
+
+    std::cout << "compact:" << std::setw(7) << compact_flat_octree.getNodes().size() << " nodes, " << std::setw(6)
+              << double(compact_flat_octree.bytes()) / compact_flat_octree.getNodes().size() << " bytes/node"
+              << " | " << std::setw(7) << rays.size() / compact_seconds * 1e-3 << " krays/s (" << compact_hits << " hits)"
+              << " | nodes alone: " << sizeof(FlatOctreeNode) << " -> " << sizeof(CompactFlatOctreeNode) << " bytes" << std::endl;
+}
+
+// Build, traversal and correctness of the insertion by position and by bounding box, in a room of large walls
+BENCHMARK("[Octree] insertion modes") {
+    std::vector<Triangle> triangles = makeRandomTriangles(TRIANGLE_COUNT / 4, Eigen::Vector3d::Zero(), 20.0, 0.3);
+
+    // Two large triangles per wall of a room around the random triangles
+    const double half_room = 12.0;
+    for (int axis = 0; axis < 3; ++axis) {
+        for (double side : {-half_room, half_room}) {
+            Eigen::Vector3d position = Eigen::Vector3d::Zero();
+            position[axis] = side;
+            Eigen::Vector3d u = Eigen::Vector3d::Zero(), v = Eigen::Vector3d::Zero();
+            u[(axis + 1) % 3] = half_room;
+            v[(axis + 2) % 3] = half_room;
+            triangles.emplace_back(position, -u - v, u - v, u + v);
+            triangles.emplace_back(position, -u - v, u + v, -u + v);
+        }
+    }
+    std::vector<Ray> rays = makeRandomRays(RAY_COUNT, 10.0);
+
+    // Closest hits of the first rays, by testing all the triangles
+    const unsigned int checked_rays = 500;
+    std::vector<const Triangle*> expected_hits(checked_rays, nullptr);
+    for (unsigned int i = 0; i < checked_rays; ++i) {
+        float u, v, t, closest = std::numeric_limits<float>::infinity();
+        for (const Triangle& triangle : triangles) {
+            if (triangle.intersect(rays[i], u, v, t) && t < closest) {
+                closest = t;
+                expected_hits[i] = &triangle;
+            }
+        }
+    }
+
+    for (OctreeInsertion insertion : {OctreeInsertion::Position, OctreeInsertion::BoundingBox}) {
+        std::optional<Octree<Triangle>> octree;
+        double build_seconds = measureSeconds([&]() {
+            octree.emplace(16, 1.0, 8, Eigen::Vector3d::Zero(), insertion);
+            for (const Triangle& triangle : triangles) {
+                octree->insert(&triangle);
+            }
+            octree->finalize();
+        });
+
+        unsigned int hits = 0;
+        double trace_seconds = measureSeconds([&]() {
+            for (const Ray& ray : rays) {
+                double hit_distance;
+                hits += octree->traceRay(ray, hit_distance) != nullptr;
+            }
+        });
+
+        unsigned int wrong_hits = 0;
+        for (unsigned int i = 0; i < checked_rays; ++i) {
+            double hit_distance;
+            wrong_hits += octree->traceRay(rays[i], hit_distance) != expected_hits[i];
+        }
+
+        const FlatOctree<Triangle>& flat_octree = octree->getFlatOctree();
+        std::cout << std::left << std::setw(12) << (insertion == OctreeInsertion::Position ? "position" : "bounding box")
+                  << std::right << std::fixed << std::setprecision(1)
+                  << " build: " << std::setw(7) << build_seconds * 1e3 << " ms"
+                  << " | " << std::setw(5) << double(flat_octree.getPrimitives().size()) / triangles.size() << " references/object"
+                  << " | traversal: " << std::setw(6) << rays.size() / trace_seconds * 1e-3 << " krays/s"
+                  << " (" << hits << " hits, " << wrong_hits << "/" << checked_rays << " wrong)" << std::endl;
+    }
+}
+
+// Build time of the incremental insertion and of the bulk build from Morton codes, serial and on thread pools
+BENCHMARK("[Octree] bulk build") {
+    std::vector<Triangle> triangles = makeRandomTriangles(5 * TRIANGLE_COUNT, Eigen::Vector3d::Zero(), 40.0, 0.3);
+    std::vector<const Triangle*> objects;
+    objects.reserve(triangles.size());
+    for (const Triangle& triangle : triangles) {
+        objects.push_back(&triangle);
+    }
+
+    std::vector<unsigned int> thread_counts = {1};
+    for (unsigned int thread_count = 2; thread_count <= std::max(2u, std::thread::hardware_concurrency()); thread_count *= 2) {
+        thread_counts.push_back(thread_count);
+    }
+
+    for (OctreeInsertion insertion : {OctreeInsertion::Position, OctreeInsertion::BoundingBox}) {
+        std::cout << (insertion == OctreeInsertion::Position ? "position" : "bounding box") << " insertion, "
+                  << triangles.size() << " triangles:" << std::endl;
+
+        Octree<Triangle> octree(16, 1.0, 8, Eigen::Vector3d::Zero(), insertion);
+        double insert_seconds = measureSeconds([&]() {
+            for (const Triangle* triangle : objects) {
+                octree.insert(triangle);
+            }
+        });
+        std::cout << "  incremental insert: " << std::fixed << std::setprecision(1) << std::setw(8) << insert_seconds * 1e3 << " ms" << std::endl;
+
+        for (unsigned int thread_count : thread_counts) {
+            std::optional<ThreadPool> pool;
+            if (thread_count > 1) pool.emplace(thread_count);
+
+            double build_seconds = measureSeconds([&]() { octree.build(objects, pool ? &*pool : nullptr); });
+            std::cout << "  bulk build, " << std::setw(2) << thread_count << " thread" << (thread_count > 1 ? "s" : " ")
+                      << ": " << std::setw(8) << build_seconds * 1e3 << " ms"
+                      << " (x" << std::setprecision(2) << insert_seconds / build_seconds << std::setprecision(1) << ")" << std::endl;
+        }
+    }
+}
+
+// Camera rays traced one by one and by packets of neighboring pixels, on the scene of main.cpp and on larger generated scenes
+// Startup of a large scene: building the octree against loading the one saved by a previous run
+BENCHMARK("[Octree] saved octree") {
+    std::vector<Triangle> triangles = makeRandomTriangles(5 * TRIANGLE_COUNT, Eigen::Vector3d::Zero(), 40.0, 0.3);
+    std::vector<const Triangle*> objects;
+    objects.reserve(triangles.size());
+    for (const Triangle& triangle : triangles) {
+        objects.push_back(&triangle);
+    }
+    std::vector<Ray> rays = makeRandomRays(RAY_COUNT, 60.0);
+    const std::string path = (std::filesystem::temp_directory_path() / "3drenderer-octree-benchmark.bin").string();
+
+    ThreadPool pool(0);
+    Octree<Triangle> built_octree(16, 1.0, 8, Eigen::Vector3d::Zero(), OctreeInsertion::BoundingBox);
+    double build_seconds = measureSeconds([&]() {
+        built_octree.build(objects, &pool);
+        built_octree.finalize();
+    });
+    double save_seconds = measureSeconds([&]() { built_octree.save(path, objects); });
+
+    Octree<Triangle> loaded_octree(16, 1.0, 8, Eigen::Vector3d::Zero(), OctreeInsertion::BoundingBox);
+    double load_seconds = measureSeconds([&]() { loaded_octree.load(path, objects); });
+
+    // The first rays fault the pages of the file in, the next ones read them from memory like the built octree
+    double hit_distance;
+    double first_trace_seconds = measureSeconds([&]() {
+        for (const Ray& ray : rays) loaded_octree.traceRay(ray, hit_distance);
+    });
+    double loaded_trace_seconds = measureSeconds([&]() {
+        for (const Ray& ray : rays) loaded_octree.traceRay(ray, hit_distance);
+    });
+    double built_trace_seconds = measureSeconds([&]() {
+        for (const Ray& ray : rays) built_octree.traceRay(ray, hit_distance);
+    });
+
+    std::cout << triangles.size() << " triangles, " << built_octree.getFlatOctree().getNodes().size() << " nodes, "
+              << std::filesystem::file_size(path) / (1024 * 1024) << " MiB file:" << std::endl << std::fixed << std::setprecision(1)
+              << "  build and finalize (" << pool.getThreadCount() << " threads): " << std::setw(8) << build_seconds * 1e3 << " ms" << std::endl
+              << "  save:                  " << std::setw(8) << save_seconds * 1e3 << " ms" << std::endl
+              << "  load:                  " << std::setw(8) << load_seconds * 1e3 << " ms"
+              << " (x" << std::setprecision(0) << build_seconds / load_seconds << std::setprecision(1) << " faster than the build)" << std::endl
+              << "  " << rays.size() << " rays, loaded octree: " << std::setw(8) << first_trace_seconds * 1e3 << " ms the first time, "
+              << loaded_trace_seconds * 1e3 << " ms then" << std::endl
+              << "  " << rays.size() << " rays, built octree:  " << std::setw(8) << built_trace_seconds * 1e3 << " ms" << std::endl;
+    std::filesystem::remove(path);
+}
+
+// Gathering the triangles of small regions through the octree, against testing all of them
+BENCHMARK("[Octree] range queries") {
+    constexpr unsigned int QUERY_COUNT = 2000;
+    std::vector<Triangle> triangles = makeRandomTriangles(TRIANGLE_COUNT, Eigen::Vector3d::Zero(), 20.0, 0.3);
+    std::vector<const Triangle*> objects;
+    for (const Triangle& triangle : triangles) {
+        objects.push_back(&triangle);
+    }
+    Octree<Triangle> octree;
+    octree.build(objects);
+    octree.finalize();
+
+    std::mt19937 generator(5);
+    std::uniform_real_distribution<double> unit(-10.0, 10.0);
+    std::vector<Box> boxes;
+    std::vector<Eigen::Vector3d> centers;
+    for (unsigned int i = 0; i < QUERY_COUNT; ++i) {
+        const Eigen::Array3d corner(unit(generator), unit(generator), unit(generator));
+        boxes.push_back(Box{corner, corner + 1.5});
+        centers.emplace_back(unit(generator), unit(generator), unit(generator));
+    }
+
+    // A frustum looking at the middle of the cloud from one of its corners
+    const Eigen::Vector3d apex(-12, -12, -12);
+    const Eigen::Vector3d axis = -apex.normalized();
+    const Eigen::Vector3d side = axis.cross(Eigen::Vector3d::UnitY()).normalized();
+    const Eigen::Vector3d up = side.cross(axis);
+    const std::vector<Plane> frustum = {
+        Plane(axis + 4 * side, apex), Plane(axis - 4 * side, apex), Plane(axis + 4 * up, apex), Plane(axis - 4 * up, apex),
+        Plane(axis, apex + 5 * axis), Plane(-axis, apex + 30 * axis),
+    };
+
+    std::vector<const Triangle*> results;
+    std::size_t gathered = 0;
+    auto report = [&](const std::string& name, std::size_t query_count, double octree_seconds, double brute_force_seconds) {
+        std::cout << std::left << std::setw(8) << name << std::right << std::fixed << std::setprecision(2)
+                  << " octree: " << std::setw(8) << octree_seconds / query_count * 1e6 << " us/query"
+                  << " | brute force: " << std::setw(8) << brute_force_seconds / query_count * 1e6 << " us/query"
+                  << " (x" << std::setprecision(0) << brute_force_seconds / octree_seconds << ", "
+                  << gathered / query_count << " triangles/query)" << std::endl;
+        gathered = 0;
+    };
+
+    double octree_seconds = measureSeconds([&]() {
+        for (const Box& box : boxes) {
+            octree.queryBox(box, results);
+            gathered += results.size();
+        }
+    });
+    double brute_force_seconds = measureSeconds([&]() {
+        for (const Box& box : boxes) {
+            results.clear();
+            for (const Triangle* triangle : objects) {
+                if (box.overlaps(triangle->getBoundingBox())) results.push_back(triangle);
+            }
+        }
+    });
+    report("box", QUERY_COUNT, octree_seconds, brute_force_seconds);
+
+    octree_seconds = measureSeconds([&]() {
+        for (const Eigen::Vector3d& center : centers) {
+            octree.querySphere(center, 1.0, results);
+            gathered += results.size();
+        }
+    });
+    brute_force_seconds = measureSeconds([&]() {
+        for (const Eigen::Vector3d& center : centers) {
+            results.clear();
+            for (const Triangle* triangle : objects) {
+                if (SphereRegion{center, 1.0}.overlaps(triangle->getBoundingBox())) results.push_back(triangle);
+            }
+        }
+    });
+    report("sphere", QUERY_COUNT, octree_seconds, brute_force_seconds);
+
+    octree_seconds = measureSeconds([&]() {
+        octree.queryFrustum(frustum, results);
+        gathered += results.size();
+    }, 20);
+    brute_force_seconds = measureSeconds([&]() {
+        results.clear();
+        for (const Triangle* triangle : objects) {
+            if (FrustumRegion{frustum}.overlaps(triangle->getBoundingBox())) results.push_back(triangle);
+        }
+    }, 20);
+    report("frustum", 20, octree_seconds * 20, brute_force_seconds * 20);
+}
+
+BENCHMARK("[Octree] nearest object") {
+    constexpr unsigned int QUERY_COUNT = 2000;
+    constexpr unsigned int FAN_SIZE = 256;
+    std::vector<Triangle> triangles = makeRandomTriangles(TRIANGLE_COUNT, Eigen::Vector3d::Zero(), 20.0, 0.3);
+    std::vector<const Triangle*> objects;
+    for (const Triangle& triangle : triangles) {
+        objects.push_back(&triangle);
+    }
+    Octree<Triangle> octree;
+    octree.build(objects);
+    octree.finalize();
+
+    std::mt19937 generator(6);
+    std::uniform_real_distribution<double> unit(-12.0, 12.0);
+    std::vector<Eigen::Vector3d> probes;
+    for (unsigned int i = 0; i < QUERY_COUNT; ++i) {
+        probes.emplace_back(unit(generator), unit(generator), unit(generator));
+    }
+
+    // The workaround: a fan of rays spread evenly over the sphere around the probe (Fibonacci sphere), keeping the closest hit
+    std::vector<Eigen::Vector3d> fan;
+    for (unsigned int i = 0; i < FAN_SIZE; ++i) {
+        const double z = 1 - (2 * i + 1.0) / FAN_SIZE;
+        const double angle = i * M_PI * (3 - std::sqrt(5.0));
+        fan.emplace_back(std::sqrt(1 - z * z) * std::cos(angle), std::sqrt(1 - z * z) * std::sin(angle), z);
+    }
+
+    std::vector<double> distances(QUERY_COUNT);
+    double nearest_seconds = measureSeconds([&]() {
+        for (unsigned int i = 0; i < QUERY_COUNT; ++i) {
+            Eigen::Vector3d closest_point;
+            const bool found = octree.nearest(probes[i], closest_point) != nullptr;
+            distances[i] = found ? (closest_point - probes[i]).norm() : std::numeric_limits<double>::infinity();
+        }
+    });
+
+    unsigned int fan_errors = 0;
+    double fan_seconds = measureSeconds([&]() {
+        fan_errors = 0;
+        for (unsigned int i = 0; i < QUERY_COUNT; ++i) {
+            double fan_distance = std::numeric_limits<double>::infinity();
+            for (const Eigen::Vector3d& direction : fan) {
+                double hit_distance;
+                if (octree.traceRay(Ray(probes[i], direction), hit_distance) != nullptr) fan_distance = std::min(fan_distance, hit_distance);
+            }
+            fan_errors += fan_distance > distances[i] * 1.01;
+        }
+    });
+
+    double brute_force_seconds = measureSeconds([&]() {
+        for (unsigned int i = 0; i < 50; ++i) {
+            double distance = std::numeric_limits<double>::infinity();
+            for (const Triangle* triangle : objects) {
+                distance = std::min(distance, (triangle->closestPoint(probes[i]) - probes[i]).squaredNorm());
+            }
+            distances[i] = std::sqrt(distance);
+        }
+    });
+
+    std::cout << std::fixed << std::setprecision(2)
+              << "nearest:     " << std::setw(9) << nearest_seconds / QUERY_COUNT * 1e6 << " us/query" << std::endl
+              << "ray fan:     " << std::setw(9) << fan_seconds / QUERY_COUNT * 1e6 << " us/query (" << FAN_SIZE << " rays, "
+              << std::setprecision(1) << 100.0 * fan_errors / QUERY_COUNT << "% of the distances over 1% too long)" << std::endl
+              << std::setprecision(2)
+              << "brute force: " << std::setw(9) << brute_force_seconds / 50 * 1e6 << " us/query" << std::endl;
+}
+
+BENCHMARK("[Octree] ray packets") {
+    // The two triangles of main.cpp, in the octree of its scene
+    Triangle triangle(Eigen::Vector3d(0, 0, 3), Eigen::Vector3d(-1, 1, 0), Eigen::Vector3d(1, 1, 0), Eigen::Vector3d(1, -1, 0), true);
+    Triangle triangle2(Eigen::Vector3d(0, 0, 3), Eigen::Vector3d(-1, 1, 0), Eigen::Vector3d(1, -1, 0), Eigen::Vector3d(-1, -1, 0), true);
+    triangle2.rotate(Eigen::Vector3d::UnitX(), M_PI / 4);
+    Octree<Triangle> main_octree(5, 2.5, 3, Eigen::Vector3d::Zero(), OctreeInsertion::BoundingBox);
+    main_octree.insert(&triangle);
+    main_octree.insert(&triangle2);
+    benchmarkPackets("main.cpp scene", main_octree, 800, 800);
+
+    for (unsigned int triangle_count : {10000u, TRIANGLE_COUNT}) {
+        std::vector<Triangle> triangles = makeRandomTriangles(triangle_count, Eigen::Vector3d(0, 0, 10), 10.0, 0.3);
+        std::vector<const Triangle*> objects;
+        for (const Triangle& generated : triangles) {
+            objects.push_back(&generated);
+        }
+
+        Octree<Triangle> octree(16, 1.0, 8, Eigen::Vector3d::Zero(), OctreeInsertion::BoundingBox);
+        octree.build(objects);
+        benchmarkPackets(std::to_string(triangle_count) + " triangles", octree, 400, 400);
+    }
+}
+
+// Camera rays traced by tiles of 16x16 pixels in 2x2 packets, from the root or from the subtrees crossed by the frustum of each tile
+BENCHMARK("[Octree] tile frustum culling") {
+    constexpr unsigned int WIDTH = 400, HEIGHT = 400, TILE_SIZE = 16;
+    std::vector<Triangle> triangles = makeRandomTriangles(TRIANGLE_COUNT, Eigen::Vector3d(0, 15, 0), 20.0, 0.3);
+    std::vector<const Triangle*> objects;
+    for (const Triangle& triangle : triangles) {
+        objects.push_back(&triangle);
+    }
+    Octree<Triangle> octree(16, 1.0, 8, Eigen::Vector3d::Zero(), OctreeInsertion::BoundingBox);
+    octree.build(objects);
+    octree.finalize();
+
+    Camera camera(Eigen::Vector3d::Zero(), 1.7, 1.7, WIDTH, HEIGHT, 1.0);
+    const std::vector<Ray>& rays = camera.getRays();
+
+    // max_nodes = 0 traces every tile from the root
+    std::cout << triangles.size() << " triangles, " << rays.size() << " camera rays in tiles of " << TILE_SIZE << "x" << TILE_SIZE << ":" << std::endl;
+    double root_seconds = 0;
+    for (std::size_t max_nodes : {std::size_t(0), std::size_t(4), std::size_t(8), std::size_t(16), std::size_t(32), std::size_t(64)}) {
+        unsigned int hits = 0, culled_tiles = 0;
+        std::size_t entry_count = 0;
+        double cull_seconds = 0;
+        const double seconds = measureSeconds([&]() {
+            hits = culled_tiles = 0;
+            entry_count = 0;
+            cull_seconds = 0;
+            OctreeEntryPoints entry_points;
+            for (unsigned int first_row = 0; first_row < HEIGHT; first_row += TILE_SIZE) {
+                for (unsigned int first_column = 0; first_column < WIDTH; first_column += TILE_SIZE) {
+                    const unsigned int last_row = std::min(first_row + TILE_SIZE, HEIGHT), last_column = std::min(first_column + TILE_SIZE, WIDTH);
+                    const unsigned char signs = getDirectionOctant(camera.getRay(first_row, first_column).getDirection());
+                    entry_points = OctreeEntryPoints();
+                    if (max_nodes > 0 && getDirectionOctant(camera.getRay(last_row - 1, last_column - 1).getDirection()) == signs &&
+                        getDirectionOctant(camera.getRay(first_row, last_column - 1).getDirection()) == signs &&
+                        getDirectionOctant(camera.getRay(last_row - 1, first_column).getDirection()) == signs) {
+                        cull_seconds += measureSeconds([&]() {
+                            octree.cullFrustum(camera.getFrustum(first_row, first_column, last_row, last_column), signs, entry_points, max_nodes);
+                        });
+                        ++culled_tiles;
+                        entry_count += entry_points.nodes.size();
+                    }
+
+                    for (unsigned int i = first_row; i < last_row; i += 2) {
+                        for (unsigned int j = first_column; j < last_column; j += 2) {
+                            RayPacket<4> packet;
+                            for (unsigned int lane = 0; lane < 4; ++lane) {
+                                packet.set(lane, camera.getRay(i + lane / 2, j + lane % 2));
+                            }
+                            RayPacket<4>::Lanes hit_distances;
+                            for (const Triangle* hit : octree.traceRays(packet, hit_distances, entry_points)) {
+                                hits += hit != nullptr;
+                            }
+                        }
+                    }
+                }
+            }
+        }, 3);
+        if (max_nodes == 0) root_seconds = seconds;
+
+        if (max_nodes == 0) {
+            std::cout << "  from the root:       ";
+        } else {
+            std::cout << "  at most " << std::setw(2) << max_nodes << " subtrees: ";
+        }
+        std::cout << std::fixed << std::setprecision(1) << std::setw(7) << rays.size() / seconds * 1e-3 << " krays/s (x" << std::setprecision(2) << root_seconds / seconds
+                  << ", " << hits << " hits), " << culled_tiles << " culled tiles, " << std::setprecision(1)
+                  << (culled_tiles ? double(entry_count) / culled_tiles : 0.0) << " subtrees per tile, culling "
+                  << std::setprecision(2) << cull_seconds * 1e3 << " ms" << std::endl;
+    }
+}
+
+// Randomly directed rays traced one by one and as streams of several batch sizes
+BENCHMARK("[Octree] ray streams") {
+    std::vector<Triangle> triangles = makeRandomTriangles(TRIANGLE_COUNT, Eigen::Vector3d::Zero(), 20.0, 0.3);
+    std::vector<const Triangle*> objects;
+    for (const Triangle& triangle : triangles) {
+        objects.push_back(&triangle);
+    }
+    std::vector<Ray> rays = makeRandomRays(5 * RAY_COUNT, 15.0);
+
+    Octree<Triangle> octree(16, 1.0, 8, Eigen::Vector3d::Zero(), OctreeInsertion::BoundingBox);
+    octree.build(objects);
+    octree.finalize();
+
+    unsigned int single_hits = 0;
+    const double single_seconds = measureSeconds([&]() {
+        for (const Ray& ray : rays) {
+            double hit_distance;
+            single_hits += octree.traceRay(ray, hit_distance) != nullptr;
+        }
+    });
+    std::cout << triangles.size() << " triangles, " << rays.size() << " random rays:" << std::endl << std::fixed << std::setprecision(1)
+              << "  single rays:         " << std::setw(7) << rays.size() / single_seconds * 1e-3 << " krays/s"
+              << " (" << single_hits << " hits)" << std::endl;
+
+    std::vector<double> hit_distances(rays.size());
+    for (std::size_t batch_size : {std::size_t(1024), std::size_t(16384), rays.size()}) {
+        unsigned int hits = 0;
+        const double seconds = measureSeconds([&]() {
+            for (std::size_t first = 0; first < rays.size(); first += batch_size) {
+                const std::size_t count = std::min(batch_size, rays.size() - first);
+                for (const Triangle* hit : octree.traceRayStream(std::span<const Ray>(rays).subspan(first, count),
+                                                                 std::span<double>(hit_distances).subspan(first, count))) {
+                    hits += hit != nullptr;
+                }
+            }
+        });
+        std::cout << "  streams of " << std::setw(6) << batch_size << ": " << std::setw(7) << rays.size() / seconds * 1e-3 << " krays/s (x"
+                  << std::setprecision(2) << single_seconds / seconds << std::setprecision(1) << ", " << hits << " hits)" << std::endl;
+    }
+}
+
+// The intersection kernels of the leaves, for each instruction set supported by the processor: triangles tested per second by a kernel alone,
+//      and rays traced per second by octrees with small and large leaves
+BENCHMARK("[Octree] leaf kernels") {
+    std::vector<Triangle> triangles = makeRandomTriangles(TRIANGLE_COUNT, Eigen::Vector3d::Zero(), 20.0, 0.3);
+    std::vector<const Triangle*> objects;
+    for (const Triangle& triangle : triangles) {
+        objects.push_back(&triangle);
+    }
+    std::vector<Ray> rays = makeRandomRays(5 * RAY_COUNT, 15.0);
+
+    // The records of 1024 triangles fit in the L2 cache, as the records of the leaves crossed by a ray
+    constexpr std::size_t BLOCK_TRIANGLE_COUNT = 1024;
+    TriangleBlockArray blocks;
+    for (std::size_t i = 0; i < BLOCK_TRIANGLE_COUNT; ++i) {
+        blocks.push_back(triangles[i].getIntersectionRecord());
+    }
+
+    Octree<Triangle> small_leaves(16, 1.0, 8, Eigen::Vector3d::Zero(), OctreeInsertion::BoundingBox);
+    small_leaves.build(objects);
+    small_leaves.finalize();
+    Octree<Triangle> large_leaves(16, 1.0, 32, Eigen::Vector3d::Zero(), OctreeInsertion::BoundingBox);
+    large_leaves.build(objects);
+    large_leaves.finalize();
+
+    const SimdLevel initial_level = getTriangleKernelLevel();
+    std::cout << triangles.size() << " triangles, " << rays.size() << " random rays, best kernel: " << getSimdLevelName(getSupportedSimdLevel()) << std::endl;
+    double scalar_kernel_seconds = 0, scalar_small_seconds = 0, scalar_large_seconds = 0;
+    for (SimdLevel level : {SimdLevel::Scalar, SimdLevel::SSE4, SimdLevel::AVX2, SimdLevel::AVX512}) {
+        if (level > getSupportedSimdLevel()) break;
+        setTriangleKernelLevel(level);
+
+        const std::size_t kernel_ray_count = rays.size() / 50;
+        unsigned int kernel_hits = 0;
+        const double kernel_seconds = measureSeconds([&]() {
+            for (std::size_t i = 0; i < kernel_ray_count; ++i) {
+                blocks.intersect(rays[i], 0, blocks.size(), [&](std::size_t, float) { ++kernel_hits; return false; });
+            }
+        });
+
+        unsigned int small_hits = 0, large_hits = 0;
+        const double small_seconds = measureSeconds([&]() {
+            for (const Ray& ray : rays) {
+                double hit_distance;
+                small_hits += small_leaves.traceRay(ray, hit_distance) != nullptr;
+            }
+        });
+        const double large_seconds = measureSeconds([&]() {
+            for (const Ray& ray : rays) {
+                double hit_distance;
+                large_hits += large_leaves.traceRay(ray, hit_distance) != nullptr;
+            }
+        });
+        if (level == SimdLevel::Scalar) {
+            scalar_kernel_seconds = kernel_seconds;
+            scalar_small_seconds = small_seconds;
+            scalar_large_seconds = large_seconds;
+        }
+
+        std::cout << std::fixed << "  " << std::left << std::setw(7) << getSimdLevelName(level) << std::right << std::setprecision(2)
+                  << " kernel: " << std::setw(6) << kernel_seconds / (kernel_ray_count * BLOCK_TRIANGLE_COUNT) * 1e9 << " ns/triangle (x"
+                  << scalar_kernel_seconds / kernel_seconds << ", " << kernel_hits << " hits)" << std::setprecision(1)
+                  << ", leaves of 8: " << std::setw(6) << rays.size() / small_seconds * 1e-3 << " krays/s (x" << std::setprecision(2)
+                  << scalar_small_seconds / small_seconds << std::setprecision(1)
+                  << "), leaves of 32: " << std::setw(6) << rays.size() / large_seconds * 1e-3 << " krays/s (x" << std::setprecision(2)
+                  << scalar_large_seconds / large_seconds << ", " << small_hits << "/" << large_hits << " hits)" << std::endl;
+    }
+    setTriangleKernelLevel(initial_level);
+}
+
+// The same octree and the same random rays in double and in single precision: kernels, traversal and memory of the flat layout
+BENCHMARK("[Octree] single precision") {
+    std::vector<Triangle> triangles = makeRandomTriangles(TRIANGLE_COUNT, Eigen::Vector3d::Zero(), 20.0, 0.3);
+    std::vector<const Triangle*> objects;
+    for (const Triangle& triangle : triangles) {
+        objects.push_back(&triangle);
+    }
+    std::vector<Ray> rays = makeRandomRays(5 * RAY_COUNT, 15.0);
+    std::vector<RayF> rays_f;
+    for (const Ray& ray : rays) {
+        rays_f.push_back(ray.cast<float>());
+    }
+
+    constexpr std::size_t BLOCK_TRIANGLE_COUNT = 1024;
+    TriangleBlockArray blocks;
+    TriangleBlockArrayF blocks_f;
+    for (std::size_t i = 0; i < BLOCK_TRIANGLE_COUNT; ++i) {
+        blocks.push_back(triangles[i].getIntersectionRecord());
+        blocks_f.push_back(triangles[i].getIntersectionRecord());
+    }
+
+    Octree<Triangle> octree(16, 1.0, 32, Eigen::Vector3d::Zero(), OctreeInsertion::BoundingBox);
+    octree.build(objects);
+    octree.finalize();
+    Octree<Triangle, NodeArena, FlatOctreeNode, float> octree_f(16, 1.0, 32, Eigen::Vector3d::Zero(), OctreeInsertion::BoundingBox);
+    octree_f.build(objects);
+    octree_f.finalize();
+
+    std::cout << triangles.size() << " triangles, " << rays.size() << " random rays, flat layout: "
+              << octree.getFlatOctree().bytes() / 1024 << " KiB in double, " << octree_f.getFlatOctree().bytes() / 1024 << " KiB in float" << std::endl;
+
+    const SimdLevel initial_level = getTriangleKernelLevel();
+    for (SimdLevel level : {SimdLevel::Scalar, SimdLevel::SSE4, SimdLevel::AVX2, SimdLevel::AVX512}) {
+        if (level > getSupportedSimdLevel()) break;
+        setTriangleKernelLevel(level);
+
+        const std::size_t kernel_ray_count = rays.size() / 50;
+        unsigned int kernel_hits = 0, kernel_hits_f = 0;
+        const double kernel_seconds = measureSeconds([&]() {
+            for (std::size_t i = 0; i < kernel_ray_count; ++i) {
+                blocks.intersect(rays[i], 0, blocks.size(), [&](std::size_t, float) { ++kernel_hits; return false; });
+            }
+        });
+        const double kernel_seconds_f = measureSeconds([&]() {
+            for (std::size_t i = 0; i < kernel_ray_count; ++i) {
+                blocks_f.intersect(rays_f[i], 0, blocks_f.size(), [&](std::size_t, float) { ++kernel_hits_f; return false; });
+            }
+        });
+
+        unsigned int hits = 0, hits_f = 0;
+        const double seconds = measureSeconds([&]() {
+            for (const Ray& ray : rays) {
+                double hit_distance;
+                hits += octree.traceRay(ray, hit_distance) != nullptr;
+            }
+        });
+        const double seconds_f = measureSeconds([&]() {
+            for (const RayF& ray : rays_f) {
+                float hit_distance;
+                hits_f += octree_f.traceRay(ray, hit_distance) != nullptr;
+            }
+        });
+
+        const double kernel_triangles = double(kernel_ray_count * BLOCK_TRIANGLE_COUNT);
+        std::cout << std::fixed << "  " << std::left << std::setw(7) << getSimdLevelName(level) << std::right << std::setprecision(2)
+                  << " kernel: " << std::setw(5) << kernel_seconds / kernel_triangles * 1e9 << " / " << std::setw(5)
+                  << kernel_seconds_f / kernel_triangles * 1e9 << " ns/triangle (x" << kernel_seconds / kernel_seconds_f << ", "
+                  << kernel_hits << "/" << kernel_hits_f << " hits)" << std::setprecision(1)
+                  << ", octree: " << std::setw(6) << rays.size() / seconds * 1e-3 << " / " << std::setw(6) << rays.size() / seconds_f * 1e-3
+                  << " krays/s (x" << std::setprecision(2) << seconds / seconds_f << ", " << hits << "/" << hits_f << " hits)" << std::endl;
+    }
+    setTriangleKernelLevel(initial_level);
+}
+
+// Traversal alone, without testing the objects: nodes visited per second by the box and sorted planes traversal and by the parametric one
+BENCHMARK("[Octree] traversal") {
+    std::vector<Triangle> triangles = makeRandomTriangles(TRIANGLE_COUNT, Eigen::Vector3d::Zero(), 20.0, 0.3);
+    std::vector<const Triangle*> objects;
+    for (const Triangle& triangle : triangles) {
+        objects.push_back(&triangle);
+    }
+    std::vector<Ray> rays = makeRandomRays(5 * RAY_COUNT, 15.0);
+
+    for (OctreeInsertion insertion : {OctreeInsertion::Position, OctreeInsertion::BoundingBox}) {
+        Octree<Triangle> octree(16, 1.0, 8, Eigen::Vector3d::Zero(), insertion);
+        octree.build(objects);
+        const FlatOctree<Triangle>& flat_octree = octree.getFlatOctree();
+        const Eigen::Vector3d& center = flat_octree.getRootCenter();
+        const double half_size = flat_octree.getRootHalfSize();
+
+        std::size_t sorted_nodes = 0;
+        const double sorted_seconds = measureSeconds([&]() {
+            for (const Ray& ray : rays) {
+                sorted_nodes += visitSortedPlanes(flat_octree, 0, center, half_size, ray);
+            }
+        });
+
+        std::size_t parametric_nodes = 0;
+        const double parametric_seconds = measureSeconds([&]() {
+            for (const Ray& ray : rays) {
+                const unsigned char signs = getDirectionOctant(ray.getDirection());
+                parametric_nodes += visitParametric(flat_octree, 0, center, half_size, getNodeSlabs(center, half_size, ray, signs), signs, ray);
+            }
+        });
+
+        std::cout << (insertion == OctreeInsertion::Position ? "position" : "bounding box") << " insertion, "
+                  << flat_octree.getNodes().size() << " nodes, " << rays.size() << " random rays:" << std::endl << std::fixed << std::setprecision(1)
+                  << "  sorted planes: " << std::setw(7) << sorted_nodes / sorted_seconds * 1e-6 << " Mnodes/s"
+                  << " (" << double(sorted_nodes) / rays.size() << " nodes/ray)" << std::endl
+                  << "  parametric:    " << std::setw(7) << parametric_nodes / parametric_seconds * 1e-6 << " Mnodes/s"
+                  << " (" << double(parametric_nodes) / rays.size() << " nodes/ray, x"
+                  << std::setprecision(2) << sorted_seconds / parametric_seconds << ")" << std::endl;
+    }
+}
+
+// Moving a fraction of the objects of an octree: incremental updates against a rebuild from scratch
+BENCHMARK("[Octree] incremental updates") {
+    std::vector<Triangle> triangles = makeRandomTriangles(TRIANGLE_COUNT, Eigen::Vector3d::Zero(), 20.0, 0.3);
+    std::vector<const Triangle*> objects;
+    for (const Triangle& triangle : triangles) {
+        objects.push_back(&triangle);
+    }
+
+    Octree<Triangle> octree(16, 1.0, 8, Eigen::Vector3d::Zero(), OctreeInsertion::BoundingBox);
+    const double rebuild_seconds = measureSeconds([&]() {
+        octree.build(objects);
+        octree.finalize();
+    });
+
+    // The first update after a build records the leaves of all the objects
+    const double first_update_seconds = measureSeconds([&]() { octree.update(objects.front()); });
+    std::cout << triangles.size() << " triangles:" << std::endl << std::fixed << std::setprecision(1)
+              << "  rebuild:                       " << std::setw(8) << rebuild_seconds * 1e3 << " ms" << std::endl
+              << "  first update:                  " << std::setw(8) << first_update_seconds * 1e3 << " ms" << std::endl;
+
+    for (unsigned int moved_count : {100u, 1000u, 10000u}) {
+        const unsigned int step = TRIANGLE_COUNT / moved_count;
+        const double update_seconds = measureSeconds([&]() {
+            for (unsigned int i = 0; i < TRIANGLE_COUNT; i += step) {
+                triangles[i].translate(Eigen::Vector3d(0.1, -0.05, 0.02));
+                octree.update(&triangles[i]);
+            }
+        });
+        const double finalize_seconds = measureSeconds([&]() { octree.finalize(); });
+        std::cout << "  update " << std::setw(5) << moved_count << " triangles: " << std::setw(8) << update_seconds * 1e3 << " ms"
+                  << " + flat layout " << std::setw(6) << finalize_seconds * 1e3 << " ms" << std::endl;
+    }
+}
@@ -0,0 +1,88 @@
+#include <algorithm>
+#include <iomanip>
+#include <thread>
+
+#include "benchmark.hpp"
+#include "camera.hpp"
+#include "light.hpp"
+#include "scene.hpp"
+
+// Frames per second of Scene::getRender for 1 to N threads, N being the number of hardware threads
+BENCHMARK("[Render] thread scaling") {
+    constexpr unsigned int WIDTH = 400;
+    constexpr unsigned int HEIGHT = 400;
+
+    Camera camera(Eigen::Vector3d::Zero(), 1.7, 1.7, WIDTH, HEIGHT, 1.0);
+    LightSource light(Eigen::Vector3d(0, 5, 0), Eigen::Vector3d(1, 1, 1), 255);
+
+    // A cloud of triangles covering part of the frame, so that tiles have uneven costs
+    std::vector<Triangle> triangles = makeRandomTriangles(5000, Eigen::Vector3d(1, 0, 6), 4.0, 0.2);
+
+    Scene scene(&camera, 10, 8.0, 8);
+    scene.setLightSource(&light);
+    for (Triangle& triangle : triangles) {
+        scene.addTriangle(&triangle);
+    }
+
+    // Powers of two up to the number of hardware threads, which is always measured
+    const unsigned int max_threads = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<unsigned int> thread_counts;
+    for (unsigned int thread_count = 1; thread_count < max_threads; thread_count *= 2) {
+        thread_counts.push_back(thread_count);
+    }
+    thread_counts.push_back(max_threads);
+
+    double single_thread_fps = 0;
+    for (unsigned int thread_count : thread_counts) {
+        scene.setThreadCount(thread_count);
+        double seconds = measureSeconds([&]() { scene.getRender(); }, 3);
+        double fps = 1.0 / seconds;
+        if (thread_count == 1) single_thread_fps = fps;
+
+        std::cout << std::setw(3) << thread_count << " threads: " << std::fixed << std::setprecision(2)
+                  << fps << " frames/s (x" << fps / single_thread_fps << ")" << std::endl;
+    }
+}
+
+// Rays per second of Scene::castRays, against tracing the rays one by one and intersecting the hit triangle again for its hit record
+BENCHMARK("[Scene] ray casts") {
+    constexpr unsigned int RAY_COUNT = 200000;
+
+    Camera camera(Eigen::Vector3d::Zero(), 1.7, 1.7, 40, 30, 1.0);
+    std::vector<Triangle> triangles = makeRandomTriangles(200000, Eigen::Vector3d::Zero(), 20.0, 0.3);
+    std::vector<Triangle*> objects;
+    for (Triangle& triangle : triangles) {
+        objects.push_back(&triangle);
+    }
+    Scene scene(&camera);
+    scene.addTriangles(objects);
+
+    // Incoherent rays, as the rays of a sensor
+    std::vector<Ray> rays = makeRandomRays(RAY_COUNT, 20.0);
+    std::vector<Hit> hits(RAY_COUNT);
+
+    Octree<Triangle> octree(OctreeInsertion::BoundingBox);
+    octree.build(std::vector<const Triangle*>(objects.begin(), objects.end()));
+    octree.finalize();
+    double one_by_one_seconds = measureSeconds([&]() {
+        for (unsigned int i = 0; i < RAY_COUNT; ++i) {
+            hits[i] = Hit();
+            hits[i].triangle = octree.traceRay(rays[i], hits[i].distance);
+            float t;
+            if (hits[i].triangle) hits[i].triangle->intersect(rays[i], hits[i].u, hits[i].v, t);
+        }
+    }, 1);
+    std::cout << "one by one:        " << std::fixed << std::setprecision(2) << RAY_COUNT / one_by_one_seconds / 1e6 << " Mrays/s" << std::endl;
+
+    // The structure of the scene is built by its first cast, which is not measured, as the build of the octree above
+    scene.castRays(rays, hits);
+
+    std::vector<unsigned int> thread_counts = {1};
+    if (std::thread::hardware_concurrency() > 1) thread_counts.push_back(std::thread::hardware_concurrency());
+    for (unsigned int thread_count : thread_counts) {
+        scene.setThreadCount(thread_count);
+        double seconds = measureSeconds([&]() { scene.castRays(rays, hits); }, 1);
+        std::cout << "castRays, " << std::setw(3) << thread_count << " threads: " << RAY_COUNT / seconds / 1e6 << " Mrays/s (x"
+                  << one_by_one_seconds / seconds << ")" << std::endl;
+    }
+}
@@ -0,0 +1,297 @@
+#include <iomanip>
+#include <string>
+
+#include "benchmark.hpp"
+#include "Structures/bvh.hpp"
+#include "Structures/octree.hpp"
+#include "instance.hpp"
+
+namespace {
+    constexpr unsigned int TRIANGLE_COUNT = 200000;
+    constexpr unsigned int RAY_COUNT = 20000;
+
+    /// @brief Add the walls of a room made of large triangles, 2 per wall
+    void addRoom(std::vector<Triangle>& triangles, double half_room) {
+        for (int axis = 0; axis < 3; ++axis) {
+            for (double side : {-half_room, half_room}) {
+                Eigen::Vector3d position = Eigen::Vector3d::Zero();
+                position[axis] = side;
+                Eigen::Vector3d u = Eigen::Vector3d::Zero(), v = Eigen::Vector3d::Zero();
+                u[(axis + 1) % 3] = half_room;
+                v[(axis + 2) % 3] = half_room;
+                triangles.emplace_back(position, -u - v, u - v, u + v);
+                triangles.emplace_back(position, -u - v, u + v, -u + v);
+            }
+        }
+    }
+
+    /// @brief Measure the bulk build and the traversal of an acceleration structure
+    template <typename Structure>
+    void benchmarkStructure(const std::string& name, Structure& structure, const std::vector<const Triangle*>& objects, const std::vector<Ray>& rays) {
+        double build_seconds = measureSeconds([&]() {
+            structure.build(objects);
+            structure.finalize();
+        });
+
+        unsigned int hits = 0;
+        double trace_seconds = measureSeconds([&]() {
+            for (const Ray& ray : rays) {
+                double hit_distance;
+                hits += structure.traceRay(ray, hit_distance) != nullptr;
+            }
+        });
+
+        std::cout << "  " << std::left << std::setw(7) << name << std::right << std::fixed << std::setprecision(1)
+                  << " build: " << std::setw(7) << build_seconds * 1e3 << " ms"
+                  << " | traversal: " << std::setw(7) << rays.size() / trace_seconds * 1e-3 << " krays/s"
+                  << " (" << hits << " hits)" << std::endl;
+    }
+
+    /// @brief Measure the closest hit and the any hit queries of an acceleration structure on the same segments
+    template <typename Structure>
+    void benchmarkOcclusion(const std::string& name, const Structure& structure, const std::vector<Ray>& rays, const std::vector<double>& max_distances) {
+        unsigned int closest_hits = 0;
+        double closest_seconds = measureSeconds([&]() {
+            for (std::size_t i = 0; i < rays.size(); ++i) {
+                double hit_distance;
+                closest_hits += structure.traceRay(rays[i], hit_distance, max_distances[i]) != nullptr;
+            }
+        });
+
+        unsigned int occluded = 0;
+        double occluded_seconds = measureSeconds([&]() {
+            for (std::size_t i = 0; i < rays.size(); ++i) {
+                occluded += structure.occluded(rays[i], max_distances[i]);
+            }
+        });
+
+        std::cout << "  " << std::left << std::setw(7) << name << std::right << std::fixed << std::setprecision(1)
+                  << " traceRay: " << std::setw(7) << rays.size() / closest_seconds * 1e-3 << " krays/s"
+                  << " | occluded: " << std::setw(7) << rays.size() / occluded_seconds * 1e-3 << " krays/s"
+                  << " (" << closest_hits << " / " << occluded << " shadowed)" << std::endl;
+    }
+
+    /// @brief Measure the bulk build, the size and the traversal of an octree on a scene
+    void benchmarkOctreeConfiguration(const std::string& name, Octree<Triangle>& octree, const std::vector<const Triangle*>& objects,
+                                      const std::vector<Ray>& rays) {
+        double build_seconds = measureSeconds([&]() {
+            octree.build(objects);
+            octree.finalize();
+        });
+
+        unsigned int hits = 0;
+        double trace_seconds = measureSeconds([&]() {
+            for (const Ray& ray : rays) {
+                double hit_distance;
+                hits += octree.traceRay(ray, hit_distance) != nullptr;
+            }
+        });
+
+        const OctreeStats stats = octree.stats();
+        std::cout << "  " << std::left << std::setw(22) << name << std::right << std::fixed << std::setprecision(1)
+                  << " build: " << std::setw(7) << build_seconds * 1e3 << " ms"
+                  << " | flat layout: " << std::setw(6) << stats.flat_bytes / 1048576.0 << " MiB"
+                  << " | expected cost: " << std::setw(7) << stats.traversal_cost
+                  << " (" << std::setw(4) << std::setprecision(0) << stats.getEmptyLeafRatio() * 100 << "% empty leaves)" << std::setprecision(1)
+                  << " | traversal: " << std::setw(7) << rays.size() / trace_seconds * 1e-3 << " krays/s"
+                  << " (" << hits << " hits)" << std::endl;
+    }
+
+    /// @brief Compare the octree and the bounding volume hierarchy on the same scene
+    void compareStructures(const std::string& scene_name, const std::vector<Triangle>& triangles, const std::vector<Ray>& rays) {
+        std::vector<const Triangle*> objects;
+        objects.reserve(triangles.size());
+        for (const Triangle& triangle : triangles) {
+            objects.push_back(&triangle);
+        }
+
+        std::cout << scene_name << ", " << triangles.size() << " triangles:" << std::endl;
+
+        Octree<Triangle> octree(16, 1.0, 8, Eigen::Vector3d::Zero(), OctreeInsertion::BoundingBox);
+        benchmarkStructure("octree", octree, objects, rays);
+
+        Bvh<Triangle> bvh(4, 16);
+        benchmarkStructure("bvh", bvh, objects, rays);
+    }
+}
+
+// Build time and ray tracing speed of the octree and of the bounding volume hierarchy on uniform and uneven scenes
+BENCHMARK("[Structures] octree and BVH") {
+    std::vector<Ray> rays = makeRandomRays(RAY_COUNT, 15.0);
+
+    // Small triangles spread uniformly
+    std::vector<Triangle> uniform = makeRandomTriangles(TRIANGLE_COUNT, Eigen::Vector3d::Zero(), 20.0, 0.3);
+    compareStructures("uniform cloud", uniform, rays);
+
+    // A few dense clusters of small triangles, like scanned objects in an empty space
+    std::vector<Triangle> clusters;
+    for (unsigned int i = 0; i < 8; ++i) {
+        Eigen::Vector3d center(((i & 4) ? 6.0 : -6.0) + i, (i & 2) ? 5.0 : -5.0, (i & 1) ? 7.0 : -4.0);
+        std::vector<Triangle> cluster = makeRandomTriangles(TRIANGLE_COUNT / 8, center, 1.5, 0.05, 42 + i);
+        clusters.insert(clusters.end(), cluster.begin(), cluster.end());
+    }
+    compareStructures("clusters", clusters, rays);
+
+    // A room of large walls around a small dense object, like an architectural interior
+    std::vector<Triangle> interior = makeRandomTriangles(TRIANGLE_COUNT, Eigen::Vector3d(1, -2, 0), 3.0, 0.05);
+    addRoom(interior, 12.0);
+    compareStructures("interior", interior, rays);
+}
+
+// Octrees configured by hand against octrees configured by their cost model, with a few ratios of the costs
+BENCHMARK("[Structures] octree cost model") {
+    std::vector<Ray> rays = makeRandomRays(RAY_COUNT, 15.0);
+
+    std::vector<std::pair<std::string, std::vector<Triangle>>> scenes;
+    scenes.emplace_back("uniform cloud", makeRandomTriangles(TRIANGLE_COUNT, Eigen::Vector3d::Zero(), 20.0, 0.3));
+    std::vector<Triangle>& clusters = scenes.emplace_back("clusters", std::vector<Triangle>()).second;
+    for (unsigned int i = 0; i < 8; ++i) {
+        Eigen::Vector3d center(((i & 4) ? 6.0 : -6.0) + i, (i & 2) ? 5.0 : -5.0, (i & 1) ? 7.0 : -4.0);
+        std::vector<Triangle> cluster = makeRandomTriangles(TRIANGLE_COUNT / 8, center, 1.5, 0.05, 42 + i);
+        clusters.insert(clusters.end(), cluster.begin(), cluster.end());
+    }
+    std::vector<Triangle>& interior = scenes.emplace_back("interior", makeRandomTriangles(TRIANGLE_COUNT, Eigen::Vector3d(1, -2, 0), 3.0, 0.05)).second;
+    addRoom(interior, 12.0);
+
+    for (const auto& [scene_name, triangles] : scenes) {
+        std::vector<const Triangle*> objects;
+        for (const Triangle& triangle : triangles) {
+            objects.push_back(&triangle);
+        }
+        std::cout << scene_name << ", " << triangles.size() << " triangles:" << std::endl;
+
+        Octree<Triangle> tuned(16, 1.0, 8, Eigen::Vector3d::Zero(), OctreeInsertion::BoundingBox);
+        benchmarkOctreeConfiguration("manual (16, 1.0, 8)", tuned, objects, rays);
+        Octree<Triangle> shallow(5, 2.5, 3, Eigen::Vector3d::Zero(), OctreeInsertion::BoundingBox);
+        benchmarkOctreeConfiguration("manual (5, 2.5, 3)", shallow, objects, rays);
+
+        for (double intersection_cost : {0.5, 1.0, 2.0, 4.0}) {
+            Octree<Triangle> automatic(OctreeInsertion::BoundingBox, OctreeCostModel{1.0, intersection_cost});
+            benchmarkOctreeConfiguration("cost model (1 : " + std::to_string(intersection_cost).substr(0, 3) + ")", automatic, objects, rays);
+        }
+    }
+}
+
+// Closest hit against any hit queries on shadow rays, which only need to know if something lies between a point and the light
+BENCHMARK("[Structures] occlusion queries") {
+    std::vector<Triangle> triangles = makeRandomTriangles(TRIANGLE_COUNT, Eigen::Vector3d(1, -2, 0), 3.0, 0.05);
+    addRoom(triangles, 12.0);
+    std::vector<const Triangle*> objects;
+    for (const Triangle& triangle : triangles) {
+        objects.push_back(&triangle);
+    }
+
+    Octree<Triangle> octree(16, 1.0, 8, Eigen::Vector3d::Zero(), OctreeInsertion::BoundingBox);
+    octree.build(objects);
+    octree.finalize();
+
+    Bvh<Triangle> bvh(4, 16);
+    bvh.build(objects);
+
+    // Shadow rays from the points seen by an eye in the room, towards a light above the object in the middle of the room
+    const Eigen::Vector3d eye(0, 0, -10);
+    const Eigen::Vector3d light(1, 4, 2);
+    std::vector<Ray> shadow_rays;
+    std::vector<double> light_distances;
+    for (const Ray& ray : makeRandomRays(RAY_COUNT, 5.0)) {
+        Ray primary_ray(eye, ray.getOrigin() + ray.getDirection() - eye);
+        double hit_distance;
+        if (bvh.traceRay(primary_ray, hit_distance) == nullptr) continue;
+
+        const Eigen::Vector3d hit_position = eye + primary_ray.getDirection() * hit_distance;
+        const Eigen::Vector3d to_light = light - hit_position;
+        shadow_rays.emplace_back(hit_position + to_light.normalized() * 1e-4, to_light);
+        light_distances.push_back(to_light.norm() - 1e-4);
+    }
+
+    std::cout << triangles.size() << " triangles, " << shadow_rays.size() << " shadow rays:" << std::endl;
+    benchmarkOcclusion("octree", octree, shadow_rays, light_distances);
+    benchmarkOcclusion("bvh", bvh, shadow_rays, light_distances);
+}
+
+// Many copies of the same mesh, placed by instances of a shared octree or flattened into one hierarchy of all their triangles
+BENCHMARK("[Structures] instanced meshes") {
+    constexpr unsigned int MESH_TRIANGLES = 2000;
+    constexpr int GRID_SIDE = 8; // 8 x 8 x 4 copies of the mesh
+
+    std::vector<Triangle> mesh_triangles = makeRandomTriangles(MESH_TRIANGLES, Eigen::Vector3d::Zero(), 1.0, 0.1);
+    std::vector<const Triangle*> mesh_objects;
+    for (const Triangle& triangle : mesh_triangles) {
+        mesh_objects.push_back(&triangle);
+    }
+
+    Mesh mesh(mesh_objects);
+    std::vector<Instance> instances;
+    std::vector<Triangle> copies;
+    instances.reserve(GRID_SIDE * GRID_SIDE * GRID_SIDE / 2);
+    copies.reserve(GRID_SIDE * GRID_SIDE * GRID_SIDE / 2 * MESH_TRIANGLES);
+    for (int i = 0; i < GRID_SIDE * GRID_SIDE * GRID_SIDE / 2; ++i) {
+        const Eigen::Vector3d position(2.5 * (i % GRID_SIDE - GRID_SIDE / 2), 2.5 * (i / GRID_SIDE % GRID_SIDE - GRID_SIDE / 2),
+                                       2.5 * (i / (GRID_SIDE * GRID_SIDE)));
+        const Eigen::Vector3d rotation(0.1 * i, 0.3, -0.2 * i);
+        instances.emplace_back(mesh, position).rotate(rotation);
+        for (const Triangle& triangle : mesh_triangles) {
+            copies.emplace_back(position, triangle.getPoint(0), triangle.getPoint(1), triangle.getPoint(2)).rotate(rotation);
+        }
+    }
+
+    std::vector<const Instance*> instance_objects;
+    for (const Instance& instance : instances) {
+        instance_objects.push_back(&instance);
+    }
+    std::vector<const Triangle*> copy_objects;
+    for (const Triangle& copy : copies) {
+        copy_objects.push_back(&copy);
+    }
+
+    Bvh<Instance> instance_hierarchy(1, 16);
+    Bvh<Triangle> flat_hierarchy(4, 16);
+    double instance_build_seconds = measureSeconds([&]() { instance_hierarchy.build(instance_objects); });
+    double flat_build_seconds = measureSeconds([&]() { flat_hierarchy.build(copy_objects); });
+
+    // Bytes used by the geometry and the structures, the triangles of the mesh being stored once for all the instances
+    const std::size_t instance_bytes = mesh_triangles.size() * sizeof(Triangle) + mesh.getOctree().getFlatOctree().bytes() +
+                                       instances.size() * sizeof(Instance) + instance_hierarchy.bytes();
+    const std::size_t flat_bytes = copies.size() * sizeof(Triangle) + flat_hierarchy.bytes();
+
+    std::vector<Ray> rays = makeRandomRays(RAY_COUNT, 25.0);
+    auto measureTraversal = [&](const auto& structure) {
+        unsigned int hits = 0;
+        double seconds = measureSeconds([&]() {
+            for (const Ray& ray : rays) {
+                double hit_distance;
+                hits += structure.traceRay(ray, hit_distance) != nullptr;
+            }
+        });
+        return std::pair{seconds, hits};
+    };
+    auto [instance_seconds, instance_hits] = measureTraversal(instance_hierarchy);
+    auto [flat_seconds, flat_hits] = measureTraversal(flat_hierarchy);
+
+    // Moving every copy: only the hierarchy of the instances is rebuilt, against all the triangles of the flattened copies
+    double instance_move_seconds = measureSeconds([&]() {
+        for (Instance& instance : instances) {
+            instance.translate(Eigen::Vector3d(0.1, 0, 0));
+            instance_hierarchy.update(&instance);
+        }
+        instance_hierarchy.finalize();
+    });
+    double flat_move_seconds = measureSeconds([&]() {
+        for (Triangle& copy : copies) {
+            copy.translate(Eigen::Vector3d(0.1, 0, 0));
+        }
+        flat_hierarchy.build(copy_objects);
+    });
+
+    std::cout << instances.size() << " copies of a mesh of " << MESH_TRIANGLES << " triangles:" << std::endl;
+    for (auto [name, bytes, build_seconds, trace_seconds, hits, move_seconds] :
+            {std::tuple{"instanced", instance_bytes, instance_build_seconds, instance_seconds, instance_hits, instance_move_seconds},
+             std::tuple{"flattened", flat_bytes, flat_build_seconds, flat_seconds, flat_hits, flat_move_seconds}}) {
+        std::cout << "  " << std::left << std::setw(9) << name << std::right << std::fixed << std::setprecision(1)
+                  << " memory: " << std::setw(7) << bytes / 1048576.0 << " MiB"
+                  << " | build: " << std::setw(7) << build_seconds * 1e3 << " ms"
+                  << " | traversal: " << std::setw(7) << rays.size() / trace_seconds * 1e-3 << " krays/s"
+                  << " (" << hits << " hits)"
+                  << " | moving all copies: " << std::setw(7) << move_seconds * 1e3 << " ms" << std::endl;
+    }
+}
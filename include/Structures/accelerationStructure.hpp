@@ -0,0 +1,30 @@
+#pragma once
+
+#include <concepts>
+#include <span>
+
+#include "Structures/ray.hpp"
+#include "threadPool.hpp"
+
+// Concept AccelerationStructure: type 'S' stores pointers to objects of type 'T' to find the objects hit by rays quickly. It has
+//  `.insert` adding a single object.
+//  `.remove` removing a single object, and returning true if it was in the structure.
+//  `.update` taking into account that a single object moved.
+//  `.build` replacing all the objects at once, optionally on a thread pool.
+//  `.finalize` preparing the structure for the queries once the objects are added (the first query does it otherwise).
+//  `.traceRay` returning the first object hit by a ray, or nullptr, and setting the distance to the hit.
+//  `.occluded` checking if any object is hit by a ray before a maximum distance.
+//  `.clear` removing all the objects.
+// Octree and Bvh model this concept, so that Scene can use either of them.
+template<typename S, typename T>
+concept AccelerationStructure = requires(S structure, const S const_structure, const T* object, std::span<const T* const> objects,
+                                         ThreadPool* thread_pool, const Ray& ray, double& hit_distance, double max_distance) {
+    structure.insert(object);
+    { structure.remove(object) } -> std::convertible_to<bool>;
+    structure.update(object);
+    structure.build(objects, thread_pool);
+    structure.finalize();
+    structure.clear();
+    { const_structure.traceRay(ray, hit_distance) } -> std::convertible_to<const T*>;
+    { const_structure.occluded(ray, max_distance) } -> std::convertible_to<bool>;
+};
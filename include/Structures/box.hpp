@@ -1,34 +1,105 @@
 #pragma once
 
+#include <concepts>
+#include <limits>
 #include <Eigen/Dense>
 #include "Structures/ray.hpp"
 
 // @brief A structure representing an Axis-Aligned Bounding Box (AABB) in 3D space.
-// @details This structure is used to represent a 3D box defined by its minimum and maximum points in 3D space.
-struct Box
+// @details This structure is used to represent a 3D box defined by its minimum and maximum points in 3D space,
+//          whose coordinates are of type 'Scalar': `Box` (double) or `BoxF` (float).
+template <std::floating_point Scalar>
+struct BasicBox
 {
+    /// @brief The points of the box
+    using Array3 = Eigen::Array<Scalar, 3, 1>;
+
     /// @brief The minimum points of the box
-    Eigen::Array3d min;
+    Array3 min;
 
     /// @brief The maximum points of the box
-    Eigen::Array3d max;
+    Array3 max;
 
     /// @brief A method to check if a point is inside the box
     /// @param point The point to check
     /// @return true if the point is inside the box, false otherwise
-    bool contains(const Eigen::Array3d& point) const {
+    bool contains(const Array3& point) const {
         return (point >= min && point <= max).all();
     };
 
     /// @brief A method to check if another box is contained within this box
     /// @param other The other box to check
-    bool contains(const Box& other) const {
+    bool contains(const BasicBox& other) const {
         return (other.min >= min && other.max <= max).all();
     };
 
+    /// @brief A method to check if another box overlaps this box
+    /// @param other The other box to check
+    /// @return true if the boxes share at least one point (touching boxes overlap), false otherwise
+    bool overlaps(const BasicBox& other) const {
+        return (other.min <= max && other.max >= min).all();
+    };
+
+    /// @brief Get an empty box, that contains no point and becomes the other box when extended with it
+    /// @return A box whose minimum points are +infinity and maximum points are -infinity
+    static BasicBox empty() {
+        return BasicBox{Array3::Constant(std::numeric_limits<Scalar>::infinity()),
+                   Array3::Constant(-std::numeric_limits<Scalar>::infinity())};
+    };
+
+    /// @brief A method to grow the box so that it contains another box
+    /// @param other The other box
+    void extend(const BasicBox& other) {
+        min = min.min(other.min);
+        max = max.max(other.max);
+    };
+
+    /// @brief A method to grow the box so that it contains a point
+    /// @param point The point
+    void extend(const Array3& point) {
+        min = min.min(point);
+        max = max.max(point);
+    };
+
+    /// @brief Get the surface area of the box
+    /// @return The total area of the 6 faces of the box, 0 for an empty box
+    Scalar getSurfaceArea() const {
+        const Array3 extent = (max - min).max(Scalar(0));
+        return 2 * (extent.x() * extent.y() + extent.y() * extent.z() + extent.z() * extent.x());
+    };
+
+    /// @brief Get the squared distance from a point to the box
+    /// @param point The point
+    /// @return The squared distance to the closest point of the box, 0 if the point is inside
+    Scalar getSquaredDistance(const Array3& point) const {
+        return (point - point.max(min).min(max)).matrix().squaredNorm();
+    };
+
     /// @brief A method to check if a ray intersects with this box
     /// @param ray The ray to check for intersection
     /// @param t The distance from the ray origin to the intersection point, only valid if the ray intersects the box
     /// @return true if the ray intersects the box, false otherwise
-    bool intersect(const Ray& ray, double& t) const;
+    bool intersect(const BasicRay<Scalar>& ray, Scalar& t) const;
+
+    /// @brief A method to get the segment of a ray inside this box
+    /// @param ray The ray to check for intersection
+    /// @param t_enter The distance from the ray origin to the point where the ray enters the box (0 if the origin is inside)
+    /// @param t_exit The distance from the ray origin to the point where the ray leaves the box
+    /// @return true if the ray intersects the box, false otherwise (the distances are then not valid)
+    bool intersect(const BasicRay<Scalar>& ray, Scalar& t_enter, Scalar& t_exit) const;
+
+    /// @brief Convert the box to another precision
+    /// @return The box with its points rounded to the other type
+    template <std::floating_point Other>
+    BasicBox<Other> cast() const {
+        return BasicBox<Other>{min.template cast<Other>(), max.template cast<Other>()};
+    };
 };
+
+/// @brief The boxes of the scene, in double precision
+using Box = BasicBox<double>;
+
+/// @brief The boxes of the single precision structures
+using BoxF = BasicBox<float>;
+
+#include "Structures/box.tpp"
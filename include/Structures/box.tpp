@@ -0,0 +1,78 @@
+#include "Structures/box.hpp"
+
+#include <algorithm>
+#include <limits>
+
+/// @brief Compute the distances along a ray to the slabs of a box
+/// @param box The box
+/// @param ray The ray
+/// @param tmin The largest distance at which the ray enters one of the slabs
+/// @param tmax The smallest distance at which the ray leaves one of the slabs
+template <std::floating_point Scalar>
+inline void getSlabDistances(const BasicBox<Scalar>& box, const BasicRay<Scalar>& ray, Scalar& tmin, Scalar& tmax) {
+    const auto& origin = ray.getOrigin();
+    const auto& inv_dir = ray.getInverseDirection();
+
+    const typename BasicBox<Scalar>::Array3 min_diff = (box.min - origin.array()) * inv_dir.array();
+    const typename BasicBox<Scalar>::Array3 max_diff = (box.max - origin.array()) * inv_dir.array();
+
+    // A ray parallel to an axis and starting on a face of the box gives 0 * inf = NaN: it lies in the face, so the slab does not clip it
+    const auto on_face = min_diff.isNaN() || max_diff.isNaN();
+    const Scalar infinity = std::numeric_limits<Scalar>::infinity();
+
+    // Calculate the minimum and maximum t values for each axis
+    tmin = on_face.select(-infinity, min_diff.min(max_diff)).maxCoeff();
+    tmax = on_face.select(infinity, min_diff.max(max_diff)).minCoeff();
+}
+
+// Taken from Tyron's anwer:
+//      https://gamedev.stackexchange.com/questions/18436/most-efficient-aabb-vs-ray-collision-algorithms
+// See for explanation:
+//      https://tavianator.com/2011/ray_box.html
+template <std::floating_point Scalar>
+bool BasicBox<Scalar>::intersect(const BasicRay<Scalar>& ray, Scalar& t) const {
+    Scalar tmin, tmax;
+    getSlabDistances(*this, ray, tmin, tmax);
+
+    // Non branhing logic to determine the intersection distance `t`:
+    //      If tmin < 0, that means the ray starts inside the box, so we want to return tmax
+    //      If tmin > 0, that means the ray starts outside the box, so we want to return tmin
+    //      t is only valid if tmax >= tmin && tmax >= 0, ie the ray intersects the box
+    t = std::max(tmin, Scalar(0)); // Ensure t is non-negative
+    t = std::min(tmax, t); // Clamp t to the maximum intersection distance
+
+    return tmax >= tmin && tmax >= 0;
+
+    // Chip between the x-axis box and the ray
+    // double t1 = (m_bounding_box.min.x() - origin.x())*inv_dir.x();
+    // double t2 = (m_bounding_box.max.x() - origin.x())*inv_dir.x();
+
+    // double tmin = std::min(t1, t2);
+    // double tmax = std::max(t1, t2);
+
+    // // Chip between the y-axis box and the ray
+    // t1 = (m_bounding_box.min.y() - origin.y())*inv_dir.y();
+    // t2 = (m_bounding_box.max.y() - origin.y())*inv_dir.y();
+
+    // tmin = std::max(tmin, std::min(t1, t2));
+    // tmax = std::min(tmax, std::max(t1, t2));
+
+    // // Chip between the z-axis box and the ray
+    // t1 = (m_bounding_box.min.z() - origin.z())*inv_dir.z();
+    // t2 = (m_bounding_box.max.z() - origin.z())*inv_dir.z();
+
+    // tmin = std::max(tmin, std::min(t1, t2));
+    // tmax = std::min(tmax, std::max(t1, t2));
+}
+
+template <std::floating_point Scalar>
+bool BasicBox<Scalar>::intersect(const BasicRay<Scalar>& ray, Scalar& t_enter, Scalar& t_exit) const {
+    // Same slab test as above, keeping both ends of the segment of the ray inside the box
+    Scalar tmin, tmax;
+    getSlabDistances(*this, ray, tmin, tmax);
+
+    t_enter = std::max(tmin, Scalar(0)); // The ray starts inside the box if tmin < 0
+    t_exit = tmax;
+
+    return tmax >= tmin && tmax >= 0;
+}
@@ -0,0 +1,231 @@
+#pragma once
+
+#include <Eigen/Dense>
+#include <algorithm>
+#include <atomic>
+#include <concepts>
+#include <cstdint>
+#include <limits>
+#include <mutex>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+#include "Structures/box.hpp"
+#include "Structures/intersectionRecord.hpp"
+#include "Structures/ray.hpp"
+#include "threadPool.hpp"
+
+// Concept BvhAcceptable: type 'T' has
+//  `.getBoundingBox` and its return is convertible to Box.
+//  `.intersect` and its return is convertible to bool.
+template<typename T>
+concept BvhAcceptable = requires(const T a, const Ray& ray, float& u, float& v, float& t) {
+    { a.getBoundingBox() } -> std::convertible_to<Box>;
+    { a.intersect(ray, u, v, t) } -> std::convertible_to<bool>;
+};
+
+// Concept HitRecordable: type 'T' is an object made of other objects, eg an Instance made of the triangles of its mesh, with
+//  `.intersect(ray, hit, t, max_distance)` filling the record 'Hit' of the object hit inside it.
+template<typename T, typename Hit>
+concept HitRecordable = requires(const T a, const Ray& ray, Hit& hit, float& t, double max_distance) {
+    { a.intersect(ray, hit, t, max_distance) } -> std::convertible_to<bool>;
+};
+
+// Concept OcclusionTestable: type 'T' has `.occluded(ray, max_distance)`, which returns at the first hit found inside the object
+//  instead of searching for the closest one (eg Instance).
+template<typename T>
+concept OcclusionTestable = requires(const T a, const Ray& ray, double max_distance) {
+    { a.occluded(ray, max_distance) } -> std::convertible_to<bool>;
+};
+
+// @brief A node of a bounding volume hierarchy (56 bytes)
+// @details The two children of an interior node are stored next to each other, starting at `index`.
+//          The objects of a leaf are the range [index, index + count) of the primitive array.
+struct BvhNode {
+    /// @brief The bounding box of all the objects of the subtree
+    Box bounds;
+
+    /// @brief Index of the first child in the node array (interior nodes), or of the first object in the primitive array (leaves)
+    std::uint32_t index;
+
+    /// @brief Number of objects in the leaf, 0 for an interior node
+    std::uint32_t count;
+
+    /// @brief Check if the node is a leaf
+    /// @return true if the node has no children
+    inline bool isLeaf() const { return count > 0; };
+};
+
+// Bounding volume hierarchy of objects of type T, built top-down with the binned Surface Area Heuristic.
+// Unlike the octree, a node is split where the objects are, not in the middle of its box: the hierarchy adapts to uneven
+// distributions of objects, and each object is referenced by a single leaf.
+// The hierarchy is built from all the objects at once: `insert` only records the object, the hierarchy is rebuilt by the next query
+// (or by `finalize`). The leaves of the objects with an intersection record test their records, stored in the order of the leaves
+// (see RecordIntersectable).
+template <BvhAcceptable T>
+class Bvh {
+    public:
+        /// @brief The maximum depth of the hierarchy, which bounds the stack of the traversal
+        static constexpr unsigned int MAX_DEPTH = 64;
+
+        /// @brief Constructor for Bvh
+        /// @param max_leaf_size Maximum number of objects in a leaf (default is 4)
+        /// @param bin_count Number of bins along each axis in which the split planes are evaluated (default is 16)
+        /// @note A leaf holds more than `max_leaf_size` objects only if their bounding box centers are all equal, or at the maximum depth.
+        /// @throws std::invalid_argument if `max_leaf_size` is 0 or `bin_count` is less than 2
+        explicit Bvh(unsigned int max_leaf_size = 4, unsigned int bin_count = 16);
+
+        /// @brief Inserts a single object into the hierarchy.
+        /// @param data Pointer to the object to be inserted
+        /// @note The hierarchy is rebuilt with all its objects by the next query, adding objects one by one is not incremental.
+        void insert(const T* data);
+
+        /// @brief Removes a single object from the hierarchy.
+        /// @param data Pointer to the object to be removed
+        /// @return true if the object was in the hierarchy
+        /// @note The hierarchy is rebuilt without the object by the next query (or by `finalize`).
+        bool remove(const T* data);
+
+        /// @brief Takes into account that an object moved, eg after Triangle::translate.
+        /// @param data Pointer to the object that moved
+        /// @note The hierarchy is rebuilt with the new bounding box of the object by the next query (or by `finalize`):
+        ///       unlike the octree, the cost of the update is that of a full build.
+        /// @throws std::invalid_argument if the object is not in the hierarchy
+        void update(const T* data);
+
+        /// @brief Builds the hierarchy from scratch with all the objects at once, replacing its content.
+        /// @param objects Pointers to the objects to insert into the hierarchy
+        /// @param thread_pool Optional pool on which the subtrees are built (nullptr builds serially)
+        /// @note The first levels are split on the calling thread, then each subtree is built by a task.
+        ///       The resulting hierarchy is the same with or without a thread pool.
+        void build(std::span<const T* const> objects, ThreadPool* thread_pool = nullptr);
+
+        /// @brief Build the hierarchy with the objects inserted since the last build.
+        /// @note Calling this method after inserting objects is optional, but it avoids paying for the build in the first query.
+        void finalize();
+
+        /// @brief Check if the hierarchy is up to date
+        /// @return true if no object was inserted, removed or updated since the last build
+        inline bool isFinalized() const {
+            return m_finalized;
+        };
+
+        /// @brief Trace a ray through the hierarchy and detect the closest object hit by the ray.
+        /// @param ray The ray to trace through the hierarchy
+        /// @param hit_distance Reference to a double that will hold the distance to the first hit object
+        /// @param max_distance Maximum distance to trace the ray (default is infinity)
+        /// @return A pointer to the first object hit by the ray, or nullptr if no object is hit
+        /// @note The children are visited front to back, and the ones farther than the closest hit so far are skipped.
+        /// @note The traversal does not allocate memory and can be called from several threads at once.
+        const T* traceRay(const Ray& ray, double& hit_distance, double max_distance = std::numeric_limits<double>::infinity()) const;
+
+        /// @brief Trace a ray through the hierarchy and detect the closest object hit by the ray, with the record of the hit inside it
+        /// @param ray The ray to trace through the hierarchy
+        /// @param hit_distance Reference to a double that will hold the distance to the first hit object
+        /// @param hit Set to the record of the hit inside the first hit object (see HitRecordable), eg the hit triangle of an instance
+        /// @param max_distance Maximum distance to trace the ray (default is infinity)
+        /// @return A pointer to the first object hit by the ray, or nullptr if no object is hit (`hit` is then unchanged)
+        /// @note Each object is tested up to the closest hit so far, and gives its record in the same pass.
+        template <typename Hit>
+            requires HitRecordable<T, Hit>
+        const T* traceRay(const Ray& ray, double& hit_distance, Hit& hit, double max_distance = std::numeric_limits<double>::infinity()) const;
+
+        /// @brief Check if any object is hit by a ray before a maximum distance, eg to know if a light is visible from a point.
+        /// @param ray The ray to trace through the hierarchy
+        /// @param max_distance The distance along the ray beyond which the hits are ignored
+        /// @return true if an object is hit at a distance in [0, max_distance)
+        /// @note The query returns at the first hit found: the children are not sorted by distance.
+        ///       The objects with an occlusion test of their own are tested with it (see OcclusionTestable).
+        bool occluded(const Ray& ray, double max_distance) const;
+
+        /// @brief Removes all the objects from the hierarchy.
+        void clear();
+
+        /// @brief Get the nodes of the hierarchy, building it if needed
+        /// @return The array of nodes, the root being the first one (empty if there are no objects)
+        const std::vector<BvhNode>& getNodes() const;
+
+        /// @brief Get the objects of the hierarchy, grouped by leaf, building it if needed
+        /// @return The array of objects
+        const std::vector<const T*>& getPrimitives() const;
+
+        /// @brief Get the memory used by the hierarchy
+        /// @return The number of bytes used by the nodes, the primitive array and the intersection records
+        inline std::size_t bytes() const {
+            return m_nodes.size() * sizeof(BvhNode) + m_primitives.size() * sizeof(const T*) + m_records.size() * sizeof(Record);
+        };
+
+    private:
+        /// @brief A range of objects lying in a node, during the build
+        struct BuildItem {
+            std::uint32_t node; // Index of the node in its node array
+            std::uint32_t begin; // Index of the first object of the node in the array of object indices
+            std::uint32_t end; // Index after the last object of the node
+            unsigned int depth; // Depth of the node in the hierarchy
+        };
+
+        /// @brief The bounding boxes and their centers, precomputed for the whole build
+        struct BuildData {
+            std::vector<Box> boxes; // Bounding box of each object
+            std::vector<Eigen::Array3d> centers; // Center of the bounding box of each object
+            std::vector<std::uint32_t> indices; // Indices of the objects, partitioned in place as the nodes are split
+        };
+
+        const unsigned int m_max_leaf_size; // Maximum number of objects in a leaf
+        const unsigned int m_bin_count; // Number of bins along each axis for the evaluation of the split planes
+
+        std::vector<const T*> m_objects; // All the objects of the hierarchy, in insertion order
+
+        // The hierarchy is built lazily by the queries, which are const: these members are protected by `m_build_mutex`
+        mutable std::vector<BvhNode> m_nodes; // Nodes of the hierarchy, the root is the first one
+        mutable std::vector<const T*> m_primitives; // Objects of the leaves, each leaf referencing a contiguous range
+
+        using Record = typename IntersectionRecordOf<T, double>::type;
+        mutable std::vector<Record> m_records; // Intersection records of the objects of `m_primitives`, in the same order (empty if T has none)
+        mutable std::atomic<bool> m_finalized{true}; // True if the hierarchy is up to date
+        mutable std::mutex m_build_mutex; // Serializes the builds of the hierarchy
+
+        /// @brief Build the hierarchy if objects were inserted since the last build
+        /// @note This method is thread-safe, the first query builds the hierarchy while the other ones wait.
+        void ensureFinalized() const;
+
+        /// @brief Test a ray against an object of the primitive array, through its record if it has one
+        /// @param primitive_index The index of the object in the primitive array
+        /// @param ray The ray to test
+        /// @param u The barycentric coordinate u of the hit
+        /// @param v The barycentric coordinate v of the hit
+        /// @param t The distance of the hit
+        /// @return true if the ray hits the object
+        inline bool intersectPrimitive(std::uint32_t primitive_index, const Ray& ray, float& u, float& v, float& t) const {
+            if constexpr (RecordIntersectable<T>) {
+                return m_records[primitive_index].intersect(ray, u, v, t);
+            } else {
+                return m_primitives[primitive_index]->intersect(ray, u, v, t);
+            }
+        };
+
+        /// @brief Trace a ray through the nodes, front to back, and test the objects of the leaves it reaches
+        /// @param ray The ray to trace
+        /// @param hit_distance Set to the distance to the closest hit, or to `max_distance`
+        /// @param max_distance Maximum distance to trace the ray
+        /// @param intersectLeafObject The test of an object of the primitive array, called with its index and the closest hit
+        ///        distance so far, which returns true and lowers the distance if the object is hit before it
+        /// @return A pointer to the first object hit by the ray, or nullptr if no object is hit
+        template <typename LeafTest>
+        const T* traceNodes(const Ray& ray, double& hit_distance, double max_distance, LeafTest&& intersectLeafObject) const;
+
+        /// @brief Build the nodes, the primitive array and the records from the objects
+        /// @param thread_pool Optional pool on which the subtrees are built (nullptr builds serially)
+        void buildNodes(ThreadPool* thread_pool) const;
+
+        /// @brief Compute the bounds of a node and split it with the binned Surface Area Heuristic, unless it becomes a leaf
+        /// @param data The precomputed boxes and the object indices
+        /// @param item The node and its range of objects
+        /// @param nodes The node array in which the node lies and in which its children are created
+        /// @param split_items The children are added to this list, to be split in turn
+        void splitNode(BuildData& data, const BuildItem& item, std::vector<BvhNode>& nodes, std::vector<BuildItem>& split_items) const;
+};
+
+// Include the implementation file to make the template class implementation accessible to the compiler
+#include "Structures/bvh.tpp"
@@ -0,0 +1,395 @@
+#include "Structures/bvh.hpp"
+
+template <BvhAcceptable T>
+Bvh<T>::Bvh(unsigned int max_leaf_size, unsigned int bin_count) :
+        m_max_leaf_size(max_leaf_size),
+        m_bin_count(bin_count)
+{
+    if (max_leaf_size == 0) {
+        throw std::invalid_argument("The maximum number of objects in a leaf must be greater than zero.");
+    }
+    if (bin_count < 2) {
+        throw std::invalid_argument("The number of bins must be at least 2.");
+    }
+}
+
+template <BvhAcceptable T>
+void Bvh<T>::insert(const T* data) {
+    m_finalized = false; // The hierarchy must be built again
+    m_objects.push_back(data);
+}
+
+template <BvhAcceptable T>
+bool Bvh<T>::remove(const T* data) {
+    auto position = std::find(m_objects.begin(), m_objects.end(), data);
+    if (position == m_objects.end()) return false;
+
+    m_finalized = false; // The hierarchy must be built again
+    m_objects.erase(position);
+    return true;
+}
+
+template <BvhAcceptable T>
+void Bvh<T>::update(const T* data) {
+    if (std::find(m_objects.begin(), m_objects.end(), data) == m_objects.end()) {
+        throw std::invalid_argument("Cannot update data: The object is not in the hierarchy.");
+    }
+    m_finalized = false; // The hierarchy must be built again
+}
+
+template <BvhAcceptable T>
+void Bvh<T>::build(std::span<const T* const> objects, ThreadPool* thread_pool) {
+    std::lock_guard<std::mutex> lock(m_build_mutex);
+    m_objects.assign(objects.begin(), objects.end());
+    buildNodes(thread_pool);
+    m_finalized = true;
+}
+
+template <BvhAcceptable T>
+void Bvh<T>::finalize() {
+    ensureFinalized();
+}
+
+template <BvhAcceptable T>
+void Bvh<T>::ensureFinalized() const {
+    if (m_finalized) return;
+
+    std::lock_guard<std::mutex> lock(m_build_mutex);
+    if (m_finalized) return; // Another thread built the hierarchy while we were waiting
+
+    buildNodes(nullptr);
+    m_finalized = true;
+}
+
+template <BvhAcceptable T>
+const std::vector<BvhNode>& Bvh<T>::getNodes() const {
+    ensureFinalized();
+    return m_nodes;
+}
+
+template <BvhAcceptable T>
+const std::vector<const T*>& Bvh<T>::getPrimitives() const {
+    ensureFinalized();
+    return m_primitives;
+}
+
+template <BvhAcceptable T>
+void Bvh<T>::clear() {
+    std::lock_guard<std::mutex> lock(m_build_mutex);
+    m_objects.clear();
+    m_nodes.clear();
+    m_primitives.clear();
+    m_records.clear();
+    m_finalized = true;
+}
+
+template <BvhAcceptable T>
+void Bvh<T>::buildNodes(ThreadPool* thread_pool) const {
+    m_nodes.clear();
+    m_primitives.clear();
+    m_records.clear();
+    if (m_objects.empty()) return;
+
+    // Precompute the bounding boxes of the objects and their centers
+    BuildData data;
+    const std::uint32_t count = static_cast<std::uint32_t>(m_objects.size());
+    data.boxes.resize(count);
+    data.centers.resize(count);
+    data.indices.resize(count);
+    for (std::uint32_t i = 0; i < count; ++i) {
+        data.boxes[i] = m_objects[i]->getBoundingBox();
+        data.centers[i] = (data.boxes[i].min + data.boxes[i].max) / 2;
+        data.indices[i] = i;
+    }
+
+    // Split the first levels on the calling thread, until there are enough subtrees to share between the workers
+    m_nodes.push_back(BvhNode{Box::empty(), 0, 0});
+    std::vector<BuildItem> items{BuildItem{0, 0, count, 0}};
+    const std::size_t task_count = thread_pool ? 4 * thread_pool->getThreadCount() : 0;
+    std::vector<BuildItem> next_items;
+    while (!items.empty() && items.size() < task_count) {
+        next_items.clear();
+        for (const BuildItem& item : items) {
+            splitNode(data, item, m_nodes, next_items);
+        }
+        items.swap(next_items);
+    }
+
+    if (!thread_pool) {
+        while (!items.empty()) {
+            BuildItem item = items.back();
+            items.pop_back();
+            splitNode(data, item, m_nodes, items);
+        }
+    } else {
+        // Each task builds a subtree in its own node array, whose first node is the root of the subtree.
+        // The objects of the subtrees are disjoint ranges of the object indices, so the tasks can partition them in place.
+        std::vector<std::vector<BvhNode>> subtrees(items.size());
+        thread_pool->run(items.size(), [&](std::size_t task_index, unsigned int) {
+            std::vector<BvhNode>& subtree = subtrees[task_index];
+            subtree.push_back(BvhNode{Box::empty(), 0, 0});
+
+            std::vector<BuildItem> stack{BuildItem{0, items[task_index].begin, items[task_index].end, items[task_index].depth}};
+            while (!stack.empty()) {
+                BuildItem item = stack.back();
+                stack.pop_back();
+                splitNode(data, item, subtree, stack);
+            }
+        });
+
+        // Append the subtrees to the node array, moving the indices of their children
+        for (std::size_t i = 0; i < items.size(); ++i) {
+            const std::uint32_t offset = static_cast<std::uint32_t>(m_nodes.size()) - 1; // The root of the subtree is not appended
+            for (BvhNode& node : subtrees[i]) {
+                if (!node.isLeaf()) node.index += offset;
+            }
+
+            m_nodes[items[i].node] = subtrees[i].front();
+            m_nodes.insert(m_nodes.end(), subtrees[i].begin() + 1, subtrees[i].end());
+        }
+    }
+
+    // Store the objects in the order of the leaves
+    m_primitives.reserve(count);
+    for (std::uint32_t index : data.indices) {
+        m_primitives.push_back(m_objects[index]);
+    }
+
+    // The leaves test the records of their objects on contiguous memory, without reading the objects
+    if constexpr (RecordIntersectable<T>) {
+        m_records.reserve(count);
+        for (const T* primitive : m_primitives) {
+            if constexpr (std::same_as<Record, typename T::IntersectionRecord>) {
+                m_records.push_back(primitive->getIntersectionRecord());
+            } else {
+                m_records.push_back(primitive->getIntersectionRecord().template cast<double>());
+            }
+        }
+    }
+}
+
+/// Uses the binned Surface Area Heuristic: the centers of the objects are put in bins along each axis,
+///     and the node is split between the two bins minimizing the sum of the areas of the children weighted by their number of objects.
+///     See https://www.sci.utah.edu/~wald/Publications/2007/ParallelBVHBuild/fastbuild.pdf
+template <BvhAcceptable T>
+void Bvh<T>::splitNode(BuildData& data, const BuildItem& item, std::vector<BvhNode>& nodes, std::vector<BuildItem>& split_items) const {
+    const std::uint32_t count = item.end - item.begin;
+
+    // Bounds of the objects and of their centers
+    Box bounds = Box::empty();
+    Box center_bounds = Box::empty();
+    for (std::uint32_t i = item.begin; i < item.end; ++i) {
+        bounds.extend(data.boxes[data.indices[i]]);
+        center_bounds.extend(data.centers[data.indices[i]]);
+    }
+    nodes[item.node].bounds = bounds;
+
+    const Eigen::Array3d center_extent = center_bounds.max - center_bounds.min;
+    auto makeLeaf = [&]() {
+        nodes[item.node].index = item.begin;
+        nodes[item.node].count = count;
+    };
+
+    // Small nodes, nodes whose objects all share the same center, and the deepest nodes become leaves
+    if (count <= m_max_leaf_size || center_extent.maxCoeff() <= 0 || item.depth + 1 >= MAX_DEPTH) {
+        makeLeaf();
+        return;
+    }
+
+    // Find the best split plane among the bin boundaries of the 3 axes
+    struct Bin {
+        Box bounds = Box::empty();
+        std::uint32_t count = 0;
+    };
+    std::vector<Bin> bins(m_bin_count);
+    std::vector<double> right_costs(m_bin_count);
+
+    auto getBin = [&](std::uint32_t object, int axis) {
+        const double relative = (data.centers[object][axis] - center_bounds.min[axis]) / center_extent[axis];
+        return std::min(m_bin_count - 1, static_cast<unsigned int>(relative * m_bin_count));
+    };
+
+    double best_cost = std::numeric_limits<double>::infinity();
+    int best_axis = -1;
+    unsigned int best_bin = 0; // The left child gets the bins up to `best_bin` included
+    for (int axis = 0; axis < 3; ++axis) {
+        if (center_extent[axis] <= 0) continue;
+
+        std::fill(bins.begin(), bins.end(), Bin{});
+        for (std::uint32_t i = item.begin; i < item.end; ++i) {
+            Bin& bin = bins[getBin(data.indices[i], axis)];
+            bin.bounds.extend(data.boxes[data.indices[i]]);
+            bin.count++;
+        }
+
+        // Sweep from the right to get the cost of the right child of each split, then from the left to get the total cost
+        Box right_bounds = Box::empty();
+        std::uint32_t right_count = 0;
+        for (unsigned int b = m_bin_count - 1; b > 0; --b) {
+            right_bounds.extend(bins[b].bounds);
+            right_count += bins[b].count;
+            right_costs[b - 1] = right_count * right_bounds.getSurfaceArea();
+        }
+
+        Box left_bounds = Box::empty();
+        std::uint32_t left_count = 0;
+        for (unsigned int b = 0; b + 1 < m_bin_count; ++b) {
+            left_bounds.extend(bins[b].bounds);
+            left_count += bins[b].count;
+            if (left_count == 0 || left_count == count) continue; // Both children must hold objects
+
+            const double cost = left_count * left_bounds.getSurfaceArea() + right_costs[b];
+            if (cost < best_cost) {
+                best_cost = cost;
+                best_axis = axis;
+                best_bin = b;
+            }
+        }
+    }
+
+    if (best_axis < 0) {
+        makeLeaf();
+        return;
+    }
+
+    // Partition the objects of the node between its two children
+    std::uint32_t* indices = data.indices.data();
+    const std::uint32_t middle = static_cast<std::uint32_t>(
+        std::partition(indices + item.begin, indices + item.end, [&](std::uint32_t object) { return getBin(object, best_axis) <= best_bin; }) - indices);
+
+    const std::uint32_t first_child = static_cast<std::uint32_t>(nodes.size());
+    nodes[item.node].index = first_child;
+    nodes[item.node].count = 0;
+    nodes.push_back(BvhNode{Box::empty(), 0, 0});
+    nodes.push_back(BvhNode{Box::empty(), 0, 0});
+
+    split_items.push_back(BuildItem{first_child, item.begin, middle, item.depth + 1});
+    split_items.push_back(BuildItem{first_child + 1, middle, item.end, item.depth + 1});
+}
+
+template <BvhAcceptable T>
+const T* Bvh<T>::traceRay(const Ray& ray, double& hit_distance, double max_distance) const {
+    return traceNodes(ray, hit_distance, max_distance, [&](std::uint32_t index, double& closest_distance) {
+        float u, v, collision_distance;
+        if (!intersectPrimitive(index, ray, u, v, collision_distance) || collision_distance >= closest_distance) return false;
+        closest_distance = collision_distance;
+        return true;
+    });
+}
+
+template <BvhAcceptable T>
+template <typename Hit>
+    requires HitRecordable<T, Hit>
+const T* Bvh<T>::traceRay(const Ray& ray, double& hit_distance, Hit& hit, double max_distance) const {
+    return traceNodes(ray, hit_distance, max_distance, [&](std::uint32_t index, double& closest_distance) {
+        Hit object_hit;
+        float collision_distance;
+        if (!m_primitives[index]->intersect(ray, object_hit, collision_distance, closest_distance) || collision_distance >= closest_distance) {
+            return false;
+        }
+        closest_distance = collision_distance;
+        hit = object_hit;
+        return true;
+    });
+}
+
+template <BvhAcceptable T>
+template <typename LeafTest>
+const T* Bvh<T>::traceNodes(const Ray& ray, double& hit_distance, double max_distance, LeafTest&& intersectLeafObject) const {
+    hit_distance = max_distance;
+    ensureFinalized();
+    if (m_nodes.empty()) return nullptr;
+
+    double enter_distance, exit_distance;
+    if (!m_nodes.front().bounds.intersect(ray, enter_distance, exit_distance) || enter_distance > hit_distance) return nullptr;
+
+    // Nodes left to visit, with the distance at which the ray enters them
+    struct StackEntry {
+        std::uint32_t node;
+        double enter_distance;
+    };
+    StackEntry stack[MAX_DEPTH];
+    unsigned int stack_size = 0;
+
+    const T* closest_collision = nullptr;
+    std::uint32_t node_index = 0;
+    while (true) {
+        const BvhNode& node = m_nodes[node_index];
+
+        if (node.isLeaf()) {
+            for (std::uint32_t i = node.index; i < node.index + node.count; ++i) {
+                if (intersectLeafObject(i, hit_distance)) closest_collision = m_primitives[i];
+            }
+        } else {
+            // Visit the closest child first, and keep the other one for later if the ray enters it before the closest hit
+            double enter_distances[2];
+            bool hits[2];
+            for (int c = 0; c < 2; ++c) {
+                hits[c] = m_nodes[node.index + c].bounds.intersect(ray, enter_distances[c], exit_distance) && enter_distances[c] <= hit_distance;
+            }
+
+            if (hits[0] && hits[1]) {
+                const int near = enter_distances[1] < enter_distances[0] ? 1 : 0;
+                stack[stack_size++] = StackEntry{node.index + 1 - near, enter_distances[1 - near]};
+                node_index = node.index + near;
+                continue;
+            }
+            if (hits[0] || hits[1]) {
+                node_index = node.index + (hits[0] ? 0 : 1);
+                continue;
+            }
+        }
+
+        // Go back to the closest node left, skipping the ones the ray enters after the closest hit
+        while (stack_size > 0 && stack[stack_size - 1].enter_distance > hit_distance) stack_size--;
+        if (stack_size == 0) break;
+        node_index = stack[--stack_size].node;
+    }
+
+    return closest_collision;
+}
+
+template <BvhAcceptable T>
+bool Bvh<T>::occluded(const Ray& ray, double max_distance) const {
+    ensureFinalized();
+    if (m_nodes.empty()) return false;
+
+    double enter_distance, exit_distance;
+    if (!m_nodes.front().bounds.intersect(ray, enter_distance, exit_distance) || enter_distance >= max_distance) return false;
+
+    std::uint32_t stack[MAX_DEPTH]; // Nodes left to visit
+    unsigned int stack_size = 0;
+
+    std::uint32_t node_index = 0;
+    while (true) {
+        const BvhNode& node = m_nodes[node_index];
+
+        if (node.isLeaf()) {
+            // Any hit closer than the maximum distance ends the query
+            for (std::uint32_t i = node.index; i < node.index + node.count; ++i) {
+                if constexpr (OcclusionTestable<T>) {
+                    if (m_primitives[i]->occluded(ray, max_distance)) return true;
+                } else {
+                    float u, v, collision_distance;
+                    if (intersectPrimitive(i, ray, u, v, collision_distance) && collision_distance < max_distance) return true;
+                }
+            }
+        } else {
+            bool hits[2];
+            for (int c = 0; c < 2; ++c) {
+                hits[c] = m_nodes[node.index + c].bounds.intersect(ray, enter_distance, exit_distance) && enter_distance < max_distance;
+            }
+
+            if (hits[0] || hits[1]) {
+                if (hits[0] && hits[1]) stack[stack_size++] = node.index + 1;
+                node_index = node.index + (hits[0] ? 0 : 1);
+                continue;
+            }
+        }
+
+        if (stack_size == 0) break;
+        node_index = stack[--stack_size];
+    }
+
+    return false;
+}
@@ -0,0 +1,912 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <concepts>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <Eigen/Dense>
+
+#include "Structures/box.hpp"
+#include "Structures/intersectionRecord.hpp"
+#include "Structures/mappedFile.hpp"
+#include "Structures/region.hpp"
+#include "Structures/ray.hpp"
+#include "Structures/rayPacket.hpp"
+#include "Structures/triangleBlocks.hpp"
+
+/// @brief Get the branch index corresponding to the closest octant from the node to the given position
+/// @param position The position to check
+/// @param node_position The position of the node
+/// @return A value between 0 and 7 (111) representing the octant in which the position lies
+///         0: (-,-,-), 1: (-,-,+), 2: (-,+,-), 3: (-,+,+),
+///         4: (+,-,-), 5: (+,-,+), 6: (+,+,-), 7: (+,+,+)
+inline unsigned char getBranchIndex(const Eigen::Vector3d& position, const Eigen::Vector3d& node_position) {
+    unsigned char branch_index = 0; // Value between 0 and 7 (111) representing the octant in which the position lies
+    if (position.x() >= node_position.x()) branch_index |= 4;
+    if (position.y() >= node_position.y()) branch_index |= 2;
+    if (position.z() >= node_position.z()) branch_index |= 1;
+    return branch_index;
+}
+
+/// @brief Get the position of the center of a child node from the center of its parent
+/// @param parent_center The center of the parent node
+/// @param parent_half_size The half size of the parent node
+/// @param child_index The index of the child (see getBranchIndex)
+/// @return The center of the child node, of the type of the half size
+template <std::floating_point Scalar>
+inline Eigen::Matrix<Scalar, 3, 1> getChildCenter(const std::type_identity_t<Eigen::Matrix<Scalar, 3, 1>>& parent_center, Scalar parent_half_size,
+                                                  unsigned char child_index) {
+    const Scalar quarter_size = parent_half_size / 2;
+    return parent_center + Eigen::Matrix<Scalar, 3, 1>((child_index & 4) ? quarter_size : -quarter_size,
+                                                       (child_index & 2) ? quarter_size : -quarter_size,
+                                                       (child_index & 1) ? quarter_size : -quarter_size);
+}
+
+// The parametric traversal of an octree (Revelles et al., "An efficient parametric algorithm for octree traversal", 2000).
+// A node is the intersection of 3 slabs, one per axis, and a ray is inside the node between the distances at which it is inside
+// all 3 slabs. The slabs of a child are halves of the slabs of its parent, cut at the distances to the planes splitting the
+// parent: the segment of the ray in each child follows from the segment in its parent with a few min/max, and the children
+// crossed by the ray are found by stepping from one to the next across the closest plane, without intersecting any box.
+// The children are numbered from the octant of the ray (see getDirectionOctant): bit `4 >> axis` of `child` is set if the child
+// lies in the far half of the parent along `axis`, and its index among the octants is `child ^ signs`.
+// The helpers compute in the precision of the ray: double for `Ray`, float for `RayF` (see FlatOctree::traceRay).
+
+/// @brief The distances at which a ray enters and leaves the slab of an octree node along each axis
+template <std::floating_point Scalar>
+struct BasicNodeSlabs {
+    /// @brief The distance at which the ray enters the slab along each axis
+    Eigen::Array<Scalar, 3, 1> enter;
+
+    /// @brief The distance at which the ray leaves the slab along each axis
+    Eigen::Array<Scalar, 3, 1> exit;
+
+    /// @brief Get the distance at which the ray enters the node
+    /// @return The largest enter distance, negative if the node contains the ray origin
+    inline Scalar getEnterDistance() const { return enter.maxCoeff(); };
+
+    /// @brief Get the distance at which the ray leaves the node
+    /// @return The smallest exit distance, smaller than the enter distance if the ray misses the node
+    inline Scalar getExitDistance() const { return exit.minCoeff(); };
+};
+
+/// @brief The slabs of the rays of the scene
+using NodeSlabs = BasicNodeSlabs<double>;
+
+/// @brief Get the slabs of a node crossed by a ray, with the same conventions as Box::intersect
+/// @param center The center of the node
+/// @param half_size The half size of the node
+/// @param ray The ray crossing the node
+/// @param signs The octant towards which the ray goes (see getDirectionOctant)
+/// @return The slabs of the node, which do not clip the ray along an axis it is parallel to and starts on a face of
+template <std::floating_point Scalar>
+inline BasicNodeSlabs<Scalar> getNodeSlabs(const std::type_identity_t<Eigen::Matrix<Scalar, 3, 1>>& center, std::type_identity_t<Scalar> half_size,
+                                           const BasicRay<Scalar>& ray, unsigned char signs) {
+    const Scalar infinity = std::numeric_limits<Scalar>::infinity();
+    BasicNodeSlabs<Scalar> slabs;
+    for (int axis = 0; axis < 3; ++axis) {
+        // A ray going backwards along the axis enters the slab through its upper face
+        const Scalar near_face = (signs & (4 >> axis)) ? center[axis] + half_size : center[axis] - half_size;
+        const Scalar far_face = (signs & (4 >> axis)) ? center[axis] - half_size : center[axis] + half_size;
+        const Scalar enter = (near_face - ray.getOrigin()[axis]) * ray.getInverseDirection()[axis];
+        const Scalar exit = (far_face - ray.getOrigin()[axis]) * ray.getInverseDirection()[axis];
+        slabs.enter[axis] = std::isnan(enter) ? -infinity : enter;
+        slabs.exit[axis] = std::isnan(exit) ? infinity : exit;
+    }
+    return slabs;
+}
+
+/// @brief Get the distances of a ray to the 3 planes splitting a node
+/// @param center The center of the node
+/// @param ray The ray crossing the node
+/// @param signs The octant towards which the ray goes (see getDirectionOctant)
+/// @return The distance to the plane normal to each axis. A ray parallel to a plane gets -inf if it lies in the far half of the node,
+///         and +inf in the near half. A ray lying in the plane is put in its positive half, like getBranchIndex does.
+template <std::floating_point Scalar>
+inline Eigen::Array<Scalar, 3, 1> getSplitDistances(const std::type_identity_t<Eigen::Matrix<Scalar, 3, 1>>& center, const BasicRay<Scalar>& ray,
+                                                    unsigned char signs) {
+    const Scalar infinity = std::numeric_limits<Scalar>::infinity();
+    Eigen::Array<Scalar, 3, 1> distances = (center - ray.getOrigin()).array() * ray.getInverseDirection().array();
+    for (int axis = 0; axis < 3; ++axis) {
+        if (std::isnan(distances[axis])) distances[axis] = (signs & (4 >> axis)) ? infinity : -infinity;
+    }
+    return distances;
+}
+
+/// @brief Get the slabs of a child from the slabs of its parent
+/// @param parent The slabs of the parent
+/// @param split_distances The distances to the planes splitting the parent (see getSplitDistances)
+/// @param child The child, numbered from the octant of the ray
+/// @return The slabs of the child: along each axis, the near half ends and the far half starts at the splitting plane
+template <std::floating_point Scalar>
+inline BasicNodeSlabs<Scalar> getChildSlabs(const BasicNodeSlabs<Scalar>& parent, const Eigen::Array<Scalar, 3, 1>& split_distances, unsigned char child) {
+    const Eigen::Array3i far((child >> 2) & 1, (child >> 1) & 1, child & 1);
+    return BasicNodeSlabs<Scalar>{(far != 0).select(split_distances, parent.enter), (far != 0).select(parent.exit, split_distances)};
+}
+
+/// @brief Get the child in which a ray lies at a distance inside its parent
+/// @param split_distances The distances to the planes splitting the parent (see getSplitDistances)
+/// @param distance The distance along the ray, eg where it enters the parent
+/// @return The child numbered from the octant of the ray: the ray is in the far half along the axes whose plane lies before the distance
+template <std::floating_point Scalar>
+inline unsigned char getFirstChild(const Eigen::Array<Scalar, 3, 1>& split_distances, std::type_identity_t<Scalar> distance) {
+    return (split_distances.x() < distance ? 4 : 0) | (split_distances.y() < distance ? 2 : 0) | (split_distances.z() < distance ? 1 : 0);
+}
+
+/// @brief Get the next child crossed by a ray, after it leaves a child of the same parent
+/// @param child The child that the ray leaves, numbered from the octant of the ray
+/// @param child_exit The distances at which the ray leaves the slabs of the child (see NodeSlabs::exit)
+/// @return The next child, or 8 if the ray leaves the parent
+/// @note The ray leaves through the closest face: through a splitting plane into the far half along its axis,
+///       or out of the parent if the child is already in the far half. Ties go to the z, then y axis.
+template <std::floating_point Scalar>
+inline unsigned char getNextChild(unsigned char child, const Eigen::Array<Scalar, 3, 1>& child_exit) {
+    const int axis = (child_exit.x() < child_exit.y() && child_exit.x() < child_exit.z()) ? 0 : (child_exit.y() < child_exit.z() ? 1 : 2);
+    const unsigned char bit = 4 >> axis;
+    return (child & bit) ? 8 : (child | bit);
+}
+
+/// @brief How the objects are placed in the leaves of an octree
+/// @note Position: each object is stored in the single leaf containing its `getPosition` point. An object spanning several
+///       octants is missed by the rays that only cross the other ones, and the first hit found is not always the closest one.
+/// @note BoundingBox: each object is referenced by every leaf that its `getBoundingBox` overlaps. Every ray crossing the object
+///       finds it, and the front-to-back traversal stops as soon as the closest hit lies inside the current child.
+enum class OctreeInsertion {
+    Position,
+    BoundingBox
+};
+
+/// @brief A small cache of the last objects tested by a ray
+/// @details With BoundingBox insertion, an object is referenced by all the leaves it overlaps, and a ray crossing several of
+///          them would test it again each time. The mailbox lives on the stack of the query, so it is not shared between threads.
+template <typename T>
+struct RayMailbox {
+    /// @brief The number of objects remembered, the oldest one is forgotten first
+    static constexpr unsigned int SIZE = 8;
+
+    /// @brief The objects already tested by the ray
+    const T* entries[SIZE] = {};
+
+    /// @brief The index of the entry replaced by the next insertion
+    unsigned int next = 0;
+
+    /// @brief Check if an object was already tested by the ray
+    /// @param object The object to check
+    /// @return true if the object is in the mailbox
+    inline bool contains(const T* object) const {
+        for (unsigned int i = 0; i < SIZE; ++i) {
+            if (entries[i] == object) return true;
+        }
+        return false;
+    };
+
+    /// @brief Remember that an object was tested by the ray
+    /// @param object The object tested
+    inline void insert(const T* object) {
+        entries[next] = object;
+        next = (next + 1) % SIZE;
+    };
+};
+
+/// @brief Start loading some memory into the cache, ahead of its use
+/// @param address The address of the memory
+inline void prefetch(const void* address) {
+#if defined(__GNUC__)
+    __builtin_prefetch(address);
+#else
+    (void)address;
+#endif
+}
+
+// @brief The objects already gathered by the range queries of a thread, so that a query gathers an object referenced by several leaves once
+// @details Each query takes a new stamp and marks the objects it reaches with it, so the marks of the previous queries need no clearing.
+struct QueryStamps {
+    /// @brief The stamp of the last query which reached each object, by object id
+    std::vector<std::uint32_t> stamps;
+
+    /// @brief The stamp of the current query
+    std::uint32_t current = 0;
+
+    /// @brief Start a query
+    /// @param object_count The number of object ids of the queried octree
+    inline void begin(std::size_t object_count) {
+        if (stamps.size() < object_count) stamps.resize(object_count, 0);
+        // Once the stamps wrap around, the marks of old queries could match the new stamp
+        if (++current == 0) {
+            std::fill(stamps.begin(), stamps.end(), 0);
+            current = 1;
+        }
+    };
+
+    /// @brief Mark an object as reached by the current query
+    /// @param id The id of the object
+    /// @return true if the query had not reached the object yet
+    inline bool mark(std::uint32_t id) {
+        if (stamps[id] == current) return false;
+        stamps[id] = current;
+        return true;
+    };
+};
+
+// @brief A subtree of a flat octree from which rays start their traversal instead of the root (see OctreeEntryPoints)
+struct OctreeEntryPoint {
+    /// @brief The index of the root of the subtree in the node array
+    std::uint32_t node_index;
+
+    /// @brief The center of the root of the subtree
+    Eigen::Vector3d center;
+
+    /// @brief The half size of the root of the subtree
+    double half_size;
+
+    /// @brief Bit `4 >> axis` is set if the rays enter the subtree along `axis` through a plane splitting one of its ancestors,
+    ///        and is not set if they enter it through a face of the root
+    unsigned char enter_splits = 0;
+
+    /// @brief Bit `4 >> axis` is set if the rays leave the subtree along `axis` through a plane splitting one of its ancestors
+    unsigned char exit_splits = 0;
+
+    /// @brief The coordinates of the splitting planes through which the rays enter the subtree (only the axes of `enter_splits`)
+    Eigen::Vector3d enter_planes = Eigen::Vector3d::Zero();
+
+    /// @brief The coordinates of the splitting planes through which the rays leave the subtree (only the axes of `exit_splits`)
+    Eigen::Vector3d exit_planes = Eigen::Vector3d::Zero();
+};
+
+/// @brief Get the slabs of the root of a subtree crossed by a ray, as the traversal from the root derives them (see getChildSlabs)
+/// @param root The slabs of the root of the octree
+/// @param entry The subtree
+/// @param ray The ray crossing the subtree
+/// @param signs The octant towards which the ray goes, for which the subtree was collected (see OctreeEntryPoints)
+/// @return The slabs of the subtree: the distances to its faces are computed from the same planes, with the same rounding, as the
+///         traversal from the root, so that both traversals get the same hits
+inline NodeSlabs getEntrySlabs(const NodeSlabs& root, const OctreeEntryPoint& entry, const Ray& ray, unsigned char signs) {
+    const Eigen::Array3d enter_distances = getSplitDistances(entry.enter_planes, ray, signs);
+    const Eigen::Array3d exit_distances = getSplitDistances(entry.exit_planes, ray, signs);
+    const Eigen::Array3i enter_splits((entry.enter_splits >> 2) & 1, (entry.enter_splits >> 1) & 1, entry.enter_splits & 1);
+    const Eigen::Array3i exit_splits((entry.exit_splits >> 2) & 1, (entry.exit_splits >> 1) & 1, entry.exit_splits & 1);
+    return NodeSlabs{(enter_splits != 0).select(enter_distances, root.enter), (exit_splits != 0).select(exit_distances, root.exit)};
+}
+
+// @brief The subtrees of a flat octree crossed by a bundle of rays, eg the rays of a tile of pixels, collected once by `FlatOctree::cull`
+// @details The rays of a tile all lie in the frustum of the tile. Instead of starting at the root and testing the same upper nodes
+//          again for every pixel, they start from the subtrees overlapping the frustum: the upper levels are visited once per tile.
+//          The subtrees are disjoint and sorted front to back for the rays going towards the octant `signs`, so that a ray visits
+//          them in the order the traversal from the root would. Each subtree keeps the planes bounding it, from which a ray gets
+//          the distances the traversal from the root would derive (see getEntrySlabs), and so the same hits.
+//          The other rays are traced from the root.
+//          The entry points are only valid until the octree changes.
+struct OctreeEntryPoints {
+    /// @brief The default maximum number of subtrees collected by `cull`
+    static constexpr std::size_t DEFAULT_MAX_NODES = 16;
+
+    /// @brief The subtrees, front to back for the octant `signs`
+    std::vector<OctreeEntryPoint> nodes;
+
+    /// @brief The octant towards which the rays go (see getDirectionOctant)
+    unsigned char signs = 0;
+
+    /// @brief false until `cull` fills the subtrees: the rays are then traced from the root
+    bool culled = false;
+};
+
+// @brief A node of the flat octree (16 bytes)
+// @details The bounds of a node are not stored: they are implied by the bounds of its parent and its index among the 8 octants.
+//          Only the children containing objects are stored, next to each other, starting at `child_base`.
+//          Child `i` exists if bit `i` of `child_mask` is set, and its index is `child_base` plus the number of existing children before it.
+struct FlatOctreeNode {
+    /// @brief Index of the first child of the node in the node array (interior nodes only)
+    std::uint32_t child_base;
+
+    /// @brief Index of the first object of the leaf in the primitive array (leaves only)
+    std::uint32_t first;
+
+    /// @brief Number of objects in the leaf (leaves only)
+    std::uint32_t count;
+
+    /// @brief Bit `i` is set if the child `i` exists, 0 for a leaf
+    std::uint8_t child_mask;
+
+    /// @brief Unused, always zero so that the nodes are written to the files without undefined bytes
+    std::uint8_t padding[3] = {};
+
+    /// @brief Create a leaf
+    /// @param first Index of the first object of the leaf in the primitive array
+    /// @param count Number of objects in the leaf
+    /// @return The leaf node
+    static inline FlatOctreeNode makeLeaf(std::uint32_t first, std::size_t count) {
+        return FlatOctreeNode{0, first, static_cast<std::uint32_t>(count), 0};
+    };
+
+    /// @brief Create an interior node
+    /// @param child_base Index of the first child of the node in the node array
+    /// @param child_mask Bit `i` is set if the child `i` exists (at least one bit must be set)
+    /// @return The interior node
+    static inline FlatOctreeNode makeInterior(std::uint32_t child_base, std::uint8_t child_mask) {
+        return FlatOctreeNode{child_base, 0, 0, child_mask};
+    };
+
+    /// @brief Get the index of the first object of the leaf in the primitive array
+    inline std::uint32_t getFirst() const { return first; };
+
+    /// @brief Get the number of objects in the leaf
+    inline std::uint32_t getCount() const { return count; };
+
+    /// @brief Get the index of the first child of the node in the node array
+    inline std::uint32_t getChildBase() const { return child_base; };
+
+    /// @brief Get the mask of the existing children, 0 for a leaf
+    inline std::uint8_t getChildMask() const { return child_mask; };
+
+    /// @brief Check if the node is a leaf
+    /// @return true if the node has no children
+    inline bool isLeaf() const { return child_mask == 0; };
+
+    /// @brief Check if the child `child_index` exists
+    /// @param child_index The index of the octant of the child (see getBranchIndex)
+    /// @return true if the child exists
+    inline bool hasChild(unsigned char child_index) const { return child_mask & (1u << child_index); };
+
+    /// @brief Get the position of a child in the node array
+    /// @param child_index The index of the octant of the child, which must exist (see getBranchIndex)
+    /// @return The index of the child node in the node array
+    inline std::uint32_t getChild(unsigned char child_index) const {
+        return child_base + std::popcount(static_cast<unsigned int>(child_mask & ((1u << child_index) - 1)));
+    };
+};
+
+// @brief A node of the flat octree packed in 8 bytes, for very large scenes (see FlatOctreeNode)
+// @details An interior node only needs the index of its first child and the mask of its children, and a leaf the range of its objects:
+//          the index is shared by both, and the mask and the number of objects are packed in a single word.
+//          A node and its siblings fit in a cache line, and the leaves hold at most MAX_COUNT objects.
+struct CompactFlatOctreeNode {
+    /// @brief Index of the first child of the node in the node array, or of the first object of the leaf in the primitive array
+    std::uint32_t index;
+
+    /// @brief Mask of the existing children in the low 8 bits (0 for a leaf), number of objects of the leaf in the high 24 bits
+    std::uint32_t mask_and_count;
+
+    /// @brief The maximum number of objects in a leaf
+    static constexpr std::size_t MAX_COUNT = (1u << 24) - 1;
+
+    /// @brief Create a leaf
+    /// @param first Index of the first object of the leaf in the primitive array
+    /// @param count Number of objects in the leaf
+    /// @return The leaf node
+    /// @throws std::length_error if the leaf holds more than MAX_COUNT objects
+    static inline CompactFlatOctreeNode makeLeaf(std::uint32_t first, std::size_t count) {
+        if (count > MAX_COUNT) {
+            throw std::length_error("Cannot compile octree: A leaf holds more than " + std::to_string(MAX_COUNT) + " objects for compact nodes.");
+        }
+        return CompactFlatOctreeNode{first, static_cast<std::uint32_t>(count) << 8};
+    };
+
+    /// @brief Create an interior node
+    /// @param child_base Index of the first child of the node in the node array
+    /// @param child_mask Bit `i` is set if the child `i` exists (at least one bit must be set)
+    /// @return The interior node
+    static inline CompactFlatOctreeNode makeInterior(std::uint32_t child_base, std::uint8_t child_mask) {
+        return CompactFlatOctreeNode{child_base, child_mask};
+    };
+
+    /// @brief Get the index of the first object of the leaf in the primitive array
+    inline std::uint32_t getFirst() const { return index; };
+
+    /// @brief Get the number of objects in the leaf
+    inline std::uint32_t getCount() const { return mask_and_count >> 8; };
+
+    /// @brief Get the index of the first child of the node in the node array
+    inline std::uint32_t getChildBase() const { return index; };
+
+    /// @brief Get the mask of the existing children, 0 for a leaf
+    inline std::uint8_t getChildMask() const { return static_cast<std::uint8_t>(mask_and_count); };
+
+    /// @brief Check if the node is a leaf
+    /// @return true if the node has no children
+    inline bool isLeaf() const { return getChildMask() == 0; };
+
+    /// @brief Check if the child `child_index` exists
+    /// @param child_index The index of the octant of the child (see getBranchIndex)
+    /// @return true if the child exists
+    inline bool hasChild(unsigned char child_index) const { return mask_and_count & (1u << child_index); };
+
+    /// @brief Get the position of a child in the node array
+    /// @param child_index The index of the octant of the child, which must exist (see getBranchIndex)
+    /// @return The index of the child node in the node array
+    inline std::uint32_t getChild(unsigned char child_index) const {
+        return index + std::popcount(mask_and_count & ((1u << child_index) - 1));
+    };
+};
+
+static_assert(sizeof(FlatOctreeNode) == 16 && std::has_unique_object_representations_v<FlatOctreeNode>,
+              "The flat octree nodes are written to the files as they are in memory.");
+static_assert(sizeof(CompactFlatOctreeNode) == 8 && std::has_unique_object_representations_v<CompactFlatOctreeNode>,
+              "The flat octree nodes are written to the files as they are in memory.");
+
+// Concept FlatOctreeNodeLayout: type 'N' is a node of the flat octree (see FlatOctreeNode and CompactFlatOctreeNode), which has
+//  `makeLeaf` and `makeInterior` to create the nodes.
+//  `getFirst`, `getCount`, `getChildBase`, `getChildMask`, `isLeaf`, `hasChild` and `getChild` to read them.
+template<typename N>
+concept FlatOctreeNodeLayout = std::is_trivially_copyable_v<N> && std::has_unique_object_representations_v<N> &&
+    requires(const N node, std::uint32_t index, std::size_t count, std::uint8_t mask, unsigned char child_index) {
+        { N::makeLeaf(index, count) } -> std::same_as<N>;
+        { N::makeInterior(index, mask) } -> std::same_as<N>;
+        { node.getFirst() } -> std::convertible_to<std::uint32_t>;
+        { node.getCount() } -> std::convertible_to<std::uint32_t>;
+        { node.getChildBase() } -> std::convertible_to<std::uint32_t>;
+        { node.getChildMask() } -> std::convertible_to<std::uint8_t>;
+        { node.isLeaf() } -> std::convertible_to<bool>;
+        { node.hasChild(child_index) } -> std::convertible_to<bool>;
+        { node.getChild(child_index) } -> std::convertible_to<std::uint32_t>;
+    };
+
+/// @brief The container of the intersection records of type 'Record' stored by the flat octree
+template <typename Record>
+struct IntersectionRecordStorageOf { using type = std::vector<Record>; };
+
+/// @brief The records of the triangles are stored in blocks, whose triangles are tested together by SIMD kernels
+template <std::floating_point Scalar>
+struct IntersectionRecordStorageOf<BasicTriangleRecord<Scalar>> { using type = BasicTriangleBlockArray<Scalar>; };
+
+// Concept RangeIntersectable: type 'S' is a container of intersection records (see IntersectionRecordStorageOf) which has
+//  `.intersect` testing a ray against a range of its records at once, calling a function for each hit by increasing index.
+template<typename S>
+concept RangeIntersectable = requires(const S storage, const Ray& ray, std::size_t first, std::size_t count, bool (*on_hit)(std::size_t, float)) {
+    { storage.intersect(ray, first, count, on_hit) } -> std::convertible_to<bool>;
+    { storage.bytes() } -> std::convertible_to<std::size_t>;
+};
+
+// Concept NearestQueryable: type 'T' is an object of the octree which has
+//  `.closestPoint` giving its point closest to another point, to search the nearest object (see FlatOctree::nearest).
+template<typename T>
+concept NearestQueryable = requires(const T object, const Eigen::Vector3d& point) {
+    { object.closestPoint(point) } -> std::convertible_to<Eigen::Vector3d>;
+};
+
+// @brief The header of a file holding a flat octree (see FlatOctree::save)
+// @details The header is followed by the array of nodes, exactly as in memory, then by the index of the object referenced
+//          by each entry of the primitive array. The nodes are read in place from the mapped file.
+//          The file is only read back on a machine with the same byte order and the same layout of the nodes.
+struct FlatOctreeFileHeader {
+    /// @brief The characters identifying the file format
+    static constexpr char MAGIC[8] = {'3', 'D', 'R', 'O', 'C', 'T', 'R', '\0'};
+
+    /// @brief The version of the file format, increased whenever the layout changes
+    static constexpr std::uint32_t VERSION = 1;
+
+    /// @brief A value written in the byte order of the machine, to detect the files written on another one
+    static constexpr std::uint32_t ENDIANNESS_MARKER = 0x01020304;
+
+    char magic[8]; // MAGIC
+    std::uint32_t version; // VERSION
+    std::uint32_t byte_order; // ENDIANNESS_MARKER
+    std::uint32_t node_size; // Size of a node, which tells the layout of the nodes (see FlatOctreeNodeLayout)
+    std::uint32_t insertion; // How the objects were placed in the leaves (see OctreeInsertion)
+    std::uint64_t node_count; // Number of nodes
+    std::uint64_t primitive_count; // Number of entries of the primitive array
+    std::uint64_t object_count; // Number of objects indexed by the primitive array
+    double root_center[3]; // Center of the root node
+    double root_half_size; // Half size of the root node
+    std::uint64_t node_offset; // Position of the first node in the file
+    std::uint64_t primitive_offset; // Position of the first primitive index in the file
+};
+
+static_assert(std::is_trivially_copyable_v<FlatOctreeFileHeader> && sizeof(FlatOctreeFileHeader) % alignof(FlatOctreeNode) == 0 &&
+              sizeof(FlatOctreeFileHeader) % alignof(CompactFlatOctreeNode) == 0);
+
+// Read-only octree compiled from the nodes of an Octree after it is built.
+// The nodes are stored in a single array and the objects of each leaf form a contiguous range of a single primitive array,
+// so that the traversal walks through compact memory instead of chasing pointers.
+// The layout of the nodes is FlatOctreeNode (16 bytes) by default, or CompactFlatOctreeNode (8 bytes) for very large scenes.
+// The single rays are traced in the precision 'Scalar', in which the intersection records of the leaves are stored (double by default,
+// float to test twice as many triangles per SIMD instruction and read less memory, see TriangleRecordF). The packets, the streams
+// and the range and nearest queries compute in double precision.
+template <typename T, FlatOctreeNodeLayout NodeLayout = FlatOctreeNode, std::floating_point Scalar = double>
+class FlatOctree {
+    public:
+        FlatOctree() = default;
+
+        /// @brief Copy a flat octree, which shares the file mapping of the original one if it was loaded (see `load`)
+        FlatOctree(const FlatOctree& other);
+
+        /// @brief Copy a flat octree, which shares the file mapping of the original one if it was loaded (see `load`)
+        FlatOctree& operator=(const FlatOctree& other);
+
+        /// @brief Move a flat octree, its nodes stay where they are
+        FlatOctree(FlatOctree&& other) noexcept;
+
+        /// @brief Move a flat octree, its nodes stay where they are
+        FlatOctree& operator=(FlatOctree&& other) noexcept;
+
+        /// @brief Compile the flat octree from the root of a pointer-based octree
+        /// @param root The root node of the octree to compile
+        /// @param insertion How the objects were placed in the leaves, which decides when the traversal can stop early
+        /// @note NodeType must have the `position`, `children`, `data` and `total_children_depth` members of OctreeNode, and `getHalfSize`.
+        /// @note The subtrees that do not contain any object are not compiled.
+        template <typename NodeType>
+        void build(const NodeType* root, OctreeInsertion insertion = OctreeInsertion::Position);
+
+        /// @brief Patch the flat octree where a pointer-based octree changed since it was compiled from it
+        /// @param root The root node of the octree, whose changed nodes and their ancestors have the `modified` flag of OctreeNode
+        /// @param insertion How the objects were placed in the leaves
+        /// @return true if the whole octree was compiled again (see `build`)
+        /// @note Only the modified nodes are compiled again: a modified leaf appends its objects at the end of the primitive array,
+        ///       and a node whose children changed appends a new block of children, the unchanged ones keeping their subtree in place.
+        ///       The cost is proportional to the number of modified nodes, not to the size of the octree.
+        /// @note The replaced nodes and objects stay in the arrays until the octree is compiled again from scratch: once they
+        ///       outnumber the ones in use, or if the octree was loaded from a file or compiled from another root.
+        template <typename NodeType>
+        bool update(const NodeType* root, OctreeInsertion insertion);
+
+        /// @brief Trace a ray through the octree with a parametric traversal and detect the first object hit by the ray.
+        /// @param ray The ray to trace through the octree
+        /// @param closest_collision_distance Reference to a distance holding the maximum distance to trace the ray,
+        ///                                   and that will hold the distance to the first hit object
+        /// @return A pointer to the first object hit by the ray, or nullptr if no object is hit
+        /// @note The segment of the ray in each child is derived from the segment in its parent, and the children are visited in the
+        ///       order the ray crosses them (see getNextChild): no box or plane is intersected below the root.
+        /// @note The traversal does not allocate memory and can be called from several threads at once.
+        /// @note A ray of another precision than the octree is converted first, and traced in the precision of the octree.
+        template <std::floating_point RayScalar>
+        const T* traceRay(const BasicRay<RayScalar>& ray, RayScalar& closest_collision_distance) const;
+
+        /// @brief Trace a packet of coherent rays through the octree together, and detect the first object hit by each ray.
+        /// @param packet The rays to trace, which must all go towards the same octant to be traced together
+        /// @param closest_collision_distances The maximum distance to trace each ray, set to the distance to its first hit object
+        /// @return A pointer to the first object hit by each ray, or nullptr if the ray hits no object or its lane is not in use
+        /// @note The packet visits the children of a node front to back for all its rays at once. The distances to the planes
+        ///       splitting the node are computed for all the rays together, and give the segment of each ray in each child.
+        ///       The rays which leave the packet early (a hit found in the current child, or the child missed) are masked out.
+        /// @note A packet whose rays go towards different octants is traced ray by ray, and so is the last ray left in a subtree.
+        ///       The hits are the same as with `traceRay`.
+        template <int N>
+        std::array<const T*, N> traceRays(const RayPacket<N>& packet, typename RayPacket<N>::Lanes& closest_collision_distances) const;
+
+        /// @brief Collect the subtrees of the octree overlapping a region, from which the rays crossing the region start their traversal
+        /// @param region The region crossed by the rays, eg the frustum of a tile of pixels (see FrustumRegion)
+        /// @param signs The octant towards which the rays go (see getDirectionOctant)
+        /// @param entry_points Filled with the subtrees overlapping the region, front to back for the octant (its capacity is reused)
+        /// @param max_nodes The maximum number of subtrees
+        /// @note The nodes overlapping the region replace their parent one level at a time, as long as there are at most `max_nodes`
+        ///       of them. The leaves are kept as they are, and the subtrees outside the region are dropped.
+        template <QueryRegion Region>
+        void cull(const Region& region, unsigned char signs, OctreeEntryPoints& entry_points,
+                  std::size_t max_nodes = OctreeEntryPoints::DEFAULT_MAX_NODES) const;
+
+        /// @brief Trace a ray crossing a region from the subtrees collected by `cull` for this region
+        /// @param ray The ray to trace, which must lie in the region given to `cull`
+        /// @param closest_collision_distance The maximum distance to trace the ray, set to the distance to its first hit object
+        /// @param entry_points The subtrees collected by `cull`
+        /// @return A pointer to the first object hit by the ray, or nullptr if no object is hit
+        /// @note The hits are the same as with `traceRay`, which traces the ray from the root if it goes towards another octant
+        ///       than the one given to `cull`. The ray is traced in double precision.
+        const T* traceRay(const Ray& ray, double& closest_collision_distance, const OctreeEntryPoints& entry_points) const;
+
+        /// @brief Trace a packet of rays crossing a region from the subtrees collected by `cull` for this region
+        /// @param packet The rays to trace, which must lie in the region given to `cull`
+        /// @param closest_collision_distances The maximum distance to trace each ray, set to the distance to its first hit object
+        /// @param entry_points The subtrees collected by `cull`
+        /// @return A pointer to the first object hit by each ray, or nullptr if the ray hits no object or its lane is not in use
+        /// @note The hits are the same as with `traceRays`, which traces the packet from the root if its rays go towards
+        ///       another octant than the one given to `cull`.
+        template <int N>
+        std::array<const T*, N> traceRays(const RayPacket<N>& packet, typename RayPacket<N>::Lanes& closest_collision_distances,
+                                          const OctreeEntryPoints& entry_points) const;
+
+        /// @brief Trace a large batch of rays through the octree node by node, and detect the first object hit by each ray.
+        /// @param rays The rays to trace, which can go in any direction
+        /// @param closest_collision_distances The maximum distance to trace each ray, set to the distance to its first hit object
+        /// @return A pointer to the first object hit by each ray, or nullptr if the ray hits no object
+        /// @note The rays are grouped by the octant of their direction. Each group goes down the octree as a stream: a node receives the
+        ///       list of the rays entering it, splits it between its children, and each leaf tests its objects against all the rays
+        ///       reaching it. The nodes and the objects are read once per group instead of once per ray.
+        /// @note A node reached by fewer than MIN_STREAM_SIZE rays traces them one by one. The hits are the same as with `traceRay`.
+        std::vector<const T*> traceRayStream(std::span<const Ray> rays, std::span<double> closest_collision_distances) const;
+
+        /// @brief Check if any object of the octree is hit by a ray before a maximum distance.
+        /// @param ray The ray to trace through the octree
+        /// @param max_distance The distance along the ray beyond which the hits are ignored
+        /// @return true if an object is hit at a distance in [0, max_distance)
+        /// @note The traversal stops at the first hit found, which is not necessarily the closest one,
+        ///       and it does not go through the children that the ray crosses beyond the maximum distance.
+        /// @note A ray of another precision than the octree is converted first, as with `traceRay`.
+        template <std::floating_point RayScalar>
+        bool occluded(const BasicRay<RayScalar>& ray, std::type_identity_t<RayScalar> max_distance) const;
+
+        /// @brief Gather the objects of the octree lying in a region of space, eg for culling or the broad phase of collisions.
+        /// @param region The region to gather (see BoxRegion, SphereRegion and FrustumRegion)
+        /// @param results Cleared, then filled with the objects in the region. Its capacity is reused, so that repeated queries do not allocate.
+        /// @note With BoundingBox insertion, an object is in the region if its bounding box overlaps it, and it is gathered once even if
+        ///       several leaves reference it. With Position insertion, its position must be in the region. The results are in no particular order.
+        /// @note The subtrees outside the region are skipped and the subtrees inside it are gathered without testing their objects.
+        ///       The objects of the leaves crossing the border of the region are tested once the traversal is done, fetching the next ones meanwhile.
+        template <QueryRegion Region>
+        void query(const Region& region, std::vector<const T*>& results) const;
+
+        /// @brief Find the object closest to a point, eg the distance from a probe to the nearest surface.
+        /// @param point The point
+        /// @param max_radius The distance beyond which the objects are ignored
+        /// @param closest_point Set to the point of the nearest object closest to `point`, only valid if an object is found
+        /// @return A pointer to the nearest object within `max_radius`, or nullptr if there is none
+        /// @note The nodes are visited best-first, by distance from the point to their cell, and the search stops when the closest
+        ///       node left is farther than the nearest object found. The distance to the objects of the leaves is exact.
+        /// @note With Position insertion, a leaf does not bound its objects: an object whose position lies in a farther leaf than
+        ///       another object may be missed, as the objects spanning several octants with `traceRay`.
+        const T* nearest(const Eigen::Vector3d& point, double max_radius, Eigen::Vector3d& closest_point) const requires NearestQueryable<T>;
+
+        /// @brief Get how the objects were placed in the leaves
+        /// @return The insertion mode of the compiled octree
+        inline OctreeInsertion getInsertion() const { return m_insertion; };
+
+        /// @brief Write the octree to a binary file, to load it later instead of building it again (see `load`)
+        /// @param path The path of the file, replaced if it exists
+        /// @param objects The objects of the octree: the file stores the position of each primitive in this array, not its address
+        /// @throws std::invalid_argument if an object of the octree is not in `objects`
+        /// @throws std::runtime_error if the file cannot be written
+        void save(const std::string& path, std::span<const T* const> objects) const;
+
+        /// @brief Replace the octree with one written to a file by `save`
+        /// @param path The path of the file
+        /// @param objects The objects of the saved octree, in the same order as when it was saved
+        /// @note The file is mapped in memory and its nodes are used in place: no node is copied or allocated, and the processes
+        ///       loading the same file share its pages. Only the primitive array is allocated, in one piece, from the saved indices.
+        /// @throws std::runtime_error if the file cannot be read, is not a flat octree file, was written by another version or on a
+        ///         machine with another layout, or is corrupted. The octree is then left unchanged.
+        /// @throws std::invalid_argument if the number of objects is not the one of the saved octree
+        void load(const std::string& path, std::span<const T* const> objects);
+
+        /// @brief Check if the nodes are read from a mapped file
+        /// @return true if the octree was loaded by `load`
+        inline bool isMapped() const { return m_mapping != nullptr; };
+
+        /// @brief Get the nodes of the octree, the root being the first one
+        /// @return The array of nodes
+        inline std::span<const NodeLayout> getNodes() const { return m_nodes; };
+
+        /// @brief Get the objects of the octree, grouped by leaf
+        /// @return The array of objects (with BoundingBox insertion, an object appears once per leaf it overlaps)
+        inline const std::vector<const T*>& getPrimitives() const { return m_primitives; };
+
+        /// @brief Get the number of objects referenced by the leaves
+        /// @return The size of the primitive array, without the objects of the leaves replaced by `update`
+        inline std::size_t getReferenceCount() const { return m_primitives.size() - m_stale_primitives; };
+
+        /// @brief Check if the arrays only hold the nodes and the objects in use
+        /// @return false if `update` patched the octree since it was compiled from scratch
+        inline bool isCompact() const { return m_contiguous; };
+
+        /// @brief Get the center of the root node
+        /// @return The position of the center of the root node
+        inline const Eigen::Vector3d& getRootCenter() const { return m_root_center; };
+
+        /// @brief Get the half size of the root node
+        /// @return Half the length of one side of the root node
+        inline double getRootHalfSize() const { return m_root_half_size; };
+
+        /// @brief Get the memory used by the flat octree
+        /// @return The number of bytes used by the nodes, the primitive array and the intersection records (the nodes of a loaded octree
+        ///         are in the mapped file)
+        inline std::size_t bytes() const {
+            std::size_t record_bytes = m_records.size() * sizeof(Record);
+            if constexpr (RangeIntersectable<RecordStorage>) record_bytes = m_records.bytes();
+            return m_nodes.size() * sizeof(NodeLayout) + m_primitives.size() * sizeof(const T*) + m_object_ids.size() * sizeof(std::uint32_t) +
+                   record_bytes;
+        };
+
+        /// @brief Below this number of rays, the rays reaching a node during a stream traversal are traced one by one
+        static constexpr std::size_t MIN_STREAM_SIZE = 16;
+
+    private:
+        std::span<const NodeLayout> m_nodes; // Nodes of the octree, the root is the first one (in `m_node_storage` or in `m_mapping`)
+        std::vector<NodeLayout> m_node_storage; // Nodes compiled by `build`, empty for an octree loaded from a file
+        std::shared_ptr<const MappedFile> m_mapping; // File holding the nodes of an octree loaded by `load`, nullptr otherwise
+        std::vector<const T*> m_primitives; // Objects of the leaves, each leaf referencing a contiguous range
+
+        using Record = typename IntersectionRecordOf<T, Scalar>::type;
+        using RecordStorage = typename IntersectionRecordStorageOf<Record>::type;
+        RecordStorage m_records; // Intersection records of the objects of `m_primitives`, in the same order (empty if T has none)
+        std::vector<std::uint32_t> m_object_ids; // Id of the object of each primitive, in the same order (BoundingBox insertion only)
+        std::unordered_map<const T*, std::uint32_t> m_ids_by_object; // Id given to each compiled object (empty for a loaded octree)
+        std::size_t m_id_count = 0; // Number of object ids, which are in [0, m_id_count)
+
+        Eigen::Vector3d m_root_center = Eigen::Vector3d::Zero(); // Center of the root node
+        double m_root_half_size = 0; // Half size of the root node
+        OctreeInsertion m_insertion = OctreeInsertion::Position; // How the objects were placed in the leaves
+        std::size_t m_stale_nodes = 0; // Nodes replaced by `update`, left in the node array
+        std::size_t m_stale_primitives = 0; // Objects of the leaves replaced by `update`, left in the primitive array
+        bool m_contiguous = true; // True if the objects of each subtree form a contiguous range of the primitive array, as compiled from scratch
+
+        /// @brief Recursively compile a node and its subtree
+        /// @param node The pointer-based node to compile
+        /// @param node_index The index of the compiled node in the node array (already allocated)
+        /// @param object_counts The number of objects in the subtree of each pointer-based node
+        template <typename NodeType>
+        void buildNode(const NodeType* node, std::uint32_t node_index, const std::unordered_map<const NodeType*, std::size_t>& object_counts);
+
+        /// @brief Compile a subtree which was not in the flat octree into an allocated node
+        /// @param node The pointer-based root of the subtree
+        /// @param node_index The index of the compiled node in the node array (already allocated)
+        template <typename NodeType>
+        void buildSubtree(const NodeType* node, std::uint32_t node_index);
+
+        /// @brief Recursively patch a modified node and the modified nodes of its subtree (see `update`)
+        /// @param node The modified pointer-based node, which holds objects
+        /// @param node_index The index of the node as it was compiled in the node array, replaced by the patched node
+        template <typename NodeType>
+        void updateNode(const NodeType* node, std::uint32_t node_index);
+
+        /// @brief Append the objects of a pointer-based leaf to the primitive array, with their ids
+        /// @param objects The objects of the leaf
+        /// @return The compiled leaf referencing the appended objects
+        NodeLayout appendLeaf(std::span<const T* const> objects);
+
+        /// @brief Count the nodes and the objects below a compiled node as stale, once the node is replaced
+        /// @param node The replaced node
+        void discardSubtree(const NodeLayout& node);
+
+        /// @brief Recursively trace a ray through a node and its subtree, with the parametric traversal
+        /// @param node_index The index of the node in the node array
+        /// @param center The center of the node
+        /// @param half_size The half size of the node
+        /// @param slabs The distances at which the ray enters and leaves the slabs of the node (see getNodeSlabs)
+        /// @param signs The octant towards which the ray goes (see getDirectionOctant)
+        /// @param ray The ray to trace
+        /// @param closest_collision_distance Reference to the distance to the closest object hit so far
+        /// @param mailbox The objects already tested by the ray (BoundingBox insertion only)
+        /// @return A pointer to the first object hit by the ray in the subtree, or nullptr if no object is hit
+        /// @note The traversal computes in the precision of the ray: the one of the octree for `traceRay`, double for the packets and streams.
+        template <std::floating_point S>
+        const T* traceNode(std::uint32_t node_index, const Eigen::Matrix<S, 3, 1>& center, S half_size, const BasicNodeSlabs<S>& slabs, unsigned char signs,
+                           const BasicRay<S>& ray, S& closest_collision_distance, RayMailbox<T>& mailbox) const;
+
+        /// @brief Recursively trace the active rays of a packet through a node and its subtree
+        /// @param node_index The index of the node in the node array
+        /// @param center The center of the node
+        /// @param half_size The half size of the node
+        /// @param packet The rays to trace
+        /// @param mask The lanes whose ray enters the node before its closest hit so far
+        /// @param signs The octant towards which all the rays go (see RayPacket::getDirectionSigns)
+        /// @param enter_distances The distance at which each ray enters the node
+        /// @param exit_distances The distance at which each ray leaves the node
+        /// @param closest_collisions The closest object hit so far by each ray
+        /// @param closest_collision_distances The distance to the closest object hit so far by each ray
+        /// @param mailboxes The objects already tested by each ray (BoundingBox insertion only)
+        template <int N>
+        void traceNodePacket(std::uint32_t node_index, const Eigen::Vector3d& center, double half_size,
+                             const RayPacket<N>& packet, typename RayPacket<N>::Mask mask, unsigned char signs,
+                             const typename RayPacket<N>::Lanes& enter_distances, const typename RayPacket<N>::Lanes& exit_distances,
+                             std::array<const T*, N>& closest_collisions, typename RayPacket<N>::Lanes& closest_collision_distances,
+                             std::array<RayMailbox<T>, N>& mailboxes) const;
+
+        /// @brief Get the rays of a packet whose traversal ends after a subtree, with the stopping rules of the scalar traversal:
+        ///        with Position insertion, a ray stops at its first hit,
+        ///        with BoundingBox insertion, a ray stops when its closest hit lies before it leaves the subtree
+        /// @param mask The lanes whose ray went through the subtree
+        /// @param closest_collisions The closest object hit so far by each ray
+        /// @param closest_collision_distances The distance to the closest object hit so far by each ray
+        /// @param exit_distances The distance at which each ray leaves the subtree
+        /// @return The lanes of `mask` whose traversal ends
+        template <int N>
+        typename RayPacket<N>::Mask getStoppedLanes(typename RayPacket<N>::Mask mask, const std::array<const T*, N>& closest_collisions,
+                                                    const typename RayPacket<N>::Lanes& closest_collision_distances,
+                                                    const typename RayPacket<N>::Lanes& exit_distances) const;
+
+        /// @brief Test a ray against an object of the primitive array, through its intersection record if it has one
+        /// @param primitive_index The index of the object in the primitive array
+        /// @param ray The ray to test
+        /// @param u Set to the barycentric coordinate u of the intersection point (see Triangle::intersect)
+        /// @param v Set to the barycentric coordinate v of the intersection point (see Triangle::intersect)
+        /// @param t Set to the distance from the ray origin to the intersection point
+        /// @return true if the ray intersects the object
+        template <std::floating_point S>
+        inline bool intersectPrimitive(std::size_t primitive_index, const BasicRay<S>& ray, float& u, float& v, float& t) const {
+            if constexpr (RecordIntersectable<T>) {
+                return m_records[primitive_index].intersect(ray, u, v, t);
+            } else if constexpr (std::same_as<S, double>) {
+                return m_primitives[primitive_index]->intersect(ray, u, v, t);
+            } else {
+                return m_primitives[primitive_index]->intersect(ray.template cast<double>(), u, v, t); // The objects test the rays of the scene
+            }
+        };
+
+        /// @brief Fill the intersection records of the objects of the primitive array, if they have some (see RecordIntersectable)
+        void buildRecords();
+
+        /// @brief Append the intersection records of the objects appended to the primitive array, if they have some
+        /// @param first The index of the first object without a record
+        void appendRecords(std::size_t first);
+
+        /// @brief Recursively gather the objects of a node's subtree lying in a region
+        /// @param node_index The index of the node in the node array
+        /// @param center The center of the node
+        /// @param half_size The half size of the node
+        /// @param region The region to gather
+        /// @param results The objects gathered so far
+        /// @param candidates The objects of the leaves crossing the border of the region, to test once the traversal is done
+        /// @param stamps The objects already reached by the query, nullptr with Position insertion
+        template <QueryRegion Region>
+        void queryNode(std::uint32_t node_index, const Eigen::Vector3d& center, double half_size, const Region& region,
+                       std::vector<const T*>& results, std::vector<const T*>& candidates, QueryStamps* stamps) const;
+
+        /// @brief Check if an object lies in the region of a query, by bounding box or by position depending on the insertion mode
+        /// @param region The region of the query
+        /// @param object The object to check
+        /// @return true if the object is gathered by the query
+        template <QueryRegion Region>
+        bool isInRegion(const Region& region, const T* object) const;
+
+        /// @brief Get the data of an object read by `isInRegion`, to fetch it before the test
+        /// @param object The object
+        /// @return The address of its bounding box or of its position if they are stored in it, the address of the object otherwise
+        const void* getRegionTestData(const T* object) const;
+
+        /// @brief Gather all the objects of a node's subtree, which lies inside the region of a query
+        /// @param node_index The index of the node in the node array
+        /// @param results The objects gathered so far
+        /// @param stamps The objects already reached by the query, nullptr with Position insertion
+        void gatherNode(std::uint32_t node_index, std::vector<const T*>& results, QueryStamps* stamps) const;
+
+        /// @brief A ray of a stream reaching a node, and its segment inside the node
+        struct StreamRay {
+            std::uint32_t index; // Index of the ray in the batch
+            double enter_distance; // Distance at which the ray enters the node
+            double exit_distance; // Distance at which the ray leaves the node
+        };
+
+        /// @brief The rays reaching the node being traversed at one depth of the octree, during a stream traversal
+        struct StreamLevel {
+            std::vector<StreamRay> rays; // The rays reaching the node
+            std::vector<std::array<double, 3>> plane_distances; // Distances of each ray to the 3 planes splitting the node
+        };
+
+        /// @brief The state of a stream traversal, shared by all the nodes
+        struct RayStream {
+            std::span<const Ray> rays; // The rays of the batch
+            std::span<double> closest_collision_distances; // Distance to the closest object hit so far by each ray
+            std::vector<const T*> closest_collisions; // Closest object hit so far by each ray
+            std::vector<char> finished; // True for the rays whose closest hit is found
+            std::vector<RayMailbox<T>> mailboxes; // Objects already tested by each ray (BoundingBox insertion only)
+            std::deque<StreamLevel> levels; // One level per depth, reused by the nodes of that depth (a deque keeps them in place)
+        };
+
+        /// @brief Recursively trace the rays of a stream through a node and its subtree
+        /// @param node_index The index of the node in the node array
+        /// @param center The center of the node
+        /// @param half_size The half size of the node
+        /// @param depth The depth of the node, whose rays are in `stream.levels[depth]`
+        /// @param signs The octant towards which all the rays go (see getDirectionOctant)
+        /// @param stream The state of the traversal
+        void traceStreamNode(std::uint32_t node_index, const Eigen::Vector3d& center, double half_size, unsigned int depth,
+                             unsigned char signs, RayStream& stream) const;
+
+        /// @brief Recursively check if a ray hits an object of a node's subtree before a maximum distance
+        /// @param node_index The index of the node in the node array
+        /// @param center The center of the node
+        /// @param half_size The half size of the node
+        /// @param slabs The distances at which the ray enters and leaves the slabs of the node (see getNodeSlabs)
+        /// @param signs The octant towards which the ray goes (see getDirectionOctant)
+        /// @param ray The ray to trace
+        /// @param max_distance The distance along the ray beyond which the hits are ignored
+        /// @param mailbox The objects already tested by the ray (BoundingBox insertion only)
+        /// @return true if an object of the subtree is hit at a distance in [0, max_distance)
+        template <std::floating_point S>
+        bool occludedNode(std::uint32_t node_index, const Eigen::Matrix<S, 3, 1>& center, S half_size, const BasicNodeSlabs<S>& slabs, unsigned char signs,
+                          const BasicRay<S>& ray, S max_distance, RayMailbox<T>& mailbox) const;
+};
+
+// Include the implementation file to make the template class implementation accessible to the compiler
+#include "Structures/flatOctree.tpp"
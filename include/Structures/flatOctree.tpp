@@ -0,0 +1,1123 @@
+#include "Structures/flatOctree.hpp"
+
+/// @brief Count the objects in the subtree of each node, in post order
+/// @param node The root of the subtree
+/// @param object_counts The map filled with the number of objects of each node's subtree
+/// @return The number of objects in the subtree of `node`
+template <typename NodeType>
+std::size_t countSubtreeObjects(const NodeType* node, std::unordered_map<const NodeType*, std::size_t>& object_counts) {
+    std::size_t count = node->data.size();
+    if (node->total_children_depth > 0) {
+        for (int i = 0; i < 8; ++i) {
+            if (node->children[i] != nullptr) count += countSubtreeObjects(node->children[i], object_counts);
+        }
+    }
+    object_counts[node] = count;
+    return count;
+}
+
+/// @brief Check if the subtree of a node holds any object
+/// @param node The root of the subtree
+/// @return true as soon as a leaf holding objects is found
+template <typename NodeType>
+bool hasSubtreeObjects(const NodeType* node) {
+    if (node->total_children_depth == 0) return !node->data.empty();
+    for (int i = 0; i < 8; ++i) {
+        if (node->children[i] != nullptr && hasSubtreeObjects(node->children[i])) return true;
+    }
+    return false;
+}
+
+template <typename T, FlatOctreeNodeLayout NodeLayout, std::floating_point Scalar>
+FlatOctree<T, NodeLayout, Scalar>::FlatOctree(const FlatOctree& other) {
+    *this = other;
+}
+
+template <typename T, FlatOctreeNodeLayout NodeLayout, std::floating_point Scalar>
+FlatOctree<T, NodeLayout, Scalar>& FlatOctree<T, NodeLayout, Scalar>::operator=(const FlatOctree& other) {
+    if (this == &other) return *this;
+    m_node_storage = other.m_node_storage;
+    m_mapping = other.m_mapping;
+    m_primitives = other.m_primitives;
+    m_records = other.m_records;
+    m_object_ids = other.m_object_ids;
+    m_ids_by_object = other.m_ids_by_object;
+    m_id_count = other.m_id_count;
+    m_root_center = other.m_root_center;
+    m_root_half_size = other.m_root_half_size;
+    m_insertion = other.m_insertion;
+    m_stale_nodes = other.m_stale_nodes;
+    m_stale_primitives = other.m_stale_primitives;
+    m_contiguous = other.m_contiguous;
+
+    // The nodes of a loaded octree stay in the shared mapping, the compiled ones are in the copied storage
+    m_nodes = m_mapping ? other.m_nodes : std::span<const NodeLayout>(m_node_storage);
+    return *this;
+}
+
+template <typename T, FlatOctreeNodeLayout NodeLayout, std::floating_point Scalar>
+FlatOctree<T, NodeLayout, Scalar>::FlatOctree(FlatOctree&& other) noexcept {
+    *this = std::move(other);
+}
+
+template <typename T, FlatOctreeNodeLayout NodeLayout, std::floating_point Scalar>
+FlatOctree<T, NodeLayout, Scalar>& FlatOctree<T, NodeLayout, Scalar>::operator=(FlatOctree&& other) noexcept {
+    if (this == &other) return *this;
+    // Moving the storage keeps its buffer, so the nodes do not move in memory
+    m_node_storage = std::move(other.m_node_storage);
+    m_mapping = std::move(other.m_mapping);
+    m_nodes = std::exchange(other.m_nodes, {});
+    m_primitives = std::move(other.m_primitives);
+    m_records = std::move(other.m_records);
+    m_object_ids = std::move(other.m_object_ids);
+    m_ids_by_object = std::move(other.m_ids_by_object);
+    m_id_count = std::exchange(other.m_id_count, 0);
+    m_root_center = other.m_root_center;
+    m_root_half_size = other.m_root_half_size;
+    m_insertion = other.m_insertion;
+    m_stale_nodes = std::exchange(other.m_stale_nodes, 0);
+    m_stale_primitives = std::exchange(other.m_stale_primitives, 0);
+    m_contiguous = std::exchange(other.m_contiguous, true);
+    return *this;
+}
+
+template <typename T, FlatOctreeNodeLayout NodeLayout, std::floating_point Scalar>
+template <typename NodeType>
+void FlatOctree<T, NodeLayout, Scalar>::build(const NodeType* root, OctreeInsertion insertion) {
+    m_mapping.reset();
+    m_node_storage.clear();
+    m_primitives.clear();
+    m_object_ids.clear();
+    m_ids_by_object.clear();
+    m_id_count = 0;
+    m_insertion = insertion;
+    m_stale_nodes = 0;
+    m_stale_primitives = 0;
+    m_contiguous = true;
+
+    m_root_center = root->position;
+    m_root_half_size = root->getHalfSize();
+
+    std::unordered_map<const NodeType*, std::size_t> object_counts;
+    // Leave room for the leaves appended by the next updates, so that the first one does not copy all the objects and their records
+    const std::size_t primitive_count = countSubtreeObjects(root, object_counts);
+    m_primitives.reserve(primitive_count + primitive_count / 8);
+    if (insertion == OctreeInsertion::BoundingBox) m_object_ids.reserve(m_primitives.capacity());
+
+    m_node_storage.push_back(NodeLayout::makeLeaf(0, 0));
+    buildNode(root, 0, object_counts);
+    m_nodes = m_node_storage;
+    buildRecords();
+}
+
+template <typename T, FlatOctreeNodeLayout NodeLayout, std::floating_point Scalar>
+void FlatOctree<T, NodeLayout, Scalar>::buildRecords() {
+    m_records.clear();
+    if constexpr (RecordIntersectable<T>) m_records.reserve(m_primitives.capacity());
+    appendRecords(0);
+}
+
+template <typename T, FlatOctreeNodeLayout NodeLayout, std::floating_point Scalar>
+void FlatOctree<T, NodeLayout, Scalar>::appendRecords(std::size_t first) {
+    if constexpr (RecordIntersectable<T>) {
+        for (std::size_t i = first; i < m_primitives.size(); ++i) {
+            if constexpr (std::same_as<Record, typename T::IntersectionRecord>) {
+                m_records.push_back(m_primitives[i]->getIntersectionRecord());
+            } else {
+                m_records.push_back(m_primitives[i]->getIntersectionRecord().template cast<Scalar>());
+            }
+        }
+    }
+}
+
+template <typename T, FlatOctreeNodeLayout NodeLayout, std::floating_point Scalar>
+template <typename NodeType>
+void FlatOctree<T, NodeLayout, Scalar>::buildNode(const NodeType* node, std::uint32_t node_index, const std::unordered_map<const NodeType*, std::size_t>& object_counts) {
+    // Leaf: append its objects to the primitive array
+    if (node->total_children_depth == 0) {
+        m_node_storage[node_index] = appendLeaf(node->data);
+        return;
+    }
+
+    // Interior node: only keep the children that contain objects
+    std::uint8_t child_mask = 0;
+    for (int i = 0; i < 8; ++i) {
+        if (node->children[i] != nullptr && object_counts.at(node->children[i]) > 0) child_mask |= (1u << i);
+    }
+
+    // Allocate the children next to each other before compiling them (the node array may be reallocated meanwhile)
+    std::uint32_t child_base = static_cast<std::uint32_t>(m_node_storage.size());
+    m_node_storage.resize(m_node_storage.size() + std::popcount(static_cast<unsigned int>(child_mask)), NodeLayout::makeLeaf(0, 0));
+    m_node_storage[node_index] = NodeLayout::makeInterior(child_base, child_mask);
+
+    for (unsigned char i = 0; i < 8; ++i) {
+        if (child_mask & (1u << i)) {
+            buildNode(node->children[i], m_node_storage[node_index].getChild(i), object_counts);
+        }
+    }
+}
+
+template <typename T, FlatOctreeNodeLayout NodeLayout, std::floating_point Scalar>
+template <typename NodeType>
+bool FlatOctree<T, NodeLayout, Scalar>::update(const NodeType* root, OctreeInsertion insertion) {
+    // The nodes of a loaded octree are read-only, and a new root has other bounds than the compiled one
+    if (m_mapping || m_node_storage.empty() || insertion != m_insertion || root->position != m_root_center ||
+        root->getHalfSize() != m_root_half_size) {
+        build(root, insertion);
+        return true;
+    }
+
+    const std::size_t first_new_primitive = m_primitives.size();
+    if (root->modified) {
+        m_contiguous = false;
+        if (hasSubtreeObjects(root)) {
+            updateNode(root, 0);
+        } else {
+            discardSubtree(m_node_storage[0]);
+            m_node_storage[0] = NodeLayout::makeLeaf(static_cast<std::uint32_t>(m_primitives.size()), 0);
+        }
+    }
+    m_nodes = m_node_storage;
+
+    // Compile from scratch once the replaced nodes or objects outnumber the ones in use
+    if (2 * m_stale_nodes > m_node_storage.size() || 2 * m_stale_primitives > m_primitives.size()) {
+        build(root, insertion);
+        return true;
+    }
+    appendRecords(first_new_primitive);
+    return false;
+}
+
+template <typename T, FlatOctreeNodeLayout NodeLayout, std::floating_point Scalar>
+template <typename NodeType>
+void FlatOctree<T, NodeLayout, Scalar>::buildSubtree(const NodeType* node, std::uint32_t node_index) {
+    std::unordered_map<const NodeType*, std::size_t> object_counts;
+    countSubtreeObjects(node, object_counts);
+    buildNode(node, node_index, object_counts);
+}
+
+template <typename T, FlatOctreeNodeLayout NodeLayout, std::floating_point Scalar>
+template <typename NodeType>
+void FlatOctree<T, NodeLayout, Scalar>::updateNode(const NodeType* node, std::uint32_t node_index) {
+    const NodeLayout compiled_node = m_node_storage[node_index];
+
+    // Leaf: append its objects to the primitive array, the objects of the compiled node are no longer used
+    if (node->total_children_depth == 0) {
+        discardSubtree(compiled_node);
+        m_node_storage[node_index] = appendLeaf(node->data);
+        return;
+    }
+
+    // The children which were not modified hold objects if they were compiled. A child created since then is modified
+    const bool was_interior = !compiled_node.isLeaf();
+    std::uint8_t child_mask = 0;
+    for (unsigned char i = 0; i < 8; ++i) {
+        const NodeType* child = node->children[i];
+        const bool has_objects = child->modified ? hasSubtreeObjects(child) : was_interior && compiled_node.hasChild(i);
+        if (has_objects) child_mask |= (1u << i);
+    }
+
+    // Same children: patch the modified ones where they are
+    if (was_interior && compiled_node.getChildMask() == child_mask) {
+        for (unsigned char i = 0; i < 8; ++i) {
+            if ((child_mask & (1u << i)) && node->children[i]->modified) updateNode(node->children[i], compiled_node.getChild(i));
+        }
+        return;
+    }
+
+    // Other children: allocate a new block of children next to each other. The children which were compiled are moved to it
+    // with their subtree left in place, and patched if they were modified
+    const std::uint32_t child_base = static_cast<std::uint32_t>(m_node_storage.size());
+    m_node_storage.resize(m_node_storage.size() + std::popcount(static_cast<unsigned int>(child_mask)), NodeLayout::makeLeaf(0, 0));
+    m_node_storage[node_index] = NodeLayout::makeInterior(child_base, child_mask);
+    if (was_interior) {
+        m_stale_nodes += std::popcount(static_cast<unsigned int>(compiled_node.getChildMask()));
+    } else {
+        discardSubtree(compiled_node);
+    }
+
+    for (unsigned char i = 0; i < 8; ++i) {
+        const bool was_compiled = was_interior && compiled_node.hasChild(i);
+        if (!(child_mask & (1u << i))) {
+            if (was_compiled) discardSubtree(m_node_storage[compiled_node.getChild(i)]);
+            continue;
+        }
+
+        const std::uint32_t child_index = m_node_storage[node_index].getChild(i);
+        if (!was_compiled) {
+            buildSubtree(node->children[i], child_index);
+            continue;
+        }
+        m_node_storage[child_index] = m_node_storage[compiled_node.getChild(i)];
+        if (node->children[i]->modified) updateNode(node->children[i], child_index);
+    }
+}
+
+template <typename T, FlatOctreeNodeLayout NodeLayout, std::floating_point Scalar>
+NodeLayout FlatOctree<T, NodeLayout, Scalar>::appendLeaf(std::span<const T* const> objects) {
+    const NodeLayout leaf = NodeLayout::makeLeaf(static_cast<std::uint32_t>(m_primitives.size()), objects.size());
+    m_primitives.insert(m_primitives.end(), objects.begin(), objects.end());
+
+    // The queries gather an object once by its id, which stays the same in all the leaves referencing it
+    if (m_insertion == OctreeInsertion::BoundingBox) {
+        for (const T* object : objects) {
+            auto [id, inserted] = m_ids_by_object.try_emplace(object, static_cast<std::uint32_t>(m_id_count));
+            if (inserted) ++m_id_count;
+            m_object_ids.push_back(id->second);
+        }
+    }
+    return leaf;
+}
+
+template <typename T, FlatOctreeNodeLayout NodeLayout, std::floating_point Scalar>
+void FlatOctree<T, NodeLayout, Scalar>::discardSubtree(const NodeLayout& node) {
+    if (node.isLeaf()) {
+        m_stale_primitives += node.getCount();
+        return;
+    }
+    m_stale_nodes += std::popcount(static_cast<unsigned int>(node.getChildMask()));
+    for (unsigned char i = 0; i < 8; ++i) {
+        if (node.hasChild(i)) discardSubtree(m_node_storage[node.getChild(i)]);
+    }
+}
+
+template <typename T, FlatOctreeNodeLayout NodeLayout, std::floating_point Scalar>
+void FlatOctree<T, NodeLayout, Scalar>::save(const std::string& path, std::span<const T* const> objects) const {
+    std::unordered_map<const T*, std::uint32_t> object_indices;
+    object_indices.reserve(objects.size());
+    for (std::size_t i = 0; i < objects.size(); ++i) {
+        object_indices.try_emplace(objects[i], static_cast<std::uint32_t>(i));
+    }
+
+    std::vector<std::uint32_t> primitive_indices;
+    primitive_indices.reserve(m_primitives.size());
+    for (const T* primitive : m_primitives) {
+        auto index = object_indices.find(primitive);
+        if (index == object_indices.end()) {
+            throw std::invalid_argument("Cannot save octree: An object of the octree is not in the saved objects.");
+        }
+        primitive_indices.push_back(index->second);
+    }
+
+    FlatOctreeFileHeader header{};
+    std::memcpy(header.magic, FlatOctreeFileHeader::MAGIC, sizeof(header.magic));
+    header.version = FlatOctreeFileHeader::VERSION;
+    header.byte_order = FlatOctreeFileHeader::ENDIANNESS_MARKER;
+    header.node_size = sizeof(NodeLayout);
+    header.insertion = static_cast<std::uint32_t>(m_insertion);
+    header.node_count = m_nodes.size();
+    header.primitive_count = m_primitives.size();
+    header.object_count = objects.size();
+    for (int axis = 0; axis < 3; ++axis) header.root_center[axis] = m_root_center[axis];
+    header.root_half_size = m_root_half_size;
+    header.node_offset = sizeof(FlatOctreeFileHeader);
+    header.primitive_offset = header.node_offset + m_nodes.size() * sizeof(NodeLayout);
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file) {
+        throw std::runtime_error("Cannot save octree: Cannot open file " + path + ".");
+    }
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    // The nodes have no padding (see FlatOctreeNodeLayout), so the same octree always gives the same file
+    file.write(reinterpret_cast<const char*>(m_nodes.data()), m_nodes.size() * sizeof(NodeLayout));
+    file.write(reinterpret_cast<const char*>(primitive_indices.data()), primitive_indices.size() * sizeof(std::uint32_t));
+
+    if (!file.flush()) {
+        throw std::runtime_error("Cannot save octree: Cannot write file " + path + ".");
+    }
+}
+
+template <typename T, FlatOctreeNodeLayout NodeLayout, std::floating_point Scalar>
+void FlatOctree<T, NodeLayout, Scalar>::load(const std::string& path, std::span<const T* const> objects) {
+    std::shared_ptr<const MappedFile> mapping = MappedFile::open(path);
+    auto fail = [&path](const std::string& reason) {
+        throw std::runtime_error("Cannot load octree from " + path + ": " + reason);
+    };
+
+    FlatOctreeFileHeader header;
+    if (mapping->size() < sizeof(header)) fail("The file is too small.");
+    std::memcpy(&header, mapping->data(), sizeof(header));
+
+    if (std::memcmp(header.magic, FlatOctreeFileHeader::MAGIC, sizeof(header.magic)) != 0) fail("This is not an octree file.");
+    if (header.version != FlatOctreeFileHeader::VERSION) fail("Unsupported version " + std::to_string(header.version) + ".");
+    if (header.byte_order != FlatOctreeFileHeader::ENDIANNESS_MARKER || header.node_size != sizeof(NodeLayout)) {
+        fail("The file was written with another layout of the nodes, or on a machine with another byte order.");
+    }
+    if (header.insertion > static_cast<std::uint32_t>(OctreeInsertion::BoundingBox)) fail("Unknown insertion mode.");
+    if (!(header.root_half_size > 0) || !std::isfinite(header.root_half_size)) fail("Invalid root node.");
+
+    // The arrays must lie in the file, at offsets where their elements are aligned
+    const std::size_t size = mapping->size();
+    if (header.node_count == 0 || header.node_offset % alignof(NodeLayout) != 0 || header.node_offset > size ||
+        header.node_count > (size - header.node_offset) / sizeof(NodeLayout) ||
+        header.primitive_offset % alignof(std::uint32_t) != 0 || header.primitive_offset > size ||
+        header.primitive_count > (size - header.primitive_offset) / sizeof(std::uint32_t)) {
+        fail("The file is truncated or corrupted.");
+    }
+    if (header.object_count != objects.size()) {
+        throw std::invalid_argument("Cannot load octree from " + path + ": The octree was saved with " + std::to_string(header.object_count) +
+                                    " objects, not " + std::to_string(objects.size()) + ".");
+    }
+
+    // The traversal trusts the indices of the nodes: the children come after their parent, and the leaves reference primitives
+    const std::span<const NodeLayout> nodes(reinterpret_cast<const NodeLayout*>(mapping->data() + header.node_offset), header.node_count);
+    for (std::size_t i = 0; i < nodes.size(); ++i) {
+        const NodeLayout& node = nodes[i];
+        const std::uint64_t end = node.isLeaf() ? std::uint64_t{node.getFirst()} + node.getCount()
+                                                : std::uint64_t{node.getChildBase()} + std::popcount(static_cast<unsigned int>(node.getChildMask()));
+        if (node.isLeaf() ? end > header.primitive_count : (node.getChildBase() <= i || end > header.node_count)) {
+            fail("Invalid node " + std::to_string(i) + ".");
+        }
+    }
+
+    // A patched octree saved by `save` is read as it was saved, with subtrees whose objects are not contiguous.
+    // The walk stops once it visits more nodes than the file holds, which only happens if nodes share children
+    bool contiguous = true;
+    std::uint64_t next_primitive = 0;
+    std::size_t visited_nodes = 0;
+    std::vector<std::uint32_t> stack = {0};
+    while (contiguous && !stack.empty()) {
+        const NodeLayout& node = nodes[stack.back()];
+        stack.pop_back();
+        if (++visited_nodes > nodes.size()) {
+            contiguous = false;
+            break;
+        }
+        if (node.isLeaf()) {
+            contiguous = node.getFirst() == next_primitive;
+            next_primitive += node.getCount();
+            continue;
+        }
+        for (int i = 7; i >= 0; --i) {
+            if (node.hasChild(i)) stack.push_back(node.getChild(i));
+        }
+    }
+
+    const std::uint32_t* indices = reinterpret_cast<const std::uint32_t*>(mapping->data() + header.primitive_offset);
+    std::vector<const T*> primitives(header.primitive_count);
+    for (std::size_t i = 0; i < primitives.size(); ++i) {
+        if (indices[i] >= objects.size()) fail("Invalid object index " + std::to_string(indices[i]) + ".");
+        primitives[i] = objects[indices[i]];
+    }
+
+    // The file is valid: replace the octree
+    m_node_storage.clear();
+    m_node_storage.shrink_to_fit();
+    m_mapping = std::move(mapping);
+    m_nodes = nodes;
+    m_primitives = std::move(primitives);
+    m_root_center = Eigen::Vector3d(header.root_center[0], header.root_center[1], header.root_center[2]);
+    m_root_half_size = header.root_half_size;
+    m_insertion = static_cast<OctreeInsertion>(header.insertion);
+    m_stale_nodes = 0;
+    m_stale_primitives = 0;
+    m_contiguous = contiguous;
+
+    // The indices of the saved objects are their ids
+    m_ids_by_object.clear();
+    m_object_ids.clear();
+    if (m_insertion == OctreeInsertion::BoundingBox) m_object_ids.assign(indices, indices + header.primitive_count);
+    m_id_count = objects.size();
+    buildRecords(); // The records depend on the objects, they are not saved
+}
+
+template <typename T, FlatOctreeNodeLayout NodeLayout, std::floating_point Scalar>
+template <std::floating_point RayScalar>
+const T* FlatOctree<T, NodeLayout, Scalar>::traceRay(const BasicRay<RayScalar>& ray, RayScalar& closest_collision_distance) const {
+    if constexpr (!std::same_as<RayScalar, Scalar>) {
+        Scalar distance = static_cast<Scalar>(closest_collision_distance);
+        const T* collision = traceRay(ray.template cast<Scalar>(), distance);
+        if (collision != nullptr) closest_collision_distance = distance;
+        return collision;
+    } else {
+        if (m_nodes.empty()) return nullptr;
+        RayMailbox<T> mailbox;
+        const unsigned char signs = getDirectionOctant(ray.getDirection());
+        const Eigen::Matrix<Scalar, 3, 1> center = m_root_center.template cast<Scalar>();
+        const Scalar half_size = static_cast<Scalar>(m_root_half_size);
+        return traceNode(0, center, half_size, getNodeSlabs(center, half_size, ray, signs), signs, ray, closest_collision_distance, mailbox);
+    }
+}
+
+/// Uses the parametric traversal of Revelles et al. to trace a ray through the octree and detect the first object hit by the ray.
+///     See http://wscg.zcu.cz/wscg2000/Papers_2000/X31.pdf
+template <typename T, FlatOctreeNodeLayout NodeLayout, std::floating_point Scalar>
+template <std::floating_point S>
+const T* FlatOctree<T, NodeLayout, Scalar>::traceNode(std::uint32_t node_index, const Eigen::Matrix<S, 3, 1>& center, S half_size, const BasicNodeSlabs<S>& slabs,
+                                                      unsigned char signs, const BasicRay<S>& ray, S& closest_collision_distance, RayMailbox<T>& mailbox) const {
+    // If the ray misses the node, leaves it behind its origin, or enters it beyond the closest collision, stop tracing
+    const S enter_distance = std::max(slabs.getEnterDistance(), S(0));
+    if (enter_distance > slabs.getExitDistance() || enter_distance > closest_collision_distance) return nullptr;
+
+    const NodeLayout& node = m_nodes[node_index];
+    const T* closest_collision = nullptr;
+
+    // If the node is a leaf, check for collisions with its objects, which are contiguous in memory
+    if constexpr (RangeIntersectable<RecordStorage>) {
+        // The records of the leaf are tested together. No mailbox is needed: an object hit in a previous leaf is not closer than the closest hit
+        if (node.isLeaf()) {
+            m_records.intersect(ray, node.getFirst(), node.getCount(), [&](std::size_t index, float collision_distance) {
+                if (collision_distance < closest_collision_distance) {
+                    closest_collision_distance = collision_distance;
+                    closest_collision = m_primitives[index];
+                }
+                return false;
+            });
+            return closest_collision;
+        }
+    }
+    if (node.isLeaf()) {
+        float u, v, collision_distance;
+        const T* const* primitives = m_primitives.data() + node.getFirst();
+        const bool check_mailbox = m_insertion == OctreeInsertion::BoundingBox;
+        for (std::uint32_t i = 0; i < node.getCount(); ++i) {
+            // Skip the objects already tested in a previous leaf
+            if (check_mailbox) {
+                if (mailbox.contains(primitives[i])) continue;
+                mailbox.insert(primitives[i]);
+            }
+
+            if (intersectPrimitive(node.getFirst() + i, ray, u, v, collision_distance) && collision_distance < closest_collision_distance) {
+                closest_collision_distance = collision_distance;
+                closest_collision = primitives[i];
+            }
+        }
+        return closest_collision;
+    }
+
+    // Traverse the children crossed by the ray, in the order the ray goes through them (maximum 4 children),
+    //      starting from the child in which the ray enters the node or from the one containing its origin
+    const Eigen::Array<S, 3, 1> split_distances = getSplitDistances(center, ray, signs);
+    for (unsigned char child = getFirstChild(split_distances, enter_distance); child < 8;) {
+        const BasicNodeSlabs<S> child_slabs = getChildSlabs(slabs, split_distances, child);
+        const unsigned char child_index = child ^ signs;
+        if (node.hasChild(child_index)) {
+            const T* child_collision = traceNode(node.getChild(child_index), getChildCenter(center, half_size, child_index), half_size / 2,
+                                                 child_slabs, signs, ray, closest_collision_distance, mailbox);
+            if (child_collision != nullptr) {
+                closest_collision = child_collision;
+
+                // With Position insertion, the first hit ends the traversal.
+                // With BoundingBox insertion, the hit may lie beyond the child, where an object referenced by the next children
+                //      can be closer: stop only if the ray leaves the child after the hit
+                if (m_insertion == OctreeInsertion::Position || closest_collision_distance <= child_slabs.getExitDistance()) break;
+            }
+        }
+        child = getNextChild(child, child_slabs.exit);
+    }
+
+    return closest_collision;
+}
+
+template <typename T, FlatOctreeNodeLayout NodeLayout, std::floating_point Scalar>
+template <int N>
+std::array<const T*, N> FlatOctree<T, NodeLayout, Scalar>::traceRays(const RayPacket<N>& packet, typename RayPacket<N>::Lanes& closest_collision_distances) const {
+    std::array<const T*, N> closest_collisions = {};
+    if (m_nodes.empty() || packet.active == 0) return closest_collisions;
+
+    // The rays going towards different octants do not visit the children in the same order: trace them one by one
+    unsigned char signs = 0;
+    if (!packet.getDirectionSigns(signs)) {
+        for (int lane = 0; lane < N; ++lane) {
+            if (packet.active & (1u << lane)) closest_collisions[lane] = traceRay(*packet.rays[lane], closest_collision_distances[lane]);
+        }
+        return closest_collisions;
+    }
+
+    const Box root_box{m_root_center.array() - m_root_half_size, m_root_center.array() + m_root_half_size};
+    typename RayPacket<N>::Lanes enter_distances, exit_distances;
+    const typename RayPacket<N>::Mask mask = packet.active & packet.intersect(root_box, enter_distances, exit_distances) &
+                                             RayPacket<N>::toMask(enter_distances <= closest_collision_distances);
+
+    std::array<RayMailbox<T>, N> mailboxes;
+    traceNodePacket<N>(0, m_root_center, m_root_half_size, packet, mask, signs, enter_distances, exit_distances,
+                       closest_collisions, closest_collision_distances, mailboxes);
+    return closest_collisions;
+}
+
+template <typename T, FlatOctreeNodeLayout NodeLayout, std::floating_point Scalar>
+template <int N>
+void FlatOctree<T, NodeLayout, Scalar>::traceNodePacket(std::uint32_t node_index, const Eigen::Vector3d& center, double half_size,
+                                    const RayPacket<N>& packet, typename RayPacket<N>::Mask mask, unsigned char signs,
+                                    const typename RayPacket<N>::Lanes& enter_distances, const typename RayPacket<N>::Lanes& exit_distances,
+                                    std::array<const T*, N>& closest_collisions, typename RayPacket<N>::Lanes& closest_collision_distances,
+                                    std::array<RayMailbox<T>, N>& mailboxes) const {
+    if (mask == 0) return;
+
+    // A single ray is traced on its own, with the scalar traversal
+    if (std::has_single_bit(mask)) {
+        const int lane = std::countr_zero(mask);
+        const Ray& ray = *packet.rays[lane];
+        double closest_collision_distance = closest_collision_distances[lane];
+        const T* collision = traceNode(node_index, center, half_size, getNodeSlabs(center, half_size, ray, signs), signs,
+                                       ray, closest_collision_distance, mailboxes[lane]);
+        if (collision != nullptr) {
+            closest_collisions[lane] = collision;
+            closest_collision_distances[lane] = closest_collision_distance;
+        }
+        return;
+    }
+
+    const NodeLayout& node = m_nodes[node_index];
+
+    // If the node is a leaf, check for collisions of each active ray with its objects
+    if (node.isLeaf()) {
+        float u, v, collision_distance;
+        const T* const* primitives = m_primitives.data() + node.getFirst();
+        const bool check_mailbox = m_insertion == OctreeInsertion::BoundingBox;
+        for (int lane = 0; lane < N; ++lane) {
+            if (!(mask & (1u << lane))) continue;
+
+            const Ray& ray = *packet.rays[lane];
+            for (std::uint32_t i = 0; i < node.getCount(); ++i) {
+                if (check_mailbox) {
+                    if (mailboxes[lane].contains(primitives[i])) continue;
+                    mailboxes[lane].insert(primitives[i]);
+                }
+
+                if (intersectPrimitive(node.getFirst() + i, ray, u, v, collision_distance) && collision_distance < closest_collision_distances[lane]) {
+                    closest_collision_distances[lane] = collision_distance;
+                    closest_collisions[lane] = primitives[i];
+                }
+            }
+        }
+        return;
+    }
+
+    // Distances to the 3 planes splitting the node, one array per axis.
+    // Every ray goes towards the octant `signs`, so on each axis it is in the near half of the node before the plane and
+    //      in the far half after it. A ray parallel to a plane stays in one half: its distance is -inf if it lies in the far half,
+    //      and +inf in the near half. A ray lying in the plane is put in its positive half, like getBranchIndex does.
+    const double infinity = std::numeric_limits<double>::infinity();
+    std::array<typename RayPacket<N>::Lanes, 3> plane_distances;
+    for (int axis = 0; axis < 3; ++axis) {
+        const typename RayPacket<N>::Lanes distances = (center[axis] - packet.origins[axis]) * packet.inverse_directions[axis];
+        plane_distances[axis] = distances.isNaN().select((signs & (4 >> axis)) ? infinity : -infinity, distances);
+    }
+
+    // Visit the children front to back for the octant of the rays, each child with the rays entering it before their closest hit.
+    // The child `i ^ signs` is in the far half of the node along the axes whose bit is set in `i`
+    for (unsigned char i = 0; i < 8 && mask != 0; ++i) {
+        const unsigned char child_index = i ^ signs;
+        if (!node.hasChild(child_index)) continue;
+
+        typename RayPacket<N>::Lanes child_enter_distances = enter_distances;
+        typename RayPacket<N>::Lanes child_exit_distances = exit_distances;
+        for (int axis = 0; axis < 3; ++axis) {
+            if (i & (4 >> axis)) {
+                child_enter_distances = child_enter_distances.max(plane_distances[axis]);
+            } else {
+                child_exit_distances = child_exit_distances.min(plane_distances[axis]);
+            }
+        }
+        const typename RayPacket<N>::Mask child_mask = mask & RayPacket<N>::toMask(child_enter_distances <= child_exit_distances &&
+                                                                                   child_enter_distances <= closest_collision_distances);
+        if (child_mask == 0) continue;
+
+        traceNodePacket<N>(node.getChild(child_index), getChildCenter(center, half_size, child_index), half_size / 2, packet, child_mask, signs,
+                           child_enter_distances, child_exit_distances, closest_collisions, closest_collision_distances, mailboxes);
+
+        // Same stopping rules as the scalar traversal, applied to each ray of the child
+        mask &= ~getStoppedLanes<N>(child_mask, closest_collisions, closest_collision_distances, child_exit_distances);
+    }
+}
+
+template <typename T, FlatOctreeNodeLayout NodeLayout, std::floating_point Scalar>
+template <int N>
+typename RayPacket<N>::Mask FlatOctree<T, NodeLayout, Scalar>::getStoppedLanes(typename RayPacket<N>::Mask mask, const std::array<const T*, N>& closest_collisions,
+                                                                              const typename RayPacket<N>::Lanes& closest_collision_distances,
+                                                                              const typename RayPacket<N>::Lanes& exit_distances) const {
+    typename RayPacket<N>::Mask stopped = 0;
+    for (int lane = 0; lane < N; ++lane) {
+        if ((mask & (1u << lane)) && closest_collisions[lane] != nullptr) stopped |= 1u << lane;
+    }
+    if (m_insertion == OctreeInsertion::BoundingBox) {
+        stopped &= RayPacket<N>::toMask(closest_collision_distances <= exit_distances);
+    }
+    return stopped;
+}
+
+template <typename T, FlatOctreeNodeLayout NodeLayout, std::floating_point Scalar>
+template <QueryRegion Region>
+void FlatOctree<T, NodeLayout, Scalar>::cull(const Region& region, unsigned char signs, OctreeEntryPoints& entry_points, std::size_t max_nodes) const {
+    entry_points.nodes.clear();
+    entry_points.signs = signs;
+    entry_points.culled = true;
+    if (m_nodes.empty()) return;
+
+    const Box root_cell{m_root_center.array() - m_root_half_size, m_root_center.array() + m_root_half_size};
+    if (region.classify(root_cell) == RegionOverlap::Outside) return;
+    entry_points.nodes.push_back({0, m_root_center, m_root_half_size});
+
+    // Each node is replaced by its children overlapping the region in the order `i ^ signs`, the order in which the rays of the
+    //      octant cross them: the nodes of each level stay front to back, as the leaves reached by a depth-first traversal
+    std::vector<OctreeEntryPoint> children;
+    for (bool split = true; split;) {
+        split = false;
+        children.clear();
+        for (const OctreeEntryPoint& entry : entry_points.nodes) {
+            const NodeLayout& node = m_nodes[entry.node_index];
+            if (node.isLeaf()) {
+                children.push_back(entry);
+            } else {
+                split = true;
+                for (unsigned char i = 0; i < 8; ++i) {
+                    const unsigned char child_index = i ^ signs;
+                    if (!node.hasChild(child_index)) continue;
+
+                    const Eigen::Vector3d child_center = getChildCenter(entry.center, entry.half_size, child_index);
+                    const double child_half_size = entry.half_size / 2;
+                    const Box cell{child_center.array() - child_half_size, child_center.array() + child_half_size};
+                    if (region.classify(cell) == RegionOverlap::Outside) continue;
+
+                    // The child is bounded by the plane splitting its parent on the side of the parent's center along each axis,
+                    //      and by the planes bounding its parent on the other side
+                    OctreeEntryPoint child = entry;
+                    child.node_index = node.getChild(child_index);
+                    child.center = child_center;
+                    child.half_size = child_half_size;
+                    for (int axis = 0; axis < 3; ++axis) {
+                        const unsigned char bit = 4 >> axis;
+                        if (i & bit) {
+                            child.enter_splits |= bit;
+                            child.enter_planes[axis] = entry.center[axis];
+                        } else {
+                            child.exit_splits |= bit;
+                            child.exit_planes[axis] = entry.center[axis];
+                        }
+                    }
+                    children.push_back(child);
+                }
+            }
+            if (children.size() > max_nodes) return; // The level is too wide, the rays start from the previous one
+        }
+        entry_points.nodes.swap(children);
+    }
+}
+
+template <typename T, FlatOctreeNodeLayout NodeLayout, std::floating_point Scalar>
+const T* FlatOctree<T, NodeLayout, Scalar>::traceRay(const Ray& ray, double& closest_collision_distance, const OctreeEntryPoints& entry_points) const {
+    const unsigned char signs = getDirectionOctant(ray.getDirection());
+    if (!entry_points.culled || signs != entry_points.signs) return traceRay(ray, closest_collision_distance);
+
+    // The subtrees are visited as the children of a node in the traversal from the root: front to back,
+    //      until the first hit with Position insertion, or until the closest hit lies before the ray leaves the subtree
+    RayMailbox<T> mailbox;
+    const T* closest_collision = nullptr;
+    const NodeSlabs root_slabs = getNodeSlabs(m_root_center, m_root_half_size, ray, signs);
+    for (const OctreeEntryPoint& entry : entry_points.nodes) {
+        const NodeSlabs slabs = getEntrySlabs(root_slabs, entry, ray, signs);
+        const T* collision = traceNode(entry.node_index, entry.center, entry.half_size, slabs, signs, ray, closest_collision_distance, mailbox);
+        if (collision != nullptr) {
+            closest_collision = collision;
+            if (m_insertion == OctreeInsertion::Position || closest_collision_distance <= slabs.getExitDistance()) break;
+        }
+    }
+    return closest_collision;
+}
+
+template <typename T, FlatOctreeNodeLayout NodeLayout, std::floating_point Scalar>
+template <int N>
+std::array<const T*, N> FlatOctree<T, NodeLayout, Scalar>::traceRays(const RayPacket<N>& packet, typename RayPacket<N>::Lanes& closest_collision_distances,
+                                                                     const OctreeEntryPoints& entry_points) const {
+    unsigned char signs = 0;
+    if (!entry_points.culled || packet.active == 0 || !packet.getDirectionSigns(signs) || signs != entry_points.signs) {
+        return traceRays(packet, closest_collision_distances);
+    }
+
+    // The segments of the rays in the root, cut by the planes bounding each subtree, as the traversal from the root cuts them
+    //      when it goes down to the subtree (see traceNodePacket)
+    std::array<const T*, N> closest_collisions = {};
+    std::array<RayMailbox<T>, N> mailboxes;
+    const Box root_box{m_root_center.array() - m_root_half_size, m_root_center.array() + m_root_half_size};
+    typename RayPacket<N>::Lanes root_enter_distances, root_exit_distances;
+    typename RayPacket<N>::Mask mask = packet.active & packet.intersect(root_box, root_enter_distances, root_exit_distances) &
+                                       RayPacket<N>::toMask(root_enter_distances <= closest_collision_distances);
+    const double infinity = std::numeric_limits<double>::infinity();
+    for (const OctreeEntryPoint& entry : entry_points.nodes) {
+        if (mask == 0) break;
+
+        typename RayPacket<N>::Lanes enter_distances = root_enter_distances;
+        typename RayPacket<N>::Lanes exit_distances = root_exit_distances;
+        for (int axis = 0; axis < 3; ++axis) {
+            const unsigned char bit = 4 >> axis;
+            const double nan_distance = (signs & bit) ? infinity : -infinity;
+            if (entry.enter_splits & bit) {
+                const typename RayPacket<N>::Lanes distances = (entry.enter_planes[axis] - packet.origins[axis]) * packet.inverse_directions[axis];
+                enter_distances = enter_distances.max(distances.isNaN().select(nan_distance, distances));
+            }
+            if (entry.exit_splits & bit) {
+                const typename RayPacket<N>::Lanes distances = (entry.exit_planes[axis] - packet.origins[axis]) * packet.inverse_directions[axis];
+                exit_distances = exit_distances.min(distances.isNaN().select(nan_distance, distances));
+            }
+        }
+        const typename RayPacket<N>::Mask entry_mask = mask & RayPacket<N>::toMask(enter_distances <= exit_distances &&
+                                                                                   enter_distances <= closest_collision_distances);
+        if (entry_mask == 0) continue;
+
+        traceNodePacket<N>(entry.node_index, entry.center, entry.half_size, packet, entry_mask, signs, enter_distances, exit_distances,
+                           closest_collisions, closest_collision_distances, mailboxes);
+        mask &= ~getStoppedLanes<N>(entry_mask, closest_collisions, closest_collision_distances, exit_distances);
+    }
+    return closest_collisions;
+}
+
+template <typename T, FlatOctreeNodeLayout NodeLayout, std::floating_point Scalar>
+std::vector<const T*> FlatOctree<T, NodeLayout, Scalar>::traceRayStream(std::span<const Ray> rays, std::span<double> closest_collision_distances) const {
+    RayStream stream{rays, closest_collision_distances, std::vector<const T*>(rays.size(), nullptr), std::vector<char>(rays.size(), 0), {}, {}};
+    if (m_nodes.empty() || rays.empty()) return std::move(stream.closest_collisions);
+
+    if (m_insertion == OctreeInsertion::BoundingBox) stream.mailboxes.resize(rays.size());
+    stream.levels.emplace_back();
+
+    // Each octant of directions is a stream of its own, whose rays all visit the children in the same front to back order
+    std::vector<unsigned char> octants(rays.size());
+    for (std::size_t i = 0; i < rays.size(); ++i) {
+        octants[i] = getDirectionOctant(rays[i].getDirection());
+    }
+
+    const Box root_box{m_root_center.array() - m_root_half_size, m_root_center.array() + m_root_half_size};
+    for (unsigned char signs = 0; signs < 8; ++signs) {
+        std::vector<StreamRay>& root_rays = stream.levels.front().rays;
+        root_rays.clear();
+        for (std::size_t i = 0; i < rays.size(); ++i) {
+            double enter_distance, exit_distance;
+            if (octants[i] == signs && root_box.intersect(rays[i], enter_distance, exit_distance) &&
+                enter_distance <= closest_collision_distances[i]) {
+                root_rays.push_back(StreamRay{static_cast<std::uint32_t>(i), enter_distance, exit_distance});
+            }
+        }
+
+        if (!root_rays.empty()) traceStreamNode(0, m_root_center, m_root_half_size, 0, signs, stream);
+    }
+
+    return std::move(stream.closest_collisions);
+}
+
+template <typename T, FlatOctreeNodeLayout NodeLayout, std::floating_point Scalar>
+void FlatOctree<T, NodeLayout, Scalar>::traceStreamNode(std::uint32_t node_index, const Eigen::Vector3d& center, double half_size, unsigned int depth,
+                                    unsigned char signs, RayStream& stream) const {
+    StreamLevel& level = stream.levels[depth];
+    const NodeLayout& node = m_nodes[node_index];
+
+    // A few rays are traced on their own, with the scalar traversal
+    if (level.rays.size() < MIN_STREAM_SIZE) {
+        RayMailbox<T> unused_mailbox; // The mailboxes are only kept with BoundingBox insertion
+        for (const StreamRay& stream_ray : level.rays) {
+            const std::uint32_t index = stream_ray.index;
+            const Ray& ray = stream.rays[index];
+            RayMailbox<T>& mailbox = stream.mailboxes.empty() ? unused_mailbox : stream.mailboxes[index];
+            const T* collision = traceNode(node_index, center, half_size, getNodeSlabs(center, half_size, ray, signs), signs,
+                                           ray, stream.closest_collision_distances[index], mailbox);
+            if (collision != nullptr) stream.closest_collisions[index] = collision;
+        }
+        return;
+    }
+
+    // If the node is a leaf, test each of its objects against all the rays reaching it
+    if (node.isLeaf()) {
+        float u, v, collision_distance;
+        const T* const* primitives = m_primitives.data() + node.getFirst();
+        const bool check_mailbox = m_insertion == OctreeInsertion::BoundingBox;
+        for (std::uint32_t i = 0; i < node.getCount(); ++i) {
+            const T* primitive = primitives[i];
+            for (const StreamRay& stream_ray : level.rays) {
+                const std::uint32_t index = stream_ray.index;
+                if (check_mailbox) {
+                    if (stream.mailboxes[index].contains(primitive)) continue;
+                    stream.mailboxes[index].insert(primitive);
+                }
+
+                if (intersectPrimitive(node.getFirst() + i, stream.rays[index], u, v, collision_distance) &&
+                    collision_distance < stream.closest_collision_distances[index]) {
+                    stream.closest_collision_distances[index] = collision_distance;
+                    stream.closest_collisions[index] = primitive;
+                }
+            }
+        }
+        return;
+    }
+
+    // Distances of each ray to the 3 planes splitting the node, with the same conventions as the packet traversal:
+    //      a ray parallel to a plane gets -inf if it lies in the far half of the node, +inf in the near half
+    const double infinity = std::numeric_limits<double>::infinity();
+    level.plane_distances.resize(level.rays.size());
+    for (std::size_t k = 0; k < level.rays.size(); ++k) {
+        const Ray& ray = stream.rays[level.rays[k].index];
+        for (int axis = 0; axis < 3; ++axis) {
+            const double distance = (center[axis] - ray.getOrigin()[axis]) * ray.getInverseDirection()[axis];
+            level.plane_distances[k][axis] = std::isnan(distance) ? ((signs & (4 >> axis)) ? infinity : -infinity) : distance;
+        }
+    }
+
+    if (stream.levels.size() <= depth + 1) stream.levels.emplace_back();
+    std::vector<StreamRay>& child_rays = stream.levels[depth + 1].rays;
+
+    // Visit the children front to back for the octant of the rays, each child with the rays entering it before their closest hit.
+    // The child `i ^ signs` is in the far half of the node along the axes whose bit is set in `i`
+    for (unsigned char i = 0; i < 8; ++i) {
+        const unsigned char child_index = i ^ signs;
+        if (!node.hasChild(child_index)) continue;
+
+        child_rays.clear();
+        for (std::size_t k = 0; k < level.rays.size(); ++k) {
+            const std::uint32_t index = level.rays[k].index;
+            if (stream.finished[index]) continue;
+
+            double enter_distance = level.rays[k].enter_distance;
+            double exit_distance = level.rays[k].exit_distance;
+            for (int axis = 0; axis < 3; ++axis) {
+                if (i & (4 >> axis)) {
+                    enter_distance = std::max(enter_distance, level.plane_distances[k][axis]);
+                } else {
+                    exit_distance = std::min(exit_distance, level.plane_distances[k][axis]);
+                }
+            }
+            if (enter_distance <= exit_distance && enter_distance <= stream.closest_collision_distances[index]) {
+                child_rays.push_back(StreamRay{index, enter_distance, exit_distance});
+            }
+        }
+        if (child_rays.empty()) continue;
+
+        traceStreamNode(node.getChild(child_index), getChildCenter(center, half_size, child_index), half_size / 2, depth + 1, signs, stream);
+
+        // Same stopping rules as the scalar traversal: with Position insertion, a ray stops at its first hit,
+        //      with BoundingBox insertion, a ray stops when its closest hit lies before it leaves the child.
+        // A ray stopping in a child also stops in all the ancestors of the child, so the flag is shared by all the levels
+        for (const StreamRay& child_ray : child_rays) {
+            const std::uint32_t index = child_ray.index;
+            if (stream.closest_collisions[index] != nullptr &&
+                (m_insertion == OctreeInsertion::Position || stream.closest_collision_distances[index] <= child_ray.exit_distance)) {
+                stream.finished[index] = 1;
+            }
+        }
+    }
+}
+
+template <typename T, FlatOctreeNodeLayout NodeLayout, std::floating_point Scalar>
+template <QueryRegion Region>
+void FlatOctree<T, NodeLayout, Scalar>::query(const Region& region, std::vector<const T*>& results) const {
+    results.clear();
+    if (m_nodes.empty()) return;
+
+    // The objects referenced by several leaves are reached once, from the first leaf reached by the query
+    thread_local QueryStamps stamps;
+    thread_local std::vector<const T*> candidates;
+    candidates.clear();
+    if (m_insertion == OctreeInsertion::BoundingBox) stamps.begin(m_id_count);
+    queryNode(0, m_root_center, m_root_half_size, region, results, candidates, m_insertion == OctreeInsertion::BoundingBox ? &stamps : nullptr);
+
+    // The objects lie anywhere in memory: each test would wait for its object without the prefetches
+    constexpr std::size_t PREFETCH_DISTANCE = 8;
+    for (std::size_t i = 0; i < candidates.size(); ++i) {
+        if (i + PREFETCH_DISTANCE < candidates.size()) prefetch(getRegionTestData(candidates[i + PREFETCH_DISTANCE]));
+        if (isInRegion(region, candidates[i])) results.push_back(candidates[i]);
+    }
+}
+
+template <typename T, FlatOctreeNodeLayout NodeLayout, std::floating_point Scalar>
+template <QueryRegion Region>
+void FlatOctree<T, NodeLayout, Scalar>::queryNode(std::uint32_t node_index, const Eigen::Vector3d& center, double half_size, const Region& region,
+                                          std::vector<const T*>& results, std::vector<const T*>& candidates, QueryStamps* stamps) const {
+    const Box cell{center.array() - half_size, center.array() + half_size};
+    const RegionOverlap overlap = region.classify(cell);
+    if (overlap == RegionOverlap::Outside) return;
+
+    // The objects of a subtree inside the region lie in it: by position in its cells, or by bounding box overlapping its cells
+    if (overlap == RegionOverlap::Inside) {
+        gatherNode(node_index, results, stamps);
+        return;
+    }
+
+    const NodeLayout& node = m_nodes[node_index];
+    if (node.isLeaf()) {
+        // The test of an object does not depend on the leaf: it is tested once
+        for (std::uint32_t i = node.getFirst(); i < node.getFirst() + node.getCount(); ++i) {
+            if (stamps == nullptr || stamps->mark(m_object_ids[i])) candidates.push_back(m_primitives[i]);
+        }
+        return;
+    }
+
+    for (unsigned char i = 0; i < 8; ++i) {
+        if (node.hasChild(i)) {
+            queryNode(node.getChild(i), getChildCenter(center, half_size, i), half_size / 2, region, results, candidates, stamps);
+        }
+    }
+}
+
+template <typename T, FlatOctreeNodeLayout NodeLayout, std::floating_point Scalar>
+template <QueryRegion Region>
+bool FlatOctree<T, NodeLayout, Scalar>::isInRegion(const Region& region, const T* object) const {
+    if constexpr (requires { { object->getBoundingBox() } -> std::convertible_to<Box>; }) {
+        if (m_insertion == OctreeInsertion::BoundingBox) return region.overlaps(object->getBoundingBox());
+    }
+    return region.contains(object->getPosition());
+}
+
+template <typename T, FlatOctreeNodeLayout NodeLayout, std::floating_point Scalar>
+const void* FlatOctree<T, NodeLayout, Scalar>::getRegionTestData(const T* object) const {
+    if constexpr (requires { { &object->getBoundingBox() } -> std::convertible_to<const Box*>; }) {
+        if (m_insertion == OctreeInsertion::BoundingBox) return &object->getBoundingBox();
+    }
+    if constexpr (requires { { &object->getPosition() } -> std::convertible_to<const Eigen::Vector3d*>; }) {
+        return &object->getPosition();
+    } else {
+        return object;
+    }
+}
+
+template <typename T, FlatOctreeNodeLayout NodeLayout, std::floating_point Scalar>
+void FlatOctree<T, NodeLayout, Scalar>::gatherNode(std::uint32_t node_index, std::vector<const T*>& results, QueryStamps* stamps) const {
+    // The objects of a subtree compiled from scratch lie between the first object of its first leaf and the last one of its last leaf
+    std::uint32_t first = node_index;
+    std::uint32_t last = node_index;
+    if (m_contiguous) {
+        while (!m_nodes[first].isLeaf()) first = m_nodes[first].getChildBase();
+        while (!m_nodes[last].isLeaf()) {
+            last = m_nodes[last].getChildBase() + std::popcount(static_cast<unsigned int>(m_nodes[last].getChildMask())) - 1;
+        }
+    } else if (!m_nodes[node_index].isLeaf()) {
+        const NodeLayout& node = m_nodes[node_index];
+        for (unsigned char i = 0; i < 8; ++i) {
+            if (node.hasChild(i)) gatherNode(node.getChild(i), results, stamps);
+        }
+        return;
+    }
+
+    const std::uint32_t begin = m_nodes[first].getFirst();
+    const std::uint32_t end = m_nodes[last].getFirst() + m_nodes[last].getCount();
+    if (stamps == nullptr) {
+        results.insert(results.end(), m_primitives.begin() + begin, m_primitives.begin() + end);
+        return;
+    }
+    for (std::uint32_t i = begin; i < end; ++i) {
+        if (stamps->mark(m_object_ids[i])) results.push_back(m_primitives[i]);
+    }
+}
+
+template <typename T, FlatOctreeNodeLayout NodeLayout, std::floating_point Scalar>
+const T* FlatOctree<T, NodeLayout, Scalar>::nearest(const Eigen::Vector3d& point, double max_radius, Eigen::Vector3d& closest_point) const
+    requires NearestQueryable<T> {
+    if (m_nodes.empty()) return nullptr;
+
+    // A node waiting to be visited, with the squared distance from the point to its cell
+    struct Candidate {
+        double squared_distance;
+        std::uint32_t node_index;
+        Eigen::Vector3d center;
+        double half_size;
+
+        bool operator>(const Candidate& other) const { return squared_distance > other.squared_distance; };
+    };
+    auto getSquaredDistance = [&point](const Eigen::Vector3d& center, double half_size) {
+        return Box{center.array() - half_size, center.array() + half_size}.getSquaredDistance(point.array());
+    };
+
+    const T* nearest_object = nullptr;
+    double nearest_squared_distance = max_radius * max_radius;
+    std::vector<Candidate> candidates; // Min-heap on the distance to the cells
+    candidates.push_back({getSquaredDistance(m_root_center, m_root_half_size), 0, m_root_center, m_root_half_size});
+
+    while (!candidates.empty()) {
+        std::pop_heap(candidates.begin(), candidates.end(), std::greater<>());
+        const Candidate candidate = candidates.back();
+        candidates.pop_back();
+
+        // All the nodes left are farther than the nearest object found
+        if (candidate.squared_distance > nearest_squared_distance) break;
+
+        const NodeLayout& node = m_nodes[candidate.node_index];
+        if (node.isLeaf()) {
+            const T* const* primitives = m_primitives.data() + node.getFirst();
+            for (std::uint32_t i = 0; i < node.getCount(); ++i) {
+                // The bounding box of an object is a cheap lower bound of its distance
+                if constexpr (requires { { primitives[i]->getBoundingBox() } -> std::convertible_to<Box>; }) {
+                    if (primitives[i]->getBoundingBox().getSquaredDistance(point.array()) > nearest_squared_distance) continue;
+                }
+                const Eigen::Vector3d object_point = primitives[i]->closestPoint(point);
+                const double squared_distance = (object_point - point).squaredNorm();
+                if (squared_distance < nearest_squared_distance || (nearest_object == nullptr && squared_distance <= nearest_squared_distance)) {
+                    nearest_object = primitives[i];
+                    nearest_squared_distance = squared_distance;
+                    closest_point = object_point;
+                }
+            }
+            continue;
+        }
+
+        for (unsigned char i = 0; i < 8; ++i) {
+            if (!node.hasChild(i)) continue;
+            const Eigen::Vector3d child_center = getChildCenter(candidate.center, candidate.half_size, i);
+            const double squared_distance = getSquaredDistance(child_center, candidate.half_size / 2);
+            if (squared_distance > nearest_squared_distance) continue;
+            candidates.push_back({squared_distance, node.getChild(i), child_center, candidate.half_size / 2});
+            std::push_heap(candidates.begin(), candidates.end(), std::greater<>());
+        }
+    }
+    return nearest_object;
+}
+
+template <typename T, FlatOctreeNodeLayout NodeLayout, std::floating_point Scalar>
+template <std::floating_point RayScalar>
+bool FlatOctree<T, NodeLayout, Scalar>::occluded(const BasicRay<RayScalar>& ray, std::type_identity_t<RayScalar> max_distance) const {
+    if constexpr (!std::same_as<RayScalar, Scalar>) {
+        return occluded(ray.template cast<Scalar>(), static_cast<Scalar>(max_distance));
+    } else {
+        if (m_nodes.empty()) return false;
+        RayMailbox<T> mailbox;
+        const unsigned char signs = getDirectionOctant(ray.getDirection());
+        const Eigen::Matrix<Scalar, 3, 1> center = m_root_center.template cast<Scalar>();
+        const Scalar half_size = static_cast<Scalar>(m_root_half_size);
+        return occludedNode(0, center, half_size, getNodeSlabs(center, half_size, ray, signs), signs, ray, max_distance, mailbox);
+    }
+}
+
+template <typename T, FlatOctreeNodeLayout NodeLayout, std::floating_point Scalar>
+template <std::floating_point S>
+bool FlatOctree<T, NodeLayout, Scalar>::occludedNode(std::uint32_t node_index, const Eigen::Matrix<S, 3, 1>& center, S half_size, const BasicNodeSlabs<S>& slabs,
+                                                     unsigned char signs, const BasicRay<S>& ray, S max_distance, RayMailbox<T>& mailbox) const {
+    // Skip the nodes that the ray misses or enters beyond the maximum distance
+    const S enter_distance = std::max(slabs.getEnterDistance(), S(0));
+    if (enter_distance > slabs.getExitDistance() || enter_distance >= max_distance) return false;
+
+    const NodeLayout& node = m_nodes[node_index];
+
+    // Any hit closer than the maximum distance ends the query
+    if constexpr (RangeIntersectable<RecordStorage>) {
+        if (node.isLeaf()) {
+            return m_records.intersect(ray, node.getFirst(), node.getCount(), [&](std::size_t, float collision_distance) {
+                return collision_distance < max_distance;
+            });
+        }
+    }
+    if (node.isLeaf()) {
+        float u, v, collision_distance;
+        const T* const* primitives = m_primitives.data() + node.getFirst();
+        const bool check_mailbox = m_insertion == OctreeInsertion::BoundingBox;
+        for (std::uint32_t i = 0; i < node.getCount(); ++i) {
+            if (check_mailbox) {
+                if (mailbox.contains(primitives[i])) continue;
+                mailbox.insert(primitives[i]);
+            }
+
+            if (intersectPrimitive(node.getFirst() + i, ray, u, v, collision_distance) && collision_distance < max_distance) return true;
+        }
+        return false;
+    }
+
+    // Only the children crossed by the ray can hold a hit. Their order does not matter for the result,
+    //      but visiting them from the ray origin finds the occluders close to it first
+    const Eigen::Array<S, 3, 1> split_distances = getSplitDistances(center, ray, signs);
+    for (unsigned char child = getFirstChild(split_distances, enter_distance); child < 8;) {
+        const BasicNodeSlabs<S> child_slabs = getChildSlabs(slabs, split_distances, child);
+        const unsigned char child_index = child ^ signs;
+        if (node.hasChild(child_index) &&
+            occludedNode(node.getChild(child_index), getChildCenter(center, half_size, child_index), half_size / 2,
+                         child_slabs, signs, ray, max_distance, mailbox)) {
+            return true;
+        }
+        child = getNextChild(child, child_slabs.exit);
+    }
+    return false;
+}
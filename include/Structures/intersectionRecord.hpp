@@ -0,0 +1,36 @@
+#pragma once
+
+#include <concepts>
+#include <type_traits>
+#include <utility>
+
+#include "Structures/ray.hpp"
+
+// Concept RecordIntersectable: type 'T' is an object whose intersection test only reads a small precomputed record, which has
+//  `.getIntersectionRecord` returning the record or a reference to it (eg TriangleRecord).
+//  `.intersect` on the record, testing a ray with the same results as the intersection test of the object.
+// The flat octree and the BVH store the records of these objects in the order of their leaves, and the rays test the records instead of the objects.
+template<typename T>
+concept RecordIntersectable = requires(const T object) {
+    { object.getIntersectionRecord() } -> std::convertible_to<typename T::IntersectionRecord>;
+} && std::is_trivially_destructible_v<typename T::IntersectionRecord> &&
+    requires(const typename T::IntersectionRecord record, const Ray& ray, float& u, float& v, float& t) {
+    { record.intersect(ray, u, v, t) } -> std::convertible_to<bool>;
+};
+
+// @brief The record of an object without a precomputed record (see RecordIntersectable), which is never stored
+struct NoIntersectionRecord {};
+
+/// @brief The type of the intersection records stored by a structure of precision 'Scalar' for the objects of type 'T'
+template <typename T, typename Scalar>
+struct IntersectionRecordOf { using type = NoIntersectionRecord; };
+
+template <RecordIntersectable T, typename Scalar>
+struct IntersectionRecordOf<T, Scalar> { using type = typename T::IntersectionRecord; };
+
+/// @brief The records which have a `cast` to another precision are stored in the precision of the structure (eg TriangleRecordF)
+template <RecordIntersectable T, typename Scalar>
+    requires requires(const typename T::IntersectionRecord record) { record.template cast<Scalar>(); }
+struct IntersectionRecordOf<T, Scalar> {
+    using type = decltype(std::declval<typename T::IntersectionRecord>().template cast<Scalar>());
+};
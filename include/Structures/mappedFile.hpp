@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+// A file mapped read-only in memory: the pages are loaded on demand and shared by all the processes mapping the same file.
+// On systems without `mmap`, the file is read into a single buffer instead.
+class MappedFile {
+    public:
+        /// @brief Map a whole file in memory
+        /// @param path The path of the file
+        /// @return The mapped file, which stays mapped as long as a pointer to it exists
+        /// @throws std::runtime_error if the file cannot be opened or mapped
+        static std::shared_ptr<const MappedFile> open(const std::string& path);
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+        ~MappedFile();
+
+        /// @brief Get the content of the file
+        /// @return The first byte of the file (aligned on a page boundary when mapped)
+        inline const std::byte* data() const { return m_data; };
+
+        /// @brief Get the size of the file
+        /// @return The number of bytes of the file
+        inline std::size_t size() const { return m_size; };
+
+    private:
+        MappedFile() = default;
+
+        const std::byte* m_data = nullptr; // Content of the file
+        std::size_t m_size = 0; // Size of the file in bytes
+        std::vector<std::byte> m_buffer; // Copy of the file, on systems without `mmap` only
+};
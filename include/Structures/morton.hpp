@@ -0,0 +1,131 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <Eigen/Dense>
+
+#include "Structures/box.hpp"
+#include "threadPool.hpp"
+
+/// @brief The number of bits of a Morton code per axis, ie the number of octree levels it can describe
+constexpr unsigned int MORTON_LEVELS = 21;
+
+/// @brief Spread the 21 lower bits of a value so that there are 2 zero bits between each of them
+/// @param value The value to spread (only the 21 lower bits are used)
+/// @return The spread value, bit `i` of `value` being moved to bit `3 * i`
+inline std::uint64_t spreadMortonBits(std::uint64_t value) {
+    value &= 0x1fffff;
+    value = (value | value << 32) & 0x1f00000000ffff;
+    value = (value | value << 16) & 0x1f0000ff0000ff;
+    value = (value | value << 8) & 0x100f00f00f00f00f;
+    value = (value | value << 4) & 0x10c30c30c30c30c3;
+    value = (value | value << 2) & 0x1249249249249249;
+    return value;
+}
+
+/// @brief Get the Morton code of a point in a cube
+/// @param point The point to encode, clamped to the cube
+/// @param cube The cube in which the point lies
+/// @return A 63 bits code in which each group of 3 bits, from the highest ones, is the octant of the point at one level of an octree
+///         spanning the cube. The octants are numbered like getBranchIndex: x is the highest bit of the group, z the lowest.
+inline std::uint64_t getMortonCode(const Eigen::Vector3d& point, const Box& cube) {
+    constexpr double cells = double(1u << MORTON_LEVELS);
+    Eigen::Array3d normalized = (point.array() - cube.min) / (cube.max - cube.min);
+    Eigen::Array3d quantized = (normalized * cells).max(0.0).min(cells - 1);
+
+    return spreadMortonBits(static_cast<std::uint64_t>(quantized.x())) << 2 |
+           spreadMortonBits(static_cast<std::uint64_t>(quantized.y())) << 1 |
+           spreadMortonBits(static_cast<std::uint64_t>(quantized.z()));
+}
+
+/// @brief Get the octant encoded by a Morton code at one level of the octree
+/// @param code The Morton code (see getMortonCode)
+/// @param level The level of the octree, 0 being the children of the root
+/// @return The index of the octant, between 0 and 7 (see getBranchIndex)
+inline unsigned char getMortonOctant(std::uint64_t code, unsigned int level) {
+    return static_cast<unsigned char>((code >> (3 * (MORTON_LEVELS - 1 - level))) & 7);
+}
+
+/// @brief The Morton code of an object and its index in the array of objects
+struct MortonKey {
+    std::uint64_t code;
+    std::uint32_t index;
+};
+
+/// @brief Get the number of contiguous chunks in which an array is split to be processed by a thread pool
+/// @param thread_pool The pool processing the chunks (nullptr for a serial processing)
+/// @param count The number of elements of the array
+/// @return One chunk per worker, or a single chunk if there is no pool or the array is small
+inline std::size_t getChunkCount(const ThreadPool* thread_pool, std::size_t count) {
+    constexpr std::size_t MIN_CHUNK_SIZE = 4096;
+    if (!thread_pool) return 1;
+    return std::max<std::size_t>(1, std::min<std::size_t>(thread_pool->getThreadCount(), count / MIN_CHUNK_SIZE));
+}
+
+/// @brief Process an array in contiguous chunks, in parallel if a thread pool is given
+/// @param thread_pool The pool processing the chunks (nullptr for a serial processing)
+/// @param count The number of elements of the array
+/// @param chunk_count The number of chunks (see getChunkCount)
+/// @param function The callable processing a chunk, receiving the index of the chunk and its range [begin, end)
+template <typename Function>
+void forEachChunk(ThreadPool* thread_pool, std::size_t count, std::size_t chunk_count, Function&& function) {
+    auto runChunk = [&](std::size_t chunk) {
+        function(chunk, chunk * count / chunk_count, (chunk + 1) * count / chunk_count);
+    };
+
+    if (!thread_pool || chunk_count == 1) {
+        for (std::size_t chunk = 0; chunk < chunk_count; ++chunk) runChunk(chunk);
+        return;
+    }
+    thread_pool->run(chunk_count, [&](std::size_t chunk, unsigned int) { runChunk(chunk); });
+}
+
+/// @brief Sort Morton keys by code with a least significant digit radix sort, in parallel if a thread pool is given
+/// @param keys The keys to sort
+/// @param thread_pool The pool sorting the chunks of the array (nullptr for a serial sort)
+/// @note The sort is stable, so the keys sharing a code keep their order and the result does not depend on the number of threads.
+/// @note Each pass sorts one byte of the codes: every chunk counts its digits, then scatters its keys to the offsets given by the
+///       prefix sums of all the counts. The passes on a byte shared by all the codes are skipped.
+inline void sortMortonKeys(std::vector<MortonKey>& keys, ThreadPool* thread_pool = nullptr) {
+    const std::size_t count = keys.size();
+    const std::size_t chunk_count = getChunkCount(thread_pool, count);
+
+    std::vector<MortonKey> buffer(count);
+    std::vector<std::array<std::size_t, 256>> histograms(chunk_count);
+
+    for (unsigned int shift = 0; shift < 3 * MORTON_LEVELS; shift += 8) {
+        forEachChunk(thread_pool, count, chunk_count, [&](std::size_t chunk, std::size_t begin, std::size_t end) {
+            std::array<std::size_t, 256>& histogram = histograms[chunk];
+            histogram.fill(0);
+            for (std::size_t i = begin; i < end; ++i) {
+                histogram[(keys[i].code >> shift) & 0xff]++;
+            }
+        });
+
+        // Turn the counts into the offset of the first key of each (digit, chunk) pair, digit by digit then chunk by chunk
+        std::size_t offset = 0;
+        bool single_digit = false;
+        for (std::size_t digit = 0; digit < 256; ++digit) {
+            std::size_t digit_count = 0;
+            for (std::size_t chunk = 0; chunk < chunk_count; ++chunk) {
+                const std::size_t chunk_digit_count = histograms[chunk][digit];
+                histograms[chunk][digit] = offset + digit_count;
+                digit_count += chunk_digit_count;
+            }
+            single_digit |= digit_count == count;
+            offset += digit_count;
+        }
+        if (single_digit) continue; // The keys are already sorted on this byte
+
+        forEachChunk(thread_pool, count, chunk_count, [&](std::size_t chunk, std::size_t begin, std::size_t end) {
+            std::array<std::size_t, 256>& offsets = histograms[chunk];
+            for (std::size_t i = begin; i < end; ++i) {
+                buffer[offsets[(keys[i].code >> shift) & 0xff]++] = keys[i];
+            }
+        });
+        keys.swap(buffer);
+    }
+}
@@ -0,0 +1,142 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Node allocators used by the Octree. They own every node they create and destroy them all at once in `clear`,
+// so the nodes never delete each other.
+// An allocator provides:
+//  `reserveContiguous(count)` making sure that the next `count` nodes created are contiguous in memory.
+//  `create(args...)` constructing a node and returning a pointer to it.
+//  `clear()` destroying all the nodes.
+//  `size()` returning the number of nodes created since the last `clear`.
+//  `bytes()` returning the memory held by the allocator.
+
+/// @brief Arena allocator: the nodes are constructed one after the other in large blocks of memory
+/// @note Sibling nodes created after `reserveContiguous(8)` lie in the same cache-friendly block.
+/// @note `clear` keeps the blocks for the next nodes, so rebuilding a tree does not go back to the system allocator.
+template <typename Node>
+class NodeArena {
+    public:
+        /// @brief Constructor for NodeArena
+        /// @param block_size The number of nodes in each block of memory
+        explicit NodeArena(std::size_t block_size = 256) : m_block_size(block_size < 8 ? 8 : block_size) {};
+
+        ~NodeArena() {
+            clear();
+            for (Node* block : m_blocks) {
+                ::operator delete(block, std::align_val_t(alignof(Node)));
+            }
+        };
+
+        NodeArena(const NodeArena&) = delete;
+        NodeArena& operator=(const NodeArena&) = delete;
+
+        /// @brief Make sure that the next `count` nodes created are contiguous in memory
+        /// @param count The number of nodes (at most the block size)
+        void reserveContiguous(std::size_t count) {
+            if (m_current_block < m_blocks.size() && m_block_counts[m_current_block] + count > m_block_size) nextBlock();
+        };
+
+        /// @brief Construct a node in the arena
+        /// @param args The arguments forwarded to the constructor of the node
+        /// @return A pointer to the new node, valid until `clear` is called
+        template <typename... Args>
+        Node* create(Args&&... args) {
+            if (m_current_block == m_blocks.size() || m_block_counts[m_current_block] == m_block_size) nextBlock();
+
+            std::size_t& block_count = m_block_counts[m_current_block];
+            Node* node = new (m_blocks[m_current_block] + block_count) Node(std::forward<Args>(args)...);
+            block_count++;
+            m_size++;
+            return node;
+        };
+
+        /// @brief Destroy all the nodes of the arena, the memory blocks are kept for later use
+        /// @note The destructors are called block by block, in memory order, and are skipped for trivially destructible nodes.
+        void clear() {
+            for (std::size_t b = 0; b < m_blocks.size(); ++b) {
+                if constexpr (!std::is_trivially_destructible_v<Node>) {
+                    std::destroy_n(m_blocks[b], m_block_counts[b]);
+                }
+                m_block_counts[b] = 0;
+            }
+            m_current_block = 0;
+            m_size = 0;
+        };
+
+        /// @brief Get the number of nodes in the arena
+        /// @return The number of nodes created since the last call to `clear`
+        inline std::size_t size() const { return m_size; };
+
+        /// @brief Get the memory held by the arena
+        /// @return The number of bytes allocated for the blocks
+        inline std::size_t bytes() const { return m_blocks.size() * m_block_size * sizeof(Node); };
+
+    private:
+        const std::size_t m_block_size; // Number of nodes in each block
+        std::vector<Node*> m_blocks; // Blocks of memory, each one can hold `m_block_size` nodes
+        std::vector<std::size_t> m_block_counts; // Number of nodes constructed in each block
+        std::size_t m_current_block = 0; // Index of the block in which the next node is constructed
+        std::size_t m_size = 0; // Total number of nodes constructed
+
+        /// @brief Move to the next block of memory, allocating it if needed
+        /// @note The unused end of the current block is left empty.
+        void nextBlock() {
+            if (m_current_block < m_blocks.size() && m_block_counts[m_current_block] > 0) m_current_block++;
+            if (m_current_block == m_blocks.size()) {
+                m_blocks.push_back(static_cast<Node*>(::operator new(m_block_size * sizeof(Node), std::align_val_t(alignof(Node)))));
+                m_block_counts.push_back(0);
+            }
+        };
+};
+
+/// @brief Heap allocator: each node is allocated on its own with `new`
+/// @note This is the behaviour of the original octree, kept for comparison in the benchmarks.
+template <typename Node>
+class NodeHeap {
+    public:
+        NodeHeap() = default;
+
+        ~NodeHeap() {
+            clear();
+        };
+
+        NodeHeap(const NodeHeap&) = delete;
+        NodeHeap& operator=(const NodeHeap&) = delete;
+
+        /// @brief Does nothing, the nodes are allocated one by one
+        void reserveContiguous(std::size_t) {};
+
+        /// @brief Allocate and construct a node on the heap
+        /// @param args The arguments forwarded to the constructor of the node
+        /// @return A pointer to the new node, valid until `clear` is called
+        template <typename... Args>
+        Node* create(Args&&... args) {
+            m_nodes.push_back(new Node(std::forward<Args>(args)...));
+            return m_nodes.back();
+        };
+
+        /// @brief Delete all the nodes one by one
+        void clear() {
+            for (Node* node : m_nodes) {
+                delete node;
+            }
+            m_nodes.clear();
+        };
+
+        /// @brief Get the number of nodes allocated
+        /// @return The number of nodes created since the last call to `clear`
+        inline std::size_t size() const { return m_nodes.size(); };
+
+        /// @brief Get the memory held by the allocator (not counting the bookkeeping of the system allocator)
+        /// @return The number of bytes allocated for the nodes
+        inline std::size_t bytes() const { return m_nodes.size() * sizeof(Node); };
+
+    private:
+        std::vector<Node*> m_nodes; // All the nodes allocated
+};
@@ -1,17 +1,30 @@
 #pragma once
 
-#include <list>
 #include <Eigen/Dense>
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <concepts>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <stdexcept>
 #include <vector>
 #include <iostream>
 #include <string>
-
-#include <Windows.h>
+#include <tuple>
+#include <unordered_map>
+#include <ostream>
 #include <cstdio>
 
 #include "Structures/box.hpp"
-#include "Structures/plane.hpp"
+#include "Structures/nodeAllocator.hpp"
+#include "Structures/flatOctree.hpp"
+#include "Structures/rayPacket.hpp"
+#include "Structures/morton.hpp"
+#include "Structures/octreeStats.hpp"
+#include "threadPool.hpp"
 
 // Concept OctreeAcceptatble: type 'T' has 
 //  `.getPosition` and its return is convertible to Vector3d.
@@ -22,6 +35,34 @@ concept OctreeAcceptatble = requires(T a, Ray& ray, float& u, float& v, float& t
     { a.intersect(ray, u, v, t) } -> std::convertible_to<bool>;
 };
 
+// Concept OctreeBoundable: type 'T' is OctreeAcceptatble and has
+//  `.getBoundingBox` and its return is convertible to Box.
+// Only these objects can be inserted with OctreeInsertion::BoundingBox.
+template<typename T>
+concept OctreeBoundable = OctreeAcceptatble<T> && requires(const T a) {
+    { a.getBoundingBox() } -> std::convertible_to<Box>;
+};
+
+// Relative costs of the steps of a ray query, used by an octree without manual parameters to decide where to stop splitting.
+// A ray crossing a cube crosses its children with a probability proportional to their surface, a quarter of the surface of
+// the cube each: once split, a leaf of `n` objects costs the visit of 2 children on average plus a quarter of the objects
+// referenced by the children, instead of `n` intersections. The leaf is split only if that is cheaper (see `shouldSplit`).
+struct OctreeCostModel {
+    /// @brief Cost of visiting a node of the flat octree
+    double traversal_cost = 1.0;
+
+    /// @brief Cost of intersecting an object, relative to `traversal_cost`
+    double intersection_cost = 1.0;
+
+    /// @brief Check if splitting a leaf makes the rays crossing it faster
+    /// @param object_count The number of objects in the leaf
+    /// @param child_references The total number of objects referenced by the 8 children once the leaf is split
+    /// @return true if the expected cost of the children is lower than the cost of the leaf
+    bool shouldSplit(std::size_t object_count, std::size_t child_references) const {
+        return 2 * traversal_cost + 0.25 * child_references * intersection_cost < object_count * intersection_cost;
+    };
+};
+
 template <OctreeAcceptatble T>
 class OctreeNode {
     public:
@@ -29,9 +70,12 @@ class OctreeNode {
         double size; // Size of the node (length of one side of the cube in the octree)
         unsigned int depth;  // Level in the octree hierarchy
         unsigned int total_children_depth; // Total depth of all children nodes
+        bool modified = false; // True if the node or its subtree changed since the flat layout was compiled (see FlatOctree::update)
 
-        OctreeNode* children[8]; // Pointers to the child nodes
-        std::list<const T*> data; // List of pointers to the data associated with the node
+        OctreeNode* children[8]; // Pointers to the child nodes (owned by the node allocator of the octree)
+        // Pointers to the data associated with the node (leaves only)
+        // This is the build representation: the queries read the objects from the contiguous ranges of the flat octree
+        std::vector<const T*> data;
 
         /// @brief Constructor for OctreeNode
         /// @param position The position of the node in 3D space
@@ -39,44 +83,26 @@ class OctreeNode {
         /// @param depth The depth of the node in the octree hierarchy
         /// @param total_children_depth The total depth of all children nodes
         /// @note The position is the center of the node, and the size is the length of one side of the cube.
-        /// @note The node is initialized with a bounding box that is an Axis-Aligned cube centered at the position.
         OctreeNode(const Eigen::Vector3d& position, double size, unsigned int depth, unsigned int total_children_depth) : 
                 position(position), 
                 size(size), 
                 depth(depth),
                 total_children_depth(total_children_depth),
-                m_half_size(size / 2),
-                m_plane_xy(Eigen::Vector3d::UnitZ(), position), // Plane parallel to XY plane
-                m_plane_xz(Eigen::Vector3d::UnitY(), position), // Plane parallel to XZ plane
-                m_plane_yz(Eigen::Vector3d::UnitX(), position) // Plane parallel to YZ plane
+                m_half_size(size / 2)
         {
             assert(size > 0 && "Size of the octree node must be greater than zero.");
 
-            // Initialize the bounding box based on position and size
-            m_bounding_box = {position.array() - Eigen::Array3d(m_half_size, m_half_size, m_half_size), 
-                            position.array() + Eigen::Array3d(m_half_size, m_half_size, m_half_size)};
-            
             // Initialize child pointers to nullptr
             for (int i = 0; i < 8; ++i) {
                 children[i] = nullptr;
             }
-
-            m_plane_indices.reserve(3); // Reserve space for plane indices
-        };
-
-        /// @brief Destructor for OctreeNode
-        ~OctreeNode() {
-            // Clean up child nodes
-            for (int i = 0; i < 8; ++i) {
-                delete children[i];
-            }
         };
 
         /// @brief Get the bounding box of the octree node.
         /// @return The bounding box of the node, which is an Axis-Aligned cube defined by its position and size.
-        inline const Box& getBoundingBox() const {
-            // Calculate the bounding box based on position and size
-            return m_bounding_box;
+        /// @note The box is computed from the center and the half size rather than stored, which saves 48 bytes per node.
+        inline Box getBoundingBox() const {
+            return {position.array() - m_half_size, position.array() + m_half_size};
         };
 
         /// @brief Get the half size of the octree node.
@@ -86,32 +112,37 @@ class OctreeNode {
         };
 
         /// @brief Trace a ray through the octree node and detect the first object hit by the ray.
-        /// @note This method uses Sorted Sibling Traversal to efficiently traverse the octree.
+        /// @note This method uses the parametric traversal of FlatOctree::traceRay on the pointer-based nodes.
+        /// @note Octree::traceRay goes through the flat layout of the octree instead (see FlatOctree), which gives the same results faster.
+        /// @note The traversal does not modify the node and does not allocate memory, so it can be called from several threads at once.
         /// @param ray The ray to trace through the octree
         /// @param closest_collision_distance Reference to a float that will hold the distance to the first hit object
+        /// @param insertion How the objects were placed in the leaves: the first hit ends the traversal with Position insertion,
+        ///        while with BoundingBox insertion an object of a later child can be closer (see Octree::getInsertion)
         /// @return A pointer to the first object hit by the ray, or nullptr if no object is hit
-        const T* traceRay(const Ray& ray, double& closest_collision_distance);
+        const T* traceRay(const Ray& ray, double& closest_collision_distance, OctreeInsertion insertion) const;
 
-        /// @brief Recursively print the structure of the octree node to the console.
+        /// @brief Recursively print the structure of the octree node to a stream.
+        /// @param stream The stream to print to
         /// @param prefix The prefix string to print before the node's information
         /// @param isLast Indicates if this node is the last child in its parent's list of children
         /// @param postfix The postfix string to print after the node's information
         /// @note This method prints the node's position, size, and the number of triangles it contains.
         /// @note The method also prints the direction of each child node in its parent's bounding box.
-        /// @note It is necessary to enable UTF-8 support in your console to see the tree structure correctly.
-        void print(const std::string& prefix, bool isLast, const std::string& postfix) const {
+        /// @note The links of the tree are UTF-8 characters, which a console must be set up to display.
+        void print(std::ostream& stream, const std::string& prefix, bool isLast, const std::string& postfix) const {
             // Inspired by Adrian Schneider's answer at:
             //      https://stackoverflow.com/questions/36802354/print-binary-tree-in-a-pretty-way-using-c
 
             // Print the prefix and the links to the hierarchy
-            std::cout << prefix;
-            std::cout << (isLast ? "└──" : "├──");
+            stream << prefix;
+            stream << (isLast ? "└──" : "├──");
 
             // Print the position and size of the node
-            std::cout << postfix << ": [" << position.transpose() << "] +- " << m_half_size << " \t >> ";
+            stream << postfix << ": [" << position.transpose() << "] +- " << m_half_size << " \t >> ";
 
             // print the value of the node
-            std::cout << data.size() << " triangles" << std::endl;
+            stream << data.size() << " triangles" << std::endl;
 
             std::string direction[8] = {
                 "Right-Bottom-Back", "Right-Bottom-Front", "Right-Top-Back", "Right-Top-Front",
@@ -119,24 +150,36 @@ class OctreeNode {
             };
             if (total_children_depth > 0) {
                 for (unsigned int i = 0; i < 8; ++i) {
-                    children[i]->print(prefix + (isLast ? "    " : "│   "), i == 7, direction[i]);
+                    children[i]->print(stream, prefix + (isLast ? "    " : "│   "), i == 7, direction[i]);
                 }
             }
         };
 
     private:
-        Box m_bounding_box; // Bounding box of the node
         double m_half_size; // Half the size of the node, used for bounding box calculations
 
-        // Planes for intersection tests
-        // These planes are centered on the node's position and aligned with the axes
-        Plane m_plane_xy, m_plane_xz, m_plane_yz; 
-
-        // Indices of the planes hit by a ray
-        std::vector<unsigned char> m_plane_indices;
+        /// @brief Recursively trace a ray through the node and its subtree
+        /// @param ray The ray to trace
+        /// @param slabs The distances at which the ray enters and leaves the slabs of the node (see getNodeSlabs)
+        /// @param signs The octant towards which the ray goes (see getDirectionOctant)
+        /// @param closest_collision_distance Reference to the distance to the closest object hit so far
+        /// @param insertion How the objects were placed in the leaves
+        /// @return A pointer to the first object hit by the ray in the subtree, or nullptr if no object is hit
+        const T* traceNode(const Ray& ray, const NodeSlabs& slabs, unsigned char signs, double& closest_collision_distance,
+                           OctreeInsertion insertion) const;
 };
 
-template <OctreeAcceptatble T>
+// Octree of objects of type T.
+// The nodes are created and destroyed by a node allocator (see nodeAllocator.hpp), by default an arena
+// that places the 8 children of a node contiguously in memory.
+// The queries do not go through these nodes, but through a compact read-only copy of the octree (see FlatOctree)
+// compiled by `finalize`. If objects were inserted, removed or updated since the last compilation, the first query patches the nodes
+// that changed (see FlatOctree::update).
+// The nodes of the flat layout take 16 bytes by default, or 8 bytes with CompactFlatOctreeNode for very large scenes.
+// With Scalar = float, the flat layout traces the single rays in single precision (see FlatOctree): a RayF is traced without
+// any conversion, and a Ray is rounded first. The objects, the nodes and the other queries stay in double precision.
+template <OctreeAcceptatble T, template <typename> class NodeAllocator = NodeArena, FlatOctreeNodeLayout FlatNode = FlatOctreeNode,
+          std::floating_point Scalar = double>
 class Octree {
     typedef OctreeNode<T> Node;
 
@@ -146,33 +189,232 @@ class Octree {
         /// @param initial_size Initial size of the octree's root node (length of one side of the cube)
         /// @param max_neighbors Maximum number of neighbors in each octree leaf
         /// @param root_postion Position of the root node in 3D space
+        /// @param insertion How the objects are placed in the leaves (default is by position, see OctreeInsertion)
         /// @note The root node's bounding box is initialized to a cube centered at `root_position` with a size of `min_size`
-        Octree(unsigned int max_depth, double initial_size, unsigned int max_neighbors, const Eigen::Vector3d& root_postion);
-
-        /// @brief Destructor for Octree
-        ~Octree() {
-            clear(); // Clear the octree to free memory
-        };
+        /// @throws std::invalid_argument if `insertion` is BoundingBox and T does not have a `getBoundingBox` method (see OctreeBoundable)
+        Octree(unsigned int max_depth, double initial_size, unsigned int max_neighbors, const Eigen::Vector3d& root_postion,
+               OctreeInsertion insertion = OctreeInsertion::Position);
+
+        /// @brief Constructor for an Octree configured by a cost model instead of manual parameters
+        /// @param insertion How the objects are placed in the leaves (default is by bounding box, see OctreeInsertion)
+        /// @param cost_model The relative costs of the traversal and of the intersections (see OctreeCostModel)
+        /// @note `build` fits the root to the bounds of the objects, and `insert` grows it from a unit cube at the origin.
+        /// @note A leaf is split only if the cost model predicts that it pays off. Otherwise it keeps all its objects, even at the
+        ///       maximum depth (MORTON_LEVELS) or when they share a position: `build` and `insert` never throw because of a full leaf.
+        /// @throws std::invalid_argument if the intersection cost is not positive or the traversal cost is negative
+        /// @throws std::invalid_argument if `insertion` is BoundingBox and T does not have a `getBoundingBox` method (see OctreeBoundable)
+        explicit Octree(OctreeInsertion insertion = OctreeInsertion::BoundingBox, const OctreeCostModel& cost_model = OctreeCostModel());
 
         /// @brief Inserts a single object into the octree.
         /// @param data Pointer to the object to be inserted into the octree
         /// @param verbose If true, prints debug information during insertion
         /// @note The object must implement the `getPosition` method returning a 3D vector and the `intersect` method for ray intersection tests.
+        /// @note With BoundingBox insertion, the object is referenced by every leaf its bounding box overlaps. A leaf holds more than
+        ///       `max_neighbors` objects only at the maximum depth, or when all its objects cover it entirely (splitting it would not help).
+        /// @note With a cost model, the leaves are split as long as it pays off and hold any number of objects otherwise (see OctreeCostModel).
+        /// @throws std::length_error if the object lies too far for the root to grow to it, or if a leaf is full at the maximum depth
+        ///         (only without a cost model)
         void insert(const T* data, bool verbose = false);
 
-        /// @brief Uses Sorted Sibling Traversal to trace a ray through the octree and detect the first object hit by the ray.
-        /// @param ray The ray to trace through the octree
-        /// @param hit_distance Reference to a double that will hold the distance to the first hit object
+        /// @brief Removes a single object from the octree.
+        /// @param data Pointer to the object to be removed
+        /// @return true if the object was in the octree
+        /// @note The object is looked for in the region of the leaves where it was placed, even if it moved since then,
+        ///       so the cost depends on the size of that region and not on the number of objects in the octree.
+        /// @note An interior node whose children are leaves holding at most `max_neighbors` objects in total becomes a leaf again
+        ///       (with a cost model, whose children are not cheaper than a leaf). Its children are kept for the next splits.
+        /// @note The first call to `remove` or `update` after a `build` records the leaves of all the objects, in a single pass.
+        bool remove(const T* data);
+
+        /// @brief Moves a single object to the leaves matching its current position or bounding box, eg after Triangle::translate.
+        /// @param data Pointer to the object that moved
+        /// @note The object is removed from the leaves where it was placed and inserted again, and the next query (or `finalize`)
+        ///       only compiles again the nodes of the flat layout that changed (see FlatOctree::update). The cost of the updates is then
+        ///       proportional to the number of leaves they touch, except for the first `remove` or `update` after a `build`, which
+        ///       records the leaves of all the objects, and for the compilations from scratch once the replaced nodes of the flat
+        ///       layout outnumber the ones in use.
+        /// @throws std::invalid_argument if the object is not in the octree
+        /// @throws std::length_error if the object cannot be inserted at its new place (see `insert`). It is then put back in the leaves
+        ///         covering its previous place, beyond `max_neighbors` if needed: it stays in the octree and can be updated or removed
+        ///         later. The root may have grown and some leaves may have been split by the failed insertion.
+        void update(const T* data);
+
+        /// @brief Builds the octree from scratch with all the objects at once, replacing its content.
+        /// @param objects Pointers to the objects to insert into the octree
+        /// @param thread_pool Optional pool on which the bounds, the Morton codes, their sort and the subtrees are computed (nullptr builds serially)
+        /// @note The root is the smallest cube centered on the objects whose size is the initial size times a power of 2.
+        ///       The objects are sorted along a Morton curve, so that the objects of each node form a contiguous range,
+        ///       then the nodes are split top-down: the first levels on the calling thread, the deeper subtrees as tasks of the pool.
+        /// @note The resulting tree is the same with or without a thread pool, and the leaves follow the same rules as `insert`.
+        /// @note With a cost model, the root is the smallest cube holding the objects and the leaves follow the cost model.
+        /// @throws std::length_error with Position insertion and without a cost model, if more than `max_neighbors` objects lie in a leaf
+        ///         at the maximum depth. The octree is then left empty.
+        void build(std::span<const T* const> objects, ThreadPool* thread_pool = nullptr);
+
+        /// @brief Get how the objects are placed in the leaves
+        /// @return The insertion mode of the octree
+        inline OctreeInsertion getInsertion() const {
+            return m_insertion;
+        };
+
+        /// @brief Get the cost model deciding where the leaves are split
+        /// @return The cost model, or nullptr if the octree uses manual parameters
+        inline const OctreeCostModel* getCostModel() const {
+            return m_cost_model ? &*m_cost_model : nullptr;
+        };
+
+        /// @brief Compile the flat layout of the octree used by the queries.
+        /// @note Calling this method after building the octree is optional, but it avoids paying for the compilation in the first query.
+        void finalize();
+
+        /// @brief Check if the flat layout of the octree is up to date
+        /// @return true if no object was inserted, removed or updated since the last compilation
+        inline bool isFinalized() const {
+            return m_finalized;
+        };
+
+        /// @brief Get the flat layout of the octree, compiling it if needed
+        /// @return The flat octree used by the queries
+        const FlatOctree<T, FlatNode, Scalar>& getFlatOctree() const;
+
+        /// @brief Write the built octree to a binary file, so that another process loads it instead of building it (see `load`)
+        /// @param path The path of the file, replaced if it exists
+        /// @param objects The objects of the octree, in the order in which they will be given to `load` (eg the array given to `build`)
+        /// @note The flat layout is compiled if needed and saved with the order of the objects in the leaves (see FlatOctree::save).
+        ///       If updates left replaced nodes in it, a copy is compiled from scratch and saved instead, so that the queries can run
+        ///       alongside. The flat layout of a loaded octree whose nodes are not rebuilt yet is saved as it was loaded.
+        /// @throws std::invalid_argument if an object of the octree is not in `objects`
+        /// @throws std::runtime_error if the file cannot be written
+        void save(const std::string& path, std::span<const T* const> objects) const;
+
+        /// @brief Replace the content of the octree with an octree saved by `save`, instead of building it
+        /// @param path The path of the file
+        /// @param objects The objects of the saved octree, in the same order as when it was saved
+        /// @note The file is mapped in memory and the queries read its nodes in place, without allocating any node: the loading time
+        ///       does not depend on the number of nodes, and the processes loading the same file share its pages.
+        /// @note The pointer-based nodes are rebuilt from the file by the first `insert`, `remove` or `update` only.
+        ///       Until then, `getRoot` is an empty root and `stats` describes the flat layout.
+        /// @throws std::runtime_error if the file cannot be read or is not a valid octree file of this version (see FlatOctree::load)
+        /// @throws std::invalid_argument if the number of objects, the insertion mode or the depth of the saved octree does not match
+        ///         this octree. The octree is left unchanged on error.
+        void load(const std::string& path, std::span<const T* const> objects);
+
+        /// @brief Uses a parametric traversal to trace a ray through the octree and detect the first object hit by the ray.
+        /// @note The ray goes through the flat layout of the octree, several threads can trace rays at once.
+        /// @param ray The ray to trace through the octree, a Ray or a RayF
+        /// @param hit_distance Reference to a scalar that will hold the distance to the first hit object
         /// @param max_distance Maximum distance to trace the ray (default is infinity)
         /// @return A pointer to the first object hit by the ray, or nullptr if no object is hit
-        const T* traceRay(const Ray& ray, double& hit_distance, double max_distance = std::numeric_limits<double>::infinity()) const;
-
-        /// @brief Clears the octree, deleting all nodes and freeing memory.
+        template <std::floating_point RayScalar = double>
+        const T* traceRay(const BasicRay<RayScalar>& ray, RayScalar& hit_distance,
+                          std::type_identity_t<RayScalar> max_distance = std::numeric_limits<RayScalar>::infinity()) const;
+
+        /// @brief Trace a packet of coherent rays through the octree together, eg the rays of a block of neighboring pixels.
+        /// @param packet The rays to trace (see RayPacket)
+        /// @param hit_distances Set to the distance to the first object hit by each ray
+        /// @param max_distance Maximum distance to trace the rays (default is infinity)
+        /// @return A pointer to the first object hit by each ray, or nullptr if the ray hits no object or its lane is not in use
+        /// @note The hits are the same as with `traceRay`. A packet whose rays go towards different octants is traced ray by ray.
+        template <int N>
+        std::array<const T*, N> traceRays(const RayPacket<N>& packet, typename RayPacket<N>::Lanes& hit_distances,
+                                          double max_distance = std::numeric_limits<double>::infinity()) const;
+
+        /// @brief Collect once the subtrees crossed by the rays of a frustum, eg the rays of a tile of pixels, to trace them from there.
+        /// @param planes The planes bounding the frustum, whose normals point inside it (see FrustumRegion)
+        /// @param signs The octant towards which the rays go (see getDirectionOctant)
+        /// @param entry_points Filled with the subtrees overlapping the frustum (see FlatOctree::cull)
+        /// @param max_nodes The maximum number of subtrees
+        /// @note The entry points are given to `traceRay` and `traceRays` for the rays lying in the frustum, until the octree changes.
+        void cullFrustum(std::span<const Plane> planes, unsigned char signs, OctreeEntryPoints& entry_points,
+                         std::size_t max_nodes = OctreeEntryPoints::DEFAULT_MAX_NODES) const;
+
+        /// @brief Trace a ray lying in a frustum from the subtrees collected by `cullFrustum`, instead of the root.
+        /// @param ray The ray to trace
+        /// @param hit_distance Set to the distance to the first hit object
+        /// @param entry_points The subtrees collected by `cullFrustum` for a frustum containing the ray
+        /// @param max_distance Maximum distance to trace the ray (default is infinity)
+        /// @return A pointer to the first object hit by the ray, or nullptr if no object is hit
+        /// @note The hits are the same as with `traceRay` from the root.
+        const T* traceRay(const Ray& ray, double& hit_distance, const OctreeEntryPoints& entry_points,
+                          double max_distance = std::numeric_limits<double>::infinity()) const;
+
+        /// @brief Trace a packet of rays lying in a frustum from the subtrees collected by `cullFrustum`, instead of the root.
+        /// @param packet The rays to trace (see RayPacket)
+        /// @param hit_distances Set to the distance to the first object hit by each ray
+        /// @param entry_points The subtrees collected by `cullFrustum` for a frustum containing the rays
+        /// @param max_distance Maximum distance to trace the rays (default is infinity)
+        /// @return A pointer to the first object hit by each ray, or nullptr if the ray hits no object or its lane is not in use
+        /// @note The hits are the same as with `traceRays` from the root.
+        template <int N>
+        std::array<const T*, N> traceRays(const RayPacket<N>& packet, typename RayPacket<N>::Lanes& hit_distances,
+                                          const OctreeEntryPoints& entry_points,
+                                          double max_distance = std::numeric_limits<double>::infinity()) const;
+
+        /// @brief Trace a large batch of incoherent rays through the octree together, eg secondary or sensor rays.
+        /// @param rays The rays to trace
+        /// @param hit_distances Set to the distance to the first object hit by each ray (same size as `rays`)
+        /// @param max_distance Maximum distance to trace the rays (default is infinity)
+        /// @return A pointer to the first object hit by each ray, or nullptr if the ray hits no object
+        /// @throws std::invalid_argument if `hit_distances` and `rays` do not have the same size
+        /// @note The rays go down the octree as streams, node by node, instead of one after the other (see FlatOctree::traceRayStream).
+        ///       The hits are the same as with `traceRay`.
+        std::vector<const T*> traceRayStream(std::span<const Ray> rays, std::span<double> hit_distances,
+                                             double max_distance = std::numeric_limits<double>::infinity()) const;
+
+        /// @brief Check if any object is hit by a ray before a maximum distance, eg to know if a light is visible from a point.
+        /// @param ray The ray to trace through the octree
+        /// @param max_distance The distance along the ray beyond which the hits are ignored
+        /// @return true if an object is hit at a distance in [0, max_distance)
+        /// @note The query returns at the first hit found instead of searching for the closest one (see FlatOctree::occluded).
+        /// @note With Position insertion, the objects spanning several octants are missed by some rays, as with `traceRay`.
+        template <std::floating_point RayScalar = double>
+        bool occluded(const BasicRay<RayScalar>& ray, std::type_identity_t<RayScalar> max_distance) const;
+
+        /// @brief Gather the objects in an axis-aligned box, eg the objects touched by a local edit.
+        /// @param box The box to gather
+        /// @param results Cleared, then filled with the objects in the box (its capacity is reused)
+        /// @note The objects are selected by bounding box or by position, as they are placed in the leaves (see FlatOctree::query).
+        void queryBox(const Box& box, std::vector<const T*>& results) const;
+
+        /// @brief Gather the objects in a ball, eg the candidates of a collision with a moving object.
+        /// @param center The center of the ball
+        /// @param radius The radius of the ball
+        /// @param results Cleared, then filled with the objects in the ball (its capacity is reused)
+        /// @note The objects are selected by bounding box or by position, as they are placed in the leaves (see FlatOctree::query).
+        void querySphere(const Eigen::Vector3d& center, double radius, std::vector<const T*>& results) const;
+
+        /// @brief Gather the objects in a convex region bounded by planes, eg the frustum of a camera for culling.
+        /// @param planes The planes bounding the region, whose normals point inside it (see FrustumRegion)
+        /// @param results Cleared, then filled with the objects in the region (its capacity is reused)
+        /// @note With BoundingBox insertion, the test of the boxes against the planes is conservative: objects near the edges of the region
+        ///       may be gathered while they are outside it.
+        void queryFrustum(std::span<const Plane> planes, std::vector<const T*>& results) const;
+
+        /// @brief Find the object closest to a point, eg the distance from a probe to the nearest surface.
+        /// @param point The point
+        /// @param closest_point Set to the point of the nearest object closest to `point`, only valid if an object is found
+        /// @param max_radius The distance beyond which the objects are ignored (default is infinity)
+        /// @return A pointer to the nearest object within `max_radius`, or nullptr if there is none
+        /// @note The objects must give their point closest to another point (see NearestQueryable and FlatOctree::nearest).
+        const T* nearest(const Eigen::Vector3d& point, Eigen::Vector3d& closest_point,
+                         double max_radius = std::numeric_limits<double>::infinity()) const requires NearestQueryable<T>;
+
+        /// @brief Clears the octree, deleting all nodes at once.
+        /// @note The octree is reset to an empty root node with the initial size and position, so that new objects can be inserted.
         void clear();
 
-        /// @brief Prints the structure of the octree to the console.
+        /// @brief Prints the structure of the octree to a stream.
+        /// @param stream The stream to print to (default is the console)
         /// @note This method prints the octree in a tree-like format, showing the hierarchy of nodes and their positions, sizes and data.
-        void print() const;
+        void print(std::ostream& stream = std::cout) const;
+
+        /// @brief Compute statistics on the shape and the memory of the octree, eg to check the quality of the tree built for a scene.
+        /// @return The node counts per depth, the occupancy of the leaves, the memory used and the expected cost of a ray (see OctreeStats)
+        /// @note The traversal cost uses the cost model of the octree, or the default one if the octree uses manual parameters.
+        /// @note The flat layout is compiled if needed, to measure its memory.
+        /// @note For an octree loaded from a file and not modified since, the statistics describe its flat layout (see `load`):
+        ///       it has no empty leaf and no pointer-based node.
+        OctreeStats stats() const;
 
         /// @brief Returns the root node of the octree.
         /// @return A pointer to the root node of the octree
@@ -183,14 +425,114 @@ class Octree {
     private:
         const unsigned int m_max_depth; // Maximum level of the octree
         const unsigned int m_max_neighbors; // Maximum number of neighbors in each octree leaf
+        const double m_initial_size; // Initial size of the root node, used when the octree is cleared
+        const Eigen::Vector3d m_initial_position; // Initial position of the root node, used when the octree is cleared
+        const OctreeInsertion m_insertion; // How the objects are placed in the leaves
+        const std::optional<OctreeCostModel> m_cost_model; // Costs deciding where the leaves are split, none with manual parameters
 
+        NodeAllocator<Node> m_nodes; // Allocator owning the nodes of the octree
+        std::vector<std::unique_ptr<NodeAllocator<Node>>> m_worker_nodes; // Allocators owning the nodes created by each worker during `build`
         Node* m_root; // Root node of the octree
 
-        /// @brief Helper method to add child nodes to a given node, skipping a specified index.
+        // Region covered by the leaves holding each object, in which `remove` looks for it.
+        // The region only grows when the leaves are split or merged, so it stays valid until the object is removed
+        std::unordered_map<const T*, Box> m_locations;
+        bool m_tracking_locations = false; // True if `m_locations` holds all the objects, set by the first `remove` or `update`
+        std::vector<std::array<Node*, 8>> m_free_children; // Children released by the merges, reused by the next splits on the calling thread
+
+        // The flat layout is compiled lazily by the queries, which are const: these members are protected by `m_finalize_mutex`
+        mutable FlatOctree<T, FlatNode, Scalar> m_flat_octree; // Compact read-only layout of the octree used by the queries
+        mutable std::atomic<bool> m_finalized{false}; // True if the flat layout is up to date
+        mutable std::mutex m_finalize_mutex; // Serializes the compilations of the flat layout
+        bool m_restore_pending = false; // True if the octree was loaded from a file and its pointer-based nodes are not rebuilt yet
+
+        /// @brief Rebuild the pointer-based nodes from the flat layout of an octree loaded from a file, before modifying it
+        void restoreNodes();
+
+        /// @brief Compile the flat layout if objects were inserted, removed or updated since the last compilation
+        /// @note Only the nodes marked as modified are compiled again (see FlatOctree::update), and their marks are cleared.
+        /// @note This method is thread-safe, the first query compiles the layout while the other ones wait.
+        void ensureFinalized() const;
+
+        /// @brief Record the region of the leaves holding each object of the octree
+        void trackLocations();
+
+        /// @brief Put an object back in the leaves covering the region where it was, after its insertion failed in `update`
+        /// @param data Pointer to the object, which is in no leaf
+        /// @param location The region of the leaves which held the object
+        void restoreLocation(const T* data, const Box& location);
+
+        /// @brief Extend the region in which an object is looked for with a leaf in which it is placed (only once locations are tracked)
+        /// @param data Pointer to the object
+        /// @param leaf The leaf holding the object
+        void addLocation(const T* data, const Node* leaf);
+
+        /// @brief Remove an object from the leaves of a subtree overlapping a region, and merge the nodes that become underfull
+        /// @param node The root of the subtree, which the region overlaps
+        /// @param data Pointer to the object to remove
+        /// @param location The region of the leaves holding the object
+        /// @return true if the object was found in the subtree
+        bool removeFromNode(Node* node, const T* data, const Box& location);
+
+        /// @brief Turn an interior node back into a leaf if its children are leaves holding at most `max_neighbors` objects in total
+        /// @param node The interior node
+        /// @note With a cost model and BoundingBox insertion, the node becomes a leaf if its children are not cheaper than the leaf.
+        void mergeChildren(Node* node);
+
+        /// @brief A range of Morton keys lying in a node, during `build` with Position insertion
+        struct MortonRange {
+            Node* node; // The node in which the objects lie
+            std::size_t begin; // Index of the first key of the range
+            std::size_t count; // Number of keys in the range
+            unsigned int level; // Level of the Morton codes giving the octant of the keys among the children of the node
+        };
+
+        /// @brief Helper method to add the 8 child nodes to a given node, contiguously in memory.
         /// @param node Pointer to the node to which child nodes will be added to
-        /// @param ignore_index Index of the child node to skip (default is 8, which means no child is skipped)
+        /// @param nodes The allocator creating the child nodes
+        /// @param existing_child Optional node moved into the children of `node` instead of creating a new one (used when the root grows)
+        /// @param existing_index Index of the existing child (default is 8, which means no existing child)
         /// @note The child nodes are created based on the position and size of the parent node
-        inline void addChildrenToNode(Node* node, const unsigned char ignore_index = 8);
+        /// @note With the allocator of the octree, the children released by a merge are reused before creating new ones.
+        inline void addChildrenToNode(Node* node, NodeAllocator<Node>& nodes, Node* existing_child = nullptr, const unsigned char existing_index = 8);
+
+        /// @brief Double the size of the root until it contains a box, or until the maximum depth is reached
+        /// @param box The box that the root must contain
+        /// @param verbose If true, prints debug information during the expansion
+        /// @return true if the root contains the box
+        bool expandRoot(const Box& box, bool verbose);
+
+        /// @brief Insert an object in every leaf of a subtree overlapped by its bounding box (BoundingBox insertion only)
+        /// @param node The root of the subtree, which the box overlaps
+        /// @param data Pointer to the object to insert
+        /// @param box The bounding box of the object
+        void insertBoundingBox(Node* node, const T* data, const Box& box);
+
+        /// @brief Split a leaf and reference each of its objects in the children that its bounding box overlaps (BoundingBox insertion only)
+        /// @param node The leaf to split
+        /// @param nodes The allocator creating the child nodes
+        /// @param split_nodes The children that hold too many objects are added to this list, to be split in turn
+        void splitBoundingBox(Node* node, NodeAllocator<Node>& nodes, std::vector<Node*>& split_nodes);
+
+        /// @brief Split nodes until none of them needs to be split anymore
+        /// @param items The nodes to split, with the state needed by `split`
+        /// @param thread_pool Optional pool on which the subtrees are split (nullptr splits them on the calling thread)
+        /// @param split The callable splitting one item with a given node allocator, and adding the items of the children to split to a list
+        /// @note The first levels are split breadth-first on the calling thread until there are enough subtrees for the workers,
+        ///       then each subtree is split depth-first by a task, creating its nodes with the allocator of its worker.
+        template <typename Item, typename SplitFunction>
+        void splitTopDown(std::vector<Item> items, ThreadPool* thread_pool, SplitFunction&& split);
+
+        /// @brief Check if a leaf holds too many objects and splitting it would separate them (BoundingBox insertion only)
+        /// @param node The leaf to check
+        /// @return true if the leaf should be split
+        /// @note With a cost model, the objects overlapping each child are counted to compare the leaf with its children.
+        bool shouldSubdivideBoundingBox(const Node* node) const;
+
+        /// @brief Get the largest number of objects kept in a leaf by a cost model when the objects are separated by a split
+        /// @param cost_model The cost model
+        /// @return The number of objects, used as the maximum number of neighbors of the octree
+        static unsigned int getLeafSize(const OctreeCostModel& cost_model);
 };
 
 // Include the implementation file to make the template class implementation accessible to the compiler
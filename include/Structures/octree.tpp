@@ -1,54 +1,101 @@
 #include "Structures/octree.hpp"
 
-template <OctreeAcceptatble T>
-Octree<T>::Octree(unsigned int max_depth, double initial_size, unsigned int max_neighbors, const Eigen::Vector3d& root_postion) : 
+template <OctreeAcceptatble T, template <typename> class NodeAllocator, FlatOctreeNodeLayout FlatNode, std::floating_point Scalar>
+Octree<T, NodeAllocator, FlatNode, Scalar>::Octree(unsigned int max_depth, double initial_size, unsigned int max_neighbors, const Eigen::Vector3d& root_postion,
+                                 OctreeInsertion insertion) : 
         m_max_depth(max_depth),
-        m_max_neighbors(max_neighbors)
+        m_max_neighbors(max_neighbors),
+        m_initial_size(initial_size),
+        m_initial_position(root_postion),
+        m_insertion(insertion)
 {
     assert(initial_size > 0 && "Initial size of the octree must be greater than zero.");
 
+    if constexpr (!OctreeBoundable<T>) {
+        if (insertion == OctreeInsertion::BoundingBox) {
+            throw std::invalid_argument("Cannot use bounding box insertion: the objects do not have a getBoundingBox method.");
+        }
+    }
+
     // Initialize the root node of the octree
-    m_root = new Node(root_postion, initial_size, 0, 0);
+    m_root = m_nodes.create(root_postion, initial_size, 0, 0);
 }
 
-/// @brief Get the branch index corresponding to the closest octant from the node to the given position
-/// @param position The position to check
-/// @param node_position The position of the node
-/// @return A value between 0 and 7 (111) representing the octant in which the position lies
-///         0: (-,-,-), 1: (-,-,+), 2: (-,+,-), 3: (-,+,+),
-///         4: (+,-,-), 5: (+,-,+), 6: (+,+,-), 7: (+,+,+)
-inline unsigned char getBranchIndex(const Eigen::Vector3d& position, const Eigen::Vector3d& node_position) {
-    unsigned char branch_index = 0; // Value between 0 and 7 (111) representing the octant in which the position lies
-    if (position.x() >= node_position.x()) branch_index |= 4;
-    if (position.y() >= node_position.y()) branch_index |= 2;
-    if (position.z() >= node_position.z()) branch_index |= 1;
-    return branch_index;
+template <OctreeAcceptatble T, template <typename> class NodeAllocator, FlatOctreeNodeLayout FlatNode, std::floating_point Scalar>
+Octree<T, NodeAllocator, FlatNode, Scalar>::Octree(OctreeInsertion insertion, const OctreeCostModel& cost_model) :
+        m_max_depth(MORTON_LEVELS),
+        m_max_neighbors(getLeafSize(cost_model)),
+        m_initial_size(1.0),
+        m_initial_position(Eigen::Vector3d::Zero()),
+        m_insertion(insertion),
+        m_cost_model(cost_model)
+{
+    if constexpr (!OctreeBoundable<T>) {
+        if (insertion == OctreeInsertion::BoundingBox) {
+            throw std::invalid_argument("Cannot use bounding box insertion: the objects do not have a getBoundingBox method.");
+        }
+    }
+
+    m_root = m_nodes.create(m_initial_position, m_initial_size, 0, 0);
 }
 
-template <OctreeAcceptatble T>
-inline void Octree<T>::addChildrenToNode(Node* node, const unsigned char ignore_index) {
-    // Create child nodes for the current node
+template <OctreeAcceptatble T, template <typename> class NodeAllocator, FlatOctreeNodeLayout FlatNode, std::floating_point Scalar>
+unsigned int Octree<T, NodeAllocator, FlatNode, Scalar>::getLeafSize(const OctreeCostModel& cost_model) {
+    if (!(cost_model.intersection_cost > 0) || !(cost_model.traversal_cost >= 0)) {
+        throw std::invalid_argument("The intersection cost must be positive and the traversal cost must not be negative.");
+    }
+
+    // Objects at distinct positions are all referenced by a single child: the leaf is split once it holds enough of them
+    unsigned int leaf_size = 1;
+    while (!cost_model.shouldSplit(leaf_size + 1, leaf_size + 1)) leaf_size++;
+    return leaf_size;
+}
+
+template <OctreeAcceptatble T, template <typename> class NodeAllocator, FlatOctreeNodeLayout FlatNode, std::floating_point Scalar>
+inline void Octree<T, NodeAllocator, FlatNode, Scalar>::addChildrenToNode(Node* node, NodeAllocator<Node>& nodes, Node* existing_child, const unsigned char existing_index) {
+    // Reuse the children released by a merge, which are already next to each other in memory.
+    // The workers of `build` create their nodes with their own allocators, and never share the free children
+    const bool reuse_children = existing_child == nullptr && &nodes == &m_nodes && !m_free_children.empty();
+    std::array<Node*, 8> free_children = {};
+    if (reuse_children) {
+        free_children = m_free_children.back();
+        m_free_children.pop_back();
+    }
+
+    // Create child nodes for the current node, next to each other in memory
+    if (!reuse_children) nodes.reserveContiguous(8);
     double new_half_size = node->getHalfSize() / 2;
     for (int i = 0; i < 8; ++i) {
-        if (i == ignore_index) continue; // Skip the ignored index
+        // Move the existing child next to its siblings
+        if (i == existing_index) {
+            node->children[i] = nodes.create(std::move(*existing_child));
+            continue;
+        }
 
         Eigen::Vector3d child_position = node->position + 
             (Eigen::Array3d((i & 4) ? 1 : -1, (i & 2) ? 1 : -1, (i & 1) ? 1 : -1) * 
             Eigen::Array3d(new_half_size, new_half_size, new_half_size)).matrix();
         
-        node->children[i] = new Node(child_position, node->getHalfSize(), node->depth + 1, 0);
+        if (reuse_children) {
+            *free_children[i] = Node(child_position, node->getHalfSize(), node->depth + 1, 0);
+            node->children[i] = free_children[i];
+        } else {
+            node->children[i] = nodes.create(child_position, node->getHalfSize(), node->depth + 1, 0);
+        }
+        node->children[i]->modified = true; // The new children are not in the flat layout
     }
+    node->modified = true;
 }
 
-template <OctreeAcceptatble T>
-void Octree<T>::insert(const T* data, bool verbose) {
-    Eigen::Vector3d position = data->getPosition(); // Get the position of the data to be inserted
-    if (verbose) std::cout << "Inserting data at position: " << position.transpose() << std::endl;
+template <OctreeAcceptatble T, template <typename> class NodeAllocator, FlatOctreeNodeLayout FlatNode, std::floating_point Scalar>
+bool Octree<T, NodeAllocator, FlatNode, Scalar>::expandRoot(const Box& box, bool verbose) {
+    while (!m_root->getBoundingBox().contains(box) && m_root->total_children_depth < m_max_depth) {
+        // Grow towards the side of the box that sticks out of the root on each axis
+        const Box& root_box = m_root->getBoundingBox();
+        Eigen::Vector3d target = (box.min < root_box.min).select(box.min, box.max).matrix();
 
-    // If the position is outside the bounding box, expand the octree
-    while (!m_root->getBoundingBox().contains(position) && m_root->total_children_depth < m_max_depth) {
         // Value between 0 and 7 (111) representing the octant in which the current root lies in the new root node
-        unsigned char current_root_index = getBranchIndex(m_root->position, position);
+        unsigned char current_root_index = getBranchIndex(m_root->position, target);
 
         // Position of the new root node is the center of the current root node's bounding box
         Eigen::Vector3d new_root_position = m_root->position +
@@ -56,14 +103,11 @@ void Octree<T>::insert(const T* data, bool verbose) {
             Eigen::Array3d(m_root->getHalfSize(), m_root->getHalfSize(), m_root->getHalfSize())).matrix();
 
         // Create a new root node with double the size of the current root node
-        Node* new_root = new Node(new_root_position, m_root->size * 2, 0, m_root->total_children_depth + 1);
+        Node* new_root = m_nodes.create(new_root_position, m_root->size * 2, 0, m_root->total_children_depth + 1);
 
-        // Set the current root as a child of the new root
-        new_root->children[current_root_index] = m_root;
+        // Set the current root as a child of the new root, and create the other 7 children of the new root node
         m_root->depth = 1; // Update the depth of the current root node to 1
-
-        // Create the other 7 children of the new root node
-        addChildrenToNode(new_root, current_root_index);
+        addChildrenToNode(new_root, m_nodes, m_root, current_root_index);
 
         // Update the root to the new root
         m_root = new_root;
@@ -71,8 +115,268 @@ void Octree<T>::insert(const T* data, bool verbose) {
         if (verbose) std::cout << "Expanded octree to new root at position: " << new_root_position.transpose() << " with size: " << m_root->size << " and bounding box: " << m_root->getBoundingBox().min.transpose() << ", " << m_root->getBoundingBox().max.transpose() << std::endl;
     }
 
-    // Check if the position is within the bounding box of the root node
-    if (!m_root->getBoundingBox().contains(position)) {
+    return m_root->getBoundingBox().contains(box);
+}
+
+template <OctreeAcceptatble T, template <typename> class NodeAllocator, FlatOctreeNodeLayout FlatNode, std::floating_point Scalar>
+void Octree<T, NodeAllocator, FlatNode, Scalar>::insertBoundingBox(Node* node, const T* data, const Box& box) {
+    node->modified = true;
+
+    // Go down to every leaf overlapped by the box
+    if (node->total_children_depth > 0) {
+        for (int i = 0; i < 8; ++i) {
+            if (node->children[i]->getBoundingBox().overlaps(box)) insertBoundingBox(node->children[i], data, box);
+        }
+        return;
+    }
+
+    if (node->data.empty()) node->data.reserve(m_max_neighbors);
+    node->data.push_back(data);
+    addLocation(data, node);
+
+    if (shouldSubdivideBoundingBox(node)) {
+        splitTopDown(std::vector<Node*>{node}, nullptr, [this](Node* split_node, NodeAllocator<Node>& nodes, std::vector<Node*>& split_nodes) {
+            splitBoundingBox(split_node, nodes, split_nodes);
+        });
+    }
+}
+
+template <OctreeAcceptatble T, template <typename> class NodeAllocator, FlatOctreeNodeLayout FlatNode, std::floating_point Scalar>
+bool Octree<T, NodeAllocator, FlatNode, Scalar>::shouldSubdivideBoundingBox(const Node* node) const {
+    if (node->data.size() <= m_max_neighbors || node->depth >= m_max_depth) return false;
+
+    // Compare the leaf with the children it would have, each object being referenced by all the children it overlaps
+    if (m_cost_model) {
+        const double half_size = node->getHalfSize() / 2;
+        std::size_t child_references = 0;
+        for (int i = 0; i < 8; ++i) {
+            const Eigen::Array3d child_center = node->position.array() +
+                Eigen::Array3d((i & 4) ? half_size : -half_size, (i & 2) ? half_size : -half_size, (i & 1) ? half_size : -half_size);
+            const Box child_box{child_center - half_size, child_center + half_size};
+            for (const T* existing_data : node->data) {
+                child_references += child_box.overlaps(existing_data->getBoundingBox());
+            }
+        }
+        return m_cost_model->shouldSplit(node->data.size(), child_references);
+    }
+
+    // The objects covering the whole leaf would be referenced by all its children: splitting only helps if one of them does not
+    const Box& node_box = node->getBoundingBox();
+    for (const T* existing_data : node->data) {
+        if (!existing_data->getBoundingBox().contains(node_box)) return true;
+    }
+    return false;
+}
+
+template <OctreeAcceptatble T, template <typename> class NodeAllocator, FlatOctreeNodeLayout FlatNode, std::floating_point Scalar>
+void Octree<T, NodeAllocator, FlatNode, Scalar>::splitBoundingBox(Node* node, NodeAllocator<Node>& nodes, std::vector<Node*>& split_nodes) {
+    addChildrenToNode(node, nodes);
+
+    // Reference each object in all the children that its bounding box overlaps
+    for (const T* existing_data : node->data) {
+        const Box& box = existing_data->getBoundingBox();
+        for (int i = 0; i < 8; ++i) {
+            std::vector<const T*>& child_data = node->children[i]->data;
+            if (!node->children[i]->getBoundingBox().overlaps(box)) continue;
+            if (child_data.empty()) child_data.reserve(m_max_neighbors);
+            child_data.push_back(existing_data);
+        }
+    }
+
+    // Set the node to not be a leaf anymore, and release its data after redistribution
+    node->total_children_depth = 1;
+    std::vector<const T*>().swap(node->data);
+
+    // All the objects may have landed in the same children: split them again if needed
+    for (int i = 0; i < 8; ++i) {
+        if (shouldSubdivideBoundingBox(node->children[i])) split_nodes.push_back(node->children[i]);
+    }
+}
+
+template <OctreeAcceptatble T, template <typename> class NodeAllocator, FlatOctreeNodeLayout FlatNode, std::floating_point Scalar>
+template <typename Item, typename SplitFunction>
+void Octree<T, NodeAllocator, FlatNode, Scalar>::splitTopDown(std::vector<Item> items, ThreadPool* thread_pool, SplitFunction&& split) {
+    // Split the first levels on the calling thread, until there are enough subtrees to share between the workers
+    const std::size_t task_count = thread_pool ? 4 * thread_pool->getThreadCount() : 0;
+    std::vector<Item> next_items;
+    while (!items.empty() && items.size() < task_count) {
+        next_items.clear();
+        for (const Item& item : items) {
+            split(item, m_nodes, next_items);
+        }
+        items.swap(next_items);
+    }
+
+    if (!thread_pool) {
+        while (!items.empty()) {
+            Item item = items.back();
+            items.pop_back();
+            split(item, m_nodes, items);
+        }
+        return;
+    }
+
+    // Each worker creates the nodes of its subtrees with its own allocator, so that no lock is needed
+    while (m_worker_nodes.size() < thread_pool->getThreadCount()) {
+        m_worker_nodes.push_back(std::make_unique<NodeAllocator<Node>>());
+    }
+
+    thread_pool->run(items.size(), [&](std::size_t task_index, unsigned int worker_index) {
+        std::vector<Item> stack{items[task_index]};
+        while (!stack.empty()) {
+            Item item = stack.back();
+            stack.pop_back();
+            split(item, *m_worker_nodes[worker_index], stack);
+        }
+    });
+}
+
+template <OctreeAcceptatble T, template <typename> class NodeAllocator, FlatOctreeNodeLayout FlatNode, std::floating_point Scalar>
+void Octree<T, NodeAllocator, FlatNode, Scalar>::build(std::span<const T* const> objects, ThreadPool* thread_pool) {
+    clear();
+    if (objects.empty()) return;
+
+    // The objects are sorted by their position, or by the center of their bounding box
+    auto getObjectBox = [this](const T* object) -> Box {
+        if constexpr (OctreeBoundable<T>) {
+            if (m_insertion == OctreeInsertion::BoundingBox) return object->getBoundingBox();
+        }
+        const Eigen::Array3d position = object->getPosition().array();
+        return Box{position, position};
+    };
+
+    const std::size_t count = objects.size();
+    const std::size_t chunk_count = getChunkCount(thread_pool, count);
+
+    try {
+        // Compute the bounds of the objects
+        const double infinity = std::numeric_limits<double>::infinity();
+        std::vector<Box> chunk_bounds(chunk_count, Box{Eigen::Array3d::Constant(infinity), Eigen::Array3d::Constant(-infinity)});
+        forEachChunk(thread_pool, count, chunk_count, [&](std::size_t chunk, std::size_t begin, std::size_t end) {
+            for (std::size_t i = begin; i < end; ++i) {
+                const Box box = getObjectBox(objects[i]);
+                chunk_bounds[chunk].min = chunk_bounds[chunk].min.min(box.min);
+                chunk_bounds[chunk].max = chunk_bounds[chunk].max.max(box.max);
+            }
+        });
+
+        Box bounds = chunk_bounds.front();
+        for (const Box& chunk_box : chunk_bounds) {
+            bounds.min = bounds.min.min(chunk_box.min);
+            bounds.max = bounds.max.max(chunk_box.max);
+        }
+
+        // The root is centered on the objects, its size grows like when the octree is expanded by `insert`.
+        // With a cost model, it fits the objects
+        const double extent = (bounds.max - bounds.min).maxCoeff();
+        double root_size = m_initial_size;
+        if (m_cost_model && extent > 0) {
+            root_size = extent;
+        } else {
+            while (root_size < extent) root_size *= 2;
+        }
+
+        m_nodes.clear();
+        m_root = m_nodes.create(((bounds.min + bounds.max) / 2).matrix(), root_size, 0, 0);
+
+        // Sort the objects along the Morton curve of the root
+        const Box cube = m_root->getBoundingBox();
+        std::vector<MortonKey> keys(count);
+        forEachChunk(thread_pool, count, chunk_count, [&](std::size_t, std::size_t begin, std::size_t end) {
+            for (std::size_t i = begin; i < end; ++i) {
+                const Box box = getObjectBox(objects[i]);
+                keys[i] = MortonKey{getMortonCode(((box.min + box.max) / 2).matrix(), cube), static_cast<std::uint32_t>(i)};
+            }
+        });
+        sortMortonKeys(keys, thread_pool);
+
+        // With bounding box insertion, the objects overlapping several children are referenced by each of them
+        if constexpr (OctreeBoundable<T>) {
+            if (m_insertion == OctreeInsertion::BoundingBox) {
+                m_root->data.reserve(count);
+                for (const MortonKey& key : keys) {
+                    m_root->data.push_back(objects[key.index]);
+                }
+
+                if (shouldSubdivideBoundingBox(m_root)) {
+                    splitTopDown(std::vector<Node*>{m_root}, thread_pool, [this](Node* node, NodeAllocator<Node>& nodes, std::vector<Node*>& split_nodes) {
+                        splitBoundingBox(node, nodes, split_nodes);
+                    });
+                }
+                return;
+            }
+        }
+
+        // With position insertion, the keys of the children of a node are consecutive ranges of the keys of the node
+        splitTopDown(std::vector<MortonRange>{MortonRange{m_root, 0, count, 0}}, thread_pool,
+                     [&](const MortonRange& range, NodeAllocator<Node>& nodes, std::vector<MortonRange>& split_ranges) {
+            Node* node = range.node;
+            if (range.count <= m_max_neighbors) {
+                node->data.reserve(m_max_neighbors);
+                for (std::size_t i = range.begin; i < range.begin + range.count; ++i) {
+                    node->data.push_back(objects[keys[i].index]);
+                }
+                return;
+            }
+
+            // With a cost model, the objects that cannot be separated stay together: at the maximum depth, or sharing a Morton code
+            const bool inseparable = node->depth >= m_max_depth || range.level >= MORTON_LEVELS ||
+                                     keys[range.begin].code == keys[range.begin + range.count - 1].code;
+            if (m_cost_model && inseparable) {
+                node->data.reserve(range.count);
+                for (std::size_t i = range.begin; i < range.begin + range.count; ++i) {
+                    node->data.push_back(objects[keys[i].index]);
+                }
+                return;
+            }
+
+            if (node->depth >= m_max_depth || range.level >= MORTON_LEVELS) {
+                throw std::length_error("Cannot build octree: More than " + std::to_string(m_max_neighbors) + " objects in a leaf at maximum octree depth (" + std::to_string(m_max_depth) + ").");
+            }
+
+            addChildrenToNode(node, nodes);
+            node->total_children_depth = 1;
+
+            const std::size_t end = range.begin + range.count;
+            for (std::size_t begin = range.begin; begin < end; ) {
+                const unsigned char octant = getMortonOctant(keys[begin].code, range.level);
+                std::size_t child_end = begin + 1;
+                while (child_end < end && getMortonOctant(keys[child_end].code, range.level) == octant) child_end++;
+
+                split_ranges.push_back(MortonRange{node->children[octant], begin, child_end - begin, range.level + 1});
+                begin = child_end;
+            }
+        });
+    } catch (...) {
+        clear();
+        throw;
+    }
+}
+
+template <OctreeAcceptatble T, template <typename> class NodeAllocator, FlatOctreeNodeLayout FlatNode, std::floating_point Scalar>
+void Octree<T, NodeAllocator, FlatNode, Scalar>::insert(const T* data, bool verbose) {
+    restoreNodes();
+    m_finalized = false; // The flat layout must be compiled again
+
+    // With bounding box insertion, reference the object in every leaf that its bounding box overlaps
+    if (m_insertion == OctreeInsertion::BoundingBox) {
+        if constexpr (OctreeBoundable<T>) {
+            const Box box = data->getBoundingBox();
+            if (verbose) std::cout << "Inserting data with bounding box: " << box.min.transpose() << ", " << box.max.transpose() << std::endl;
+
+            if (!expandRoot(box, verbose)) {
+                throw std::length_error("Cannot insert data: Bounding box still outside the bounding box of the octree root after maximum depth (" + std::to_string(m_max_depth) + ") reached.");
+            }
+            insertBoundingBox(m_root, data, box);
+        }
+        return;
+    }
+
+    Eigen::Vector3d position = data->getPosition(); // Get the position of the data to be inserted
+    if (verbose) std::cout << "Inserting data at position: " << position.transpose() << std::endl;
+
+    // If the position is outside the bounding box, expand the octree
+    if (!expandRoot(Box{position.array(), position.array()}, verbose)) {
         // If the position is still outside the bounding box, we cannot insert it
         throw std::length_error("Cannot insert data: Position still outside the bounding box of the octree root after maximum depth (" + std::to_string(m_max_depth) + ") reached.");
         return;
@@ -84,16 +388,25 @@ void Octree<T>::insert(const T* data, bool verbose) {
     unsigned char branch_index = 0; // Value between 0 and 7 (111) representing the octant in which the position lies
     Node* current_node = m_root;
     while (current_node->depth <= m_max_depth) {
+        current_node->modified = true;
         if (verbose) std::cout << "Current node position: " << current_node->position.transpose() << ", depth: " << current_node->depth << ", total children depth: " << current_node->total_children_depth << std::endl;
 
         // Check if the current node is a leaf node
         if (current_node->total_children_depth == 0) {
             if (verbose) std::cout << "Current node is a leaf node." << std::endl;
+            // With a cost model, a leaf whose objects cannot be separated from the new one keeps them all
+            const bool inseparable = m_cost_model && (current_node->depth >= m_max_depth ||
+                std::all_of(current_node->data.begin(), current_node->data.end(), [&](const T* existing_data) {
+                    return existing_data->getPosition() == position;
+                }));
+
             // If the current node is a leaf, check if it can accommodate the new data
-            if (current_node->data.size() < m_max_neighbors) {
+            if (current_node->data.size() < m_max_neighbors || inseparable) {
                 if (verbose) std::cout << "Current node has space for new data." << std::endl;
-                // If there is space, add the data to the current node
+                // If there is space, add the data to the current node, allocating room for a full leaf at once
+                if (current_node->data.empty()) current_node->data.reserve(m_max_neighbors);
                 current_node->data.push_back(data);
+                addLocation(data, current_node);
                 break; // Data inserted successfully
             } 
             
@@ -106,17 +419,19 @@ void Octree<T>::insert(const T* data, bool verbose) {
                 while(current_subdivision->data.size() >= m_max_neighbors && current_subdivision->depth < m_max_depth) {
                     if (verbose) std::cout << "Subdividing node at position: " << current_subdivision->position.transpose() << ", depth: " << current_subdivision->depth << " and size: " << current_subdivision->size << std::endl;
                     // Create child nodes
-                    addChildrenToNode(current_subdivision);
+                    addChildrenToNode(current_subdivision, m_nodes);
 
                     // Redistribute existing data to the new children
                     for (const T* existing_data : current_subdivision->data) {
                         unsigned char index = getBranchIndex(existing_data->getPosition(), current_subdivision->position);
-                        current_subdivision->children[index]->data.push_back(existing_data);
+                        std::vector<const T*>& child_data = current_subdivision->children[index]->data;
+                        if (child_data.empty()) child_data.reserve(m_max_neighbors);
+                        child_data.push_back(existing_data);
                     }
 
                     // Set the current node to not be a leaf anymore
                     current_subdivision->total_children_depth = 1; // Set the total children depth to 1 after subdivision
-                    current_subdivision->data.clear(); // Clear the data in the leaf after redistribution
+                    std::vector<const T*>().swap(current_subdivision->data); // Release the data of the leaf after redistribution
 
                     // Move to the child node where we will insert the new data
                     branch_index = getBranchIndex(position, current_subdivision->position);
@@ -124,9 +439,10 @@ void Octree<T>::insert(const T* data, bool verbose) {
                 }
 
                 // Now we can insert the new data into the appropriate child node if it is not full
-                if (current_subdivision->data.size() < m_max_neighbors) {
+                if (current_subdivision->data.size() < m_max_neighbors || m_cost_model) {
                     if (verbose) std::cout << "Inserting data into subdivided node at position: " << current_subdivision->position.transpose() << ", depth: " << current_subdivision->depth << " and size: " << current_subdivision->size << std::endl;
                     current_subdivision->data.push_back(data);
+                    addLocation(data, current_subdivision);
                     break; // Data inserted successfully
                 }
                 else {
@@ -160,22 +476,346 @@ void Octree<T>::insert(const T* data, bool verbose) {
     }
 }
 
-template <OctreeAcceptatble T>
-const T* Octree<T>::traceRay(const Ray& ray, double& hit_distance, double max_distance) const {
+template <OctreeAcceptatble T, template <typename> class NodeAllocator, FlatOctreeNodeLayout FlatNode, std::floating_point Scalar>
+bool Octree<T, NodeAllocator, FlatNode, Scalar>::remove(const T* data) {
+    restoreNodes();
+    if (!m_tracking_locations) trackLocations();
+
+    auto location = m_locations.find(data);
+    if (location == m_locations.end()) return false;
+
+    const Box region = location->second;
+    m_locations.erase(location);
+    m_finalized = false; // The flat layout must be compiled again
+
+    if (m_root->getBoundingBox().overlaps(region)) removeFromNode(m_root, data, region);
+    return true;
+}
+
+template <OctreeAcceptatble T, template <typename> class NodeAllocator, FlatOctreeNodeLayout FlatNode, std::floating_point Scalar>
+void Octree<T, NodeAllocator, FlatNode, Scalar>::update(const T* data) {
+    restoreNodes();
+    if (!m_tracking_locations) trackLocations();
+
+    auto location = m_locations.find(data);
+    if (location == m_locations.end()) {
+        throw std::invalid_argument("Cannot update data: The object is not in the octree.");
+    }
+    const Box previous_location = location->second;
+
+    remove(data);
+    try {
+        insert(data);
+    } catch (...) {
+        // Put the object back where it was, so that it is not lost by the octree
+        restoreLocation(data, previous_location);
+        throw;
+    }
+}
+
+template <OctreeAcceptatble T, template <typename> class NodeAllocator, FlatOctreeNodeLayout FlatNode, std::floating_point Scalar>
+void Octree<T, NodeAllocator, FlatNode, Scalar>::restoreLocation(const T* data, const Box& location) {
+    // With Position insertion, the object goes back to the single leaf holding the center of its previous leaf
+    if (m_insertion == OctreeInsertion::Position) {
+        const Eigen::Vector3d center = ((location.min + location.max) / 2).matrix();
+        Node* node = m_root;
+        while (node->total_children_depth > 0) {
+            node->modified = true;
+            node = node->children[getBranchIndex(center, node->position)];
+        }
+        node->modified = true;
+        node->data.push_back(data);
+        addLocation(data, node);
+        return;
+    }
+
+    // With BoundingBox insertion, it goes back to every leaf inside the region of its previous leaves.
+    // The leaves only touching the region are not in it, and the leaves are not split again
+    std::vector<Node*> stack{m_root};
+    while (!stack.empty()) {
+        Node* node = stack.back();
+        stack.pop_back();
+        node->modified = true;
+
+        if (node->total_children_depth > 0) {
+            for (Node* child : node->children) {
+                const Box child_box = child->getBoundingBox();
+                if ((child_box.min < location.max).all() && (location.min < child_box.max).all()) stack.push_back(child);
+            }
+            continue;
+        }
+        node->data.push_back(data);
+        addLocation(data, node);
+    }
+}
+
+template <OctreeAcceptatble T, template <typename> class NodeAllocator, FlatOctreeNodeLayout FlatNode, std::floating_point Scalar>
+void Octree<T, NodeAllocator, FlatNode, Scalar>::trackLocations() {
+    m_locations.clear();
+    m_tracking_locations = true;
+
+    std::vector<const Node*> stack{m_root};
+    while (!stack.empty()) {
+        const Node* node = stack.back();
+        stack.pop_back();
+
+        if (node->total_children_depth > 0) {
+            for (const Node* child : node->children) stack.push_back(child);
+            continue;
+        }
+        for (const T* data : node->data) {
+            addLocation(data, node);
+        }
+    }
+}
+
+template <OctreeAcceptatble T, template <typename> class NodeAllocator, FlatOctreeNodeLayout FlatNode, std::floating_point Scalar>
+void Octree<T, NodeAllocator, FlatNode, Scalar>::addLocation(const T* data, const Node* leaf) {
+    if (!m_tracking_locations) return;
+
+    // With BoundingBox insertion, the region grows with each leaf referencing the object
+    auto [location, inserted] = m_locations.try_emplace(data, leaf->getBoundingBox());
+    if (!inserted) location->second.extend(leaf->getBoundingBox());
+}
+
+template <OctreeAcceptatble T, template <typename> class NodeAllocator, FlatOctreeNodeLayout FlatNode, std::floating_point Scalar>
+bool Octree<T, NodeAllocator, FlatNode, Scalar>::removeFromNode(Node* node, const T* data, const Box& location) {
+    // A leaf references an object at most once
+    if (node->total_children_depth == 0) {
+        auto position = std::find(node->data.begin(), node->data.end(), data);
+        if (position == node->data.end()) return false;
+        node->data.erase(position);
+        node->modified = true;
+        return true;
+    }
+
+    // The leaves splitting the region are in the children it overlaps
+    bool removed = false;
+    for (int i = 0; i < 8; ++i) {
+        if (node->children[i]->getBoundingBox().overlaps(location)) removed |= removeFromNode(node->children[i], data, location);
+    }
+
+    // The merges go up the tree as the recursion unwinds, a merged node can make its parent underfull in turn
+    if (removed) {
+        node->modified = true;
+        mergeChildren(node);
+    }
+    return removed;
+}
+
+template <OctreeAcceptatble T, template <typename> class NodeAllocator, FlatOctreeNodeLayout FlatNode, std::floating_point Scalar>
+void Octree<T, NodeAllocator, FlatNode, Scalar>::mergeChildren(Node* node) {
+    std::size_t reference_count = 0;
+    for (const Node* child : node->children) {
+        if (child->total_children_depth > 0) return;
+        reference_count += child->data.size();
+    }
+    if (m_insertion == OctreeInsertion::Position && reference_count > m_max_neighbors) return;
+
+    // With BoundingBox insertion, an object overlapping several children is counted once.
+    // With a cost model, the children are kept as long as they are cheaper than the merged leaf
+    const std::size_t max_merged = m_cost_model ? reference_count : m_max_neighbors;
+    std::vector<const T*> merged_data;
+    merged_data.reserve(std::min<std::size_t>(reference_count, max_merged));
+    for (const Node* child : node->children) {
+        for (const T* data : child->data) {
+            if (std::find(merged_data.begin(), merged_data.end(), data) != merged_data.end()) continue;
+            if (merged_data.size() == max_merged) return;
+            merged_data.push_back(data);
+        }
+    }
+    if (m_cost_model && m_insertion == OctreeInsertion::BoundingBox && m_cost_model->shouldSplit(merged_data.size(), reference_count)) return;
+
+    // The node becomes a leaf again, its children are kept for the next split
+    node->data = std::move(merged_data);
+    node->total_children_depth = 0;
+    std::array<Node*, 8> released_children;
+    for (int i = 0; i < 8; ++i) {
+        std::vector<const T*>().swap(node->children[i]->data);
+        released_children[i] = node->children[i];
+        node->children[i] = nullptr;
+    }
+    m_free_children.push_back(released_children);
+}
+
+template <OctreeAcceptatble T, template <typename> class NodeAllocator, FlatOctreeNodeLayout FlatNode, std::floating_point Scalar>
+void Octree<T, NodeAllocator, FlatNode, Scalar>::finalize() {
+    ensureFinalized();
+}
+
+template <OctreeAcceptatble T, template <typename> class NodeAllocator, FlatOctreeNodeLayout FlatNode, std::floating_point Scalar>
+void Octree<T, NodeAllocator, FlatNode, Scalar>::ensureFinalized() const {
+    if (m_finalized) return;
+
+    std::lock_guard<std::mutex> lock(m_finalize_mutex);
+    if (m_finalized) return; // Another thread compiled the layout while we were waiting
+
+    // Patch the flat layout where the nodes changed since the last compilation, then forget the changes
+    const bool compiled_all = m_flat_octree.update(m_root, m_insertion);
+    std::vector<Node*> stack{m_root};
+    while (!stack.empty()) {
+        Node* node = stack.back();
+        stack.pop_back();
+        if (!node->modified && !compiled_all) continue;
+
+        node->modified = false;
+        if (node->total_children_depth > 0) stack.insert(stack.end(), std::begin(node->children), std::end(node->children));
+    }
+    m_finalized = true;
+}
+
+template <OctreeAcceptatble T, template <typename> class NodeAllocator, FlatOctreeNodeLayout FlatNode, std::floating_point Scalar>
+const FlatOctree<T, FlatNode, Scalar>& Octree<T, NodeAllocator, FlatNode, Scalar>::getFlatOctree() const {
+    ensureFinalized();
+    return m_flat_octree;
+}
+
+template <OctreeAcceptatble T, template <typename> class NodeAllocator, FlatOctreeNodeLayout FlatNode, std::floating_point Scalar>
+void Octree<T, NodeAllocator, FlatNode, Scalar>::save(const std::string& path, std::span<const T* const> objects) const {
+    // A loaded octree has no pointer-based nodes yet: its flat layout is the content of the file, saved as it is
+    if (m_restore_pending) {
+        m_flat_octree.save(path, objects);
+        return;
+    }
+
+    ensureFinalized();
+    if (m_flat_octree.isCompact()) {
+        m_flat_octree.save(path, objects);
+        return;
+    }
+
+    // The nodes and the objects replaced by the updates are not saved: a copy of the flat layout is compiled again without them,
+    // as the queries running alongside read the shared one without locking
+    FlatOctree<T, FlatNode, Scalar> compiled_octree;
+    compiled_octree.build(m_root, m_insertion);
+    compiled_octree.save(path, objects);
+}
+
+template <OctreeAcceptatble T, template <typename> class NodeAllocator, FlatOctreeNodeLayout FlatNode, std::floating_point Scalar>
+void Octree<T, NodeAllocator, FlatNode, Scalar>::load(const std::string& path, std::span<const T* const> objects) {
+    FlatOctree<T, FlatNode, Scalar> flat_octree;
+    flat_octree.load(path, objects);
+
+    if (flat_octree.getInsertion() != m_insertion) {
+        throw std::invalid_argument("Cannot load octree from " + path + ": The octree was saved with another insertion mode.");
+    }
+
+    // The children come after their parent in the node array, so a single pass finds the depth of every node
+    const std::span<const FlatNode> nodes = flat_octree.getNodes();
+    std::vector<std::pair<std::uint32_t, unsigned int>> stack{{0, 0}};
+    while (!stack.empty()) {
+        const auto [node_index, depth] = stack.back();
+        stack.pop_back();
+        if (depth > m_max_depth) {
+            throw std::invalid_argument("Cannot load octree from " + path + ": The octree is deeper than the maximum depth (" + std::to_string(m_max_depth) + ").");
+        }
+        for (unsigned char i = 0; i < 8; ++i) {
+            if (nodes[node_index].hasChild(i)) stack.emplace_back(nodes[node_index].getChild(i), depth + 1);
+        }
+    }
+
+    clear();
+    m_flat_octree = std::move(flat_octree);
+    m_finalized = true;
+    m_restore_pending = true;
+}
+
+template <OctreeAcceptatble T, template <typename> class NodeAllocator, FlatOctreeNodeLayout FlatNode, std::floating_point Scalar>
+void Octree<T, NodeAllocator, FlatNode, Scalar>::restoreNodes() {
+    if (!m_restore_pending) return;
+    m_restore_pending = false;
+
+    // The subtrees without objects were not compiled: they become empty leaves, as the children created by a split
+    const std::span<const FlatNode> nodes = m_flat_octree.getNodes();
+    const std::vector<const T*>& primitives = m_flat_octree.getPrimitives();
+    m_nodes.clear();
+    m_root = m_nodes.create(m_flat_octree.getRootCenter(), 2 * m_flat_octree.getRootHalfSize(), 0, 0);
+
+    std::vector<std::pair<std::uint32_t, Node*>> stack{{0, m_root}};
+    while (!stack.empty()) {
+        const auto [node_index, node] = stack.back();
+        stack.pop_back();
+
+        const FlatNode& flat_node = nodes[node_index];
+        if (flat_node.isLeaf()) {
+            node->data.assign(primitives.begin() + flat_node.getFirst(), primitives.begin() + flat_node.getFirst() + flat_node.getCount());
+            continue;
+        }
+
+        addChildrenToNode(node, m_nodes);
+        node->total_children_depth = 1;
+        for (unsigned char i = 0; i < 8; ++i) {
+            if (flat_node.hasChild(i)) stack.emplace_back(flat_node.getChild(i), node->children[i]);
+        }
+    }
+}
+
+template <OctreeAcceptatble T, template <typename> class NodeAllocator, FlatOctreeNodeLayout FlatNode, std::floating_point Scalar>
+template <std::floating_point RayScalar>
+const T* Octree<T, NodeAllocator, FlatNode, Scalar>::traceRay(const BasicRay<RayScalar>& ray, RayScalar& hit_distance, std::type_identity_t<RayScalar> max_distance) const {
     hit_distance = max_distance;
-    return m_root->traceRay(ray, hit_distance); // Start tracing the ray from the root node
+    return getFlatOctree().traceRay(ray, hit_distance); // Start tracing the ray from the root node
+}
+
+template <OctreeAcceptatble T, template <typename> class NodeAllocator, FlatOctreeNodeLayout FlatNode, std::floating_point Scalar>
+template <int N>
+std::array<const T*, N> Octree<T, NodeAllocator, FlatNode, Scalar>::traceRays(const RayPacket<N>& packet, typename RayPacket<N>::Lanes& hit_distances,
+                                                            double max_distance) const {
+    hit_distances.setConstant(max_distance);
+    return getFlatOctree().traceRays(packet, hit_distances);
+}
+
+template <OctreeAcceptatble T, template <typename> class NodeAllocator, FlatOctreeNodeLayout FlatNode, std::floating_point Scalar>
+void Octree<T, NodeAllocator, FlatNode, Scalar>::cullFrustum(std::span<const Plane> planes, unsigned char signs, OctreeEntryPoints& entry_points,
+                                                             std::size_t max_nodes) const {
+    getFlatOctree().cull(FrustumRegion{planes}, signs, entry_points, max_nodes);
+}
+
+template <OctreeAcceptatble T, template <typename> class NodeAllocator, FlatOctreeNodeLayout FlatNode, std::floating_point Scalar>
+const T* Octree<T, NodeAllocator, FlatNode, Scalar>::traceRay(const Ray& ray, double& hit_distance, const OctreeEntryPoints& entry_points,
+                                                              double max_distance) const {
+    hit_distance = max_distance;
+    return getFlatOctree().traceRay(ray, hit_distance, entry_points);
+}
+
+template <OctreeAcceptatble T, template <typename> class NodeAllocator, FlatOctreeNodeLayout FlatNode, std::floating_point Scalar>
+template <int N>
+std::array<const T*, N> Octree<T, NodeAllocator, FlatNode, Scalar>::traceRays(const RayPacket<N>& packet, typename RayPacket<N>::Lanes& hit_distances,
+                                                                              const OctreeEntryPoints& entry_points, double max_distance) const {
+    hit_distances.setConstant(max_distance);
+    return getFlatOctree().traceRays(packet, hit_distances, entry_points);
+}
+
+template <OctreeAcceptatble T, template <typename> class NodeAllocator, FlatOctreeNodeLayout FlatNode, std::floating_point Scalar>
+std::vector<const T*> Octree<T, NodeAllocator, FlatNode, Scalar>::traceRayStream(std::span<const Ray> rays, std::span<double> hit_distances,
+                                                               double max_distance) const {
+    if (hit_distances.size() != rays.size()) {
+        throw std::invalid_argument("There must be one hit distance per ray.");
+    }
+    std::fill(hit_distances.begin(), hit_distances.end(), max_distance);
+    return getFlatOctree().traceRayStream(rays, hit_distances);
+}
+
+template <OctreeAcceptatble T, template <typename> class NodeAllocator, FlatOctreeNodeLayout FlatNode, std::floating_point Scalar>
+template <std::floating_point RayScalar>
+bool Octree<T, NodeAllocator, FlatNode, Scalar>::occluded(const BasicRay<RayScalar>& ray, std::type_identity_t<RayScalar> max_distance) const {
+    return getFlatOctree().occluded(ray, max_distance);
 }
 
-/// Uses Sorted Sibling Traversal to trace a ray through the octree and detect the first object hit by the ray.
-///     Inspired from https://bertolami.com/files/octrees.pdf
 template <OctreeAcceptatble T>
-const T* OctreeNode<T>::traceRay(const Ray& ray, double& closest_collision_distance) {
-    // If the ray does not intersect the current bounding box, stop tracing
-    double box_collision_distance;
-    if (!getBoundingBox().intersect(ray, box_collision_distance)) return nullptr;
+const T* OctreeNode<T>::traceRay(const Ray& ray, double& closest_collision_distance, OctreeInsertion insertion) const {
+    const unsigned char signs = getDirectionOctant(ray.getDirection());
+    return traceNode(ray, getNodeSlabs(position, m_half_size, ray, signs), signs, closest_collision_distance, insertion);
+}
 
-    // If the intersection distance is greater than the closest collision distance, stop tracing
-    if (box_collision_distance > closest_collision_distance) return nullptr;
+/// Uses the parametric traversal of Revelles et al. to trace a ray through the octree and detect the first object hit by the ray.
+///     See http://wscg.zcu.cz/wscg2000/Papers_2000/X31.pdf
+template <OctreeAcceptatble T>
+const T* OctreeNode<T>::traceNode(const Ray& ray, const NodeSlabs& slabs, unsigned char signs, double& closest_collision_distance,
+                                  OctreeInsertion insertion) const {
+    // If the ray does not cross the node before the closest collision, stop tracing
+    const double enter_distance = std::max(slabs.getEnterDistance(), 0.0);
+    if (enter_distance > slabs.getExitDistance() || enter_distance > closest_collision_distance) return nullptr;
 
     // Initialize the closest collision to nullptr
     const T* closest_collision = nullptr;
@@ -197,87 +837,144 @@ const T* OctreeNode<T>::traceRay(const Ray& ray, double& closest_collision_dista
         return closest_collision; // Return the closest object hit by the ray, or nullptr if no object was hit
     }
 
-    // If the current node is not a leaf, traverse its children
-    else {
-        // Check the collision with the planes of the current node
-        double plane_collision_distances[3];
-        bool plane_collisions[3] = {
-            m_plane_xy.intersect(ray, plane_collision_distances[0]), // Check intersection with the XY plane
-            m_plane_xz.intersect(ray, plane_collision_distances[1]), // Check intersection with the XZ plane
-            m_plane_yz.intersect(ray, plane_collision_distances[2])  // Check intersection with the YZ plane
-        };
-        
-        // Fill in the indices vector with the indices of the planes that were hit 
-        //      AND are close enough to the ray origin to avoid checking collisions that are too far away
-        m_plane_indices.clear(); // Clear the vector to ensure it is empty before filling it
-        double max_collision_distance = (ray.getOrigin() - position).norm() + m_half_size; // Maximum distance to consider for plane collisions
-        for (int i = 0; i < 3; ++i) {
-            // If the plane was hit and the hit point is close enough, add its index to the vector
-            if (plane_collisions[i] && plane_collision_distances[i] <= max_collision_distance) {
-                m_plane_indices.push_back(i);
+    // If the current node is not a leaf, traverse the children crossed by the ray in the order it goes through them (maximum 4 children):
+    //      the segment of the ray in each child comes from the distances to the planes splitting the node
+    const Eigen::Array3d split_distances = getSplitDistances(position, ray, signs);
+    for (unsigned char child = getFirstChild(split_distances, enter_distance); child < 8;) {
+        const NodeSlabs child_slabs = getChildSlabs(slabs, split_distances, child);
+        const OctreeNode* child_node = children[child ^ signs];
+
+        if (child_node != nullptr) {
+            const T* child_collision = child_node->traceNode(ray, child_slabs, signs, closest_collision_distance, insertion);
+            if (child_collision != nullptr) {
+                closest_collision = child_collision;
+
+                // With Position insertion, the first hit ends the traversal.
+                // With BoundingBox insertion, the hit may lie beyond the child, where an object referenced by the next children
+                //      can be closer: stop only if the ray leaves the child after the hit
+                if (insertion == OctreeInsertion::Position || closest_collision_distance <= child_slabs.getExitDistance()) break;
             }
         }
+        child = getNextChild(child, child_slabs.exit);
+    }
 
-        // Sort the indices of the planes that were hit based on the distance to the ray origin
-        std::sort(m_plane_indices.begin(), m_plane_indices.end(), [&](unsigned char a, unsigned char b) {
-            // Sort the indices based on the distance to the ray origin
-            return plane_collision_distances[a] < plane_collision_distances[b];
-        });
-
-
-        // Get the index of the closest child node to the ray origin
-        unsigned char closest_node_index = getBranchIndex(ray.getOrigin(), position); 
+    return closest_collision; // Return the closest object hit by the ray, or nullptr if no object was hit
+}
 
-        // Traverse the children of the current node (sorted by distance to the ray origin => maximum 4 children to traverse)
-        unsigned char next_plane_index = 0; // Index of the next plane to check
-        for (int i = 0; i < 4; ++i) {
-            // If the current child node is valid, check for collision
-            if (children[closest_node_index] != nullptr) {
-                closest_collision = children[closest_node_index]->traceRay(ray, closest_collision_distance); // Recursively trace the ray in the child node
-                
-                // If a collision was detected in the child node, we can stop tracing
-                if (closest_collision != nullptr) {
-                    break;
-                }
-            }
+template <OctreeAcceptatble T, template <typename> class NodeAllocator, FlatOctreeNodeLayout FlatNode, std::floating_point Scalar>
+void Octree<T, NodeAllocator, FlatNode, Scalar>::queryBox(const Box& box, std::vector<const T*>& results) const {
+    getFlatOctree().query(BoxRegion{box}, results);
+}
 
-            // If we have checked all the planes, we can stop tracing
-            if (next_plane_index >= m_plane_indices.size()) {
-                break;
-            }
+template <OctreeAcceptatble T, template <typename> class NodeAllocator, FlatOctreeNodeLayout FlatNode, std::floating_point Scalar>
+void Octree<T, NodeAllocator, FlatNode, Scalar>::querySphere(const Eigen::Vector3d& center, double radius, std::vector<const T*>& results) const {
+    getFlatOctree().query(SphereRegion{center, radius}, results);
+}
 
-            // Go to the next child node based on the plane index that was first hit by the ray
-            //      ie flip the bit corresponding to a change of node by passing through the current plane
-            closest_node_index ^= (1 << m_plane_indices[next_plane_index]); 
-            next_plane_index++; // Increment the index for the next iteration ie invalidate the current plane
-        }
+template <OctreeAcceptatble T, template <typename> class NodeAllocator, FlatOctreeNodeLayout FlatNode, std::floating_point Scalar>
+void Octree<T, NodeAllocator, FlatNode, Scalar>::queryFrustum(std::span<const Plane> planes, std::vector<const T*>& results) const {
+    getFlatOctree().query(FrustumRegion{planes}, results);
+}
 
-        return closest_collision; // Return the closest object hit by the ray, or nullptr if no object was hit
-    }
+template <OctreeAcceptatble T, template <typename> class NodeAllocator, FlatOctreeNodeLayout FlatNode, std::floating_point Scalar>
+const T* Octree<T, NodeAllocator, FlatNode, Scalar>::nearest(const Eigen::Vector3d& point, Eigen::Vector3d& closest_point, double max_radius) const
+    requires NearestQueryable<T> {
+    return getFlatOctree().nearest(point, max_radius, closest_point);
 }
 
-template <OctreeAcceptatble T>
-void Octree<T>::clear() {
-    // Clear the octree
-    if (m_root) {
-        delete m_root; // Delete the root node, which will recursively delete all child nodes
-        m_root = nullptr; // Set the root to nullptr after deletion
+template <OctreeAcceptatble T, template <typename> class NodeAllocator, FlatOctreeNodeLayout FlatNode, std::floating_point Scalar>
+void Octree<T, NodeAllocator, FlatNode, Scalar>::clear() {
+    // Destroy all the nodes at once, then start again from an empty root
+    m_finalized = false;
+    m_restore_pending = false;
+    m_flat_octree = FlatOctree<T, FlatNode, Scalar>(); // The next query compiles the new nodes from scratch
+    for (std::unique_ptr<NodeAllocator<Node>>& worker_nodes : m_worker_nodes) {
+        worker_nodes->clear();
     }
+    m_nodes.clear();
+    m_free_children.clear();
+    m_locations.clear();
+    m_tracking_locations = false;
+    m_root = m_nodes.create(m_initial_position, m_initial_size, 0, 0);
 }
 
-template <OctreeAcceptatble T>
-void Octree<T>::print() const {
+template <OctreeAcceptatble T, template <typename> class NodeAllocator, FlatOctreeNodeLayout FlatNode, std::floating_point Scalar>
+void Octree<T, NodeAllocator, FlatNode, Scalar>::print(std::ostream& stream) const {
     // Print the octree structure
-    if (m_root) {
-        std::cout << "Octree Root Position: " << m_root->position.transpose() << ", Size: " << m_root->size 
-                  << ", Depth: " << m_root->depth << ", Total Children Depth: " << m_root->total_children_depth 
-                  << std::endl;
-        
-        // Ensure the console output is in UTF-8 format for proper character display
-        SetConsoleOutputCP(CP_UTF8);
-        // m_root->debugPrint("Root Node"); // Print the root node's position and size for debugging purposes
-        m_root->print("", true, "root"); // Call the print method of the root node to print its children and data
+    if (m_restore_pending) {
+        stream << "Octree loaded from a file, with " << m_flat_octree.getNodes().size() << " nodes in its flat layout." << std::endl;
+    } else if (m_root) {
+        stream << "Octree Root Position: " << m_root->position.transpose() << ", Size: " << m_root->size 
+               << ", Depth: " << m_root->depth << ", Total Children Depth: " << m_root->total_children_depth 
+               << std::endl;
+        m_root->print(stream, "", true, "root"); // Call the print method of the root node to print its children and data
     } else {
-        std::cout << "Octree is empty." << std::endl;
+        stream << "Octree is empty." << std::endl;
+    }
+}
+
+template <OctreeAcceptatble T, template <typename> class NodeAllocator, FlatOctreeNodeLayout FlatNode, std::floating_point Scalar>
+OctreeStats Octree<T, NodeAllocator, FlatNode, Scalar>::stats() const {
+    OctreeStats stats;
+    stats.flat_bytes = getFlatOctree().bytes();
+
+    // A ray crossing the root crosses a node with a probability equal to the ratio of their surfaces
+    const OctreeCostModel cost_model = m_cost_model.value_or(OctreeCostModel());
+    auto addNode = [&](std::size_t depth, double probability) {
+        if (stats.nodes_per_depth.size() <= depth) stats.nodes_per_depth.resize(depth + 1, 0);
+        stats.nodes_per_depth[depth]++;
+        stats.traversal_cost += probability * cost_model.traversal_cost;
+    };
+    auto addLeaf = [&](std::size_t object_count, double probability) {
+        std::size_t bucket = 0;
+        while ((std::size_t{1} << bucket) <= object_count) bucket++;
+        if (stats.leaf_occupancy.size() <= bucket) stats.leaf_occupancy.resize(bucket + 1, 0);
+        stats.leaf_occupancy[bucket]++;
+
+        stats.leaf_count++;
+        stats.empty_leaf_count += object_count == 0;
+        stats.reference_count += object_count;
+        stats.traversal_cost += probability * object_count * cost_model.intersection_cost;
+    };
+
+    // An octree loaded from a file only has its flat layout, in which the empty subtrees are not compiled
+    if (m_restore_pending) {
+        const std::span<const FlatNode> nodes = m_flat_octree.getNodes();
+        std::vector<std::tuple<std::uint32_t, std::size_t, double>> stack{{0, 0, 1.0}};
+        while (!stack.empty()) {
+            const auto [node_index, depth, relative_size] = stack.back();
+            stack.pop_back();
+
+            const double probability = relative_size * relative_size;
+            addNode(depth, probability);
+            if (nodes[node_index].isLeaf()) {
+                addLeaf(nodes[node_index].getCount(), probability);
+                continue;
+            }
+            for (unsigned char i = 0; i < 8; ++i) {
+                if (nodes[node_index].hasChild(i)) stack.emplace_back(nodes[node_index].getChild(i), depth + 1, relative_size / 2);
+            }
+        }
+        return stats;
+    }
+
+    std::vector<std::pair<const Node*, std::size_t>> stack{{m_root, 0}};
+    while (!stack.empty()) {
+        const auto [node, depth] = stack.back();
+        stack.pop_back();
+
+        const double relative_size = node->size / m_root->size;
+        const double probability = relative_size * relative_size;
+        addNode(depth, probability);
+        stats.node_bytes += sizeof(Node);
+
+        if (node->total_children_depth > 0) {
+            for (const Node* child : node->children) stack.emplace_back(child, depth + 1);
+            continue;
+        }
+
+        addLeaf(node->data.size(), probability);
+        stats.primitive_bytes += node->data.capacity() * sizeof(const T*);
     }
+    return stats;
 }
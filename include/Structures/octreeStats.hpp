@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Statistics on the shape and the memory of an octree (see Octree::stats), to compare the quality of the trees built for
+// different scenes or parameters.
+struct OctreeStats {
+    /// @brief The number of nodes at each depth, the root being at depth 0
+    std::vector<std::size_t> nodes_per_depth;
+
+    /// @brief The number of leaves, including the empty ones
+    std::size_t leaf_count = 0;
+
+    /// @brief The number of leaves holding no object
+    std::size_t empty_leaf_count = 0;
+
+    /// @brief Histogram of the number of objects per leaf: bucket 0 counts the empty leaves,
+    ///        bucket `k > 0` the leaves holding between 2^(k-1) and 2^k - 1 objects
+    std::vector<std::size_t> leaf_occupancy;
+
+    /// @brief The number of references to objects in the leaves (an object overlapping several leaves is counted in each of them)
+    std::size_t reference_count = 0;
+
+    /// @brief The bytes used by the nodes of the octree
+    std::size_t node_bytes = 0;
+
+    /// @brief The bytes allocated for the lists of objects of the leaves
+    std::size_t primitive_bytes = 0;
+
+    /// @brief The bytes used by the flat layout of the octree, which the queries go through (see FlatOctree)
+    std::size_t flat_bytes = 0;
+
+    /// @brief The expected cost of a ray crossing the root, in units of the costs of the cost model (see OctreeCostModel):
+    ///        each node costs a traversal step and each leaf the intersection of its objects, weighted by the probability
+    ///        that a ray crossing the root crosses the node (the ratio of their surfaces)
+    double traversal_cost = 0;
+
+    /// @brief Get the total number of nodes
+    /// @return The number of interior nodes and leaves
+    std::size_t getNodeCount() const;
+
+    /// @brief Get the share of the leaves holding no object
+    /// @return The number of empty leaves divided by the number of leaves (0 without leaves)
+    double getEmptyLeafRatio() const;
+
+    /// @brief Write the statistics as a JSON object
+    /// @param stream The stream to write to
+    void writeJson(std::ostream& stream) const;
+
+    /// @brief Get the statistics as a JSON object
+    /// @return The JSON text
+    std::string toJson() const;
+};
@@ -1,48 +1,72 @@
 #pragma once
 
+#include <concepts>
+#include <limits>
 #include <Eigen/Dense>
 
-class Ray {
+// A ray whose coordinates are of type 'Scalar': `Ray` (double) for the scene, `RayF` (float) for the single precision structures,
+//  which test twice as many coordinates per SIMD instruction and read half the memory.
+template <std::floating_point Scalar>
+class BasicRay {
+    public:
+        /// @brief The vectors of the ray
+        using Vector3 = Eigen::Matrix<Scalar, 3, 1>;
+
     private:
-        Eigen::Vector3d m_origin;
-        Eigen::Vector3d m_direction;
+        Vector3 m_origin;
+        Vector3 m_direction;
 
-        Eigen::Vector3d m_inv; // Inverse of the direction vector for faster calculations
+        Vector3 m_inv; // Inverse of the direction vector for faster calculations
 
     public:
         /// @brief Constructor for the Ray class
         /// @param origin The origin of the ray (3-dim vector in meters)
         /// @param direction The direction of the ray (3-dim vector in meters)
-        Ray(const Eigen::Vector3d& origin, const Eigen::Vector3d& direction)
-            : m_origin(origin), m_direction(direction.normalized()), m_inv(1.0 / direction.x(), 1.0 / direction.y(), 1.0 / direction.z()) {};
+        /// @note The inverse is taken from the normalized direction, so that the distances along the ray are in meters everywhere
+        BasicRay(const Vector3& origin, const Vector3& direction)
+            : m_origin(origin), m_direction(direction.normalized()), m_inv(1 / m_direction.x(), 1 / m_direction.y(), 1 / m_direction.z()) {};
 
         /// @brief Default constructor for the Ray class
         /// @note Initializes the origin and direction to zero vectors and the inverse to infinity
-        Ray() : m_origin(Eigen::Vector3d::Zero()), 
-            m_direction(Eigen::Vector3d::Zero()), 
-            m_inv(Eigen::Vector3d::Constant(std::numeric_limits<double>::infinity())) {};
+        BasicRay() : m_origin(Vector3::Zero()),
+            m_direction(Vector3::Zero()),
+            m_inv(Vector3::Constant(std::numeric_limits<Scalar>::infinity())) {};
 
 
         /// @brief Get the origin of the ray
         /// @return The origin of the ray as a 3-dim vector in meters
-        inline const Eigen::Vector3d& getOrigin() const { return m_origin; };
+        inline const Vector3& getOrigin() const { return m_origin; };
 
         /// @brief Get the direction of the ray
         /// @return The direction of the ray as a 3-dim vector in meters
-        inline const Eigen::Vector3d& getDirection() const { return m_direction; };
+        inline const Vector3& getDirection() const { return m_direction; };
 
         /// @brief Get the inverse of the direction vector
         /// @return The inverse of the direction vector as a 3-dim vector
-        inline const Eigen::Vector3d& getInverseDirection() const { return m_inv; };
+        inline const Vector3& getInverseDirection() const { return m_inv; };
 
         /// @brief Set the origin of the ray
         /// @param origin The new origin of the ray (3-dim vector in meters)
-        void setOrigin(const Eigen::Vector3d& origin) { m_origin = origin; };
+        void setOrigin(const Vector3& origin) { m_origin = origin; };
 
         /// @brief Set the direction of the ray
         /// @param direction The new direction of the ray (3-dim vector in meters)
-        void setDirection(const Eigen::Vector3d& direction) {
+        void setDirection(const Vector3& direction) {
             m_direction = direction.normalized();
-            m_inv = Eigen::Vector3d(1.0 / m_direction.x(), 1.0 / m_direction.y(), 1.0 / m_direction.z());
+            m_inv = Vector3(1 / m_direction.x(), 1 / m_direction.y(), 1 / m_direction.z());
+        };
+
+        /// @brief Convert the ray to another precision
+        /// @return The same ray, with its origin and direction rounded to the other type (the direction is normalized again)
+        template <std::floating_point Other>
+        BasicRay<Other> cast() const {
+            if constexpr (std::same_as<Other, Scalar>) return *this;
+            else return BasicRay<Other>(m_origin.template cast<Other>(), m_direction.template cast<Other>());
         };
 };
+
+/// @brief The rays of the scene, in double precision
+using Ray = BasicRay<double>;
+
+/// @brief The rays of the single precision structures
+using RayF = BasicRay<float>;
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <array>
+#include <cmath>
+#include <concepts>
+#include <cstdint>
+#include <limits>
+#include <Eigen/Dense>
+
+#include "Structures/box.hpp"
+#include "Structures/ray.hpp"
+
+/// @brief Get the octant towards which a direction goes
+/// @param direction The direction
+/// @return Bit 2 for a negative x, bit 1 for a negative y and bit 0 for a negative z
+/// @note The sign bit is used, so that a direction -0 goes the same way as its inverse -inf.
+/// @note Visiting the children of an octree node in the order `i ^ octant` is front to back for all the rays of the octant.
+template <std::floating_point Scalar>
+inline unsigned char getDirectionOctant(const Eigen::Matrix<Scalar, 3, 1>& direction) {
+    return (std::signbit(direction.x()) ? 4 : 0) | (std::signbit(direction.y()) ? 2 : 0) | (std::signbit(direction.z()) ? 1 : 0);
+}
+
+// A group of N coherent rays, eg the rays of a block of neighboring pixels, traced together through an acceleration structure.
+// The origins and inverse directions are stored axis by axis, so that the slab test of a box runs on all the rays at once:
+// Eigen maps the lanes to the SIMD registers enabled at compile time (2 lanes per SSE2 register, 4 per AVX register).
+// Each lane holds one ray, and the lanes in use are the set bits of `active`.
+template <int N>
+struct RayPacket {
+    static_assert(N == 4 || N == 8, "A ray packet holds 4 or 8 rays.");
+
+    /// @brief One value per lane
+    using Lanes = Eigen::Array<double, N, 1>;
+
+    /// @brief One bit per lane, bit `i` being lane `i`
+    using Mask = std::uint32_t;
+
+    /// @brief The mask of all the lanes
+    static constexpr Mask ALL_LANES = (1u << N) - 1;
+
+    /// @brief The rays of the lanes, nullptr for the lanes not in use
+    std::array<const Ray*, N> rays = {};
+
+    /// @brief The coordinates of the origins of the rays, one array per axis
+    std::array<Lanes, 3> origins = {Lanes::Zero(), Lanes::Zero(), Lanes::Zero()};
+
+    /// @brief The coordinates of the inverse directions of the rays, one array per axis
+    std::array<Lanes, 3> inverse_directions = {Lanes::Zero(), Lanes::Zero(), Lanes::Zero()};
+
+    /// @brief The lanes in use
+    Mask active = 0;
+
+    /// @brief Put a ray in a lane of the packet
+    /// @param lane The index of the lane, between 0 and N - 1
+    /// @param ray The ray, which must outlive the packet
+    void set(unsigned int lane, const Ray& ray) {
+        rays[lane] = &ray;
+        for (int axis = 0; axis < 3; ++axis) {
+            origins[axis][lane] = ray.getOrigin()[axis];
+            inverse_directions[axis][lane] = ray.getInverseDirection()[axis];
+        }
+        active |= 1u << lane;
+    };
+
+    /// @brief Get the octant towards which all the active rays go
+    /// @param signs Set to the octant of the directions (see getDirectionOctant)
+    /// @return false if the active rays go towards different octants
+    bool getDirectionSigns(unsigned char& signs) const {
+        bool first = true;
+        for (int lane = 0; lane < N; ++lane) {
+            if (!(active & (1u << lane))) continue;
+
+            const unsigned char lane_signs = getDirectionOctant(rays[lane]->getDirection());
+            if (first) {
+                signs = lane_signs;
+                first = false;
+            } else if (lane_signs != signs) {
+                return false;
+            }
+        }
+        return true;
+    };
+
+    /// @brief Intersect all the rays of the packet with a box at once, with the same slab test as Box::intersect
+    /// @param box The box to intersect
+    /// @param enter_distances Set to the distance at which each ray enters the box (0 if it starts inside)
+    /// @param exit_distances Set to the distance at which each ray leaves the box
+    /// @return The mask of the lanes whose ray intersects the box, including the lanes not in use
+    Mask intersect(const Box& box, Lanes& enter_distances, Lanes& exit_distances) const {
+        const double infinity = std::numeric_limits<double>::infinity();
+        Lanes tmin = Lanes::Constant(-infinity);
+        Lanes tmax = Lanes::Constant(infinity);
+        for (int axis = 0; axis < 3; ++axis) {
+            const Lanes min_diff = (box.min[axis] - origins[axis]) * inverse_directions[axis];
+            const Lanes max_diff = (box.max[axis] - origins[axis]) * inverse_directions[axis];
+
+            // A ray parallel to an axis and starting on a face of the box gives 0 * inf = NaN, the slab does not clip it
+            const auto on_face = min_diff.isNaN() || max_diff.isNaN();
+            tmin = tmin.max(on_face.select(-infinity, min_diff.min(max_diff)));
+            tmax = tmax.min(on_face.select(infinity, min_diff.max(max_diff)));
+        }
+
+        enter_distances = tmin.max(0.0);
+        exit_distances = tmax;
+        return toMask(tmax >= tmin && tmax >= 0);
+    };
+
+    /// @brief Turn one boolean per lane into a mask
+    /// @param lanes The booleans, or an expression giving them
+    /// @return The mask whose bit `i` is set if lane `i` is true
+    template <typename Booleans>
+    static Mask toMask(const Booleans& lanes) {
+        const Eigen::Array<bool, N, 1> values = lanes;
+        Mask mask = 0;
+        for (int lane = 0; lane < N; ++lane) {
+            mask |= static_cast<Mask>(values[lane]) << lane;
+        }
+        return mask;
+    };
+};
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <concepts>
+#include <span>
+#include <Eigen/Dense>
+
+#include "Structures/box.hpp"
+#include "Structures/plane.hpp"
+
+// @brief How a box lies relative to a region of a range query
+enum class RegionOverlap {
+    Outside, // The box and the region share no point
+    Partial, // The box may share points with the region
+    Inside // The box is entirely inside the region
+};
+
+// Concept QueryRegion: type 'R' is a region of space gathered by a range query (see FlatOctree::query), which has
+//  `.classify` telling how a node of the octree lies relative to the region (see RegionOverlap).
+//  `.contains` checking if a point is in the region.
+//  `.overlaps` checking if a box shares points with the region.
+template<typename R>
+concept QueryRegion = requires(const R region, const Box& box, const Eigen::Vector3d& point) {
+    { region.classify(box) } -> std::same_as<RegionOverlap>;
+    { region.contains(point) } -> std::convertible_to<bool>;
+    { region.overlaps(box) } -> std::convertible_to<bool>;
+};
+
+// @brief An axis-aligned box gathered by a range query
+struct BoxRegion {
+    /// @brief The box
+    Box box;
+
+    /// @brief Check how a box lies relative to the region
+    /// @param other The box to check
+    /// @return Outside if the boxes do not overlap, Inside if the region contains the box, Partial otherwise
+    inline RegionOverlap classify(const Box& other) const {
+        if (!box.overlaps(other)) return RegionOverlap::Outside;
+        return box.contains(other) ? RegionOverlap::Inside : RegionOverlap::Partial;
+    };
+
+    /// @brief Check if a point is in the region (points on its faces included)
+    inline bool contains(const Eigen::Vector3d& point) const { return box.contains(point.array()); };
+
+    /// @brief Check if a box shares points with the region
+    inline bool overlaps(const Box& other) const { return box.overlaps(other); };
+};
+
+// @brief A ball gathered by a range query
+struct SphereRegion {
+    /// @brief The center of the ball
+    Eigen::Vector3d center;
+
+    /// @brief The radius of the ball
+    double radius;
+
+    /// @brief Check how a box lies relative to the region
+    /// @param box The box to check
+    /// @return Outside if the closest point of the box is out of the ball, Inside if its farthest corner is in the ball, Partial otherwise
+    inline RegionOverlap classify(const Box& box) const {
+        if (!overlaps(box)) return RegionOverlap::Outside;
+        const Eigen::Array3d farthest = (center.array() - box.min).abs().max((center.array() - box.max).abs());
+        return farthest.matrix().squaredNorm() <= radius * radius ? RegionOverlap::Inside : RegionOverlap::Partial;
+    };
+
+    /// @brief Check if a point is in the region (points on the sphere included)
+    inline bool contains(const Eigen::Vector3d& point) const { return (point - center).squaredNorm() <= radius * radius; };
+
+    /// @brief Check if a box shares points with the region
+    inline bool overlaps(const Box& box) const {
+        const Eigen::Array3d closest = center.array().max(box.min).min(box.max);
+        return (closest.matrix() - center).squaredNorm() <= radius * radius;
+    };
+};
+
+// @brief A convex region bounded by planes, eg the frustum of a camera, gathered by a range query
+// @details A point is in the region if it lies on the side of every plane towards which its normal points.
+struct FrustumRegion {
+    /// @brief The planes bounding the region, whose normals point inside it (they must outlive the region)
+    std::span<const Plane> planes;
+
+    /// @brief Check how a box lies relative to the region
+    /// @param box The box to check
+    /// @return Outside if the box is behind one of the planes, Inside if it is in front of all of them, Partial otherwise
+    /// @note A box near an edge of the region can be Partial while it is outside: the test is conservative.
+    inline RegionOverlap classify(const Box& box) const {
+        const Eigen::Vector3d center = ((box.min + box.max) / 2).matrix();
+        const Eigen::Vector3d extent = ((box.max - box.min) / 2).matrix();
+        RegionOverlap overlap = RegionOverlap::Inside;
+        for (const Plane& plane : planes) {
+            // The corners of the box farthest along the normal and against it lie `spread` away from the center along the normal:
+            // the first one is the last to leave the region, the second one the first to leave it
+            const double distance = plane.normal.dot(center - plane.point);
+            const double spread = plane.normal.cwiseAbs().dot(extent);
+            if (distance + spread < 0) return RegionOverlap::Outside;
+            if (distance - spread < 0) overlap = RegionOverlap::Partial;
+        }
+        return overlap;
+    };
+
+    /// @brief Check if a point is in the region (points on the planes included)
+    inline bool contains(const Eigen::Vector3d& point) const {
+        for (const Plane& plane : planes) {
+            if (plane.normal.dot(point - plane.point) < 0) return false;
+        }
+        return true;
+    };
+
+    /// @brief Check if a box may share points with the region
+    /// @note The test is conservative, as `classify`.
+    inline bool overlaps(const Box& box) const { return classify(box) != RegionOverlap::Outside; };
+};
@@ -0,0 +1,192 @@
+#pragma once
+
+#include <bit>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+#include <Eigen/Dense>
+
+#include "Structures/ray.hpp"
+#include "Structures/triangleRecord.hpp"
+
+// @brief The instruction sets of the intersection kernels of the triangle blocks (see TriangleBlockArray)
+enum class SimdLevel {
+    Scalar, // One triangle at a time, with TriangleRecord::intersect
+    SSE4, // 4 triangles at a time (SSE4.1)
+    AVX2, // 8 triangles at a time (AVX2)
+    AVX512 // 16 triangles at a time (AVX-512F)
+};
+
+/// @brief Get the best instruction set of the processor, detected once with CPUID
+/// @return Scalar on a processor which is not x86, or if the compiler does not support the SIMD kernels
+SimdLevel getSupportedSimdLevel();
+
+/// @brief Get the instruction set of the kernel currently used by the triangle blocks
+/// @return The best supported level, unless another one is chosen with setTriangleKernelLevel
+SimdLevel getTriangleKernelLevel();
+
+/// @brief Choose the instruction set of the kernel used by every triangle block, eg to compare the kernels
+/// @param level The instruction set to use
+/// @throws std::invalid_argument if the processor does not support the level (see getSupportedSimdLevel)
+/// @note The level must not be changed while rays are traced.
+void setTriangleKernelLevel(SimdLevel level);
+
+/// @brief Get the name of an instruction set, eg "AVX2"
+std::string getSimdLevelName(SimdLevel level);
+
+// @brief The intersection records of up to 16 triangles, transposed (structure of arrays) so that a kernel tests them together
+// @details Lane i of every array holds the data of the i-th triangle of the block (see BasicTriangleRecord).
+//          The 4, 8 or 16 lanes of a SIMD register are loaded from consecutive addresses, aligned on a cache line.
+//          The first points are of type 'Scalar': a block of TriangleRecordF is 576 bytes instead of 768 bytes.
+template <std::floating_point Scalar>
+struct alignas(64) BasicTriangleBlock {
+    /// @brief The number of triangles in a block
+    static constexpr std::size_t SIZE = 16;
+
+    /// @brief The coordinates x, y, z of the first points of the triangles
+    Scalar point0[3][SIZE];
+
+    /// @brief The coordinates x, y, z of the first edges of the triangles
+    float edge1[3][SIZE];
+
+    /// @brief The coordinates x, y, z of the second edges of the triangles
+    float edge2[3][SIZE];
+};
+
+/// @brief The blocks of TriangleRecord
+using TriangleBlock = BasicTriangleBlock<double>;
+
+// @brief A ray as read by the kernels: its origin in the precision of the first points of the triangles, its direction in single precision
+template <std::floating_point Scalar>
+struct TriangleBlockRay {
+    /// @brief The coordinates x, y, z of the origin of the ray
+    Scalar origin[3];
+
+    /// @brief The coordinates x, y, z of the direction of the ray
+    float direction[3];
+
+    /// @brief Round a ray as TriangleRecord::intersect does
+    template <std::floating_point RayScalar>
+    explicit TriangleBlockRay(const BasicRay<RayScalar>& ray)
+        : origin{static_cast<Scalar>(ray.getOrigin().x()), static_cast<Scalar>(ray.getOrigin().y()), static_cast<Scalar>(ray.getOrigin().z())},
+          direction{static_cast<float>(ray.getDirection().x()), static_cast<float>(ray.getDirection().y()), static_cast<float>(ray.getDirection().z())} {};
+};
+
+/// @brief Test a ray against some triangles of a block, with the kernel chosen by setTriangleKernelLevel
+/// @param block The block of triangles
+/// @param lanes The mask of the triangles of the block to test (bit i for the i-th triangle)
+/// @param ray The ray to test
+/// @param distances The distance of the hits, written for the lanes of the returned mask (16 floats)
+/// @return The mask of the tested triangles hit by the ray
+/// @note Every kernel returns the same hits and distances as BasicTriangleRecord::intersect, bit for bit.
+template <std::floating_point Scalar>
+std::uint32_t intersectTriangleBlock(const BasicTriangleBlock<Scalar>& block, std::uint32_t lanes, const TriangleBlockRay<Scalar>& ray, float* distances);
+
+// @brief The intersection records of triangles stored in blocks of 16, tested by the SIMD kernels (see BasicTriangleBlock)
+// @details It is used by the flat octree as the records of its triangles, in the order of its leaves: the triangles of a leaf are
+//          tested together, 4, 8 or 16 at a time depending on the processor. A leaf range starting inside a block is masked.
+template <std::floating_point Scalar>
+class BasicTriangleBlockArray {
+    public:
+        /// @brief The blocks of the array
+        using Block = BasicTriangleBlock<Scalar>;
+
+        /// @brief The records of the array
+        using Record = BasicTriangleRecord<Scalar>;
+
+        BasicTriangleBlockArray() = default;
+        BasicTriangleBlockArray(const BasicTriangleBlockArray&) = default;
+        BasicTriangleBlockArray& operator=(const BasicTriangleBlockArray&) = default;
+
+        /// @brief Move the records, leaving the other array empty
+        BasicTriangleBlockArray(BasicTriangleBlockArray&& other) noexcept
+            : m_blocks(std::move(other.m_blocks)), m_size(std::exchange(other.m_size, 0)) {};
+
+        /// @brief Move the records, leaving the other array empty
+        BasicTriangleBlockArray& operator=(BasicTriangleBlockArray&& other) noexcept {
+            m_blocks = std::move(other.m_blocks);
+            m_size = std::exchange(other.m_size, 0);
+            return *this;
+        };
+
+        /// @brief Get the number of records
+        inline std::size_t size() const { return m_size; };
+
+        /// @brief Remove every record
+        inline void clear() { m_blocks.clear(); m_size = 0; };
+
+        /// @brief Reserve the memory of some records
+        inline void reserve(std::size_t count) { m_blocks.reserve((count + Block::SIZE - 1) / Block::SIZE); };
+
+        /// @brief Append a record after the last one
+        /// @param record The record, rounded to the precision of the array
+        template <std::floating_point RecordScalar>
+        void push_back(const BasicTriangleRecord<RecordScalar>& record) {
+            const std::size_t lane = m_size % Block::SIZE;
+            if (lane == 0) m_blocks.emplace_back(Block{}); // The lanes past the last record stay zero: their triangles are degenerate
+            Block& block = m_blocks.back();
+            for (int axis = 0; axis < 3; ++axis) {
+                block.point0[axis][lane] = static_cast<Scalar>(record.point0[axis]);
+                block.edge1[axis][lane] = record.edge1[axis];
+                block.edge2[axis][lane] = record.edge2[axis];
+            }
+            ++m_size;
+        };
+
+        /// @brief Get a record
+        /// @param index The index of the record, less than size()
+        /// @return A copy of the record, gathered from its block
+        Record operator[](std::size_t index) const {
+            const Block& block = m_blocks[index / Block::SIZE];
+            const std::size_t lane = index % Block::SIZE;
+            return Record{
+                typename Eigen::Matrix<Scalar, 3, 1>(block.point0[0][lane], block.point0[1][lane], block.point0[2][lane]),
+                Eigen::Vector3f(block.edge1[0][lane], block.edge1[1][lane], block.edge1[2][lane]),
+                Eigen::Vector3f(block.edge2[0][lane], block.edge2[1][lane], block.edge2[2][lane])
+            };
+        };
+
+        /// @brief Get the memory used by the blocks, in bytes
+        inline std::size_t bytes() const { return m_blocks.size() * sizeof(Block); };
+
+        /// @brief Test a ray against a range of records, in order
+        /// @tparam HitFunction A function `bool(std::size_t index, float distance)`, returning true to stop the test
+        /// @param ray The ray to test
+        /// @param first The index of the first record of the range
+        /// @param count The number of records of the range
+        /// @param on_hit The function called for every hit record of the range, by increasing index
+        /// @return true if on_hit stopped the test
+        template <std::floating_point RayScalar, typename HitFunction>
+        bool intersect(const BasicRay<RayScalar>& ray, std::size_t first, std::size_t count, HitFunction&& on_hit) const {
+            if (count == 0) return false;
+
+            const TriangleBlockRay<Scalar> block_ray(ray);
+            const std::size_t end = first + count;
+            for (std::size_t block_index = first / Block::SIZE; block_index * Block::SIZE < end; ++block_index) {
+                const std::size_t block_first = block_index * Block::SIZE;
+                std::uint32_t lanes = 0xFFFFu;
+                if (first > block_first) lanes &= 0xFFFFu << (first - block_first);
+                if (end < block_first + Block::SIZE) lanes &= 0xFFFFu >> (block_first + Block::SIZE - end);
+
+                alignas(64) float distances[Block::SIZE];
+                for (std::uint32_t hits = intersectTriangleBlock(m_blocks[block_index], lanes, block_ray, distances); hits != 0; hits &= hits - 1) {
+                    const unsigned lane = std::countr_zero(hits);
+                    if (on_hit(block_first + lane, distances[lane])) return true;
+                }
+            }
+            return false;
+        };
+
+    private:
+        std::vector<Block> m_blocks; // The blocks, the last one holding the records past the last multiple of 16
+        std::size_t m_size = 0; // The number of records
+};
+
+/// @brief The blocks of TriangleRecord
+using TriangleBlockArray = BasicTriangleBlockArray<double>;
+
+/// @brief The blocks of TriangleRecordF
+using TriangleBlockArrayF = BasicTriangleBlockArray<float>;
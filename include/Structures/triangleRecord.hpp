@@ -0,0 +1,90 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <concepts>
+#include <Eigen/Dense>
+
+#include "Structures/ray.hpp"
+
+// @brief The data of a triangle read by its intersection test, precomputed once (see Triangle::getIntersectionRecord)
+// @details The flat octree stores the records of the triangles in the order of its leaves, so that a ray tests the triangles of
+//          a leaf on contiguous memory, without reading the triangles themselves. The records are not updated when a triangle moves.
+//          The edges are stored in single precision, as the barycentric coordinates and the distance of the hits. The first point
+//          is of type 'Scalar': `TriangleRecord` (double, 48 bytes per triangle) or `TriangleRecordF` (float, 36 bytes), whose rays
+//          far from the origin of the scene lose precision.
+template <std::floating_point Scalar>
+struct BasicTriangleRecord {
+    /// @brief The first point of the triangle A, in the global frame
+    Eigen::Matrix<Scalar, 3, 1> point0;
+
+    /// @brief The first edge of the triangle E1 = B - A
+    Eigen::Vector3f edge1;
+
+    /// @brief The second edge of the triangle E2 = C - A
+    Eigen::Vector3f edge2;
+
+    /// @brief Return true if the ray intersects the triangle (Möller-Trumbore algorithm)
+    /// @param R The Ray to test for intersection
+    /// @param u The barycentric coordinate u of the intersection point (IP): IP = A + u * E1 + v * E2
+    /// @param v The barycentric coordinate v of the intersection point (IP): IP = A + u * E1 + v * E2
+    /// @param t The distance from the ray origin to the intersection point (IP): IP = R.Origin + t * R.Dir
+    /// @return true if the Ray intersect the triangle, false otherwise
+    /// @note The rays parallel to the triangle are missed. The division is only computed for the hits.
+    /// @note The origin of a ray of another precision is rounded to the precision of the first point.
+    template <std::floating_point RayScalar>
+    inline bool intersect(const BasicRay<RayScalar>& R, float& u, float& v, float& t) const {
+        const Eigen::Vector3f direction = R.getDirection().template cast<float>();
+        const Eigen::Vector3f P = direction.cross(edge2);
+        const float det = edge1.dot(P); // -D.(E1 x E2), 0 if the ray is parallel to the triangle
+        if (std::fabs(det) < 1e-6f) return false;
+
+        // The barycentric coordinates (u, v, 1-u-v) are computed times det, and checked against det before the division.
+        // They are checked together: most rays miss the triangle, and a single branch is well predicted
+        const float sign = det > 0 ? 1.0f : -1.0f;
+        const Eigen::Vector3f AO = (R.getOrigin().template cast<Scalar>() - point0).template cast<float>();
+        const Eigen::Vector3f Q = AO.cross(edge1);
+        const float u_det = AO.dot(P) * sign;
+        const float v_det = direction.dot(Q) * sign;
+        if (!((u_det >= 0) & (v_det >= 0) & (u_det + v_det <= det * sign))) return false;
+
+        // Calculate the distance from the ray origin to the intersection point
+        const float invdet = 1.0f / det;
+        t = edge2.dot(Q) * invdet;
+        u = u_det * sign * invdet;
+        v = v_det * sign * invdet;
+        return t >= 0;
+    };
+
+    /// @brief Get the barycentric coordinates of a point of the triangle, eg a hit point found by another intersection test
+    /// @param point The point, projected on the plane of the triangle
+    /// @param u The barycentric coordinate u of the point: point = A + u * E1 + v * E2
+    /// @param v The barycentric coordinate v of the point: point = A + u * E1 + v * E2
+    /// @note The coordinates are clamped to the triangle, as a point found by a less precise test can lie slightly out of it.
+    inline void getCoordinates(const Eigen::Matrix<Scalar, 3, 1>& point, float& u, float& v) const {
+        const Eigen::Vector3f AP = (point - point0).template cast<float>();
+        const float d11 = edge1.dot(edge1), d12 = edge1.dot(edge2), d22 = edge2.dot(edge2);
+        const float p1 = AP.dot(edge1), p2 = AP.dot(edge2);
+        const float det = d11 * d22 - d12 * d12;
+        u = det > 0 ? std::max((d22 * p1 - d12 * p2) / det, 0.0f) : 0.0f;
+        v = det > 0 ? std::max((d11 * p2 - d12 * p1) / det, 0.0f) : 0.0f;
+        if (u + v > 1) {
+            const float sum = u + v;
+            u /= sum;
+            v /= sum;
+        }
+    };
+
+    /// @brief Convert the record to another precision
+    /// @return The record with its first point rounded to the other type
+    template <std::floating_point Other>
+    BasicTriangleRecord<Other> cast() const {
+        return BasicTriangleRecord<Other>{point0.template cast<Other>(), edge1, edge2};
+    };
+};
+
+/// @brief The records of the triangles, in double precision
+using TriangleRecord = BasicTriangleRecord<double>;
+
+/// @brief The records of the triangles of the single precision structures
+using TriangleRecordF = BasicTriangleRecord<float>;
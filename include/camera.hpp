@@ -1,11 +1,20 @@
 #pragma once
 
+#include <array>
+#include <cmath>
+#include <concepts>
+#include <limits>
 #include <Eigen/Dense>
 #include <tuple>
+#include <vector>
 #include "sceneObject.hpp"
+#include "Structures/plane.hpp"
 #include "Structures/ray.hpp"
 
-class Camera : public SceneObject {
+// A camera whose rays are of type BasicRay<Scalar>: `Camera` (double) renders the scene, `CameraF` (float) gives the rays
+//  of the single precision structures (see Octree). The pixel positions are computed in double precision in both cases.
+template <std::floating_point Scalar>
+class BasicCamera : public SceneObject {
     private:
         /// @brief The horizontal field of view (in radian)
         double m_horizontalFOV;
@@ -40,7 +49,7 @@ class Camera : public SceneObject {
 
         /// @brief A vector of rays, each ray corresponds to a pixel in the frame
         /// @note The vector is of size (horizontalResolution * verticalResolution)
-        std::vector<Ray> m_rays;
+        std::vector<BasicRay<Scalar>> m_rays;
 
         /// @brief A method to update the rays that leave the camera and go through each pixel in the frame
         /// @note The rays are updated based on the camera position, orientation, and pixel positions
@@ -53,7 +62,7 @@ class Camera : public SceneObject {
         /// @param horizontalResolution The horizontal resolution (in number of pixels)
         /// @param verticalResolution The vertical field of vue (in number of pixels)
         /// @param distance The distance between the eye and the projection plane (in meters)
-        Camera(Eigen::Vector3d position, double horizontalFOV, double verticalFOV,
+        BasicCamera(Eigen::Vector3d position, double horizontalFOV, double verticalFOV,
                 const unsigned int horizontalResolution, const unsigned int verticalResolution, double projectionDistance);
 
 
@@ -104,10 +113,28 @@ class Camera : public SceneObject {
         /// @param i The vertical index of the pixel in the frame
         /// @param j The horizontal index of the pixel in the frame
         /// @return The corresponding Ray (custom object)
-        const Ray& getRay(const int i, const int j) const;
+        const BasicRay<Scalar>& getRay(const int i, const int j) const;
 
         /// @brief A method to get all the rays that leave the camera and go through each pixel in the frame
         /// @return A vector of rays, each ray corresponds to a pixel in the frame
         /// @note The vector is of size (horizontalResolution * verticalResolution)
-        const std::vector<Ray>& getRays() const;
+        const std::vector<BasicRay<Scalar>>& getRays() const;
+
+        /// @brief A method to get the frustum containing the rays that go through a rectangle of pixels, eg a tile of the render
+        /// @param first_row The first row of the rectangle
+        /// @param first_column The first column of the rectangle
+        /// @param last_row The row after the last one of the rectangle
+        /// @param last_column The column after the last one of the rectangle
+        /// @return The 4 planes going through the camera and the sides of the rectangle, whose normals point inside the frustum
+        /// @note The sides bound the pixels of the rectangle on the projection plane, widened by half a pixel: the frustum contains
+        ///       their rays with a margin, and it is not flat for a single row or column.
+        std::array<Plane, 4> getFrustum(unsigned int first_row, unsigned int first_column, unsigned int last_row, unsigned int last_column) const;
 };
+
+/// @brief The camera of the scene, in double precision
+using Camera = BasicCamera<double>;
+
+/// @brief A camera giving the rays of the single precision structures
+using CameraF = BasicCamera<float>;
+
+#include "camera.tpp"
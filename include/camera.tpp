@@ -1,6 +1,5 @@
-#include "camera.hpp"
-
-Camera::Camera(Eigen::Vector3d position, double horizontalFOV, double verticalFOV, 
+template <std::floating_point Scalar>
+BasicCamera<Scalar>::BasicCamera(Eigen::Vector3d position, double horizontalFOV, double verticalFOV, 
                 const unsigned int horizontalResolution, const unsigned int verticalResolution, double projectionDistance) :
     SceneObject(position, Eigen::Vector3d::UnitY(), Eigen::Vector3d::UnitZ()),
     m_horizontalFOV(horizontalFOV), 
@@ -19,7 +18,8 @@ Camera::Camera(Eigen::Vector3d position, double horizontalFOV, double verticalFO
     updateRays();
 }
 
-void Camera::updatePixelPositions() {
+template <std::floating_point Scalar>
+void BasicCamera<Scalar>::updatePixelPositions() {
     Eigen::Vector3d center_screen_position = (m_position + getForward() * m_distance);
 
     Eigen::ArrayXd Rows(m_verticalResolution * m_horizontalResolution), Cols(m_verticalResolution * m_horizontalResolution);
@@ -52,27 +52,62 @@ void Camera::updatePixelPositions() {
     // }
 }
 
-void Camera::updateRays() {
-    for(int i(0); i<m_verticalResolution; ++i) {
-        for(int j(0); j<m_horizontalResolution; ++j) {
-            m_rays[i * m_horizontalResolution + j].setOrigin(m_position);
-            m_rays[i * m_horizontalResolution + j].setDirection(getPositionPixel(i, j) - m_position);
+template <std::floating_point Scalar>
+void BasicCamera<Scalar>::updateRays() {
+    for(unsigned int i(0); i<m_verticalResolution; ++i) {
+        for(unsigned int j(0); j<m_horizontalResolution; ++j) {
+            m_rays[i * m_horizontalResolution + j].setOrigin(m_position.template cast<Scalar>());
+            m_rays[i * m_horizontalResolution + j].setDirection((getPositionPixel(i, j) - m_position).template cast<Scalar>());
         }
     }
 }
 
-const std::tuple<const int, const int> Camera::getDimensions() const {
+template <std::floating_point Scalar>
+const std::tuple<const int, const int> BasicCamera<Scalar>::getDimensions() const {
     return std::tuple<const int, const int>(m_verticalResolution, m_horizontalResolution);
 }
 
-Eigen::Vector3d Camera::getPositionPixel(const int i, const int j) const {
+template <std::floating_point Scalar>
+Eigen::Vector3d BasicCamera<Scalar>::getPositionPixel(const int i, const int j) const {
     return m_pixel_positions(i * m_horizontalResolution + j, Eigen::all);
 }
 
-const Ray& Camera::getRay(const int i, const int j) const {
+template <std::floating_point Scalar>
+const BasicRay<Scalar>& BasicCamera<Scalar>::getRay(const int i, const int j) const {
     return m_rays[i * m_horizontalResolution + j];
 }
 
-const std::vector<Ray>& Camera::getRays() const {
+template <std::floating_point Scalar>
+const std::vector<BasicRay<Scalar>>& BasicCamera<Scalar>::getRays() const {
     return m_rays;
 }
+
+template <std::floating_point Scalar>
+std::array<Plane, 4> BasicCamera<Scalar>::getFrustum(unsigned int first_row, unsigned int first_column, unsigned int last_row, unsigned int last_column) const {
+    // Bounds of the pixels of the rectangle on the projection plane, along the up and right vectors, one unit away from the camera
+    double up_min = std::numeric_limits<double>::infinity(), up_max = -up_min, right_min = up_min, right_max = -up_min;
+    for (unsigned int i = first_row; i < last_row; ++i) {
+        for (unsigned int j = first_column; j < last_column; ++j) {
+            const Eigen::Vector3d direction = (getPositionPixel(i, j) - m_position) / m_distance;
+            up_min = std::min(up_min, direction.dot(getUp()));
+            up_max = std::max(up_max, direction.dot(getUp()));
+            right_min = std::min(right_min, direction.dot(getRight()));
+            right_max = std::max(right_max, direction.dot(getRight()));
+        }
+    }
+
+    // Widen the bounds by half the largest step between two pixels, so that the rays on the sides are not on the planes
+    const double margin = std::max(std::tan(m_horizontalRadPerPixel), std::tan(m_verticalRadPerPixel)) / 2;
+    up_min -= margin;
+    up_max += margin;
+    right_min -= margin;
+    right_max += margin;
+
+    // A direction `forward + u * up + r * right` is in front of the side `u = up_min` if `u - up_min >= 0`, and so on
+    return {
+        Plane(getUp() - up_min * getForward(), m_position),
+        Plane(up_max * getForward() - getUp(), m_position),
+        Plane(getRight() - right_min * getForward(), m_position),
+        Plane(right_max * getForward() - getRight(), m_position)
+    };
+}
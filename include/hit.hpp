@@ -0,0 +1,34 @@
+#pragma once
+
+#include <limits>
+#include <Eigen/Dense>
+
+#include "triangle.hpp"
+#include "instance.hpp"
+
+// @brief The first triangle of a scene hit by a ray, with everything known about the hit (see Scene::castRays)
+// @details The hit point is `ray origin + distance * ray direction`, or `A + u * (B - A) + v * (C - A)` from the points A, B, C of the
+//          triangle, in the frame of its mesh for a triangle of an instance.
+struct Hit {
+    /// @brief The hit triangle, nullptr if the ray hits nothing (the other fields are then not valid)
+    const Triangle* triangle = nullptr;
+
+    /// @brief The instance holding the hit triangle, nullptr for a triangle added to the scene itself
+    const Instance* instance = nullptr;
+
+    /// @brief The distance from the ray origin to the hit point
+    double distance = std::numeric_limits<double>::infinity();
+
+    /// @brief The barycentric coordinate u of the hit point on the triangle (see Triangle::intersect)
+    float u = 0;
+
+    /// @brief The barycentric coordinate v of the hit point on the triangle (see Triangle::intersect)
+    float v = 0;
+
+    /// @brief The geometric normal of the hit triangle, in the global frame
+    Eigen::Vector3d normal = Eigen::Vector3d::Zero();
+
+    /// @brief Check if the ray hits a triangle
+    /// @return true if `triangle` is set
+    inline bool isHit() const { return triangle != nullptr; };
+};
@@ -0,0 +1,160 @@
+#pragma once
+
+#include <limits>
+#include <span>
+#include <vector>
+#include <Eigen/Dense>
+
+#include "sceneObject.hpp"
+#include "triangle.hpp"
+#include "threadPool.hpp"
+#include "Structures/ray.hpp"
+#include "Structures/box.hpp"
+#include "Structures/octree.hpp"
+
+class Mesh {
+    public:
+        /// @brief A group of triangles placed in the scene many times through instances (see Instance)
+        /// @param triangles The triangles of the mesh, in the frame of the mesh (they must outlive the mesh)
+        /// @param octree_max_depth The maximum depth of the octree of the mesh
+        /// @param octree_initial_size The size of the smallest root of the octree of the mesh (see Octree::build)
+        /// @param octree_max_neighbors The maximum number of neighbors in each leaf of the octree of the mesh
+        /// @param thread_pool Optional pool on which the octree is built (nullptr builds serially)
+        /// @note The octree is built and compiled once, then shared by all the instances of the mesh.
+        /// @throws std::invalid_argument if the mesh has no triangle
+        Mesh(std::span<const Triangle* const> triangles, unsigned int octree_max_depth = 16, double octree_initial_size = 1.0,
+             unsigned int octree_max_neighbors = 8, ThreadPool* thread_pool = nullptr);
+
+        /// @brief Get the bounding box of the mesh
+        /// @return The bounding box of all the triangles, in the frame of the mesh
+        inline const Box& getBoundingBox() const { return m_bounding_box; }
+
+        /// @brief Get the number of triangles of the mesh
+        /// @return The number of triangles
+        inline std::size_t getTriangleCount() const { return m_triangles.size(); }
+
+        /// @brief Get the octree holding the triangles of the mesh
+        /// @return The octree, in the frame of the mesh
+        inline const Octree<Triangle>& getOctree() const { return m_octree; }
+
+    private:
+        std::vector<const Triangle*> m_triangles; // The triangles of the mesh, in the frame of the mesh
+        Box m_bounding_box; // Bounding box of the triangles, in the frame of the mesh
+        Octree<Triangle> m_octree; // Octree of the triangles, in the frame of the mesh
+};
+
+// @brief The hit of a ray on the mesh of an instance (see Instance::intersect)
+struct InstanceHit {
+    /// @brief The hit triangle of the mesh, in the frame of the mesh
+    const Triangle* triangle = nullptr;
+
+    /// @brief The barycentric coordinate u of the hit point on the hit triangle (see Triangle::intersect)
+    float u = 0;
+
+    /// @brief The barycentric coordinate v of the hit point on the hit triangle (see Triangle::intersect)
+    float v = 0;
+};
+
+class Instance : public SceneObject {
+    public:
+        /// @brief A copy of a mesh placed in the scene, which only stores its position and orientation
+        /// @param mesh The mesh to place in the scene (it must outlive the instance)
+        /// @param position The position of the origin of the mesh in the global frame
+        /// @param up The up vector of the instance in the global frame
+        /// @param forward The forward vector of the instance in the global frame
+        /// @note A point `p` of the mesh lies at `position + Rᵀ p` in the global frame, R being the rotation matrix of the instance,
+        ///       as the points of a Triangle.
+        Instance(const Mesh& mesh, const Eigen::Vector3d& position,
+                 const Eigen::Vector3d& up = Eigen::Vector3d::UnitY(), const Eigen::Vector3d& forward = Eigen::Vector3d::UnitZ());
+
+        /// @brief A method to set the position of the instance in the global frame
+        /// @param position The new position of the instance in the global frame
+        void setPosition(const Eigen::Vector3d& position) {
+            SceneObject::setPosition(position);
+            updateBoundingBox();
+        };
+
+        /// @brief A method to translate the instance along a displacement vector
+        /// @param displacement The displacement vector
+        void translate(const Eigen::Vector3d& displacement) {
+            SceneObject::translate(displacement);
+            updateBoundingBox();
+        };
+
+        /// @brief A method to rotate the instance around a given axis
+        /// @param axis The axis of rotation (must be a unit vector)
+        /// @param angle The angle of rotation in radians
+        void rotate(const Eigen::Vector3d& axis, const double angle) {
+            SceneObject::rotate(axis, angle);
+            updateBoundingBox();
+        };
+
+        /// @brief A method to rotate the instance around a given rotation vector
+        /// @param rotationVector The rotation vector (angle and axis of rotation)
+        void rotate(const Eigen::Vector3d& rotationVector) {
+            SceneObject::rotate(rotationVector);
+            updateBoundingBox();
+        };
+
+        /// @brief Get the mesh placed by the instance
+        /// @return The mesh
+        inline const Mesh& getMesh() const { return *m_mesh; }
+
+        /// @brief A method to get the bounding box of the instance
+        /// @return The bounding box of the mesh once placed in the global frame
+        inline const Box& getBoundingBox() const { return m_bounding_box; }
+
+        /// @brief Express a ray of the global frame in the frame of the mesh
+        /// @param ray The ray in the global frame
+        /// @return The same ray in the frame of the mesh, in which the distances along the ray are unchanged
+        Ray toMeshFrame(const Ray& ray) const;
+
+        /// @brief Express a direction of the frame of the mesh in the global frame, eg the normal of a triangle of the mesh
+        /// @param direction The direction in the frame of the mesh
+        /// @return The direction in the global frame
+        Eigen::Vector3d toGlobalFrame(const Eigen::Vector3d& direction) const {
+            return getRotationMatrix().transpose() * direction;
+        };
+
+        /// @brief Find the first triangle of the mesh hit by a ray
+        /// @param ray The ray in the global frame
+        /// @param hit_distance Set to the distance to the hit triangle
+        /// @param max_distance Maximum distance to trace the ray (default is infinity)
+        /// @return The hit triangle of the mesh, or nullptr. Its points and normal are in the frame of the mesh (see toGlobalFrame).
+        const Triangle* traceRay(const Ray& ray, double& hit_distance, double max_distance = std::numeric_limits<double>::infinity()) const;
+
+        /// @brief Return true if the ray hits the mesh, so that instances can be stored in an acceleration structure (see Bvh)
+        /// @param R The Ray to test for intersection, in the global frame
+        /// @param u The barycentric coordinate u of the intersection point on the hit triangle (see Triangle::intersect)
+        /// @param v The barycentric coordinate v of the intersection point on the hit triangle (see Triangle::intersect)
+        /// @param t The distance from the ray origin to the first triangle of the mesh hit by the ray
+        /// @return true if the Ray intersect the mesh, false otherwise
+        bool intersect(const Ray& R, float& u, float& v, float& t) const;
+
+        /// @brief Find the first triangle of the mesh hit by a ray, with its barycentric coordinates, in a single traversal of the mesh
+        /// @param R The Ray to test for intersection, in the global frame
+        /// @param hit Set to the hit triangle, in the frame of the mesh, and the barycentric coordinates of the hit point on it
+        /// @param t The distance from the ray origin to the hit triangle
+        /// @param max_distance Maximum distance to trace the ray, eg the closest hit so far in other instances
+        /// @return true if the Ray hits the mesh before `max_distance`, false otherwise (`hit` and `t` are then unchanged)
+        /// @note The coordinates come from the intersection record of the hit triangle, tested by the octree of the mesh too.
+        ///       If its test misses the ray in the mesh frame, eg on an edge, they are the ones of the hit point.
+        bool intersect(const Ray& R, InstanceHit& hit, float& t, double max_distance = std::numeric_limits<double>::infinity()) const;
+
+        /// @brief Check if any triangle of the mesh is hit by a ray before a maximum distance, eg for a shadow ray
+        /// @param R The Ray to test, in the global frame
+        /// @param max_distance The distance along the ray beyond which the hits are ignored
+        /// @return true if a triangle is hit at a distance in [0, max_distance)
+        /// @note The octree of the mesh returns at the first hit found, instead of searching for the closest one (see Octree::occluded).
+        bool occluded(const Ray& R, double max_distance) const;
+
+    private:
+        const Mesh* m_mesh; // The mesh placed by the instance, shared with the other instances
+
+        /// @brief The bounding box of the mesh once placed in the global frame
+        Box m_bounding_box;
+
+        /// @brief A method to update the bounding box based on the position and rotation of the instance
+        /// @note This method is called whenever the position or rotation of the instance is changed
+        void updateBoundingBox();
+};
@@ -1,21 +1,141 @@
 #pragma once
 
+#include <array>
 #include <list>
 #include <tuple>
+#include <memory>
+#include <unordered_map>
+#include <span>
+#include <string>
+#include <variant>
+#include <vector>
 #include <Eigen/Dense>
 
 #include "camera.hpp"
 #include "light.hpp"
 #include "triangle.hpp"
+#include "instance.hpp"
+#include "hit.hpp"
+#include "threadPool.hpp"
 #include "Structures/ray.hpp"
+#include "Structures/rayPacket.hpp"
 #include "Structures/render.hpp"
 #include "Structures/octree.hpp"
+#include "Structures/bvh.hpp"
+#include "Structures/morton.hpp"
+#include "Structures/accelerationStructure.hpp"
+
+static_assert(AccelerationStructure<Octree<Triangle>, Triangle>);
+static_assert(AccelerationStructure<Bvh<Triangle>, Triangle>);
+static_assert(AccelerationStructure<Bvh<Instance>, Instance>);
+
+// Concept PacketTraceable: type 'S' traces packets of camera rays together with `.traceRays` (see Octree::traceRays)
+template<typename S>
+concept PacketTraceable = requires(const S structure, const RayPacket<4>& packet, RayPacket<4>::Lanes& hit_distances) {
+    structure.traceRays(packet, hit_distances);
+};
+
+// Concept TileCullable: type 'S' collects once the nodes crossed by the frustum of a tile of pixels with `.cullFrustum`,
+//  and traces the packets of the tile from them (see Octree::cullFrustum)
+template<typename S>
+concept TileCullable = requires(const S structure, std::span<const Plane> planes, OctreeEntryPoints& entry_points,
+                                const RayPacket<4>& packet, RayPacket<4>::Lanes& hit_distances) {
+    structure.cullFrustum(planes, (unsigned char)0, entry_points);
+    structure.traceRays(packet, hit_distances, entry_points);
+};
 
 class Scene {
     private:
         Camera* m_camera;
         LightSource* m_lightSource;
-        Octree<Triangle> m_octree; // Octree to manage the scene objects efficiently
+        std::variant<Octree<Triangle>, Bvh<Triangle>> m_acceleration_structure; // Structure to find the triangles hit by the rays efficiently
+        std::vector<const Triangle*> m_triangles; // All the triangles of the scene, used to rebuild the acceleration structure at once
+        std::vector<const Triangle*> m_moved_triangles; // Triangles moved since the last render, updated in the acceleration structure before the next one
+
+        // Position of each triangle in `m_triangles`, so that a triangle is found without going through all of them.
+        // A removed triangle leaves a null pointer behind, until `compactTriangles` drops them: the other triangles keep their
+        // order, in which the saved acceleration structures index them
+        struct TriangleEntry {
+            std::size_t index; // Position of the triangle in `m_triangles`
+            bool moved; // True if the triangle is in `m_moved_triangles`
+        };
+        std::unordered_map<const Triangle*, TriangleEntry> m_triangle_entries;
+        std::size_t m_removed_triangle_count = 0; // Number of null pointers left in `m_triangles` by the removals
+
+        // Two-level structure of the instanced meshes: a hierarchy of the instances, each of them tracing the rays through the octree
+        // of its mesh. One instance per leaf, as testing an instance costs a full traversal of its mesh
+        std::vector<const Instance*> m_instances; // All the instances of the scene
+        Bvh<Instance> m_instance_hierarchy{1, 16}; // Structure to find the instances hit by the rays efficiently
+
+        std::unique_ptr<ThreadPool> m_thread_pool; // Pool used to render the tiles in parallel, nullptr for serial rendering
+        unsigned int m_tile_size = 16; // Length of the side of a square tile of pixels (in number of pixels)
+
+        static constexpr double SHADOW_RAY_OFFSET = 1e-4; // Distance between a hit point and the origin of its shadow ray (in meters)
+        static constexpr std::size_t CAST_BATCH_SIZE = 16384; // Number of rays of `castRays` traced by one task of the thread pool
+        static constexpr unsigned int CAST_ORDER_LEVELS = 4; // Number of levels of the cells of origins and directions sorting the rays of `castRays`
+
+        // The camera rays are traced by blocks of PACKET_WIDTH x PACKET_HEIGHT pixels through the structures supporting packets
+        static constexpr unsigned int PACKET_WIDTH = 2; // Number of columns of pixels in a block
+        static constexpr unsigned int PACKET_HEIGHT = 2; // Number of rows of pixels in a block
+        static constexpr int PACKET_SIZE = PACKET_WIDTH * PACKET_HEIGHT; // Number of rays in a packet
+
+        /// @brief Compute the color of one pixel of the render, once its camera ray is traced
+        /// @param structure The acceleration structure holding the triangles of the scene, queried by the shadow ray
+        /// @param ray The ray leaving the camera through the pixel
+        /// @param hit_triangle The first triangle hit by the ray, or nullptr
+        /// @param hit_distance The distance to the hit triangle
+        /// @param linear_id The linear index of the pixel in the render
+        /// @param render The render in which the color of the pixel is written
+        /// @note Both the serial and the tiled paths go through this method, so they produce the exact same image
+        /// @note The instances are traced here, and replace the hit triangle if one of them is closer (see traceInstances)
+        template <typename Structure>
+        void shadePixel(const Structure& structure, const Ray& ray, const Triangle* hit_triangle, double hit_distance,
+                        unsigned int linear_id, Render& render) const;
+
+        /// @brief Find the first triangle of the instances hit by a ray, if it is closer than a hit already found
+        /// @param ray The ray to trace
+        /// @param hit_distance The distance to the closest hit so far (infinity if none), set to the distance to the hit triangle
+        /// @param hit Set to the hit triangle, in the frame of the mesh of the hit instance, and its barycentric coordinates
+        /// @return The instance holding the hit triangle, or nullptr if no instance is hit before `hit_distance`
+        /// @note The mesh of each instance is traced once, and gives the hit triangle with its distance (see Instance::intersect)
+        const Instance* traceInstances(const Ray& ray, double& hit_distance, InstanceHit& hit) const;
+
+        /// @brief Compute the colors of a rectangle of pixels of the render
+        /// @param structure The acceleration structure holding the triangles of the scene
+        /// @param first_row The first row of the rectangle
+        /// @param first_column The first column of the rectangle
+        /// @param last_row The row after the last one of the rectangle
+        /// @param last_column The column after the last one of the rectangle
+        /// @param render The render in which the colors are written
+        /// @note The camera rays are traced by packets if the structure supports it (see PacketTraceable), and one by one otherwise.
+        ///       The packets start from the nodes crossed by the frustum of the rectangle if the structure supports it (see TileCullable).
+        template <typename Structure>
+        void renderTile(const Structure& structure, unsigned int first_row, unsigned int first_column,
+                        unsigned int last_row, unsigned int last_column, Render& render) const;
+
+        /// @brief Compute the colors of all the pixels of the render, tile by tile, serially or on the thread pool
+        /// @param structure The acceleration structure holding the triangles of the scene
+        /// @param render The render in which the colors are written
+        template <typename Structure>
+        void renderPixels(const Structure& structure, Render& render) const;
+
+        /// @brief Sort rays so that the rays close in the sorted order have close origins and directions (see castRays)
+        /// @param rays The rays to sort
+        /// @return The index of each ray in `rays`, in the sorted order: by octant of direction, then along the Morton curve of the
+        ///         cells of the origins, then along the Morton curve of the cells of the directions (CAST_ORDER_LEVELS levels each)
+        std::vector<MortonKey> sortRays(std::span<const Ray> rays) const;
+
+        /// @brief Trace a batch of rays and fill their hit records (see castRays)
+        /// @param structure The acceleration structure holding the triangles of the scene
+        /// @param rays All the rays to trace
+        /// @param batch The indices of the rays of the batch in `rays` (see sortRays)
+        /// @param hits The hit records of all the rays, same size as `rays`, of which the records of the batch are written
+        /// @note The rays go through the structure as a stream if it supports it (see Octree::traceRayStream), and one by one otherwise
+        template <typename Structure>
+        void castRayBatch(const Structure& structure, std::span<const Ray> rays, std::span<const MortonKey> batch, std::span<Hit> hits) const;
+
+        /// @brief Drop the null pointers left in `m_triangles` by the removals, keeping the order of the other triangles
+        void compactTriangles();
     
     public:
         /// @brief Create the whole scene that contains one camera and a few objects
@@ -23,22 +143,136 @@ class Scene {
         /// @param octree_max_depth The maximum depth of the octree
         /// @param octree_initial_size The initial size of the octree's root node (length of one side of the cube)
         /// @param octree_max_neighbors The maximum number of neighbors in each octree leaf
+        /// @note The triangles are stored in an octree, inserted by bounding box so that large triangles are found by every ray crossing them
         Scene(Camera* camera, unsigned int octree_max_depth, double octree_initial_size, unsigned int octree_max_neighbors) : 
             m_camera(camera), 
-            m_octree(octree_max_depth, octree_initial_size, octree_max_neighbors, camera->getPosition())
+            m_acceleration_structure(std::in_place_type<Octree<Triangle>>, octree_max_depth, octree_initial_size, octree_max_neighbors,
+                                     camera->getPosition(), OctreeInsertion::BoundingBox)
         {};
 
+        /// @brief Create the whole scene that contains one camera and a few objects, stored in an octree without manual parameters
+        /// @param camera The camera to be used for rendering
+        /// @param cost_model The relative costs of the traversal and of the intersections of the octree (see OctreeCostModel)
+        /// @note The root of the octree fits the triangles, and its leaves are split as long as the cost model predicts that it pays off
+        explicit Scene(Camera* camera, const OctreeCostModel& cost_model = OctreeCostModel()) :
+            m_camera(camera),
+            m_acceleration_structure(std::in_place_type<Octree<Triangle>>, OctreeInsertion::BoundingBox, cost_model)
+        {};
+
+        /// @brief Create the whole scene that contains one camera and a few objects, stored in a bounding volume hierarchy
+        /// @param camera The camera to be used for rendering
+        /// @param bvh_max_leaf_size The maximum number of triangles in each leaf of the hierarchy
+        /// @param bvh_bin_count The number of bins along each axis used to choose the split planes of the hierarchy
+        /// @note The hierarchy adapts to uneven distributions of triangles better than the octree (see Bvh)
+        Scene(Camera* camera, unsigned int bvh_max_leaf_size, unsigned int bvh_bin_count) :
+            m_camera(camera),
+            m_acceleration_structure(std::in_place_type<Bvh<Triangle>>, bvh_max_leaf_size, bvh_bin_count)
+        {};
+
+        /// @brief Check which acceleration structure holds the triangles of the scene
+        /// @return true for a bounding volume hierarchy, false for an octree
+        bool usesBvh() const {
+            return std::holds_alternative<Bvh<Triangle>>(m_acceleration_structure);
+        }
+
         /// @brief Set the light source of the scene
         /// @param lightSource The light source to be used for rendering
         void setLightSource(LightSource* lightSource) {
             m_lightSource = lightSource;
         }
 
+        /// @brief Set the number of threads used to render the scene
+        /// @param thread_count The number of threads (1 renders serially, 0 uses one thread per hardware thread)
+        /// @note The frame is split in square tiles, rendered one after the other by a single thread,
+        ///       and scheduled on a work-stealing thread pool with more than one thread
+        void setThreadCount(unsigned int thread_count);
+
+        /// @brief Get the number of threads used to render the scene
+        /// @return The number of threads (1 if the scene is rendered serially)
+        unsigned int getThreadCount() const {
+            return m_thread_pool ? m_thread_pool->getThreadCount() : 1;
+        }
+
+        /// @brief Set the size of the tiles used by the renderer
+        /// @param tile_size The length of the side of a square tile (in number of pixels, must be greater than zero)
+        void setTileSize(unsigned int tile_size);
+
         /// @brief This method analyses what the camera sees on each of its pixels
         /// @return The image frame of the scene through the camera's eye
-        Render getRender() const;
+        /// @note The triangles marked as moved are updated in the acceleration structure first (see flushUpdates).
+        Render getRender();
+
+        /// @brief Trace many rays through the scene and record the first triangle hit by each of them, eg for sensor simulation
+        /// @param rays The rays to trace
+        /// @param hits Set to the hit record of each ray (same size as `rays`): the hit triangle and instance, the distance,
+        ///             the barycentric coordinates and the geometric normal (see Hit)
+        /// @throws std::invalid_argument if `hits` and `rays` do not have the same size
+        /// @note The rays are split in batches traced in parallel on the thread pool of the renderer, if there is one (see setThreadCount).
+        ///       The triangles marked as moved are updated first (see flushUpdates).
+        /// @note The rays can come in any order: they are sorted first, so that each batch gathers rays of close origins and directions,
+        ///       which visit the same nodes of the structure (see sortRays).
+        void castRays(std::span<const Ray> rays, std::span<Hit> hits);
 
         /// @brief A function to add an object to the scene
         /// @param triangle The object to be added (now only Triangle)
-        void addTriangle(Triangle* triangle);
+        /// @return true if the object was added, false if it was already in the scene
+        bool addTriangle(Triangle* triangle);
+
+        /// @brief A function to add many objects to the scene at once
+        /// @param triangles The objects to be added
+        /// @note The objects already in the scene, or repeated in `triangles`, are added once.
+        /// @note The acceleration structure is rebuilt from scratch with all the triangles of the scene (see Octree::build and Bvh::build),
+        ///       on the thread pool of the renderer if there is one. This is much faster than adding the triangles one by one.
+        void addTriangles(std::span<Triangle* const> triangles);
+
+        /// @brief A function to add many objects to the scene at once, with the acceleration structure saved by `saveAccelerationStructure`
+        /// @param triangles The objects to be added, in the same order as when the structure was saved (eg from the same model file)
+        /// @param path The path of the file holding the acceleration structure
+        /// @note The octree is mapped from the file instead of being built, so that a large scene starts without the cost of the build.
+        /// @throws std::invalid_argument if the scene uses a bounding volume hierarchy, if an object is already in the scene or repeated,
+        ///         or if the saved octree does not match the scene
+        /// @throws std::runtime_error if the file cannot be read or is not a valid octree file (see Octree::load).
+        ///         The scene is left unchanged on error.
+        void loadTriangles(std::span<Triangle* const> triangles, const std::string& path);
+
+        /// @brief Write the acceleration structure of the scene to a file, to load it later with `loadTriangles`
+        /// @param path The path of the file, replaced if it exists
+        /// @note The objects marked as moved are updated first (see flushUpdates). The instances are not saved.
+        /// @throws std::invalid_argument if the scene uses a bounding volume hierarchy
+        /// @throws std::runtime_error if the file cannot be written
+        void saveAccelerationStructure(const std::string& path);
+
+        /// @brief A function to remove an object from the scene
+        /// @param triangle The object to be removed
+        /// @return true if the object was in the scene
+        bool removeTriangle(const Triangle* triangle);
+
+        /// @brief Mark an object of the scene as moved, eg after Triangle::translate or Triangle::rotate
+        /// @param triangle The object that moved
+        /// @note The object is moved in the acceleration structure by the next render, or by `flushUpdates`,
+        ///       so that an animated scene is not rebuilt from scratch at every frame. Marking it again before then does nothing.
+        /// @throws std::invalid_argument if the object is not in the scene
+        void updateTriangle(const Triangle* triangle);
+
+        /// @brief Update the objects marked as moved in the acceleration structure (see Octree::update and Bvh::update)
+        /// @throws std::length_error if an object cannot be placed in the octree, eg out of its maximum bounds (see Octree::insert).
+        ///         The objects updated until then, and the one that failed, are no longer marked as moved: the next render
+        ///         updates the remaining ones. The one that failed stays where it was in the octree (see Octree::update).
+        void flushUpdates();
+
+        /// @brief A function to add a copy of a mesh to the scene
+        /// @param instance The instance placing the mesh in the scene
+        /// @note The triangles of the mesh are not copied: all the instances of a mesh share its triangles and its octree.
+        void addInstance(Instance* instance);
+
+        /// @brief A function to remove a copy of a mesh from the scene
+        /// @param instance The instance to be removed
+        /// @return true if the instance was in the scene
+        bool removeInstance(const Instance* instance);
+
+        /// @brief Mark an instance of the scene as moved, eg after Instance::translate or Instance::rotate
+        /// @param instance The instance that moved, which must be in the scene
+        /// @note Only the hierarchy of the instances is rebuilt, the octree of the mesh stays the same.
+        /// @throws std::invalid_argument if the instance is not in the scene
+        void updateInstance(const Instance* instance);
 };
\ No newline at end of file
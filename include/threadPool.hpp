@@ -0,0 +1,74 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool {
+    public:
+        /// @brief The signature of a task: it receives the index of the task and the index of the worker running it
+        typedef std::function<void(std::size_t task_index, unsigned int worker_index)> Task;
+
+        /// @brief A pool of persistent worker threads that share batches of tasks through work stealing
+        /// @param thread_count The number of worker threads (0 means one thread per hardware thread)
+        /// @note Each worker owns a queue of tasks. When its queue is empty, it steals from the back of the others' queues.
+        explicit ThreadPool(unsigned int thread_count = 0);
+
+        /// @brief Destructor for ThreadPool, joins all the worker threads
+        ~ThreadPool();
+
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+        /// @brief Get the number of worker threads in the pool
+        /// @return The number of worker threads
+        inline unsigned int getThreadCount() const { return static_cast<unsigned int>(m_workers.size()); };
+
+        /// @brief Run a batch of tasks on the pool and wait for all of them to complete
+        /// @param task_count The number of tasks in the batch, indexed from 0 to task_count - 1
+        /// @param task The callable to run for each task index
+        /// @note Tasks are initially split in contiguous blocks between the workers, so neighbouring tasks tend to run on the same thread.
+        /// @note If a task throws, the first exception is rethrown by this method once the batch is over.
+        /// @note The pool runs one batch at a time: concurrent calls from several threads are serialized, each one waiting for the
+        ///       batches started before it to complete.
+        /// @throws std::logic_error if called from a task of the pool, which would wait for its own batch forever
+        void run(std::size_t task_count, const Task& task);
+
+    private:
+        /// @brief The queue of pending task indices owned by one worker
+        struct WorkQueue {
+            std::mutex mutex;
+            std::deque<std::size_t> tasks;
+        };
+
+        std::vector<std::thread> m_workers; // Worker threads
+        std::vector<std::unique_ptr<WorkQueue>> m_queues; // One queue per worker
+
+        std::mutex m_run_mutex; // Held by `run` for the whole batch, so that the batches of concurrent callers do not overlap
+        std::mutex m_mutex; // Protects the batch state below
+        std::condition_variable m_wake_condition; // Signals the workers that a new batch is available
+        std::condition_variable m_done_condition; // Signals `run` that the batch is over
+
+        std::atomic<const Task*> m_task{nullptr}; // Task of the current batch
+        std::size_t m_batch = 0; // Index of the current batch, used by the workers to detect new batches
+        std::atomic<std::size_t> m_remaining_tasks{0}; // Number of tasks of the current batch not completed yet
+        std::exception_ptr m_exception; // First exception thrown by a task of the current batch
+        bool m_stop = false; // Set by the destructor to stop the workers
+
+        /// @brief The main loop of a worker thread
+        /// @param worker_index The index of the worker
+        void workerLoop(unsigned int worker_index);
+
+        /// @brief Get the next task for a worker, from its own queue first, then by stealing from the other queues
+        /// @param worker_index The index of the worker
+        /// @param task_index Reference that will hold the index of the task to run
+        /// @return true if a task was found, false if all the queues are empty
+        bool popTask(unsigned int worker_index, std::size_t& task_index);
+};
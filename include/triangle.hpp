@@ -6,9 +6,13 @@
 #include "sceneObject.hpp"
 #include "Structures/ray.hpp"
 #include "Structures/box.hpp"
+#include "Structures/triangleRecord.hpp"
 
 class Triangle : public SceneObject {    
     public:
+        /// @brief The precomputed data of the intersection test, stored by the octree in the order of its leaves (see RecordIntersectable)
+        using IntersectionRecord = TriangleRecord;
+
         /// @brief A very simple triangular mesh
         /// @param point0 The coordinates of the first point of the mesh (3-dim vector in meters)
         /// @param point1 The coordinates of the second point of the mesh (3-dim vector in meters)
@@ -78,6 +82,15 @@ class Triangle : public SceneObject {
         /// @return true if the Ray intersect the object, false otherwise
         bool intersect(const Ray& R, float& u, float& v, float& t) const;
 
+        /// @brief Get the data read by the intersection test of the triangle, to test many rays without reading the triangle
+        /// @return The first point and the edges of the triangle in the global frame (see TriangleRecord), updated when the triangle moves
+        inline const TriangleRecord& getIntersectionRecord() const { return m_intersection_record; }
+
+        /// @brief Get the point of the triangle closest to a point
+        /// @param point The point in the global frame
+        /// @return The closest point of the triangle (on its surface, edges or vertices) in the global frame
+        Eigen::Vector3d closestPoint(const Eigen::Vector3d& point) const;
+
     private:
         /// @brief The coordinates of the points of the triangle in the local frame
         Eigen::Vector3d m_point0;
@@ -98,7 +111,10 @@ class Triangle : public SceneObject {
         /// @brief The bounding box of the triangle in the global frame
         Box m_bounding_box;
 
-        /// @brief A method to update the global points and normal vector based on the position and rotation of the triangle
+        /// @brief The data read by the intersection test, in the global frame
+        TriangleRecord m_intersection_record;
+
+        /// @brief A method to update the global points, normal vector, bounding box and intersection record based on the position and rotation of the triangle
         /// @note This method is called whenever the position or rotation of the triangle is changed
         void updatePoints();
 };
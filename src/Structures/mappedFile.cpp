@@ -0,0 +1,61 @@
+#include "Structures/mappedFile.hpp"
+
+#include <fstream>
+#include <stdexcept>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define HAS_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+std::shared_ptr<const MappedFile> MappedFile::open(const std::string& path) {
+    std::shared_ptr<MappedFile> file(new MappedFile());
+
+#ifdef HAS_MMAP
+    const int descriptor = ::open(path.c_str(), O_RDONLY);
+    if (descriptor < 0) {
+        throw std::runtime_error("Cannot open file: " + path);
+    }
+
+    struct stat status;
+    if (fstat(descriptor, &status) != 0) {
+        ::close(descriptor);
+        throw std::runtime_error("Cannot read the size of file: " + path);
+    }
+    file->m_size = static_cast<std::size_t>(status.st_size);
+
+    // An empty file cannot be mapped, and has no content to share anyway
+    if (file->m_size > 0) {
+        void* address = mmap(nullptr, file->m_size, PROT_READ, MAP_SHARED, descriptor, 0);
+        if (address == MAP_FAILED) {
+            ::close(descriptor);
+            throw std::runtime_error("Cannot map file: " + path);
+        }
+        file->m_data = static_cast<const std::byte*>(address);
+    }
+    ::close(descriptor); // The mapping keeps its own reference to the file
+#else
+    std::ifstream stream(path, std::ios::binary | std::ios::ate);
+    if (!stream) {
+        throw std::runtime_error("Cannot open file: " + path);
+    }
+    file->m_size = static_cast<std::size_t>(stream.tellg());
+    file->m_buffer.resize(file->m_size);
+    stream.seekg(0);
+    if (!stream.read(reinterpret_cast<char*>(file->m_buffer.data()), file->m_size)) {
+        throw std::runtime_error("Cannot read file: " + path);
+    }
+    file->m_data = file->m_buffer.data();
+#endif
+
+    return file;
+}
+
+MappedFile::~MappedFile() {
+#ifdef HAS_MMAP
+    if (m_data != nullptr) munmap(const_cast<std::byte*>(m_data), m_size);
+#endif
+}
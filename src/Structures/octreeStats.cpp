@@ -0,0 +1,57 @@
+#include "Structures/octreeStats.hpp"
+
+#include <numeric>
+#include <sstream>
+
+std::size_t OctreeStats::getNodeCount() const {
+    return std::accumulate(nodes_per_depth.begin(), nodes_per_depth.end(), std::size_t{0});
+}
+
+double OctreeStats::getEmptyLeafRatio() const {
+    return leaf_count == 0 ? 0.0 : static_cast<double>(empty_leaf_count) / leaf_count;
+}
+
+/// @brief Write a list of counts as a JSON array
+/// @param stream The stream to write to
+/// @param values The counts
+static void writeJsonArray(std::ostream& stream, const std::vector<std::size_t>& values) {
+    stream << "[";
+    for (std::size_t i = 0; i < values.size(); ++i) {
+        stream << (i > 0 ? ", " : "") << values[i];
+    }
+    stream << "]";
+}
+
+void OctreeStats::writeJson(std::ostream& stream) const {
+    stream << "{\n";
+    stream << "  \"node_count\": " << getNodeCount() << ",\n";
+    stream << "  \"nodes_per_depth\": ";
+    writeJsonArray(stream, nodes_per_depth);
+    stream << ",\n";
+    stream << "  \"leaf_count\": " << leaf_count << ",\n";
+    stream << "  \"empty_leaf_count\": " << empty_leaf_count << ",\n";
+    stream << "  \"empty_leaf_ratio\": " << getEmptyLeafRatio() << ",\n";
+
+    // Each bucket of the histogram is written with its range, so that the file can be read without knowing the bucketing
+    stream << "  \"leaf_occupancy\": [";
+    for (std::size_t k = 0; k < leaf_occupancy.size(); ++k) {
+        const std::size_t min_objects = (k == 0) ? 0 : std::size_t{1} << (k - 1);
+        const std::size_t max_objects = (k == 0) ? 0 : (std::size_t{1} << k) - 1;
+        stream << (k > 0 ? ", " : "") << "{\"min_objects\": " << min_objects << ", \"max_objects\": " << max_objects
+               << ", \"leaves\": " << leaf_occupancy[k] << "}";
+    }
+    stream << "],\n";
+
+    stream << "  \"reference_count\": " << reference_count << ",\n";
+    stream << "  \"node_bytes\": " << node_bytes << ",\n";
+    stream << "  \"primitive_bytes\": " << primitive_bytes << ",\n";
+    stream << "  \"flat_bytes\": " << flat_bytes << ",\n";
+    stream << "  \"traversal_cost\": " << traversal_cost << "\n";
+    stream << "}";
+}
+
+std::string OctreeStats::toJson() const {
+    std::ostringstream stream;
+    writeJson(stream);
+    return stream.str();
+}
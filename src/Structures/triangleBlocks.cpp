@@ -0,0 +1,289 @@
+#include "Structures/triangleBlocks.hpp"
+
+#include <atomic>
+#include <stdexcept>
+
+// The SIMD kernels are compiled for their instruction set with the target attribute of GCC and Clang, whatever the flags of the build,
+// and only called if CPUID reports the instruction set. Other compilers and processors use the scalar kernel.
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define TRIANGLE_BLOCKS_SIMD
+#include <immintrin.h>
+#endif
+
+// The kernels compute the same operations as BasicTriangleRecord::intersect, in the same order (the dot products of Eigen add the last two
+// products first), so that they round the same way. This file is compiled without fused multiply-adds (see CMakeLists.txt).
+
+/// @brief A kernel testing a ray against some triangles of a block (see intersectTriangleBlock)
+template <std::floating_point Scalar>
+using TriangleBlockKernel = std::uint32_t (*)(const BasicTriangleBlock<Scalar>&, std::uint32_t, const TriangleBlockRay<Scalar>&, float*);
+
+/// @brief The kernel testing the triangles one at a time, as TriangleRecord::intersect
+template <std::floating_point Scalar>
+static std::uint32_t intersectBlockScalar(const BasicTriangleBlock<Scalar>& block, std::uint32_t lanes, const TriangleBlockRay<Scalar>& ray, float* distances) {
+    const float dx = ray.direction[0], dy = ray.direction[1], dz = ray.direction[2];
+
+    std::uint32_t hits = 0;
+    for (; lanes != 0; lanes &= lanes - 1) {
+        const unsigned lane = std::countr_zero(lanes);
+        const float e1x = block.edge1[0][lane], e1y = block.edge1[1][lane], e1z = block.edge1[2][lane];
+        const float e2x = block.edge2[0][lane], e2y = block.edge2[1][lane], e2z = block.edge2[2][lane];
+        const float px = dy * e2z - dz * e2y, py = dz * e2x - dx * e2z, pz = dx * e2y - dy * e2x;
+        const float det = e1x * px + (e1y * py + e1z * pz);
+        if (std::fabs(det) < 1e-6f) continue;
+
+        const float sign = det > 0 ? 1.0f : -1.0f;
+        const float aox = static_cast<float>(ray.origin[0] - block.point0[0][lane]);
+        const float aoy = static_cast<float>(ray.origin[1] - block.point0[1][lane]);
+        const float aoz = static_cast<float>(ray.origin[2] - block.point0[2][lane]);
+        const float qx = aoy * e1z - aoz * e1y, qy = aoz * e1x - aox * e1z, qz = aox * e1y - aoy * e1x;
+        const float u_det = (aox * px + (aoy * py + aoz * pz)) * sign;
+        const float v_det = (dx * qx + (dy * qy + dz * qz)) * sign;
+        if (!((u_det >= 0) & (v_det >= 0) & (u_det + v_det <= det * sign))) continue;
+
+        distances[lane] = (e2x * qx + (e2y * qy + e2z * qz)) * (1.0f / det);
+        if (distances[lane] >= 0) hits |= 1u << lane;
+    }
+    return hits;
+}
+
+#ifdef TRIANGLE_BLOCKS_SIMD
+
+/// @brief Compute 4 differences O - A in the precision of the points, rounded to single precision
+__attribute__((target("sse4.1")))
+static inline __m128 subtractSSE4(double origin, const double* point) {
+    return _mm_movelh_ps(_mm_cvtpd_ps(_mm_sub_pd(_mm_set1_pd(origin), _mm_load_pd(point))),
+                         _mm_cvtpd_ps(_mm_sub_pd(_mm_set1_pd(origin), _mm_load_pd(point + 2))));
+}
+
+__attribute__((target("sse4.1")))
+static inline __m128 subtractSSE4(float origin, const float* point) {
+    return _mm_sub_ps(_mm_set1_ps(origin), _mm_load_ps(point));
+}
+
+/// @brief The kernel testing 4 triangles at a time with SSE4.1
+template <std::floating_point Scalar>
+__attribute__((target("sse4.1")))
+static std::uint32_t intersectBlockSSE4(const BasicTriangleBlock<Scalar>& block, std::uint32_t lanes, const TriangleBlockRay<Scalar>& ray, float* distances) {
+    const __m128 dx = _mm_set1_ps(ray.direction[0]), dy = _mm_set1_ps(ray.direction[1]), dz = _mm_set1_ps(ray.direction[2]);
+    const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f), minus_one = _mm_set1_ps(-1.0f), epsilon = _mm_set1_ps(1e-6f);
+    const __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+
+    std::uint32_t hits = 0;
+    for (std::size_t offset = 0; offset < BasicTriangleBlock<Scalar>::SIZE; offset += 4) {
+        if (((lanes >> offset) & 0xFu) == 0) continue;
+
+        const __m128 e1x = _mm_load_ps(block.edge1[0] + offset), e1y = _mm_load_ps(block.edge1[1] + offset), e1z = _mm_load_ps(block.edge1[2] + offset);
+        const __m128 e2x = _mm_load_ps(block.edge2[0] + offset), e2y = _mm_load_ps(block.edge2[1] + offset), e2z = _mm_load_ps(block.edge2[2] + offset);
+
+        // P = D x E2, det = E1.P
+        const __m128 px = _mm_sub_ps(_mm_mul_ps(dy, e2z), _mm_mul_ps(dz, e2y));
+        const __m128 py = _mm_sub_ps(_mm_mul_ps(dz, e2x), _mm_mul_ps(dx, e2z));
+        const __m128 pz = _mm_sub_ps(_mm_mul_ps(dx, e2y), _mm_mul_ps(dy, e2x));
+        const __m128 det = _mm_add_ps(_mm_mul_ps(e1x, px), _mm_add_ps(_mm_mul_ps(e1y, py), _mm_mul_ps(e1z, pz)));
+        const __m128 not_parallel = _mm_cmpnlt_ps(_mm_and_ps(det, abs_mask), epsilon);
+        const __m128 sign = _mm_blendv_ps(minus_one, one, _mm_cmpgt_ps(det, zero));
+
+        // AO = O - A in the precision of the points, rounded to single precision
+        const __m128 aox = subtractSSE4(ray.origin[0], block.point0[0] + offset);
+        const __m128 aoy = subtractSSE4(ray.origin[1], block.point0[1] + offset);
+        const __m128 aoz = subtractSSE4(ray.origin[2], block.point0[2] + offset);
+
+        // Q = AO x E1, and the barycentric coordinates times det
+        const __m128 qx = _mm_sub_ps(_mm_mul_ps(aoy, e1z), _mm_mul_ps(aoz, e1y));
+        const __m128 qy = _mm_sub_ps(_mm_mul_ps(aoz, e1x), _mm_mul_ps(aox, e1z));
+        const __m128 qz = _mm_sub_ps(_mm_mul_ps(aox, e1y), _mm_mul_ps(aoy, e1x));
+        const __m128 u_det = _mm_mul_ps(_mm_add_ps(_mm_mul_ps(aox, px), _mm_add_ps(_mm_mul_ps(aoy, py), _mm_mul_ps(aoz, pz))), sign);
+        const __m128 v_det = _mm_mul_ps(_mm_add_ps(_mm_mul_ps(dx, qx), _mm_add_ps(_mm_mul_ps(dy, qy), _mm_mul_ps(dz, qz))), sign);
+        const __m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(u_det, zero), _mm_cmpge_ps(v_det, zero)),
+                                         _mm_cmple_ps(_mm_add_ps(u_det, v_det), _mm_mul_ps(det, sign)));
+
+        const __m128 t = _mm_mul_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_add_ps(_mm_mul_ps(e2y, qy), _mm_mul_ps(e2z, qz))), _mm_div_ps(one, det));
+        const __m128 hit = _mm_and_ps(_mm_and_ps(not_parallel, inside), _mm_cmpge_ps(t, zero));
+        _mm_storeu_ps(distances + offset, t);
+        hits |= static_cast<std::uint32_t>(_mm_movemask_ps(hit)) << offset;
+    }
+    return hits & lanes;
+}
+
+/// @brief Compute 8 differences O - A in the precision of the points, rounded to single precision
+__attribute__((target("avx2")))
+static inline __m256 subtractAVX2(double origin, const double* point) {
+    const __m128 low = _mm256_cvtpd_ps(_mm256_sub_pd(_mm256_set1_pd(origin), _mm256_load_pd(point)));
+    const __m128 high = _mm256_cvtpd_ps(_mm256_sub_pd(_mm256_set1_pd(origin), _mm256_load_pd(point + 4)));
+    return _mm256_insertf128_ps(_mm256_castps128_ps256(low), high, 1);
+}
+
+__attribute__((target("avx2")))
+static inline __m256 subtractAVX2(float origin, const float* point) {
+    return _mm256_sub_ps(_mm256_set1_ps(origin), _mm256_load_ps(point));
+}
+
+/// @brief The kernel testing 8 triangles at a time with AVX2
+template <std::floating_point Scalar>
+__attribute__((target("avx2")))
+static std::uint32_t intersectBlockAVX2(const BasicTriangleBlock<Scalar>& block, std::uint32_t lanes, const TriangleBlockRay<Scalar>& ray, float* distances) {
+    const __m256 dx = _mm256_set1_ps(ray.direction[0]), dy = _mm256_set1_ps(ray.direction[1]), dz = _mm256_set1_ps(ray.direction[2]);
+    const __m256 zero = _mm256_setzero_ps(), one = _mm256_set1_ps(1.0f), minus_one = _mm256_set1_ps(-1.0f), epsilon = _mm256_set1_ps(1e-6f);
+    const __m256 abs_mask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7FFFFFFF));
+
+    std::uint32_t hits = 0;
+    for (std::size_t offset = 0; offset < BasicTriangleBlock<Scalar>::SIZE; offset += 8) {
+        if (((lanes >> offset) & 0xFFu) == 0) continue;
+
+        const __m256 e1x = _mm256_load_ps(block.edge1[0] + offset), e1y = _mm256_load_ps(block.edge1[1] + offset), e1z = _mm256_load_ps(block.edge1[2] + offset);
+        const __m256 e2x = _mm256_load_ps(block.edge2[0] + offset), e2y = _mm256_load_ps(block.edge2[1] + offset), e2z = _mm256_load_ps(block.edge2[2] + offset);
+
+        // P = D x E2, det = E1.P
+        const __m256 px = _mm256_sub_ps(_mm256_mul_ps(dy, e2z), _mm256_mul_ps(dz, e2y));
+        const __m256 py = _mm256_sub_ps(_mm256_mul_ps(dz, e2x), _mm256_mul_ps(dx, e2z));
+        const __m256 pz = _mm256_sub_ps(_mm256_mul_ps(dx, e2y), _mm256_mul_ps(dy, e2x));
+        const __m256 det = _mm256_add_ps(_mm256_mul_ps(e1x, px), _mm256_add_ps(_mm256_mul_ps(e1y, py), _mm256_mul_ps(e1z, pz)));
+        const __m256 not_parallel = _mm256_cmp_ps(_mm256_and_ps(det, abs_mask), epsilon, _CMP_NLT_UQ);
+        const __m256 sign = _mm256_blendv_ps(minus_one, one, _mm256_cmp_ps(det, zero, _CMP_GT_OQ));
+
+        // AO = O - A in the precision of the points, rounded to single precision
+        const __m256 aox = subtractAVX2(ray.origin[0], block.point0[0] + offset);
+        const __m256 aoy = subtractAVX2(ray.origin[1], block.point0[1] + offset);
+        const __m256 aoz = subtractAVX2(ray.origin[2], block.point0[2] + offset);
+
+        // Q = AO x E1, and the barycentric coordinates times det
+        const __m256 qx = _mm256_sub_ps(_mm256_mul_ps(aoy, e1z), _mm256_mul_ps(aoz, e1y));
+        const __m256 qy = _mm256_sub_ps(_mm256_mul_ps(aoz, e1x), _mm256_mul_ps(aox, e1z));
+        const __m256 qz = _mm256_sub_ps(_mm256_mul_ps(aox, e1y), _mm256_mul_ps(aoy, e1x));
+        const __m256 u_det = _mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(aox, px), _mm256_add_ps(_mm256_mul_ps(aoy, py), _mm256_mul_ps(aoz, pz))), sign);
+        const __m256 v_det = _mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(dx, qx), _mm256_add_ps(_mm256_mul_ps(dy, qy), _mm256_mul_ps(dz, qz))), sign);
+        const __m256 inside = _mm256_and_ps(_mm256_and_ps(_mm256_cmp_ps(u_det, zero, _CMP_GE_OQ), _mm256_cmp_ps(v_det, zero, _CMP_GE_OQ)),
+                                            _mm256_cmp_ps(_mm256_add_ps(u_det, v_det), _mm256_mul_ps(det, sign), _CMP_LE_OQ));
+
+        const __m256 t = _mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(e2x, qx), _mm256_add_ps(_mm256_mul_ps(e2y, qy), _mm256_mul_ps(e2z, qz))),
+                                       _mm256_div_ps(one, det));
+        const __m256 hit = _mm256_and_ps(_mm256_and_ps(not_parallel, inside), _mm256_cmp_ps(t, zero, _CMP_GE_OQ));
+        _mm256_storeu_ps(distances + offset, t);
+        hits |= static_cast<std::uint32_t>(_mm256_movemask_ps(hit)) << offset;
+    }
+    return hits & lanes;
+}
+
+/// @brief Compute 16 differences O - A in the precision of the points, rounded to single precision
+__attribute__((target("avx512f")))
+static inline __m512 subtractAVX512(double origin, const double* point) {
+    const __m256 low = _mm512_cvtpd_ps(_mm512_sub_pd(_mm512_set1_pd(origin), _mm512_load_pd(point)));
+    const __m256 high = _mm512_cvtpd_ps(_mm512_sub_pd(_mm512_set1_pd(origin), _mm512_load_pd(point + 8)));
+    return _mm512_castpd_ps(_mm512_insertf64x4(_mm512_castps_pd(_mm512_castps256_ps512(low)), _mm256_castps_pd(high), 1));
+}
+
+__attribute__((target("avx512f")))
+static inline __m512 subtractAVX512(float origin, const float* point) {
+    return _mm512_sub_ps(_mm512_set1_ps(origin), _mm512_load_ps(point));
+}
+
+/// @brief The kernel testing the 16 triangles at once with AVX-512F
+template <std::floating_point Scalar>
+__attribute__((target("avx512f")))
+static std::uint32_t intersectBlockAVX512(const BasicTriangleBlock<Scalar>& block, std::uint32_t lanes, const TriangleBlockRay<Scalar>& ray, float* distances) {
+    const __m512 dx = _mm512_set1_ps(ray.direction[0]), dy = _mm512_set1_ps(ray.direction[1]), dz = _mm512_set1_ps(ray.direction[2]);
+    const __m512 zero = _mm512_setzero_ps(), one = _mm512_set1_ps(1.0f), minus_one = _mm512_set1_ps(-1.0f), epsilon = _mm512_set1_ps(1e-6f);
+
+    const __m512 e1x = _mm512_load_ps(block.edge1[0]), e1y = _mm512_load_ps(block.edge1[1]), e1z = _mm512_load_ps(block.edge1[2]);
+    const __m512 e2x = _mm512_load_ps(block.edge2[0]), e2y = _mm512_load_ps(block.edge2[1]), e2z = _mm512_load_ps(block.edge2[2]);
+
+    // P = D x E2, det = E1.P
+    const __m512 px = _mm512_sub_ps(_mm512_mul_ps(dy, e2z), _mm512_mul_ps(dz, e2y));
+    const __m512 py = _mm512_sub_ps(_mm512_mul_ps(dz, e2x), _mm512_mul_ps(dx, e2z));
+    const __m512 pz = _mm512_sub_ps(_mm512_mul_ps(dx, e2y), _mm512_mul_ps(dy, e2x));
+    const __m512 det = _mm512_add_ps(_mm512_mul_ps(e1x, px), _mm512_add_ps(_mm512_mul_ps(e1y, py), _mm512_mul_ps(e1z, pz)));
+    const __mmask16 not_parallel = _mm512_cmp_ps_mask(_mm512_abs_ps(det), epsilon, _CMP_NLT_UQ);
+    const __m512 sign = _mm512_mask_blend_ps(_mm512_cmp_ps_mask(det, zero, _CMP_GT_OQ), minus_one, one);
+
+    // AO = O - A in the precision of the points, rounded to single precision
+    const __m512 aox = subtractAVX512(ray.origin[0], block.point0[0]);
+    const __m512 aoy = subtractAVX512(ray.origin[1], block.point0[1]);
+    const __m512 aoz = subtractAVX512(ray.origin[2], block.point0[2]);
+
+    // Q = AO x E1, and the barycentric coordinates times det
+    const __m512 qx = _mm512_sub_ps(_mm512_mul_ps(aoy, e1z), _mm512_mul_ps(aoz, e1y));
+    const __m512 qy = _mm512_sub_ps(_mm512_mul_ps(aoz, e1x), _mm512_mul_ps(aox, e1z));
+    const __m512 qz = _mm512_sub_ps(_mm512_mul_ps(aox, e1y), _mm512_mul_ps(aoy, e1x));
+    const __m512 u_det = _mm512_mul_ps(_mm512_add_ps(_mm512_mul_ps(aox, px), _mm512_add_ps(_mm512_mul_ps(aoy, py), _mm512_mul_ps(aoz, pz))), sign);
+    const __m512 v_det = _mm512_mul_ps(_mm512_add_ps(_mm512_mul_ps(dx, qx), _mm512_add_ps(_mm512_mul_ps(dy, qy), _mm512_mul_ps(dz, qz))), sign);
+    const __mmask16 inside = _mm512_cmp_ps_mask(u_det, zero, _CMP_GE_OQ) & _mm512_cmp_ps_mask(v_det, zero, _CMP_GE_OQ) &
+                             _mm512_cmp_ps_mask(_mm512_add_ps(u_det, v_det), _mm512_mul_ps(det, sign), _CMP_LE_OQ);
+
+    const __m512 t = _mm512_mul_ps(_mm512_add_ps(_mm512_mul_ps(e2x, qx), _mm512_add_ps(_mm512_mul_ps(e2y, qy), _mm512_mul_ps(e2z, qz))),
+                                   _mm512_div_ps(one, det));
+    _mm512_storeu_ps(distances, t);
+    return static_cast<std::uint32_t>(not_parallel & inside & _mm512_cmp_ps_mask(t, zero, _CMP_GE_OQ)) & lanes;
+}
+
+#endif
+
+/// @brief Get the kernel of an instruction set
+/// @throws std::invalid_argument if the processor does not support the level
+template <std::floating_point Scalar>
+static TriangleBlockKernel<Scalar> getKernel(SimdLevel level) {
+    if (level > getSupportedSimdLevel()) {
+        throw std::invalid_argument("The processor does not support the " + getSimdLevelName(level) + " triangle kernel");
+    }
+    switch (level) {
+#ifdef TRIANGLE_BLOCKS_SIMD
+        case SimdLevel::SSE4: return intersectBlockSSE4<Scalar>;
+        case SimdLevel::AVX2: return intersectBlockAVX2<Scalar>;
+        case SimdLevel::AVX512: return intersectBlockAVX512<Scalar>;
+#endif
+        default: return intersectBlockScalar<Scalar>;
+    }
+}
+
+/// @brief The kernel used by the triangle blocks, the best supported one unless another is chosen
+template <std::floating_point Scalar>
+static std::atomic<TriangleBlockKernel<Scalar>>& getCurrentKernel() {
+    static std::atomic<TriangleBlockKernel<Scalar>> kernel{getKernel<Scalar>(getSupportedSimdLevel())};
+    return kernel;
+}
+
+/// @brief The level of the kernel used by the triangle blocks
+static std::atomic<SimdLevel>& getCurrentLevel() {
+    static std::atomic<SimdLevel> level{getSupportedSimdLevel()};
+    return level;
+}
+
+SimdLevel getSupportedSimdLevel() {
+    static const SimdLevel level = [] {
+#ifdef TRIANGLE_BLOCKS_SIMD
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512f")) return SimdLevel::AVX512;
+        if (__builtin_cpu_supports("avx2")) return SimdLevel::AVX2;
+        if (__builtin_cpu_supports("sse4.1")) return SimdLevel::SSE4;
+#endif
+        return SimdLevel::Scalar;
+    }();
+    return level;
+}
+
+SimdLevel getTriangleKernelLevel() {
+    return getCurrentLevel().load();
+}
+
+void setTriangleKernelLevel(SimdLevel level) {
+    getCurrentKernel<double>().store(getKernel<double>(level));
+    getCurrentKernel<float>().store(getKernel<float>(level));
+    getCurrentLevel().store(level);
+}
+
+std::string getSimdLevelName(SimdLevel level) {
+    switch (level) {
+        case SimdLevel::Scalar: return "Scalar";
+        case SimdLevel::SSE4: return "SSE4";
+        case SimdLevel::AVX2: return "AVX2";
+        case SimdLevel::AVX512: return "AVX512";
+    }
+    return "Unknown";
+}
+
+template <std::floating_point Scalar>
+std::uint32_t intersectTriangleBlock(const BasicTriangleBlock<Scalar>& block, std::uint32_t lanes, const TriangleBlockRay<Scalar>& ray, float* distances) {
+    return getCurrentKernel<Scalar>().load(std::memory_order_relaxed)(block, lanes, ray, distances);
+}
+
+template std::uint32_t intersectTriangleBlock<double>(const TriangleBlock&, std::uint32_t, const TriangleBlockRay<double>&, float*);
+template std::uint32_t intersectTriangleBlock<float>(const BasicTriangleBlock<float>&, std::uint32_t, const TriangleBlockRay<float>&, float*);
@@ -0,0 +1,82 @@
+#include "instance.hpp"
+
+#include <stdexcept>
+
+Mesh::Mesh(std::span<const Triangle* const> triangles, unsigned int octree_max_depth, double octree_initial_size,
+           unsigned int octree_max_neighbors, ThreadPool* thread_pool) :
+        m_triangles(triangles.begin(), triangles.end()),
+        m_bounding_box(Box::empty()),
+        m_octree(octree_max_depth, octree_initial_size, octree_max_neighbors, Eigen::Vector3d::Zero(), OctreeInsertion::BoundingBox)
+{
+    if (m_triangles.empty()) {
+        throw std::invalid_argument("A mesh must have at least one triangle.");
+    }
+
+    for (const Triangle* triangle : m_triangles) {
+        m_bounding_box.extend(triangle->getBoundingBox());
+    }
+
+    // The octree is compiled now, so that the instances query it from several threads without locking
+    m_octree.build(m_triangles, thread_pool);
+    m_octree.finalize();
+}
+
+Instance::Instance(const Mesh& mesh, const Eigen::Vector3d& position, const Eigen::Vector3d& up, const Eigen::Vector3d& forward) :
+        SceneObject(position, up, forward),
+        m_mesh(&mesh)
+{
+    updateBoundingBox();
+}
+
+void Instance::updateBoundingBox() {
+    // The inverse rotation matrix is the transpose of the rotation matrix
+    const Eigen::Matrix3d inv_rot = getRotationMatrix().transpose();
+    const Box& mesh_box = m_mesh->getBoundingBox();
+
+    // The box of the instance holds the 8 corners of the box of the mesh, once placed in the global frame
+    m_bounding_box = Box::empty();
+    for (int corner = 0; corner < 8; ++corner) {
+        const Eigen::Vector3d point((corner & 4) ? mesh_box.max.x() : mesh_box.min.x(),
+                                    (corner & 2) ? mesh_box.max.y() : mesh_box.min.y(),
+                                    (corner & 1) ? mesh_box.max.z() : mesh_box.min.z());
+        m_bounding_box.extend((m_position + inv_rot * point).array());
+    }
+}
+
+Ray Instance::toMeshFrame(const Ray& ray) const {
+    // The rotation is orthonormal, so the direction stays normalized and the distances along the ray are the same in both frames
+    return Ray(getRotationMatrix() * (ray.getOrigin() - m_position), getRotationMatrix() * ray.getDirection());
+}
+
+const Triangle* Instance::traceRay(const Ray& ray, double& hit_distance, double max_distance) const {
+    return m_mesh->getOctree().traceRay(toMeshFrame(ray), hit_distance, max_distance);
+}
+
+bool Instance::intersect(const Ray& R, float& u, float& v, float& t) const {
+    InstanceHit hit;
+    if (!intersect(R, hit, t)) return false;
+    u = hit.u;
+    v = hit.v;
+    return true;
+}
+
+bool Instance::intersect(const Ray& R, InstanceHit& hit, float& t, double max_distance) const {
+    const Ray mesh_ray = toMeshFrame(R);
+    double hit_distance;
+    const Triangle* hit_triangle = m_mesh->getOctree().traceRay(mesh_ray, hit_distance, max_distance);
+    if (!hit_triangle) return false;
+
+    // Only the distance is kept by the octree, the barycentric coordinates come from the record of the hit triangle
+    const TriangleRecord& record = hit_triangle->getIntersectionRecord();
+    float record_distance;
+    if (!record.intersect(mesh_ray, hit.u, hit.v, record_distance)) {
+        record.getCoordinates(mesh_ray.getOrigin() + mesh_ray.getDirection() * hit_distance, hit.u, hit.v);
+    }
+    hit.triangle = hit_triangle;
+    t = static_cast<float>(hit_distance);
+    return true;
+}
+
+bool Instance::occluded(const Ray& R, double max_distance) const {
+    return m_mesh->getOctree().occluded(toMeshFrame(R), max_distance);
+}
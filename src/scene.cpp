@@ -1,84 +1,431 @@
 #include "scene.hpp"
 
 #include <iostream>
-#include <chrono>
-using namespace std::chrono;
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <unordered_set>
 
-Render Scene::getRender() const {
-    // auto t0 = high_resolution_clock::now();
+void Scene::setThreadCount(unsigned int thread_count) {
+    if (thread_count == 1) {
+        m_thread_pool.reset(); // Render serially
+    } else {
+        m_thread_pool = std::make_unique<ThreadPool>(thread_count);
+    }
+}
 
-    const std::tuple<const unsigned int, const unsigned int> dimensions = m_camera->getDimensions();
-    const unsigned int verticalResolution = std::get<0>(dimensions);
-    const unsigned int horizontalResolution = std::get<1>(dimensions);
+void Scene::setTileSize(unsigned int tile_size) {
+    if (tile_size == 0) {
+        throw std::invalid_argument("The tile size must be greater than zero.");
+    }
+    m_tile_size = tile_size;
+}
 
-    // auto t1 = high_resolution_clock::now();
+const Instance* Scene::traceInstances(const Ray& ray, double& hit_distance, InstanceHit& hit) const {
+    // The hierarchy traces each instance up to the closest hit so far, and keeps the hit triangle of the closest one
+    double instance_distance;
+    const Instance* hit_instance = m_instance_hierarchy.traceRay(ray, instance_distance, hit, hit_distance);
+    if (hit_instance) hit_distance = instance_distance;
+    return hit_instance;
+}
 
-    Render my_render(verticalResolution, horizontalResolution);
+template <typename Structure>
+void Scene::shadePixel(const Structure& structure, const Ray& ray, const Triangle* hit_triangle, double hit_distance,
+                       unsigned int linear_id, Render& render) const {
+    Eigen::Vector3d triangle_normal; // The normal vector of the hit triangle
+    bool hit = hit_triangle != nullptr;
+    if (hit) {
+        triangle_normal = hit_triangle->getNormal();
+    } else {
+        hit_distance = std::numeric_limits<double>::infinity();
+    }
+
+    // A triangle of an instance closer than the hit triangle replaces it
+    if (!m_instances.empty()) {
+        InstanceHit instance_hit;
+        if (const Instance* hit_instance = traceInstances(ray, hit_distance, instance_hit)) {
+            triangle_normal = hit_instance->toGlobalFrame(instance_hit.triangle->getNormal());
+            hit = true;
+        }
+    }
+
+    // If a triangle was hit, calculate the color intensity based on the light source
+    if(hit) {
+        Eigen::Vector3d hit_position = ray.getOrigin() + ray.getDirection() * hit_distance; // Calculate the intersection point
+        Eigen::Vector3d lightDirection = m_lightSource->getPosition() - hit_position;
+        const double light_distance = lightDirection.norm();
+        lightDirection.normalize(); // Normalize the light direction vector
 
-    // auto t2 = high_resolution_clock::now();
+        // Calculate the dot product between the triangle normal and the light direction
+        float dotProduct = triangle_normal.dot(lightDirection);
 
+        // The triangle faces the light source: it is lit unless another triangle lies between them.
+        // The shadow ray leaves slightly above the triangle so that it does not hit the triangle itself,
+        //      and any hit before the light source is enough to shadow the point
+        bool lit = dotProduct > 0;
+        if (lit) {
+            const Ray shadow_ray(hit_position + triangle_normal * SHADOW_RAY_OFFSET, lightDirection);
+            lit = !structure.occluded(shadow_ray, light_distance - SHADOW_RAY_OFFSET) &&
+                  (m_instances.empty() || !m_instance_hierarchy.occluded(shadow_ray, light_distance - SHADOW_RAY_OFFSET));
+        }
+
+        // If the triangle is lit by the light source, the color depends on the angle between the normal and the light direction
+        if (lit) {
+            // Calculate the color intensity based on the dot product
+            unsigned char intensity = dotProduct * m_lightSource->getIntensity();
+
+            render.render(linear_id, 0) = intensity; // Set the pixel color in the render
+            render.render(linear_id, 1) = intensity; // Set the pixel color in the render
+            render.render(linear_id, 2) = intensity; // Set the pixel color in the render
+        } else {
+            render.render(linear_id, 0) = 50;
+        }
+    }
+}
+
+template <typename Structure>
+void Scene::renderTile(const Structure& structure, unsigned int first_row, unsigned int first_column,
+                       unsigned int last_row, unsigned int last_column, Render& render) const {
+    const unsigned int horizontalResolution = render.horizontalResolution;
     const std::vector<Ray>& rays = m_camera->getRays(); // Generate rays from the camera
 
-    // auto t3 = high_resolution_clock::now();
-
-    // auto tracing_time = 0.0;
-
-    // Iterate through each pixel in the frame
-    // Each pixel corresponds to a ray in the rays vector
-    for (int linear_id(0); linear_id < verticalResolution * horizontalResolution; ++linear_id) 
-    {
-        const Ray& ray = rays[linear_id];
-
-        double hit_distance;
-        // auto t_start = high_resolution_clock::now();
-        const Triangle* hit_triangle = m_octree.traceRay(ray, hit_distance); // Check for intersection with the octree
-        // auto t_end = high_resolution_clock::now();
-        // tracing_time += duration_cast<nanoseconds>(t_end - t_start).count(); // Measure the time taken for ray tracing
-
-        // If a triangle was hit, calculate the color intensity based on the light source
-        if(hit_triangle) {
-            Eigen::Vector3d triangle_normal = hit_triangle->getNormal(); // Get the normal vector of the triangle
-            Eigen::Vector3d hit_position = ray.getOrigin() + ray.getDirection() * hit_distance; // Calculate the intersection point
-            Eigen::Vector3d lightDirection = m_lightSource->getPosition() - hit_position;
-            lightDirection.normalize(); // Normalize the light direction vector
-
-            // Calculate the dot product between the triangle normal and the light direction
-            float dotProduct = triangle_normal.dot(lightDirection);
-            // If the dot product is positive, the triangle is lit by the light source
-            if (dotProduct > 0) {
-                // Calculate the color intensity based on the dot product
-                unsigned char intensity = dotProduct * m_lightSource->getIntensity();
-                // std::cout << "Pixel (" << i << ", " << j << ") is lit with intensity: " << static_cast<int>(intensity) << std::endl;
-                // std::cout << m_lightSource->getIntensity() << std::endl;
-
-                my_render.render(linear_id, 0) = intensity; // Set the pixel color in the render
-                my_render.render(linear_id, 1) = intensity; // Set the pixel color in the render
-                my_render.render(linear_id, 2) = intensity; // Set the pixel color in the render
-            } else {
-                my_render.render(linear_id, 0) = 50;
+    // Structures without packet traversal trace the rays of the tile one by one
+    if constexpr (!PacketTraceable<Structure>) {
+        for (unsigned int i = first_row; i < last_row; ++i) {
+            for (unsigned int j = first_column; j < last_column; ++j) {
+                const unsigned int linear_id = i * horizontalResolution + j;
+                double hit_distance;
+                const Triangle* hit_triangle = structure.traceRay(rays[linear_id], hit_distance);
+                shadePixel(structure, rays[linear_id], hit_triangle, hit_distance, linear_id, render);
+            }
+        }
+    } else {
+        // The rays of the tile lie in its frustum: the nodes crossed by the frustum are collected once, and the packets start from them.
+        // Only the rays going towards the octant of the corners of the tile are traced from these nodes, the others from the root
+        OctreeEntryPoints entry_points;
+        if constexpr (TileCullable<Structure>) {
+            const unsigned char signs = getDirectionOctant(rays[first_row * horizontalResolution + first_column].getDirection());
+            if (getDirectionOctant(rays[first_row * horizontalResolution + last_column - 1].getDirection()) == signs &&
+                getDirectionOctant(rays[(last_row - 1) * horizontalResolution + first_column].getDirection()) == signs &&
+                getDirectionOctant(rays[(last_row - 1) * horizontalResolution + last_column - 1].getDirection()) == signs) {
+                const std::array<Plane, 4> frustum = m_camera->getFrustum(first_row, first_column, last_row, last_column);
+                structure.cullFrustum(frustum, signs, entry_points);
+            }
+        }
+
+        // Trace the camera rays by blocks of neighboring pixels, which are coherent enough to go through the structure together.
+        // The blocks on the borders of the tile are partial, their missing pixels are inactive lanes of the packet
+        for (unsigned int i = first_row; i < last_row; i += PACKET_HEIGHT) {
+            for (unsigned int j = first_column; j < last_column; j += PACKET_WIDTH) {
+                RayPacket<PACKET_SIZE> packet;
+                unsigned int linear_ids[PACKET_SIZE];
+                for (unsigned int lane_row = 0; lane_row < PACKET_HEIGHT && i + lane_row < last_row; ++lane_row) {
+                    for (unsigned int lane_column = 0; lane_column < PACKET_WIDTH && j + lane_column < last_column; ++lane_column) {
+                        const unsigned int lane = lane_row * PACKET_WIDTH + lane_column;
+                        linear_ids[lane] = (i + lane_row) * horizontalResolution + j + lane_column;
+                        packet.set(lane, rays[linear_ids[lane]]);
+                    }
+                }
+
+                typename RayPacket<PACKET_SIZE>::Lanes hit_distances;
+                std::array<const Triangle*, PACKET_SIZE> hit_triangles;
+                if constexpr (TileCullable<Structure>) {
+                    hit_triangles = structure.traceRays(packet, hit_distances, entry_points);
+                } else {
+                    hit_triangles = structure.traceRays(packet, hit_distances);
+                }
+                for (unsigned int lane = 0; lane < PACKET_SIZE; ++lane) {
+                    if (packet.active & (1u << lane)) {
+                        shadePixel(structure, *packet.rays[lane], hit_triangles[lane], hit_distances[lane], linear_ids[lane], render);
+                    }
+                }
+            }
+        }
+    }
+}
+
+template <typename Structure>
+void Scene::renderPixels(const Structure& structure, Render& render) const {
+    const unsigned int verticalResolution = render.verticalResolution;
+    const unsigned int horizontalResolution = render.horizontalResolution;
+
+    // Split the frame in square tiles, whose narrow frustums let the structures skip the nodes out of sight once per tile (see renderTile)
+    const unsigned int vertical_tiles = (verticalResolution + m_tile_size - 1) / m_tile_size;
+    const unsigned int horizontal_tiles = (horizontalResolution + m_tile_size - 1) / m_tile_size;
+    const auto render_tile = [&](std::size_t tile_index) {
+        const unsigned int first_row = (tile_index / horizontal_tiles) * m_tile_size;
+        const unsigned int first_column = (tile_index % horizontal_tiles) * m_tile_size;
+        const unsigned int last_row = std::min(first_row + m_tile_size, verticalResolution);
+        const unsigned int last_column = std::min(first_column + m_tile_size, horizontalResolution);
+
+        renderTile(structure, first_row, first_column, last_row, last_column, render);
+    };
+
+    // Serial rendering: the tiles one after the other
+    if (!m_thread_pool) {
+        for (std::size_t tile_index = 0; tile_index < std::size_t(vertical_tiles) * horizontal_tiles; ++tile_index) {
+            render_tile(tile_index);
+        }
+        return;
+    }
+
+    // Parallel rendering: each tile is one task of the thread pool
+    // The tiles are written to disjoint pixels of the render, so no synchronization is needed
+    m_thread_pool->run(vertical_tiles * horizontal_tiles, [&](std::size_t tile_index, unsigned int) { render_tile(tile_index); });
+}
+
+std::vector<MortonKey> Scene::sortRays(std::span<const Ray> rays) const {
+    // The origins are located in the cube bounding them, the directions in the cube bounding the unit sphere
+    Box origins = Box::empty();
+    for (const Ray& ray : rays) {
+        origins.extend(ray.getOrigin().array());
+    }
+    const double origin_size = std::max((origins.max - origins.min).maxCoeff(), std::numeric_limits<double>::min());
+    const Box origin_cube{origins.min, origins.min + origin_size};
+    const Box direction_cube{Eigen::Array3d::Constant(-1.0), Eigen::Array3d::Constant(1.0)};
+
+    // Only the first levels of the Morton codes are kept: the rays of a cell of origins are then sorted by their directions
+    constexpr unsigned int code_shift = 3 * (MORTON_LEVELS - CAST_ORDER_LEVELS);
+    std::vector<MortonKey> keys(rays.size());
+    for (std::size_t i = 0; i < rays.size(); ++i) {
+        const std::uint64_t octant = getDirectionOctant(rays[i].getDirection());
+        const std::uint64_t origin_code = getMortonCode(rays[i].getOrigin(), origin_cube) >> code_shift;
+        const std::uint64_t direction_code = getMortonCode(rays[i].getDirection(), direction_cube) >> code_shift;
+        keys[i] = MortonKey{octant << (6 * CAST_ORDER_LEVELS) | origin_code << (3 * CAST_ORDER_LEVELS) | direction_code,
+                            static_cast<std::uint32_t>(i)};
+    }
+    sortMortonKeys(keys, m_thread_pool.get());
+    return keys;
+}
+
+template <typename Structure>
+void Scene::castRayBatch(const Structure& structure, std::span<const Ray> rays, std::span<const MortonKey> batch, std::span<Hit> hits) const {
+    std::vector<Ray> batch_rays(batch.size());
+    for (std::size_t i = 0; i < batch.size(); ++i) {
+        batch_rays[i] = rays[batch[i].index];
+    }
+
+    std::vector<double> hit_distances(batch.size());
+    std::vector<const Triangle*> hit_triangles;
+    if constexpr (requires { structure.traceRayStream(std::span<const Ray>(batch_rays), std::span<double>(hit_distances)); }) {
+        hit_triangles = structure.traceRayStream(batch_rays, hit_distances);
+    } else {
+        hit_triangles.resize(batch.size());
+        for (std::size_t i = 0; i < batch.size(); ++i) {
+            hit_triangles[i] = structure.traceRay(batch_rays[i], hit_distances[i]);
+        }
+    }
+
+    for (std::size_t i = 0; i < batch.size(); ++i) {
+        Hit& hit = hits[batch[i].index];
+        hit = Hit();
+        if (hit_triangles[i]) {
+            hit.triangle = hit_triangles[i];
+            hit.distance = hit_distances[i];
+        }
+
+        // A triangle of an instance closer than the hit triangle replaces it, with its barycentric coordinates
+        if (!m_instances.empty()) {
+            InstanceHit instance_hit;
+            if (const Instance* hit_instance = traceInstances(batch_rays[i], hit.distance, instance_hit)) {
+                hit.triangle = instance_hit.triangle;
+                hit.instance = hit_instance;
+                hit.u = instance_hit.u;
+                hit.v = instance_hit.v;
+                hit.normal = hit_instance->toGlobalFrame(hit.triangle->getNormal());
+                continue;
             }
         }
+        if (!hit.triangle) continue;
+
+        // Only the distance is kept by the structures, the barycentric coordinates come from the intersection record of the hit triangle,
+        // which the structures test too. If its test misses the ray, eg on an edge for a structure testing in another precision,
+        // the coordinates are the ones of the hit point
+        const TriangleRecord& record = hit.triangle->getIntersectionRecord();
+        float t;
+        if (!record.intersect(batch_rays[i], hit.u, hit.v, t)) {
+            record.getCoordinates(batch_rays[i].getOrigin() + batch_rays[i].getDirection() * hit.distance, hit.u, hit.v);
+        }
+        hit.normal = hit.triangle->getNormal();
     }
+}
 
-    // auto t4 = high_resolution_clock::now();
+void Scene::castRays(std::span<const Ray> rays, std::span<Hit> hits) {
+    if (hits.size() != rays.size()) {
+        throw std::invalid_argument("There must be one hit record per ray.");
+    }
+    flushUpdates();
+    m_instance_hierarchy.finalize(); // Rebuild the hierarchy of the instances now rather than in the first query of a batch
 
-    // std::cout << "Time taken for resolution: "
-    //           << duration_cast<milliseconds>(t1 - t0).count() << " ms" << std::endl;
-    // std::cout << "Time taken for render: "
-    //           << duration_cast<milliseconds>(t2 - t1).count() << " ms" << std::endl;
-    // std::cout << "Time taken for ray generation: "
-    //             << duration_cast<milliseconds>(t3 - t2).count() << " ms" << std::endl;
-    // std::cout << "Time taken for intersection: "
-    //             << duration_cast<milliseconds>(t4 - t3).count() << " ms" << std::endl;
-    // std::cout << "Total time taken for ray tracing: "
-    //           << tracing_time * 1e-6 << " ms"
-    //           << " (" << tracing_time / duration_cast<nanoseconds>(t4 - t0).count() * 100 << " % of total time)" << std::endl;
-    // std::cout << "Total time taken: "
-    //           << duration_cast<milliseconds>(t4 - t0).count() << " ms"  << std::endl;
+    // Incoherent rays, eg of a sensor, are sorted so that each batch gathers rays of close origins and directions,
+    // which the structures trace faster together than the rays spread over the scene in their order
+    const std::vector<MortonKey> order = sortRays(rays);
+
+    // Each batch of rays is one task of the thread pool, and writes to the hit records of its own rays
+    const std::size_t batch_count = (rays.size() + CAST_BATCH_SIZE - 1) / CAST_BATCH_SIZE;
+    std::visit([&](const auto& structure) {
+        auto castBatch = [&](std::size_t batch_index) {
+            const std::size_t first = batch_index * CAST_BATCH_SIZE;
+            const std::size_t count = std::min(CAST_BATCH_SIZE, rays.size() - first);
+            castRayBatch(structure, rays, std::span<const MortonKey>(order).subspan(first, count), hits);
+        };
+        if (!m_thread_pool) {
+            for (std::size_t batch_index = 0; batch_index < batch_count; ++batch_index) {
+                castBatch(batch_index);
+            }
+        } else {
+            m_thread_pool->run(batch_count, [&](std::size_t batch_index, unsigned int) { castBatch(batch_index); });
+        }
+    }, m_acceleration_structure);
+}
+
+Render Scene::getRender() {
+    flushUpdates();
+    m_instance_hierarchy.finalize(); // Rebuild the hierarchy of the instances now rather than in the first query of a tile
+
+    const std::tuple<const unsigned int, const unsigned int> dimensions = m_camera->getDimensions();
+    const unsigned int verticalResolution = std::get<0>(dimensions);
+    const unsigned int horizontalResolution = std::get<1>(dimensions);
+
+    Render my_render(verticalResolution, horizontalResolution);
+
+    // Dispatch once on the type of the acceleration structure, the pixels are then rendered without indirection
+    std::visit([&](const auto& structure) { renderPixels(structure, my_render); }, m_acceleration_structure);
 
     return my_render;
 }
 
-void Scene::addTriangle(Triangle* triangle) {
-    m_octree.insert(triangle); // Insert the triangle into the octree
-}
\ No newline at end of file
+bool Scene::addTriangle(Triangle* triangle) {
+    // A triangle inserted twice would be referenced twice by the acceleration structure, and removed from it only once
+    if (!m_triangle_entries.try_emplace(triangle, TriangleEntry{m_triangles.size(), false}).second) return false;
+
+    std::visit([&](auto& structure) { structure.insert(triangle); }, m_acceleration_structure);
+    m_triangles.push_back(triangle);
+    return true;
+}
+
+void Scene::addTriangles(std::span<Triangle* const> triangles) {
+    compactTriangles();
+    for (Triangle* triangle : triangles) {
+        if (m_triangle_entries.try_emplace(triangle, TriangleEntry{m_triangles.size(), false}).second) m_triangles.push_back(triangle);
+    }
+
+    // The rebuild places all the triangles where they are now
+    for (const Triangle* triangle : m_moved_triangles) m_triangle_entries.at(triangle).moved = false;
+    m_moved_triangles.clear();
+
+    // Rebuild the acceleration structure with all the triangles at once
+    std::visit([&](auto& structure) { structure.build(m_triangles, m_thread_pool.get()); }, m_acceleration_structure);
+}
+
+void Scene::loadTriangles(std::span<Triangle* const> triangles, const std::string& path) {
+    Octree<Triangle>* octree = std::get_if<Octree<Triangle>>(&m_acceleration_structure);
+    if (!octree) {
+        throw std::invalid_argument("Cannot load triangles: Only an octree can be loaded from a file.");
+    }
+
+    // The saved octree indexes all the triangles of the scene, the new ones after the ones already there
+    std::unordered_set<const Triangle*> new_triangles;
+    for (const Triangle* triangle : triangles) {
+        if (m_triangle_entries.contains(triangle) || !new_triangles.insert(triangle).second) {
+            throw std::invalid_argument("Cannot load triangles: A triangle is already in the scene or repeated.");
+        }
+    }
+    compactTriangles();
+    std::vector<const Triangle*> scene_triangles = m_triangles;
+    scene_triangles.insert(scene_triangles.end(), triangles.begin(), triangles.end());
+    octree->load(path, scene_triangles);
+
+    for (Triangle* triangle : triangles) {
+        m_triangle_entries.try_emplace(triangle, TriangleEntry{m_triangles.size(), false});
+        m_triangles.push_back(triangle);
+    }
+    for (const Triangle* triangle : m_moved_triangles) m_triangle_entries.at(triangle).moved = false;
+    m_moved_triangles.clear();
+}
+
+void Scene::saveAccelerationStructure(const std::string& path) {
+    Octree<Triangle>* octree = std::get_if<Octree<Triangle>>(&m_acceleration_structure);
+    if (!octree) {
+        throw std::invalid_argument("Cannot save the acceleration structure: Only an octree can be saved to a file.");
+    }
+
+    flushUpdates();
+    compactTriangles();
+    octree->save(path, m_triangles);
+}
+
+bool Scene::removeTriangle(const Triangle* triangle) {
+    auto entry = m_triangle_entries.find(triangle);
+    if (entry == m_triangle_entries.end()) return false;
+
+    m_triangles[entry->second.index] = nullptr;
+    ++m_removed_triangle_count;
+    if (entry->second.moved) std::erase(m_moved_triangles, triangle);
+    m_triangle_entries.erase(entry);
+    std::visit([&](auto& structure) { structure.remove(triangle); }, m_acceleration_structure);
+
+    // Drop the null pointers once they are as many as the triangles, so that the removals stay constant time on average
+    if (2 * m_removed_triangle_count > m_triangles.size()) compactTriangles();
+    return true;
+}
+
+void Scene::updateTriangle(const Triangle* triangle) {
+    auto entry = m_triangle_entries.find(triangle);
+    if (entry == m_triangle_entries.end()) {
+        throw std::invalid_argument("Cannot update triangle: The triangle is not in the scene.");
+    }
+    if (entry->second.moved) return;
+
+    entry->second.moved = true;
+    m_moved_triangles.push_back(triangle);
+}
+
+void Scene::flushUpdates() {
+    if (m_moved_triangles.empty()) return;
+
+    // The updated triangles are unmarked even if one of them fails, so that the scene does not throw again at every render
+    std::size_t updated_count = 0;
+    try {
+        std::visit([&](auto& structure) {
+            for (const Triangle* triangle : m_moved_triangles) {
+                m_triangle_entries.at(triangle).moved = false;
+                ++updated_count;
+                structure.update(triangle);
+            }
+        }, m_acceleration_structure);
+    } catch (...) {
+        m_moved_triangles.erase(m_moved_triangles.begin(), m_moved_triangles.begin() + updated_count);
+        throw;
+    }
+    m_moved_triangles.clear();
+}
+
+void Scene::compactTriangles() {
+    if (m_removed_triangle_count == 0) return;
+
+    std::erase(m_triangles, nullptr);
+    m_removed_triangle_count = 0;
+    for (std::size_t i = 0; i < m_triangles.size(); ++i) {
+        auto entry = m_triangle_entries.find(m_triangles[i]);
+        if (entry != m_triangle_entries.end()) entry->second.index = i;
+    }
+}
+
+void Scene::addInstance(Instance* instance) {
+    m_instances.push_back(instance);
+    m_instance_hierarchy.insert(instance);
+}
+
+bool Scene::removeInstance(const Instance* instance) {
+    auto position = std::find(m_instances.begin(), m_instances.end(), instance);
+    if (position == m_instances.end()) return false;
+
+    m_instances.erase(position);
+    m_instance_hierarchy.remove(instance);
+    return true;
+}
+
+void Scene::updateInstance(const Instance* instance) {
+    m_instance_hierarchy.update(instance);
+}
@@ -0,0 +1,132 @@
+#include "threadPool.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace {
+    // The pool whose worker is the current thread, nullptr outside the workers
+    thread_local const ThreadPool* current_pool = nullptr;
+}
+
+ThreadPool::ThreadPool(unsigned int thread_count) {
+    if (thread_count == 0) {
+        thread_count = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    m_queues.reserve(thread_count);
+    for (unsigned int i = 0; i < thread_count; ++i) {
+        m_queues.push_back(std::make_unique<WorkQueue>());
+    }
+
+    m_workers.reserve(thread_count);
+    for (unsigned int i = 0; i < thread_count; ++i) {
+        m_workers.emplace_back(&ThreadPool::workerLoop, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_wake_condition.notify_all();
+
+    for (std::thread& worker : m_workers) {
+        worker.join();
+    }
+}
+
+void ThreadPool::run(std::size_t task_count, const Task& task) {
+    if (current_pool == this) {
+        throw std::logic_error("A task of the thread pool cannot run a batch on the same pool.");
+    }
+    if (task_count == 0) return;
+
+    const std::size_t worker_count = m_workers.size();
+
+    // One batch at a time: the batch state below is shared by all the callers
+    std::lock_guard<std::mutex> run_lock(m_run_mutex);
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_task = &task;
+    m_exception = nullptr;
+    m_remaining_tasks = task_count;
+
+    // Split the tasks in contiguous blocks, one per worker
+    for (std::size_t w = 0; w < worker_count; ++w) {
+        std::lock_guard<std::mutex> queue_lock(m_queues[w]->mutex);
+        for (std::size_t i = w * task_count / worker_count; i < (w + 1) * task_count / worker_count; ++i) {
+            m_queues[w]->tasks.push_back(i);
+        }
+    }
+
+    // Wake up the workers and wait for the whole batch to be completed
+    ++m_batch;
+    m_wake_condition.notify_all();
+    m_done_condition.wait(lock, [this] { return m_remaining_tasks == 0; });
+    m_task = nullptr;
+
+    if (m_exception) {
+        std::rethrow_exception(m_exception);
+    }
+}
+
+bool ThreadPool::popTask(unsigned int worker_index, std::size_t& task_index) {
+    // Take the next task from the front of the worker's own queue
+    {
+        WorkQueue& own_queue = *m_queues[worker_index];
+        std::lock_guard<std::mutex> lock(own_queue.mutex);
+        if (!own_queue.tasks.empty()) {
+            task_index = own_queue.tasks.front();
+            own_queue.tasks.pop_front();
+            return true;
+        }
+    }
+
+    // Steal from the back of the other queues, starting with the next worker
+    const std::size_t worker_count = m_queues.size();
+    for (std::size_t offset = 1; offset < worker_count; ++offset) {
+        WorkQueue& victim_queue = *m_queues[(worker_index + offset) % worker_count];
+        std::lock_guard<std::mutex> lock(victim_queue.mutex);
+        if (!victim_queue.tasks.empty()) {
+            task_index = victim_queue.tasks.back();
+            victim_queue.tasks.pop_back();
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void ThreadPool::workerLoop(unsigned int worker_index) {
+    current_pool = this;
+    std::size_t last_batch = 0;
+
+    while (true) {
+        {
+            // Wait for a new batch of tasks (or for the pool to be destroyed)
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wake_condition.wait(lock, [&] { return m_stop || m_batch != last_batch; });
+            if (m_stop) return;
+
+            last_batch = m_batch;
+        }
+
+        std::size_t task_index;
+        while (popTask(worker_index, task_index)) {
+            // The task is read after popping: a worker late on one batch may already pop tasks of the next one
+            const Task* task = m_task.load();
+            try {
+                (*task)(task_index, worker_index);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                if (!m_exception) m_exception = std::current_exception();
+            }
+
+            // The last task of the batch wakes up the thread waiting in `run`
+            if (--m_remaining_tasks == 0) {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_done_condition.notify_all();
+            }
+        }
+    }
+}
@@ -38,6 +38,9 @@ void Triangle::updatePoints() {
     m_bounding_box.max << std::max({m_global_point0.x(), m_global_point1.x(), m_global_point2.x()}),
                             std::max({m_global_point0.y(), m_global_point1.y(), m_global_point2.y()}),
                             std::max({m_global_point0.z(), m_global_point1.z(), m_global_point2.z()});
+
+    m_intersection_record = TriangleRecord{m_global_point0, (m_global_point1 - m_global_point0).cast<float>(),
+                                           (m_global_point2 - m_global_point0).cast<float>()};
 }
 
 const Eigen::Vector3d& Triangle::getPoint(int i) const {
@@ -58,37 +61,57 @@ const Eigen::Vector3d& Triangle::getNormal() const {
     return m_global_normal;
 }
 
-// The interesectRay method is based on the algorithm described by BrunoLevy at:
-// https://stackoverflow.com/questions/42740765/intersection-between-line-and-triangle-in-3d
-//
-// Explanation of the algorithm:
-//      https://tavianator.com/2014/ray_triangle.html
+// The intersection test is the algorithm of Möller and Trumbore ("Fast, Minimum Storage Ray/Triangle Intersection", 1997).
+// It is in TriangleRecord::intersect, which the octree runs on the records of its leaves, so that the hits are the same with every structure.
+// There is no bounding box check first: a ray grazing an edge could miss the box after rounding while the record hits the triangle.
 bool Triangle::intersect(const Ray& R, float& u, float& v, float& t) const {
-    // AABB (Axis-Aligned Bounding Box) check
-    // If the ray does not intersect the bounding box of the triangle, return false
-    double box_t;
-    if (!m_bounding_box.intersect(R, box_t)) {
-        return false;
-    }
-    
+    return m_intersection_record.intersect(R, u, v, t);
+}
+
+// The closestPoint method is based on the algorithm described by Christer Ericson in
+// "Real-Time Collision Detection" (2005), section 5.1.5.
+//
+// The point is projected on the plane of the triangle, then the Voronoi region of the triangle containing it
+// (one of the 3 vertices, one of the 3 edges or the face) is found from its barycentric coordinates.
+Eigen::Vector3d Triangle::closestPoint(const Eigen::Vector3d& point) const {
     const Eigen::Vector3d& A = getPoint(0);
     const Eigen::Vector3d& B = getPoint(1);
     const Eigen::Vector3d& C = getPoint(2);
 
-    Eigen::Vector3d E1 = B-A;
-    Eigen::Vector3d E2 = C-A;
-    Eigen::Vector3d N = E1.cross(E2);
-    float det = -R.getDirection().dot(N);
-    float invdet = 1.0/det;
-    Eigen::Vector3d AO  = R.getOrigin() - A;
-    Eigen::Vector3d DAO = AO.cross(R.getDirection());
+    const Eigen::Vector3d AB = B - A;
+    const Eigen::Vector3d AC = C - A;
+
+    // Vertex region of A
+    const Eigen::Vector3d AP = point - A;
+    const double d1 = AB.dot(AP);
+    const double d2 = AC.dot(AP);
+    if (d1 <= 0 && d2 <= 0) return A;
+
+    // Vertex region of B
+    const Eigen::Vector3d BP = point - B;
+    const double d3 = AB.dot(BP);
+    const double d4 = AC.dot(BP);
+    if (d3 >= 0 && d4 <= d3) return B;
 
-    // Calculate the barycentric coordinates of the intersection (u, v, 1-u-v) 
-    u =  E2.dot(DAO) * invdet;
-    v = -E1.dot(DAO) * invdet;
+    // Edge region of AB
+    const double vc = d1 * d4 - d3 * d2;
+    if (vc <= 0 && d1 >= 0 && d3 <= 0) return A + d1 / (d1 - d3) * AB;
 
-    // Calculate the distance from the ray origin to the intersection point
-    t = AO.dot(N) * invdet;
+    // Vertex region of C
+    const Eigen::Vector3d CP = point - C;
+    const double d5 = AB.dot(CP);
+    const double d6 = AC.dot(CP);
+    if (d6 >= 0 && d5 <= d6) return C;
 
-    return (std::fabs(det) >= 1e-6 && t >= 0 && u >= 0 && v >= 0 && (u+v) <= 1);
-}
\ No newline at end of file
+    // Edge region of AC
+    const double vb = d5 * d2 - d1 * d6;
+    if (vb <= 0 && d2 >= 0 && d6 <= 0) return A + d2 / (d2 - d6) * AC;
+
+    // Edge region of BC
+    const double va = d3 * d6 - d5 * d4;
+    if (va <= 0 && (d4 - d3) >= 0 && (d5 - d6) >= 0) return B + (d4 - d3) / ((d4 - d3) + (d5 - d6)) * (C - B);
+
+    // Face region
+    const double denominator = 1 / (va + vb + vc);
+    return A + AB * (vb * denominator) + AC * (vc * denominator);
+}
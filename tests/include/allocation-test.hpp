@@ -0,0 +1,12 @@
+#pragma once
+#include <doctest/doctest.h>
+
+#include <atomic>
+#include <cstddef>
+
+#include "Structures/octree.hpp"
+#include "triangle.hpp"
+
+/// @brief Get the number of calls to the global operator new since the start of the tests
+/// @note The global operator new is replaced in allocation-test.cpp to count the allocations
+std::size_t getAllocationCount();
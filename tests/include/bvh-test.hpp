@@ -0,0 +1,12 @@
+#pragma once
+#include <doctest/doctest.h>
+
+#include "Structures/bvh.hpp"
+#include "Structures/octree.hpp"
+#include "triangle.hpp"
+#include "threadPool.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <random>
+#include <vector>
@@ -0,0 +1,7 @@
+#pragma once
+#include <doctest/doctest.h>
+
+#include "instance.hpp"
+#include "triangle.hpp"
+#include "Structures/bvh.hpp"
+#include "Structures/ray.hpp"
@@ -1,9 +1,25 @@
 #pragma once
 #include <doctest/doctest.h>
 
+#include "camera.hpp"
 #include "Structures/octree.hpp"
+#include "Structures/triangleBlocks.hpp"
 #include "triangle.hpp"
 
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <limits>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
 class MockTriangle {
     public:
         Eigen::Vector3d position;
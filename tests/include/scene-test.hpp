@@ -0,0 +1,10 @@
+#pragma once
+#include <doctest/doctest.h>
+
+#include <Eigen/Dense>
+#include "camera.hpp"
+#include "light.hpp"
+#include "triangle.hpp"
+#include "instance.hpp"
+#include "scene.hpp"
+#include "threadPool.hpp"
@@ -0,0 +1,85 @@
+#include "allocation-test.hpp"
+
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+// Replace the global allocation functions to count the number of allocations of the test executable
+static std::atomic<std::size_t> allocation_count{0};
+
+std::size_t getAllocationCount() {
+    return allocation_count.load();
+}
+
+void* operator new(std::size_t size) {
+    ++allocation_count;
+    if (void* pointer = std::malloc(size ? size : 1)) return pointer;
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size) {
+    return operator new(size);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment) {
+    ++allocation_count;
+    // std::aligned_alloc requires the size to be a multiple of the alignment
+    std::size_t align = static_cast<std::size_t>(alignment);
+    std::size_t aligned_size = (size + align - 1) / align * align;
+    if (void* pointer = std::aligned_alloc(align, aligned_size ? aligned_size : align)) return pointer;
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment) {
+    return operator new(size, alignment);
+}
+
+void operator delete(void* pointer) noexcept { std::free(pointer); }
+void operator delete[](void* pointer) noexcept { std::free(pointer); }
+void operator delete(void* pointer, std::size_t) noexcept { std::free(pointer); }
+void operator delete[](void* pointer, std::size_t) noexcept { std::free(pointer); }
+void operator delete(void* pointer, std::align_val_t) noexcept { std::free(pointer); }
+void operator delete[](void* pointer, std::align_val_t) noexcept { std::free(pointer); }
+void operator delete(void* pointer, std::size_t, std::align_val_t) noexcept { std::free(pointer); }
+void operator delete[](void* pointer, std::size_t, std::align_val_t) noexcept { std::free(pointer); }
+
+TEST_CASE("[Octree] testing that ray tracing does not allocate memory") {
+    Octree<Triangle> octree(6, 2.0, 2, Eigen::Vector3d::Zero());
+
+    // A small grid of triangles, so that the octree has several levels
+    std::vector<Triangle> triangles;
+    triangles.reserve(64);
+    for (int i = 0; i < 8; ++i) {
+        for (int j = 0; j < 8; ++j) {
+            Eigen::Vector3d corner(-1.0 + 0.25 * i, -1.0 + 0.25 * j, 0.1 * ((i + j) % 3));
+            triangles.emplace_back(corner, corner + Eigen::Vector3d(0.2, 0, 0), corner + Eigen::Vector3d(0, 0.2, 0));
+        }
+    }
+    for (const Triangle& triangle : triangles) {
+        octree.insert(&triangle);
+    }
+
+    // Rays aimed at the triangles, and rays aimed between them
+    std::vector<Ray> rays;
+    rays.reserve(2 * triangles.size());
+    for (const Triangle& triangle : triangles) {
+        Eigen::Vector3d target = triangle.getPoint(0) + Eigen::Vector3d(0.05, 0.05, 0);
+        rays.emplace_back(Eigen::Vector3d(0.1, 0.2, -3), target - Eigen::Vector3d(0.1, 0.2, -3));
+        rays.emplace_back(Eigen::Vector3d(0.1, 0.2, -3), target + Eigen::Vector3d(0.17, 0.17, 0) - Eigen::Vector3d(0.1, 0.2, -3));
+    }
+
+    // Compile the flat layout before measuring, the compilation itself allocates memory
+    octree.finalize();
+
+    // Trace all the rays and make sure that no allocation happened meanwhile
+    unsigned int hits = 0;
+    const std::size_t allocations_before = getAllocationCount();
+    for (const Ray& ray : rays) {
+        double hit_distance;
+        hits += octree.traceRay(ray, hit_distance) != nullptr;
+    }
+    const std::size_t allocations_after = getAllocationCount();
+
+    CHECK(hits > 0);
+    CHECK(allocations_after == allocations_before);
+}
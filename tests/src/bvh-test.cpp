@@ -0,0 +1,185 @@
+#include "bvh-test.hpp"
+
+/// @brief Small random triangles in a few dense clusters, to get an uneven distribution
+static std::vector<Triangle> makeClusteredTriangles(unsigned int count, unsigned int seed) {
+    std::mt19937 generator(seed);
+    std::normal_distribution<double> normal(0.0, 0.3);
+    std::uniform_real_distribution<double> unit(-0.5, 0.5);
+    const Eigen::Vector3d cluster_centers[3] = {Eigen::Vector3d(-3, 0, 4), Eigen::Vector3d(2, 1, 6), Eigen::Vector3d(0, -2, 9)};
+
+    std::vector<Triangle> triangles;
+    triangles.reserve(count);
+    for (unsigned int i = 0; i < count; ++i) {
+        Eigen::Vector3d center = cluster_centers[i % 3] + Eigen::Vector3d(normal(generator), normal(generator), normal(generator));
+        triangles.emplace_back(center, 0.1 * Eigen::Vector3d(unit(generator), unit(generator), unit(generator)),
+                               0.1 * Eigen::Vector3d(unit(generator), unit(generator), unit(generator)) + Eigen::Vector3d(0.05, 0, 0),
+                               0.1 * Eigen::Vector3d(unit(generator), unit(generator), unit(generator)) + Eigen::Vector3d(0, 0.05, 0));
+    }
+    return triangles;
+}
+
+TEST_CASE("[Bvh] testing construction") {
+    CHECK_THROWS_AS(Bvh<Triangle>(0, 16), std::invalid_argument);
+    CHECK_THROWS_AS(Bvh<Triangle>(4, 1), std::invalid_argument);
+
+    Bvh<Triangle> bvh(4, 16);
+    double hit_distance;
+    CHECK(bvh.traceRay(Ray(Eigen::Vector3d::Zero(), Eigen::Vector3d::UnitZ()), hit_distance) == nullptr);
+    CHECK(bvh.getNodes().empty());
+
+    std::vector<Triangle> triangles = makeClusteredTriangles(800, 5);
+    std::vector<const Triangle*> objects;
+    for (const Triangle& triangle : triangles) {
+        objects.push_back(&triangle);
+    }
+    bvh.build(objects);
+    CHECK(bvh.isFinalized());
+
+    const std::vector<BvhNode>& nodes = bvh.getNodes();
+
+    SUBCASE("Every object is in exactly one leaf, which is small enough") {
+        std::vector<const Triangle*> primitives = bvh.getPrimitives();
+        CHECK(primitives.size() == objects.size());
+
+        std::size_t leaf_objects = 0;
+        for (const BvhNode& node : nodes) {
+            if (!node.isLeaf()) continue;
+            CHECK(node.count <= 4);
+            leaf_objects += node.count;
+        }
+        CHECK(leaf_objects == objects.size());
+
+        std::sort(primitives.begin(), primitives.end());
+        std::sort(objects.begin(), objects.end());
+        CHECK(primitives == objects);
+    }
+
+    SUBCASE("The bounds of a node contain its children and its objects") {
+        for (const BvhNode& node : nodes) {
+            if (node.isLeaf()) {
+                for (std::uint32_t i = node.index; i < node.index + node.count; ++i) {
+                    CHECK(node.bounds.contains(bvh.getPrimitives()[i]->getBoundingBox()));
+                }
+            } else {
+                CHECK(node.bounds.contains(nodes[node.index].bounds));
+                CHECK(node.bounds.contains(nodes[node.index + 1].bounds));
+            }
+        }
+    }
+
+    SUBCASE("The parallel build gives the same hierarchy as the serial build") {
+        ThreadPool pool(3);
+        Bvh<Triangle> parallel_bvh(4, 16);
+        parallel_bvh.build(objects, &pool);
+
+        CHECK(parallel_bvh.getPrimitives() == bvh.getPrimitives());
+        REQUIRE(parallel_bvh.getNodes().size() == nodes.size());
+
+        // The nodes are not stored in the same order, compare the hierarchies from the root
+        std::vector<std::pair<std::uint32_t, std::uint32_t>> stack{{0, 0}};
+        while (!stack.empty()) {
+            auto [serial_index, parallel_index] = stack.back();
+            stack.pop_back();
+
+            const BvhNode& serial_node = nodes[serial_index];
+            const BvhNode& parallel_node = parallel_bvh.getNodes()[parallel_index];
+            CHECK((serial_node.bounds.min == parallel_node.bounds.min).all());
+            CHECK((serial_node.bounds.max == parallel_node.bounds.max).all());
+            CHECK(serial_node.count == parallel_node.count);
+            if (serial_node.isLeaf()) {
+                CHECK(serial_node.index == parallel_node.index);
+            } else {
+                stack.emplace_back(serial_node.index, parallel_node.index);
+                stack.emplace_back(serial_node.index + 1, parallel_node.index + 1);
+            }
+        }
+    }
+
+    SUBCASE("Clearing the hierarchy") {
+        bvh.clear();
+        CHECK(bvh.getNodes().empty());
+        CHECK(bvh.getPrimitives().empty());
+    }
+}
+
+TEST_CASE("[Bvh] testing ray tracing") {
+    std::vector<Triangle> triangles = makeClusteredTriangles(600, 9);
+
+    // A large floor under the clusters
+    triangles.emplace_back(Eigen::Vector3d(0, -3, 6), Eigen::Vector3d(-10, 0, -10), Eigen::Vector3d(10, 0, -10), Eigen::Vector3d(0, 0, 10));
+
+    Bvh<Triangle> bvh(2, 8);
+    for (const Triangle& triangle : triangles) {
+        bvh.insert(&triangle);
+    }
+    CHECK_FALSE(bvh.isFinalized());
+
+    Octree<Triangle> octree(10, 2.0, 4, Eigen::Vector3d::Zero(), OctreeInsertion::BoundingBox);
+    for (const Triangle& triangle : triangles) {
+        octree.insert(&triangle);
+    }
+
+    int hits = 0;
+    for (int i = 0; i < 250; ++i) {
+        Eigen::Vector3d origin(6 * std::cos(0.1 * i), 4 * std::sin(0.37 * i), 6 * std::sin(0.1 * i) - 3);
+        Ray ray(origin, triangles[(7 * i) % triangles.size()].getPosition() - origin);
+
+        // Closest hit by testing all the triangles
+        const Triangle* expected_hit = nullptr;
+        float u, v, t, expected_distance = std::numeric_limits<float>::infinity();
+        for (const Triangle& triangle : triangles) {
+            if (triangle.intersect(ray, u, v, t) && t < expected_distance) {
+                expected_distance = t;
+                expected_hit = &triangle;
+            }
+        }
+
+        double bvh_distance, octree_distance;
+        const Triangle* bvh_hit = bvh.traceRay(ray, bvh_distance);
+        const Triangle* octree_hit = octree.traceRay(ray, octree_distance);
+        CHECK(bvh_hit == expected_hit);
+        CHECK(octree_hit == bvh_hit);
+        if (bvh_hit) CHECK(bvh_distance == expected_distance);
+        hits += bvh_hit != nullptr;
+
+        // The hit must be closer than the maximum distance
+        double limited_distance;
+        if (bvh_hit) CHECK(bvh.traceRay(ray, limited_distance, bvh_distance * 0.5) == nullptr);
+
+        // Any hit before the maximum distance occludes the ray
+        const double infinity = std::numeric_limits<double>::infinity();
+        CHECK(bvh.occluded(ray, infinity) == (expected_hit != nullptr));
+        CHECK(octree.occluded(ray, infinity) == (expected_hit != nullptr));
+        if (expected_hit) {
+            CHECK(bvh.occluded(ray, expected_distance * 1.01));
+            CHECK(octree.occluded(ray, expected_distance * 1.01));
+            CHECK_FALSE(bvh.occluded(ray, expected_distance * 0.99));
+            CHECK_FALSE(octree.occluded(ray, expected_distance * 0.99));
+        }
+    }
+    CHECK(hits > 0);
+    CHECK(bvh.isFinalized());
+}
+
+TEST_CASE("[Bvh] testing removal and updates") {
+    std::vector<Triangle> triangles = makeClusteredTriangles(300, 4);
+    Bvh<Triangle> bvh(2, 8);
+    for (const Triangle& triangle : triangles) {
+        bvh.insert(&triangle);
+    }
+    bvh.finalize();
+
+    CHECK(bvh.remove(&triangles[0]));
+    CHECK_FALSE(bvh.remove(&triangles[0]));
+    CHECK_FALSE(bvh.isFinalized());
+    CHECK(bvh.getPrimitives().size() == triangles.size() - 1);
+
+    // The moved triangle is found where it is now
+    triangles[1].setPosition(Eigen::Vector3d(20, 0, 0));
+    bvh.update(&triangles[1]);
+    CHECK_FALSE(bvh.isFinalized());
+    double hit_distance;
+    CHECK(bvh.traceRay(Ray(Eigen::Vector3d(20, 0, -5), Eigen::Vector3d::UnitZ()), hit_distance) == &triangles[1]);
+
+    CHECK_THROWS_AS(bvh.update(&triangles[0]), std::invalid_argument);
+}
@@ -0,0 +1,202 @@
+#include <cmath>
+#include <limits>
+#include <random>
+#include <vector>
+#include "instance-test.hpp"
+
+/// @brief Small random triangles around the origin of the frame of a mesh
+static std::vector<Triangle> makeMeshTriangles(unsigned int count, unsigned int seed) {
+    std::mt19937 generator(seed);
+    std::uniform_real_distribution<double> spread(-1.0, 1.0);
+    std::uniform_real_distribution<double> unit(-0.5, 0.5);
+
+    std::vector<Triangle> triangles;
+    triangles.reserve(count);
+    for (unsigned int i = 0; i < count; ++i) {
+        Eigen::Vector3d center(spread(generator), 0.5 * spread(generator), 0.3 * spread(generator));
+        triangles.emplace_back(center, 0.3 * Eigen::Vector3d(unit(generator), unit(generator), unit(generator)),
+                               0.3 * Eigen::Vector3d(unit(generator), unit(generator), unit(generator)) + Eigen::Vector3d(0.1, 0, 0),
+                               0.3 * Eigen::Vector3d(unit(generator), unit(generator), unit(generator)) + Eigen::Vector3d(0, 0.1, 0));
+    }
+    return triangles;
+}
+
+/// @brief The placement of an instance: a position and a rotation vector
+struct Placement {
+    Eigen::Vector3d position;
+    Eigen::Vector3d rotation;
+};
+
+/// @brief Copy the triangles of a mesh in the global frame, placed as an instance would place them
+static void placeCopies(const std::vector<Triangle>& mesh_triangles, const Placement& placement, std::vector<Triangle>& copies) {
+    for (const Triangle& triangle : mesh_triangles) {
+        // The points of the mesh are relative to its origin, as the local points of a triangle to its position
+        Triangle& copy = copies.emplace_back(placement.position, triangle.getPoint(0), triangle.getPoint(1), triangle.getPoint(2));
+        copy.rotate(placement.rotation);
+    }
+}
+
+/// @brief Rays from random points of a sphere towards random points near its center
+static std::vector<Ray> makeRays(unsigned int count, double radius, unsigned int seed) {
+    std::mt19937 generator(seed);
+    std::normal_distribution<double> normal(0.0, 1.0);
+    std::uniform_real_distribution<double> target(-0.4 * radius, 0.4 * radius);
+
+    std::vector<Ray> rays;
+    rays.reserve(count);
+    for (unsigned int i = 0; i < count; ++i) {
+        Eigen::Vector3d origin = radius * Eigen::Vector3d(normal(generator), normal(generator), normal(generator)).normalized();
+        rays.emplace_back(origin, Eigen::Vector3d(target(generator), target(generator), target(generator)) - origin);
+    }
+    return rays;
+}
+
+/// @brief Find the first triangle hit by a ray by testing all of them
+static const Triangle* traceAll(const std::vector<Triangle>& triangles, const Ray& ray, double& hit_distance) {
+    const Triangle* hit_triangle = nullptr;
+    hit_distance = std::numeric_limits<double>::infinity();
+    for (const Triangle& triangle : triangles) {
+        float u, v, t;
+        if (triangle.intersect(ray, u, v, t) && t < hit_distance) {
+            hit_distance = t;
+            hit_triangle = &triangle;
+        }
+    }
+    return hit_triangle;
+}
+
+TEST_CASE("[Instance] testing the frame of the mesh") {
+    std::vector<Triangle> mesh_triangles = makeMeshTriangles(60, 7);
+    std::vector<const Triangle*> objects;
+    for (const Triangle& triangle : mesh_triangles) {
+        objects.push_back(&triangle);
+    }
+    CHECK_THROWS_AS(Mesh(std::span<const Triangle* const>()), std::invalid_argument);
+
+    Mesh mesh(objects, 12, 0.25, 4);
+    CHECK(mesh.getTriangleCount() == 60);
+    CHECK(mesh.getOctree().isFinalized());
+
+    const Placement placements[] = {
+        {Eigen::Vector3d::Zero(), Eigen::Vector3d::Zero()},
+        {Eigen::Vector3d(1.5, -0.7, 2.0), Eigen::Vector3d::Zero()},
+        {Eigen::Vector3d(-0.3, 0.8, 1.1), Eigen::Vector3d(0.4, -1.1, 0.7)},
+    };
+    for (const Placement& placement : placements) {
+        CAPTURE(placement.position.transpose());
+        CAPTURE(placement.rotation.transpose());
+        Instance instance(mesh, Eigen::Vector3d::Zero());
+        instance.setPosition(placement.position);
+        instance.rotate(placement.rotation);
+
+        std::vector<Triangle> copies;
+        placeCopies(mesh_triangles, placement, copies);
+
+        // The bounding box of the instance holds the placed triangles
+        for (const Triangle& copy : copies) {
+            CHECK((copy.getBoundingBox().min >= instance.getBoundingBox().min - 1e-12).all());
+            CHECK((copy.getBoundingBox().max <= instance.getBoundingBox().max + 1e-12).all());
+        }
+
+        // The instance is hit where the placed triangles are, with the same distances and normals
+        for (const Ray& ray : makeRays(200, 4.0, 11)) {
+            Ray placed_ray(ray.getOrigin() + placement.position, ray.getDirection());
+            double expected_distance, hit_distance;
+            const Triangle* expected = traceAll(copies, placed_ray, expected_distance);
+            const Triangle* hit_triangle = instance.traceRay(placed_ray, hit_distance);
+
+            REQUIRE((hit_triangle != nullptr) == (expected != nullptr));
+            float u, v, t;
+            CHECK(instance.intersect(placed_ray, u, v, t) == (expected != nullptr));
+            if (!expected) continue;
+
+            CHECK(hit_distance == doctest::Approx(expected_distance).epsilon(1e-5));
+            CHECK(t == doctest::Approx(expected_distance).epsilon(1e-5));
+            CHECK((instance.toGlobalFrame(hit_triangle->getNormal()) - expected->getNormal()).norm() < 1e-9);
+        }
+    }
+}
+
+TEST_CASE("[Instance] testing a hierarchy of instances") {
+    std::vector<Triangle> mesh_triangles = makeMeshTriangles(30, 3);
+    std::vector<const Triangle*> objects;
+    for (const Triangle& triangle : mesh_triangles) {
+        objects.push_back(&triangle);
+    }
+    Mesh mesh(objects);
+
+    std::mt19937 generator(19);
+    std::uniform_real_distribution<double> spread(-5.0, 5.0);
+    std::uniform_real_distribution<double> angle(-1.5, 1.5);
+    std::vector<Placement> placements;
+    std::vector<Instance> instances;
+    instances.reserve(40);
+    for (int i = 0; i < 40; ++i) {
+        Placement placement{Eigen::Vector3d(spread(generator), spread(generator), spread(generator)),
+                            Eigen::Vector3d(angle(generator), angle(generator), angle(generator))};
+        placements.push_back(placement);
+        Instance& instance = instances.emplace_back(mesh, placement.position);
+        instance.rotate(placement.rotation);
+    }
+
+    Bvh<Instance> hierarchy(1, 16);
+    for (const Instance& instance : instances) {
+        hierarchy.insert(&instance);
+    }
+
+    auto checkHits = [&]() {
+        std::vector<Triangle> copies;
+        copies.reserve(placements.size() * mesh_triangles.size());
+        for (const Placement& placement : placements) {
+            placeCopies(mesh_triangles, placement, copies);
+        }
+
+        unsigned int hits = 0;
+        for (const Ray& ray : makeRays(200, 12.0, 5)) {
+            double expected_distance, hit_distance;
+            const Triangle* expected = traceAll(copies, ray, expected_distance);
+            const Instance* hit_instance = hierarchy.traceRay(ray, hit_distance);
+
+            REQUIRE((hit_instance != nullptr) == (expected != nullptr));
+            CHECK(hierarchy.occluded(ray, std::numeric_limits<double>::infinity()) == (expected != nullptr));
+            if (!expected) continue;
+
+            ++hits;
+            CHECK(hit_distance == doctest::Approx(expected_distance).epsilon(1e-5));
+            // The hit instance is the one whose copy of the mesh holds the expected triangle
+            CHECK(hit_instance == &instances[(expected - copies.data()) / mesh_triangles.size()]);
+
+            // The same traversal gives the hit triangle of the mesh and the barycentric coordinates of the hit point on it
+            InstanceHit hit;
+            double record_distance;
+            REQUIRE(hierarchy.traceRay(ray, record_distance, hit) == hit_instance);
+            CHECK(record_distance == hit_distance);
+            REQUIRE(hit.triangle != nullptr);
+            CHECK(hit.triangle == &mesh_triangles[(expected - copies.data()) % mesh_triangles.size()]);
+            const Ray mesh_ray = hit_instance->toMeshFrame(ray);
+            const Eigen::Vector3d barycentric_point = hit.triangle->getPoint(0) + hit.u * (hit.triangle->getPoint(1) - hit.triangle->getPoint(0))
+                                                      + hit.v * (hit.triangle->getPoint(2) - hit.triangle->getPoint(0));
+            CHECK((barycentric_point - (mesh_ray.getOrigin() + hit_distance * mesh_ray.getDirection())).norm() < 1e-4);
+
+            // The any-hit test of the instances agrees with the distance of the closest hit
+            CHECK(hierarchy.occluded(ray, hit_distance * 1.001));
+            CHECK_FALSE(hierarchy.occluded(ray, hit_distance * 0.999));
+            CHECK(hit_instance->occluded(ray, hit_distance * 1.001));
+        }
+        CHECK(hits > 10);
+    };
+
+    SUBCASE("Static instances") {
+        checkHits();
+    }
+
+    SUBCASE("Moved instances") {
+        checkHits();
+        for (std::size_t i = 0; i < instances.size(); i += 3) {
+            placements[i].position += Eigen::Vector3d(1.0, -2.0, 0.5);
+            instances[i].translate(Eigen::Vector3d(1.0, -2.0, 0.5));
+            hierarchy.update(&instances[i]);
+        }
+        checkHits();
+    }
+}
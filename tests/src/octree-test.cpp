@@ -265,4 +265,1780 @@ TEST_CASE("[Octree] testing ray tracing collision") {
             CHECK(hit_distance == 27);
         }
     }
-}
\ No newline at end of file
+}
+
+TEST_CASE("[Octree] testing concurrent ray tracing") {
+    Octree<Triangle> octree(6, 2.0, 2, Eigen::Vector3d::Zero());
+
+    std::vector<Triangle> triangles;
+    triangles.reserve(27);
+    for (int i = 0; i < 27; ++i) {
+        Eigen::Vector3d corner(-1.0 + 0.7 * (i % 3), -1.0 + 0.7 * ((i / 3) % 3), -1.0 + 0.7 * (i / 9));
+        triangles.emplace_back(corner, corner + Eigen::Vector3d(0.5, 0, 0), corner + Eigen::Vector3d(0, 0.5, 0.1));
+    }
+    for (const Triangle& triangle : triangles) {
+        octree.insert(&triangle);
+    }
+
+    std::vector<Ray> rays;
+    for (int i = 0; i < 400; ++i) {
+        rays.emplace_back(Eigen::Vector3d(-3, -3, -3), Eigen::Vector3d(1 + 0.01 * (i % 20), 1 + 0.01 * (i / 20), 1));
+    }
+
+    // Reference results computed serially
+    std::vector<const Triangle*> expected_hits(rays.size());
+    for (std::size_t i = 0; i < rays.size(); ++i) {
+        double hit_distance;
+        expected_hits[i] = octree.traceRay(rays[i], hit_distance);
+    }
+
+    // Several threads trace all the rays through the same read-only octree
+    const Octree<Triangle>& shared_octree = octree;
+    std::vector<std::vector<const Triangle*>> thread_hits(4, std::vector<const Triangle*>(rays.size()));
+    std::vector<std::thread> threads;
+    for (std::size_t t = 0; t < thread_hits.size(); ++t) {
+        threads.emplace_back([&, t]() {
+            for (std::size_t i = 0; i < rays.size(); ++i) {
+                double hit_distance;
+                thread_hits[t][i] = shared_octree.traceRay(rays[i], hit_distance);
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    for (const std::vector<const Triangle*>& hits : thread_hits) {
+        CHECK(hits == expected_hits);
+    }
+}
+
+
+TEST_CASE("[Octree] testing node allocation") {
+    Octree<MockTriangle> octree(5, 2.0, 1, Eigen::Vector3d::Zero());
+
+    MockTriangle triangle1(Eigen::Vector3d(0.5, 0.5, 0.5));
+    MockTriangle triangle2(Eigen::Vector3d(-0.5, -0.5, -0.5));
+    octree.insert(&triangle1);
+    octree.insert(&triangle2);
+
+    SUBCASE("Sibling nodes are contiguous in memory") {
+        const OctreeNode<MockTriangle>* root = octree.getRoot();
+        REQUIRE(root->total_children_depth > 0);
+        for (int i = 0; i < 8; ++i) {
+            CHECK(root->children[i] == root->children[0] + i);
+        }
+    }
+
+    SUBCASE("Sibling nodes stay contiguous when the root grows") {
+        MockTriangle triangle3(Eigen::Vector3d(3.0, 3.0, 3.0));
+        octree.insert(&triangle3);
+
+        const OctreeNode<MockTriangle>* root = octree.getRoot();
+        for (int i = 0; i < 8; ++i) {
+            CHECK(root->children[i] == root->children[0] + i);
+        }
+    }
+
+    SUBCASE("The octree can be reused after being cleared") {
+        octree.clear();
+        const OctreeNode<MockTriangle>* root = octree.getRoot();
+        CHECK(root->total_children_depth == 0);
+        CHECK(root->data.size() == 0);
+        CHECK(root->size == 2.0);
+
+        octree.insert(&triangle1);
+        CHECK(octree.getRoot()->data.size() == 1);
+    }
+
+    SUBCASE("The heap allocator builds the same octree") {
+        Octree<MockTriangle, NodeHeap> heap_octree(5, 2.0, 1, Eigen::Vector3d::Zero());
+        heap_octree.insert(&triangle1);
+        heap_octree.insert(&triangle2);
+
+        const OctreeNode<MockTriangle>* root = octree.getRoot();
+        const OctreeNode<MockTriangle>* heap_root = heap_octree.getRoot();
+        CHECK(heap_root->total_children_depth == root->total_children_depth);
+        for (int i = 0; i < 8; ++i) {
+            CHECK(heap_root->children[i]->position.isApprox(root->children[i]->position));
+            CHECK(heap_root->children[i]->data.size() == root->children[i]->data.size());
+        }
+    }
+}
+
+
+TEST_CASE("[Octree] testing flat layout") {
+    Octree<Triangle> octree(6, 2.0, 2, Eigen::Vector3d::Zero());
+
+    std::vector<Triangle> triangles;
+    triangles.reserve(20);
+    for (int i = 0; i < 20; ++i) {
+        Eigen::Vector3d center(-0.9 + 0.09 * i, -0.8 + 0.05 * (i % 7), 0.4 - 0.07 * (i % 5));
+        triangles.emplace_back(center, Eigen::Vector3d(-0.1, -0.1, 0), Eigen::Vector3d(0.2, -0.1, 0), Eigen::Vector3d(-0.1, 0.2, 0.05));
+    }
+    for (const Triangle& triangle : triangles) {
+        octree.insert(&triangle);
+    }
+
+    CHECK_FALSE(octree.isFinalized());
+    octree.finalize();
+    CHECK(octree.isFinalized());
+
+    const FlatOctree<Triangle>& flat_octree = octree.getFlatOctree();
+    const std::span<const FlatOctreeNode> nodes = flat_octree.getNodes();
+
+    SUBCASE("Every object is in exactly one leaf") {
+        std::vector<const Triangle*> primitives = flat_octree.getPrimitives();
+        CHECK(primitives.size() == triangles.size());
+
+        std::size_t leaf_objects = 0;
+        for (const FlatOctreeNode& node : nodes) {
+            if (node.isLeaf()) leaf_objects += node.count;
+        }
+        CHECK(leaf_objects == triangles.size());
+
+        std::sort(primitives.begin(), primitives.end());
+        CHECK(std::adjacent_find(primitives.begin(), primitives.end()) == primitives.end());
+    }
+
+    SUBCASE("The leaves are consecutive ranges of the primitive array") {
+        std::vector<std::pair<std::uint32_t, std::uint32_t>> ranges;
+        for (const FlatOctreeNode& node : nodes) {
+            if (node.isLeaf()) ranges.emplace_back(node.first, node.count);
+        }
+        std::sort(ranges.begin(), ranges.end());
+
+        std::uint32_t next_first = 0;
+        for (const auto& [first, count] : ranges) {
+            CHECK(first == next_first);
+            next_first = first + count;
+        }
+        CHECK(next_first == flat_octree.getPrimitives().size());
+    }
+
+    SUBCASE("Empty subtrees are not compiled") {
+        for (const FlatOctreeNode& node : nodes) {
+            CHECK((!node.isLeaf() || node.count > 0));
+        }
+    }
+
+    SUBCASE("The flat layout gives the same hits as the node traversal") {
+        int hits = 0;
+        for (int i = 0; i < 200; ++i) {
+            // Aim around the triangles, from the front and from the side
+            Eigen::Vector3d origin = (i % 2) ? Eigen::Vector3d(0.1, 0.2, -3) : Eigen::Vector3d(3, -0.4, 0.1);
+            Eigen::Vector3d target = triangles[i % triangles.size()].getPosition() + Eigen::Vector3d(0.01 * (i % 13), 0.01 * (i % 11), 0.01 * (i % 3));
+            Ray ray(origin, target - origin);
+
+            double node_distance = std::numeric_limits<double>::infinity();
+            const Triangle* node_hit = octree.getRoot()->traceRay(ray, node_distance, octree.getInsertion());
+
+            double flat_distance;
+            const Triangle* flat_hit = octree.traceRay(ray, flat_distance);
+
+            CHECK(flat_hit == node_hit);
+            if (flat_hit) CHECK(flat_distance == node_distance);
+            hits += flat_hit != nullptr;
+        }
+        CHECK(hits > 0);
+    }
+
+    SUBCASE("Inserting an object invalidates the flat layout") {
+        Triangle triangle(Eigen::Vector3d(0.5, 0.5, 0.5), Eigen::Vector3d(0.6, 0.5, 0.5), Eigen::Vector3d(0.5, 0.6, 0.5));
+        octree.insert(&triangle);
+        CHECK_FALSE(octree.isFinalized());
+        CHECK(octree.getFlatOctree().getReferenceCount() == triangles.size() + 1);
+        CHECK(octree.isFinalized());
+    }
+}
+
+TEST_CASE("[Octree] testing bounding box insertion") {
+    CHECK_THROWS_AS(Octree<MockTriangle>(5, 2.0, 3, Eigen::Vector3d::Zero(), OctreeInsertion::BoundingBox), std::invalid_argument);
+
+    Octree<Triangle> octree(6, 2.0, 2, Eigen::Vector3d::Zero(), OctreeInsertion::BoundingBox);
+    CHECK(octree.getInsertion() == OctreeInsertion::BoundingBox);
+
+    // A large floor spanning every octant, under a few small triangles
+    Triangle floor(Eigen::Vector3d(0, -0.5, 0), Eigen::Vector3d(-3, 0, -3), Eigen::Vector3d(3, 0, -3), Eigen::Vector3d(0, 0, 3));
+    std::vector<Triangle> triangles;
+    triangles.reserve(20);
+    for (int i = 0; i < 20; ++i) {
+        Eigen::Vector3d center(-0.9 + 0.09 * i, -0.3 + 0.05 * (i % 7), 0.4 - 0.07 * (i % 5));
+        triangles.emplace_back(center, Eigen::Vector3d(-0.1, -0.1, 0), Eigen::Vector3d(0.2, -0.1, 0), Eigen::Vector3d(-0.1, 0.2, 0.05));
+    }
+
+    octree.insert(&floor);
+    for (const Triangle& triangle : triangles) {
+        octree.insert(&triangle);
+    }
+    CHECK(octree.getRoot()->getBoundingBox().contains(floor.getBoundingBox()));
+
+    const FlatOctree<Triangle>& flat_octree = octree.getFlatOctree();
+    CHECK(flat_octree.getInsertion() == OctreeInsertion::BoundingBox);
+
+    SUBCASE("Objects are referenced by every leaf they overlap") {
+        std::size_t floor_references = std::count(flat_octree.getPrimitives().begin(), flat_octree.getPrimitives().end(), &floor);
+        CHECK(floor_references > 1);
+
+        for (const Triangle& triangle : triangles) {
+            CHECK(std::count(flat_octree.getPrimitives().begin(), flat_octree.getPrimitives().end(), &triangle) >= 1);
+        }
+    }
+
+    SUBCASE("The large triangle is hit far from its position") {
+        for (double x : {-2.5, -1.2, 1.2, 2.5}) {
+            Ray ray(Eigen::Vector3d(x, 1, -2), Eigen::Vector3d(0, -1, 0));
+            double hit_distance;
+            CHECK(octree.traceRay(ray, hit_distance) == &floor);
+            CHECK(hit_distance == doctest::Approx(1.5));
+        }
+    }
+
+    SUBCASE("The traversal finds the closest hit") {
+        std::vector<const Triangle*> all_triangles = {&floor};
+        for (const Triangle& triangle : triangles) {
+            all_triangles.push_back(&triangle);
+        }
+
+        int hits = 0;
+        for (int i = 0; i < 300; ++i) {
+            // Aim at the small triangles from every side, so that the rays often cross the floor as well
+            Eigen::Vector3d origin(3 * std::cos(0.1 * i), 2 * std::sin(0.37 * i), 3 * std::sin(0.1 * i));
+            Eigen::Vector3d target = triangles[i % triangles.size()].getPosition() + Eigen::Vector3d(0.01 * (i % 13), 0.01 * (i % 11), 0.01 * (i % 3));
+            Ray ray(origin, target - origin);
+
+            const Triangle* expected_hit = nullptr;
+            float u, v, t, expected_distance = std::numeric_limits<float>::infinity();
+            for (const Triangle* triangle : all_triangles) {
+                if (triangle->intersect(ray, u, v, t) && t < expected_distance) {
+                    expected_distance = t;
+                    expected_hit = triangle;
+                }
+            }
+
+            double hit_distance;
+            const Triangle* hit = octree.traceRay(ray, hit_distance);
+            CHECK(hit == expected_hit);
+            if (hit) CHECK(hit_distance == expected_distance);
+            hits += hit != nullptr;
+
+            // The node traversal goes on after a hit beyond the child, as the flat layout
+            double node_distance = std::numeric_limits<double>::infinity();
+            const Triangle* node_hit = octree.getRoot()->traceRay(ray, node_distance, OctreeInsertion::BoundingBox);
+            CHECK(node_hit == expected_hit);
+            if (node_hit) CHECK(node_distance == expected_distance);
+        }
+        CHECK(hits > 0);
+    }
+
+    SUBCASE("Rays starting on the splitting planes, parallel to the axes") {
+        // One small triangle on each side of the origin along each axis, facing the origin
+        Octree<Triangle> axes(6, 2.0, 1, Eigen::Vector3d::Zero(), OctreeInsertion::BoundingBox);
+        std::vector<Triangle> targets;
+        std::vector<Eigen::Vector3d> directions;
+        for (int axis = 0; axis < 3; ++axis) {
+            for (double side : {-1.0, 1.0}) {
+                Eigen::Vector3d direction = Eigen::Vector3d::Zero(), u = Eigen::Vector3d::Zero(), v = Eigen::Vector3d::Zero();
+                direction[axis] = side;
+                u[(axis + 1) % 3] = 0.1;
+                v[(axis + 2) % 3] = 0.1;
+                targets.emplace_back(0.6 * direction, -2 * u - 2 * v, 3 * u - 2 * v, -2 * u + 3 * v);
+                directions.push_back(direction);
+            }
+        }
+        for (const Triangle& target : targets) {
+            axes.insert(&target);
+        }
+        CHECK(axes.getRoot()->total_children_depth > 0);
+
+        for (std::size_t i = 0; i < targets.size(); ++i) {
+            double hit_distance;
+            CHECK(axes.traceRay(Ray(Eigen::Vector3d::Zero(), directions[i]), hit_distance) == &targets[i]);
+            CHECK(hit_distance == doctest::Approx(0.6));
+        }
+    }
+
+    SUBCASE("Leaves covered by all their objects are not split") {
+        // Three slanted triangles whose bounding boxes contain the whole root: splitting would reference them in every child
+        Octree<Triangle> covered(4, 10.0, 1, Eigen::Vector3d::Zero(), OctreeInsertion::BoundingBox);
+        std::vector<Triangle> slanted;
+        for (int i = 0; i < 3; ++i) {
+            slanted.emplace_back(Eigen::Vector3d::Zero(), Eigen::Vector3d(-5, -5, -5), Eigen::Vector3d(5, -5, 5), Eigen::Vector3d(i - 1, 5, 0));
+        }
+        for (const Triangle& triangle : slanted) {
+            covered.insert(&triangle);
+        }
+
+        CHECK(covered.getRoot()->total_children_depth == 0);
+        CHECK(covered.getRoot()->data.size() == 3);
+    }
+}
+
+TEST_CASE("[Octree] testing bulk build") {
+    SUBCASE("The radix sort of the Morton keys is stable, with or without threads") {
+        std::mt19937 generator(3);
+        std::uniform_int_distribution<std::uint64_t> code(0, (std::uint64_t(1) << 20) - 1);
+        std::vector<MortonKey> keys(20000);
+        for (std::uint32_t i = 0; i < keys.size(); ++i) {
+            keys[i] = MortonKey{code(generator) << 40 | code(generator) % 64, i}; // Many equal codes, some bytes all equal
+        }
+
+        std::vector<MortonKey> expected = keys;
+        std::stable_sort(expected.begin(), expected.end(), [](const MortonKey& a, const MortonKey& b) { return a.code < b.code; });
+
+        ThreadPool pool(3);
+        for (ThreadPool* thread_pool : {static_cast<ThreadPool*>(nullptr), &pool}) {
+            std::vector<MortonKey> sorted = keys;
+            sortMortonKeys(sorted, thread_pool);
+            for (std::size_t i = 0; i < sorted.size(); ++i) {
+                CHECK(sorted[i].code == expected[i].code);
+                CHECK(sorted[i].index == expected[i].index);
+            }
+        }
+    }
+
+    SUBCASE("Morton octants match the octants of the nodes") {
+        const Box cube{Eigen::Array3d(-1, -1, -1), Eigen::Array3d(1, 1, 1)};
+        const Eigen::Vector3d point(0.3, -0.6, 0.8);
+        const std::uint64_t code = getMortonCode(point, cube);
+
+        CHECK(getMortonOctant(code, 0) == getBranchIndex(point, Eigen::Vector3d::Zero()));
+        CHECK(getMortonOctant(code, 1) == getBranchIndex(point, getChildCenter(Eigen::Vector3d::Zero(), 1.0, getMortonOctant(code, 0))));
+    }
+
+    std::vector<Triangle> triangles;
+    triangles.reserve(3000);
+    std::mt19937 generator(11);
+    std::uniform_real_distribution<double> unit(-0.5, 0.5);
+    for (int i = 0; i < 3000; ++i) {
+        Eigen::Vector3d center = 6 * Eigen::Vector3d(unit(generator), unit(generator), unit(generator));
+        triangles.emplace_back(center, Eigen::Vector3d(-0.1, -0.1, 0), Eigen::Vector3d(0.2, -0.1, 0), Eigen::Vector3d(-0.1, 0.2, 0.05));
+    }
+    std::vector<const Triangle*> objects;
+    for (const Triangle& triangle : triangles) {
+        objects.push_back(&triangle);
+    }
+
+    SUBCASE("Every object is in the leaf containing its position") {
+        Octree<Triangle> octree(12, 1.0, 4, Eigen::Vector3d::Zero());
+        octree.build(objects);
+
+        std::size_t object_count = 0;
+        std::function<void(const OctreeNode<Triangle>*)> checkNode = [&](const OctreeNode<Triangle>* node) {
+            if (node->total_children_depth > 0) {
+                CHECK(node->data.empty());
+                for (const OctreeNode<Triangle>* child : node->children) checkNode(child);
+                return;
+            }
+            CHECK(node->data.size() <= 4);
+            for (const Triangle* triangle : node->data) {
+                CHECK(node->getBoundingBox().contains(triangle->getPosition()));
+            }
+            object_count += node->data.size();
+        };
+        checkNode(octree.getRoot());
+        CHECK(object_count == objects.size());
+    }
+
+    SUBCASE("The parallel build gives the same octree as the serial build") {
+        for (OctreeInsertion insertion : {OctreeInsertion::Position, OctreeInsertion::BoundingBox}) {
+            Octree<Triangle> serial_octree(12, 1.0, 4, Eigen::Vector3d::Zero(), insertion);
+            serial_octree.build(objects);
+
+            ThreadPool pool(4);
+            Octree<Triangle> parallel_octree(12, 1.0, 4, Eigen::Vector3d::Zero(), insertion);
+            parallel_octree.build(objects, &pool);
+
+            CHECK(parallel_octree.getFlatOctree().getNodes().size() == serial_octree.getFlatOctree().getNodes().size());
+            CHECK(parallel_octree.getFlatOctree().getPrimitives() == serial_octree.getFlatOctree().getPrimitives());
+        }
+    }
+
+    SUBCASE("The bulk build gives the same hits as the incremental insertion") {
+        Octree<Triangle> inserted_octree(12, 1.0, 4, Eigen::Vector3d::Zero(), OctreeInsertion::BoundingBox);
+        for (const Triangle* triangle : objects) {
+            inserted_octree.insert(triangle);
+        }
+
+        ThreadPool pool(2);
+        Octree<Triangle> built_octree(12, 1.0, 4, Eigen::Vector3d::Zero(), OctreeInsertion::BoundingBox);
+        built_octree.build(objects, &pool);
+
+        int hits = 0;
+        for (int i = 0; i < 300; ++i) {
+            Eigen::Vector3d origin(8 * std::cos(0.1 * i), 3 * std::sin(0.37 * i), 8 * std::sin(0.1 * i));
+            Ray ray(origin, triangles[i].getPosition() - origin);
+
+            double inserted_distance, built_distance;
+            const Triangle* inserted_hit = inserted_octree.traceRay(ray, inserted_distance);
+            const Triangle* built_hit = built_octree.traceRay(ray, built_distance);
+            CHECK(built_hit == inserted_hit);
+            if (built_hit) CHECK(built_distance == inserted_distance);
+            hits += built_hit != nullptr;
+        }
+        CHECK(hits > 0);
+
+        // The octree can still grow by insertion after a bulk build
+        Triangle far_triangle(Eigen::Vector3d(20, 0, 0), Eigen::Vector3d(-0.1, -0.1, 0), Eigen::Vector3d(0.2, -0.1, 0), Eigen::Vector3d(-0.1, 0.2, 0.05));
+        built_octree.insert(&far_triangle);
+        double hit_distance;
+        CHECK(built_octree.traceRay(Ray(Eigen::Vector3d(20, 0, -5), Eigen::Vector3d::UnitZ()), hit_distance) == &far_triangle);
+    }
+
+    SUBCASE("Too many objects at the same position") {
+        Octree<MockTriangle> octree(3, 1.0, 2, Eigen::Vector3d::Zero());
+        std::vector<MockTriangle> mock_triangles(3, MockTriangle(Eigen::Vector3d(0.1, 0.1, 0.1)));
+        mock_triangles.emplace_back(Eigen::Vector3d(-0.4, 0.2, 0.1));
+        std::vector<const MockTriangle*> mock_objects;
+        for (const MockTriangle& triangle : mock_triangles) {
+            mock_objects.push_back(&triangle);
+        }
+
+        CHECK_THROWS_AS(octree.build(mock_objects), std::length_error);
+        CHECK(octree.getRoot()->total_children_depth == 0);
+        CHECK(octree.getRoot()->data.empty());
+
+        mock_objects.erase(mock_objects.begin());
+        octree.build(mock_objects);
+        CHECK(octree.getFlatOctree().getPrimitives().size() == 3);
+    }
+}
+
+TEST_CASE("[Octree] testing ray packets") {
+    // Small triangles in front of the origin, and a wall behind them spanning many leaves
+    std::mt19937 generator(3);
+    std::uniform_real_distribution<double> unit(-0.5, 0.5);
+    std::vector<Triangle> triangles;
+    for (int i = 0; i < 400; ++i) {
+        Eigen::Vector3d center(4 * unit(generator), 4 * unit(generator), 4 + 3 * unit(generator));
+        triangles.emplace_back(center, Eigen::Vector3d(-0.1, -0.1, 0), Eigen::Vector3d(0.15, -0.1, 0.02), Eigen::Vector3d(0, 0.15, -0.02));
+    }
+    triangles.emplace_back(Eigen::Vector3d(0, 0, 6), Eigen::Vector3d(-6, -6, 0), Eigen::Vector3d(6, -6, 0), Eigen::Vector3d(0, 6, 0));
+    std::vector<const Triangle*> objects;
+    for (const Triangle& triangle : triangles) {
+        objects.push_back(&triangle);
+    }
+
+    // Camera-like rays from the origin through a grid of pixels, and rays going every way
+    std::vector<Ray> coherent_rays;
+    for (int row = 0; row < 24; ++row) {
+        for (int column = 0; column < 24; ++column) {
+            coherent_rays.emplace_back(Eigen::Vector3d::Zero(), Eigen::Vector3d(-0.6 + 0.05 * column, -0.6 + 0.05 * row, 1));
+        }
+    }
+    std::vector<Ray> diverging_rays;
+    for (int i = 0; i < 96; ++i) {
+        Eigen::Vector3d origin(0.3 * unit(generator), 0.3 * unit(generator), 4 + 0.3 * unit(generator));
+        diverging_rays.emplace_back(origin, Eigen::Vector3d(unit(generator), unit(generator), unit(generator)));
+    }
+
+    // Check that the packets of N rays, some of them partial, give the same hits as the rays traced one by one
+    auto checkPackets = [&]<int N>(const Octree<Triangle>& octree, const std::vector<Ray>& rays, double max_distance) {
+        int hits = 0;
+        for (std::size_t first = 0; first < rays.size(); first += N) {
+            RayPacket<N> packet;
+            const int lane_count = 1 + (first / N) % N; // From 1 to N rays
+            for (int lane = 0; lane < lane_count && first + lane < rays.size(); ++lane) {
+                packet.set(lane, rays[first + lane]);
+            }
+
+            typename RayPacket<N>::Lanes hit_distances;
+            const std::array<const Triangle*, N> packet_hits = octree.traceRays(packet, hit_distances, max_distance);
+            for (int lane = 0; lane < N; ++lane) {
+                if (!(packet.active & (1u << lane))) {
+                    CHECK(packet_hits[lane] == nullptr);
+                    continue;
+                }
+
+                double hit_distance;
+                const Triangle* hit = octree.traceRay(rays[first + lane], hit_distance, max_distance);
+                CHECK(packet_hits[lane] == hit);
+                if (hit) CHECK(hit_distances[lane] == hit_distance);
+                hits += hit != nullptr;
+            }
+        }
+        return hits;
+    };
+
+    for (OctreeInsertion insertion : {OctreeInsertion::Position, OctreeInsertion::BoundingBox}) {
+        CAPTURE(static_cast<int>(insertion));
+        Octree<Triangle> octree(10, 1.0, 4, Eigen::Vector3d::Zero(), insertion);
+        octree.build(objects);
+
+        for (double max_distance : {std::numeric_limits<double>::infinity(), 4.5}) {
+            CHECK(checkPackets.operator()<4>(octree, coherent_rays, max_distance) > 0);
+            CHECK(checkPackets.operator()<8>(octree, coherent_rays, max_distance) > 0);
+            CHECK(checkPackets.operator()<4>(octree, diverging_rays, max_distance) > 0);
+            CHECK(checkPackets.operator()<8>(octree, diverging_rays, max_distance) > 0);
+        }
+    }
+
+    SUBCASE("Empty octree and empty packet") {
+        Octree<Triangle> octree(10, 1.0, 4, Eigen::Vector3d::Zero(), OctreeInsertion::BoundingBox);
+        RayPacket<4> packet;
+        RayPacket<4>::Lanes hit_distances;
+        for (const Triangle* hit : octree.traceRays(packet, hit_distances)) {
+            CHECK(hit == nullptr);
+        }
+
+        packet.set(0, coherent_rays.front());
+        for (const Triangle* hit : octree.traceRays(packet, hit_distances)) {
+            CHECK(hit == nullptr);
+        }
+    }
+}
+
+TEST_CASE("[Octree] testing ray streams") {
+    std::mt19937 generator(11);
+    std::uniform_real_distribution<double> unit(-0.5, 0.5);
+    std::vector<Triangle> triangles;
+    for (int i = 0; i < 600; ++i) {
+        Eigen::Vector3d center(6 * unit(generator), 6 * unit(generator), 6 * unit(generator));
+        triangles.emplace_back(center, Eigen::Vector3d(-0.15, -0.1, 0), Eigen::Vector3d(0.15, -0.1, 0.05), Eigen::Vector3d(0, 0.2, -0.05));
+    }
+    triangles.emplace_back(Eigen::Vector3d(0, -2, 0), Eigen::Vector3d(-5, 0, -5), Eigen::Vector3d(5, 0, -5), Eigen::Vector3d(0, 0, 5));
+    std::vector<const Triangle*> objects;
+    for (const Triangle& triangle : triangles) {
+        objects.push_back(&triangle);
+    }
+
+    // Rays in every direction, from inside and outside the octree, including rays parallel to the axes
+    std::vector<Ray> rays;
+    for (int i = 0; i < 2000; ++i) {
+        Eigen::Vector3d origin(10 * unit(generator), 10 * unit(generator), 10 * unit(generator));
+        rays.emplace_back(origin, Eigen::Vector3d(unit(generator), unit(generator), unit(generator)));
+    }
+    for (int axis = 0; axis < 3; ++axis) {
+        for (double sign : {-1.0, 1.0}) {
+            rays.emplace_back(Eigen::Vector3d(0.01, 0.02, 0.03) - 8 * sign * Eigen::Vector3d::Unit(axis), sign * Eigen::Vector3d::Unit(axis));
+        }
+    }
+
+    for (OctreeInsertion insertion : {OctreeInsertion::Position, OctreeInsertion::BoundingBox}) {
+        CAPTURE(static_cast<int>(insertion));
+        Octree<Triangle> octree(10, 1.0, 4, Eigen::Vector3d::Zero(), insertion);
+        octree.build(objects);
+
+        for (double max_distance : {std::numeric_limits<double>::infinity(), 3.0}) {
+            std::vector<double> hit_distances(rays.size());
+            const std::vector<const Triangle*> hits = octree.traceRayStream(rays, hit_distances, max_distance);
+            REQUIRE(hits.size() == rays.size());
+
+            int hit_count = 0;
+            for (std::size_t i = 0; i < rays.size(); ++i) {
+                double hit_distance;
+                const Triangle* hit = octree.traceRay(rays[i], hit_distance, max_distance);
+                CHECK(hits[i] == hit);
+                CHECK(hit_distances[i] == hit_distance);
+                hit_count += hit != nullptr;
+            }
+            CHECK(hit_count > 0);
+        }
+    }
+
+    SUBCASE("Empty batch, empty octree and invalid sizes") {
+        Octree<Triangle> octree(10, 1.0, 4, Eigen::Vector3d::Zero(), OctreeInsertion::BoundingBox);
+        std::vector<double> hit_distances(rays.size());
+        for (const Triangle* hit : octree.traceRayStream(rays, hit_distances)) {
+            CHECK(hit == nullptr);
+        }
+        CHECK(octree.traceRayStream(std::span<const Ray>(), std::span<double>()).empty());
+
+        hit_distances.pop_back();
+        CHECK_THROWS_AS(octree.traceRayStream(rays, hit_distances), std::invalid_argument);
+    }
+}
+
+TEST_CASE("[Octree] testing removal and updates") {
+    std::mt19937 generator(5);
+    std::uniform_real_distribution<double> unit(-0.5, 0.5);
+    std::vector<Eigen::Vector3d> centers;
+    for (int i = 0; i < 400; ++i) {
+        centers.emplace_back(6 * unit(generator), 6 * unit(generator), 6 * unit(generator));
+    }
+
+    std::vector<Ray> rays;
+    for (int i = 0; i < 300; ++i) {
+        Eigen::Vector3d origin(8 * std::cos(0.1 * i), 3 * std::sin(0.37 * i), 8 * std::sin(0.1 * i));
+        rays.emplace_back(origin, centers[i] - origin);
+    }
+
+    // Check that the leaves hold the objects still in the octree where they are now, and only them
+    auto checkLeaves = [](const Octree<Triangle>& octree, const std::vector<const Triangle*>& remaining) {
+        std::unordered_map<const Triangle*, int> references;
+        std::function<void(const OctreeNode<Triangle>*)> visit = [&](const OctreeNode<Triangle>* node) {
+            if (node->total_children_depth > 0) {
+                for (const OctreeNode<Triangle>* child : node->children) visit(child);
+                return;
+            }
+            for (const Triangle* triangle : node->data) {
+                references[triangle]++;
+                if (octree.getInsertion() == OctreeInsertion::Position) {
+                    CHECK(node->getBoundingBox().contains(triangle->getPosition().array()));
+                } else {
+                    CHECK(node->getBoundingBox().overlaps(triangle->getBoundingBox()));
+                }
+            }
+        };
+        visit(octree.getRoot());
+
+        CHECK(references.size() == remaining.size());
+        for (const Triangle* triangle : remaining) {
+            CHECK(references[triangle] >= 1);
+            if (octree.getInsertion() == OctreeInsertion::Position) CHECK(references[triangle] == 1);
+        }
+    };
+
+    // With BoundingBox insertion, the hits are the closest ones among the objects still in the octree
+    auto checkHits = [&](const Octree<Triangle>& octree, const std::vector<const Triangle*>& remaining) {
+        for (const Ray& ray : rays) {
+            const Triangle* expected_hit = nullptr;
+            float u, v, t, expected_distance = std::numeric_limits<float>::infinity();
+            for (const Triangle* triangle : remaining) {
+                if (triangle->intersect(ray, u, v, t) && t < expected_distance) {
+                    expected_distance = t;
+                    expected_hit = triangle;
+                }
+            }
+
+            double hit_distance;
+            CHECK(octree.traceRay(ray, hit_distance) == expected_hit);
+        }
+    };
+
+    for (OctreeInsertion insertion : {OctreeInsertion::Position, OctreeInsertion::BoundingBox}) {
+        for (bool bulk_build : {false, true}) {
+            CAPTURE(static_cast<int>(insertion));
+            CAPTURE(bulk_build);
+            std::vector<Triangle> triangles;
+            for (const Eigen::Vector3d& center : centers) {
+                triangles.emplace_back(center, Eigen::Vector3d(-0.15, -0.1, 0), Eigen::Vector3d(0.15, -0.1, 0.05), Eigen::Vector3d(0, 0.2, -0.05));
+            }
+            std::vector<const Triangle*> objects;
+            for (const Triangle& triangle : triangles) {
+                objects.push_back(&triangle);
+            }
+
+            Octree<Triangle> octree(10, 1.0, 4, Eigen::Vector3d::Zero(), insertion);
+            if (bulk_build) {
+                octree.build(objects);
+            } else {
+                for (const Triangle* triangle : objects) octree.insert(triangle);
+            }
+            octree.finalize();
+
+            // Remove a third of the objects
+            std::vector<const Triangle*> remaining;
+            for (std::size_t i = 0; i < objects.size(); ++i) {
+                if (i % 3 == 0) {
+                    CHECK(octree.remove(objects[i]));
+                    CHECK_FALSE(octree.remove(objects[i]));
+                } else {
+                    remaining.push_back(objects[i]);
+                }
+            }
+            CHECK_FALSE(octree.isFinalized());
+            checkLeaves(octree, remaining);
+            if (insertion == OctreeInsertion::BoundingBox) checkHits(octree, remaining);
+
+            // Move some objects, a few of them out of the root
+            for (std::size_t i = 0; i < remaining.size(); i += 5) {
+                Triangle& triangle = triangles[remaining[i] - triangles.data()];
+                triangle.translate(Eigen::Vector3d(0.7, -1.3, (i % 50 == 0) ? 9.0 : 0.4));
+                octree.update(&triangle);
+            }
+            checkLeaves(octree, remaining);
+            if (insertion == OctreeInsertion::BoundingBox) checkHits(octree, remaining);
+
+            // Removing every object merges the nodes back into a single leaf
+            for (const Triangle* triangle : remaining) {
+                CHECK(octree.remove(triangle));
+            }
+            CHECK(octree.getRoot()->total_children_depth == 0);
+            CHECK(octree.getRoot()->data.empty());
+            CHECK(octree.getFlatOctree().getPrimitives().empty());
+
+            // The children released by the merges are reused by the next insertions
+            for (const Triangle* triangle : remaining) {
+                octree.insert(triangle);
+            }
+            checkLeaves(octree, remaining);
+            if (insertion == OctreeInsertion::BoundingBox) checkHits(octree, remaining);
+
+            CHECK_THROWS_AS(octree.update(objects[0]), std::invalid_argument);
+        }
+    }
+
+    SUBCASE("Underfull siblings are merged") {
+        Octree<MockTriangle> octree(5, 2.0, 3, Eigen::Vector3d::Zero());
+        MockTriangle triangle1(Eigen::Vector3d(0.5, 0.5, 0.5));
+        MockTriangle triangle2(Eigen::Vector3d(-0.5, 0.5, 0.5));
+        MockTriangle triangle3(Eigen::Vector3d(0.5, -0.5, 0.5));
+        MockTriangle triangle4(Eigen::Vector3d(0.5, 0.5, -0.5));
+        for (const MockTriangle* triangle : {&triangle1, &triangle2, &triangle3, &triangle4}) {
+            octree.insert(triangle);
+        }
+        REQUIRE(octree.getRoot()->total_children_depth > 0);
+
+        CHECK(octree.remove(&triangle2));
+        CHECK(octree.getRoot()->total_children_depth == 0);
+        CHECK(octree.getRoot()->data.size() == 3);
+
+        // A moved object is found in the leaf where it was placed
+        triangle1.position = Eigen::Vector3d(-0.9, -0.9, -0.9);
+        octree.update(&triangle1);
+        CHECK(octree.getRoot()->data.size() == 3);
+        CHECK(octree.getRoot()->data.back() == &triangle1);
+    }
+
+    SUBCASE("The flat layout is patched where the nodes changed") {
+        // Check that two flat octrees have the same nodes and the same objects in each leaf, wherever they are in the arrays
+        std::function<void(const FlatOctree<Triangle>&, std::uint32_t, const FlatOctree<Triangle>&, std::uint32_t)> compareNodes =
+            [&](const FlatOctree<Triangle>& patched, std::uint32_t patched_index, const FlatOctree<Triangle>& compiled, std::uint32_t compiled_index) {
+                const FlatOctreeNode& patched_node = patched.getNodes()[patched_index];
+                const FlatOctreeNode& compiled_node = compiled.getNodes()[compiled_index];
+                REQUIRE(patched_node.getChildMask() == compiled_node.getChildMask());
+                if (compiled_node.isLeaf()) {
+                    REQUIRE(patched_node.getCount() == compiled_node.getCount());
+                    for (std::uint32_t i = 0; i < compiled_node.getCount(); ++i) {
+                        CHECK(patched.getPrimitives()[patched_node.getFirst() + i] == compiled.getPrimitives()[compiled_node.getFirst() + i]);
+                    }
+                    return;
+                }
+                for (unsigned char i = 0; i < 8; ++i) {
+                    if (compiled_node.hasChild(i)) compareNodes(patched, patched_node.getChild(i), compiled, compiled_node.getChild(i));
+                }
+            };
+
+        for (OctreeInsertion insertion : {OctreeInsertion::Position, OctreeInsertion::BoundingBox}) {
+            CAPTURE(static_cast<int>(insertion));
+            std::vector<Triangle> triangles;
+            for (const Eigen::Vector3d& center : centers) {
+                triangles.emplace_back(center, Eigen::Vector3d(-0.15, -0.1, 0), Eigen::Vector3d(0.15, -0.1, 0.05), Eigen::Vector3d(0, 0.2, -0.05));
+            }
+            std::vector<const Triangle*> objects;
+            for (const Triangle& triangle : triangles) {
+                objects.push_back(&triangle);
+            }
+            Octree<Triangle> octree(10, 8.0, 4, Eigen::Vector3d::Zero(), insertion);
+            octree.build(objects);
+            octree.finalize();
+            REQUIRE(octree.getFlatOctree().isCompact());
+
+            // Move a few objects at each frame: only their leaves are compiled again
+            bool patched = false;
+            for (int frame = 0; frame < 20; ++frame) {
+                CAPTURE(frame);
+                for (std::size_t i = frame; i < triangles.size(); i += 37) {
+                    triangles[i].translate(Eigen::Vector3d(0.3 * std::sin(frame + i), 0.2, -0.25 * std::cos(i)));
+                    octree.update(&triangles[i]);
+                }
+                const FlatOctree<Triangle>& flat_octree = octree.getFlatOctree();
+                CHECK(octree.getRoot()->modified == false);
+                patched |= !flat_octree.isCompact();
+
+                FlatOctree<Triangle> compiled_octree;
+                compiled_octree.build(octree.getRoot(), insertion);
+                CHECK(flat_octree.getReferenceCount() == compiled_octree.getPrimitives().size());
+                compareNodes(flat_octree, 0, compiled_octree, 0);
+                if (insertion == OctreeInsertion::BoundingBox) checkHits(octree, objects);
+            }
+            CHECK(patched);
+
+            // The replaced nodes are not saved, and the patched layout read by the queries is left as it is
+            const std::string path = (std::filesystem::temp_directory_path() / "octree_patched.bin").string();
+            const bool compact = octree.getFlatOctree().isCompact();
+            const std::size_t node_count = octree.getFlatOctree().getNodes().size();
+            octree.save(path, objects);
+            CHECK(octree.getFlatOctree().isCompact() == compact);
+            CHECK(octree.getFlatOctree().getNodes().size() == node_count);
+            Octree<Triangle> loaded_octree(insertion);
+            loaded_octree.load(path, objects);
+            CHECK(loaded_octree.getFlatOctree().isCompact());
+            FlatOctree<Triangle> compiled_octree;
+            compiled_octree.build(octree.getRoot(), insertion);
+            compareNodes(loaded_octree.getFlatOctree(), 0, compiled_octree, 0);
+            std::filesystem::remove(path);
+        }
+    }
+
+    SUBCASE("An object which cannot be moved stays in the octree") {
+        for (OctreeInsertion insertion : {OctreeInsertion::Position, OctreeInsertion::BoundingBox}) {
+            CAPTURE(static_cast<int>(insertion));
+            std::vector<Triangle> triangles;
+            for (std::size_t i = 0; i < 60; ++i) {
+                triangles.emplace_back(centers[i], Eigen::Vector3d(-0.15, -0.1, 0), Eigen::Vector3d(0.15, -0.1, 0.05), Eigen::Vector3d(0, 0.2, -0.05));
+            }
+            std::vector<const Triangle*> objects;
+            for (const Triangle& triangle : triangles) {
+                objects.push_back(&triangle);
+            }
+            Octree<Triangle> octree(5, 8.0, 4, Eigen::Vector3d::Zero(), insertion);
+            for (const Triangle* triangle : objects) octree.insert(triangle);
+            octree.finalize();
+
+            // The root cannot grow to the new position: the object is put back where it was
+            Triangle& moved = triangles[7];
+            moved.translate(Eigen::Vector3d(1e6, 0, 0));
+            CHECK_THROWS_AS(octree.update(&moved), std::length_error);
+            moved.translate(Eigen::Vector3d(-1e6, 0, 0));
+            if (insertion == OctreeInsertion::BoundingBox) checkHits(octree, objects);
+
+            octree.update(&moved);
+            checkLeaves(octree, objects);
+            if (insertion == OctreeInsertion::BoundingBox) checkHits(octree, objects);
+            CHECK(octree.remove(&moved));
+        }
+    }
+}
+
+TEST_CASE("[Octree] testing the cost model") {
+    CHECK_THROWS_AS(Octree<Triangle>(OctreeInsertion::BoundingBox, OctreeCostModel{1.0, 0.0}), std::invalid_argument);
+    CHECK_THROWS_AS(Octree<Triangle>(OctreeInsertion::BoundingBox, OctreeCostModel{-1.0, 1.0}), std::invalid_argument);
+    CHECK_THROWS_AS(Octree<MockTriangle>(OctreeInsertion::BoundingBox), std::invalid_argument);
+
+    // Splitting pays off when the children are crossed less often than the leaf, and not when they all reference every object
+    const OctreeCostModel cost_model;
+    CHECK(cost_model.shouldSplit(20, 20));
+    CHECK_FALSE(cost_model.shouldSplit(20, 160));
+    CHECK_FALSE(cost_model.shouldSplit(1, 1));
+
+    SUBCASE("Objects sharing a position stay in an overflowing leaf") {
+        std::vector<MockTriangle> triangles(50, MockTriangle(Eigen::Vector3d(0.3, -0.2, 0.1)));
+        triangles.emplace_back(Eigen::Vector3d(-2, 1, 0.5));
+        std::vector<const MockTriangle*> objects;
+        for (const MockTriangle& triangle : triangles) {
+            objects.push_back(&triangle);
+        }
+
+        // Without a cost model, the objects must be separated before the maximum depth
+        Octree<MockTriangle> manual(10, 1.0, 8, Eigen::Vector3d::Zero());
+        CHECK_THROWS_AS(manual.build(objects), std::length_error);
+
+        for (bool bulk_build : {false, true}) {
+            CAPTURE(bulk_build);
+            Octree<MockTriangle> octree(OctreeInsertion::Position);
+            CHECK(octree.getCostModel() != nullptr);
+            if (bulk_build) {
+                CHECK_NOTHROW(octree.build(objects));
+            } else {
+                for (const MockTriangle* triangle : objects) CHECK_NOTHROW(octree.insert(triangle));
+            }
+
+            std::size_t largest_leaf = 0;
+            std::function<void(const OctreeNode<MockTriangle>*)> visit = [&](const OctreeNode<MockTriangle>* node) {
+                if (node->total_children_depth > 0) {
+                    for (const OctreeNode<MockTriangle>* child : node->children) visit(child);
+                    return;
+                }
+                largest_leaf = std::max(largest_leaf, node->data.size());
+            };
+            visit(octree.getRoot());
+            CHECK(largest_leaf == 50);
+            CHECK(octree.getFlatOctree().getPrimitives().size() == 51);
+        }
+    }
+
+    SUBCASE("Leaves are split as long as it pays off") {
+        std::mt19937 generator(9);
+        std::uniform_real_distribution<double> unit(-0.5, 0.5);
+        std::vector<Triangle> triangles;
+        for (int i = 0; i < 600; ++i) {
+            // A dense cluster in a large sparse cloud, and a few large triangles
+            const double spread = (i % 3 == 0) ? 20.0 : 1.0;
+            const double size = (i % 50 == 0) ? 4.0 : 0.1;
+            triangles.emplace_back(Eigen::Vector3d(spread * unit(generator) + 3, spread * unit(generator), spread * unit(generator)),
+                                   size * Eigen::Vector3d(-1, -0.5, 0), size * Eigen::Vector3d(1, -0.5, 0.2), size * Eigen::Vector3d(0, 1, -0.2));
+        }
+        std::vector<const Triangle*> objects;
+        Box bounds = Box::empty();
+        for (const Triangle& triangle : triangles) {
+            objects.push_back(&triangle);
+            bounds.extend(triangle.getBoundingBox());
+        }
+
+        for (bool bulk_build : {false, true}) {
+            CAPTURE(bulk_build);
+            Octree<Triangle> octree;
+            if (bulk_build) {
+                octree.build(objects);
+
+                // The root fits the objects
+                CHECK(octree.getRoot()->size == doctest::Approx((bounds.max - bounds.min).maxCoeff()));
+                CHECK(octree.getRoot()->getBoundingBox().contains(bounds));
+            } else {
+                for (const Triangle* triangle : objects) octree.insert(triangle);
+            }
+
+            // No leaf would be cheaper once split
+            std::function<void(const OctreeNode<Triangle>*)> visit = [&](const OctreeNode<Triangle>* node) {
+                if (node->total_children_depth > 0) {
+                    for (const OctreeNode<Triangle>* child : node->children) visit(child);
+                    return;
+                }
+                std::size_t child_references = 0;
+                const double half_size = node->getHalfSize() / 2;
+                for (int i = 0; i < 8; ++i) {
+                    const Eigen::Array3d center = node->position.array() +
+                        Eigen::Array3d((i & 4) ? half_size : -half_size, (i & 2) ? half_size : -half_size, (i & 1) ? half_size : -half_size);
+                    for (const Triangle* triangle : node->data) {
+                        child_references += Box{center - half_size, center + half_size}.overlaps(triangle->getBoundingBox());
+                    }
+                }
+                CHECK_FALSE(cost_model.shouldSplit(node->data.size(), child_references));
+            };
+            visit(octree.getRoot());
+
+            // The hits are the closest ones
+            for (int i = 0; i < 200; ++i) {
+                Eigen::Vector3d origin(15 * std::cos(0.3 * i), 4 * std::sin(0.7 * i), 15 * std::sin(0.3 * i));
+                Ray ray(origin, triangles[i].getPosition() - origin);
+
+                const Triangle* expected_hit = nullptr;
+                float u, v, t, expected_distance = std::numeric_limits<float>::infinity();
+                for (const Triangle& triangle : triangles) {
+                    if (triangle.intersect(ray, u, v, t) && t < expected_distance) {
+                        expected_distance = t;
+                        expected_hit = &triangle;
+                    }
+                }
+                double hit_distance;
+                CHECK(octree.traceRay(ray, hit_distance) == expected_hit);
+            }
+        }
+    }
+}
+
+TEST_CASE("[Octree] testing statistics") {
+    SUBCASE("A root split once") {
+        Octree<MockTriangle> octree(5, 2.0, 3, Eigen::Vector3d::Zero());
+        MockTriangle triangle1(Eigen::Vector3d(0.5, 0.5, 0.5));
+        MockTriangle triangle2(Eigen::Vector3d(-0.5, 0.5, 0.5));
+        MockTriangle triangle3(Eigen::Vector3d(0.5, -0.5, 0.5));
+        MockTriangle triangle4(Eigen::Vector3d(0.5, 0.5, -0.5));
+        for (const MockTriangle* triangle : {&triangle1, &triangle2, &triangle3, &triangle4}) {
+            octree.insert(triangle);
+        }
+
+        const OctreeStats stats = octree.stats();
+        CHECK(stats.nodes_per_depth == std::vector<std::size_t>{1, 8});
+        CHECK(stats.getNodeCount() == 9);
+        CHECK(stats.leaf_count == 8);
+        CHECK(stats.empty_leaf_count == 4);
+        CHECK(stats.getEmptyLeafRatio() == 0.5);
+        CHECK(stats.leaf_occupancy == std::vector<std::size_t>{4, 4});
+        CHECK(stats.reference_count == 4);
+        CHECK(stats.node_bytes == 9 * sizeof(OctreeNode<MockTriangle>));
+        CHECK(stats.primitive_bytes >= 4 * sizeof(const MockTriangle*));
+        CHECK(stats.flat_bytes == octree.getFlatOctree().bytes());
+
+        // The root and its 8 children, each crossed by a quarter of the rays, and one object in half of the children
+        CHECK(stats.traversal_cost == doctest::Approx(1 + 8 * 0.25 + 4 * 0.25));
+
+        const std::string json = stats.toJson();
+        CHECK(json.front() == '{');
+        CHECK(json.back() == '}');
+        CHECK(json.find("\"nodes_per_depth\": [1, 8]") != std::string::npos);
+        CHECK(json.find("\"empty_leaf_ratio\": 0.5") != std::string::npos);
+        CHECK(json.find("{\"min_objects\": 1, \"max_objects\": 1, \"leaves\": 4}") != std::string::npos);
+    }
+
+    SUBCASE("The statistics add up on a larger tree") {
+        std::mt19937 generator(3);
+        std::uniform_real_distribution<double> unit(-0.5, 0.5);
+        std::vector<Triangle> triangles;
+        for (int i = 0; i < 500; ++i) {
+            triangles.emplace_back(Eigen::Vector3d(10 * unit(generator), 10 * unit(generator), unit(generator)),
+                                   Eigen::Vector3d(-0.1, -0.1, 0), Eigen::Vector3d(0.1, -0.1, 0.05), Eigen::Vector3d(0, 0.1, -0.05));
+        }
+        std::vector<const Triangle*> objects;
+        for (const Triangle& triangle : triangles) {
+            objects.push_back(&triangle);
+        }
+
+        Octree<Triangle> octree;
+        octree.build(objects);
+        const OctreeStats stats = octree.stats();
+
+        std::size_t bucket_total = 0;
+        for (std::size_t leaves : stats.leaf_occupancy) bucket_total += leaves;
+        CHECK(bucket_total == stats.leaf_count);
+        CHECK(stats.leaf_occupancy.front() == stats.empty_leaf_count);
+        CHECK(stats.nodes_per_depth.front() == 1);
+        CHECK((stats.getNodeCount() - 1) % 8 == 0);
+        CHECK(stats.leaf_count == stats.getNodeCount() - (stats.getNodeCount() - 1) / 8);
+        CHECK(stats.reference_count >= objects.size());
+
+        // Splitting the leaves made the rays cheaper than testing all the objects in the root
+        CHECK(stats.traversal_cost < OctreeCostModel().traversal_cost + objects.size() * OctreeCostModel().intersection_cost);
+
+        std::ostringstream printed;
+        octree.print(printed);
+        CHECK(printed.str().find("root") != std::string::npos);
+    }
+}
+
+TEST_CASE("[Octree] testing saving and loading") {
+    std::mt19937 generator(8);
+    std::uniform_real_distribution<double> unit(-0.5, 0.5);
+    std::vector<Triangle> triangles;
+    for (int i = 0; i < 400; ++i) {
+        triangles.emplace_back(Eigen::Vector3d(10 * unit(generator), 10 * unit(generator), 10 * unit(generator)),
+                               Eigen::Vector3d(-0.2, -0.2, 0), Eigen::Vector3d(0.2, -0.2, 0.1), Eigen::Vector3d(0, 0.2, -0.1));
+    }
+    std::vector<const Triangle*> objects;
+    for (const Triangle& triangle : triangles) {
+        objects.push_back(&triangle);
+    }
+
+    std::vector<Ray> rays;
+    for (int i = 0; i < 300; ++i) {
+        const Eigen::Vector3d origin(20 * unit(generator), 20 * unit(generator), -15);
+        rays.emplace_back(origin, Eigen::Vector3d(10 * unit(generator), 10 * unit(generator), 0) - origin);
+    }
+
+    Octree<Triangle> octree;
+    octree.build(objects);
+    const std::string path = (std::filesystem::temp_directory_path() / "3drenderer-octree-test.bin").string();
+    octree.save(path, objects);
+
+    auto checkSameHits = [&](const Octree<Triangle>& loaded_octree) {
+        unsigned int hits = 0;
+        for (const Ray& ray : rays) {
+            double expected_distance, hit_distance;
+            const Triangle* expected = octree.traceRay(ray, expected_distance);
+            REQUIRE(loaded_octree.traceRay(ray, hit_distance) == expected);
+            if (!expected) continue;
+            ++hits;
+            CHECK(hit_distance == expected_distance);
+        }
+        CHECK(hits > 50);
+    };
+
+    SUBCASE("The loaded octree is the saved one, read from the file") {
+        Octree<Triangle> loaded_octree;
+        loaded_octree.load(path, objects);
+        CHECK(loaded_octree.isFinalized());
+
+        const FlatOctree<Triangle>& flat_octree = loaded_octree.getFlatOctree();
+        const FlatOctree<Triangle>& saved_flat_octree = octree.getFlatOctree();
+        CHECK(flat_octree.isMapped());
+        CHECK_FALSE(saved_flat_octree.isMapped());
+        REQUIRE(flat_octree.getNodes().size() == saved_flat_octree.getNodes().size());
+        for (std::size_t i = 0; i < flat_octree.getNodes().size(); ++i) {
+            CHECK(flat_octree.getNodes()[i].child_base == saved_flat_octree.getNodes()[i].child_base);
+            CHECK(flat_octree.getNodes()[i].child_mask == saved_flat_octree.getNodes()[i].child_mask);
+            CHECK(flat_octree.getNodes()[i].first == saved_flat_octree.getNodes()[i].first);
+            CHECK(flat_octree.getNodes()[i].count == saved_flat_octree.getNodes()[i].count);
+        }
+        CHECK(flat_octree.getPrimitives() == saved_flat_octree.getPrimitives());
+        CHECK(flat_octree.getRootCenter() == saved_flat_octree.getRootCenter());
+        CHECK(flat_octree.getRootHalfSize() == saved_flat_octree.getRootHalfSize());
+        checkSameHits(loaded_octree);
+
+        // A copy shares the mapping of the file
+        const FlatOctree<Triangle> copy = flat_octree;
+        CHECK(copy.getNodes().data() == flat_octree.getNodes().data());
+
+        // The statistics of the flat layout count the same references, without the empty leaves
+        const OctreeStats stats = loaded_octree.stats();
+        CHECK(stats.reference_count == octree.stats().reference_count);
+        CHECK(stats.empty_leaf_count == 0);
+        CHECK(stats.node_bytes == 0);
+    }
+
+    SUBCASE("The loaded octree can be modified") {
+        Octree<Triangle> loaded_octree;
+        loaded_octree.load(path, objects);
+
+        for (std::size_t i = 0; i < triangles.size(); i += 4) {
+            triangles[i].translate(Eigen::Vector3d(0.5, 0, 0));
+            octree.update(&triangles[i]);
+            loaded_octree.update(&triangles[i]);
+        }
+        CHECK_FALSE(loaded_octree.getFlatOctree().isMapped());
+        CHECK(loaded_octree.stats().reference_count == octree.stats().reference_count);
+        checkSameHits(loaded_octree);
+
+        CHECK(loaded_octree.remove(objects[1]));
+        CHECK_FALSE(loaded_octree.remove(objects[1]));
+    }
+
+    SUBCASE("The file must match the octree and the objects") {
+        Octree<Triangle> loaded_octree;
+        CHECK_THROWS_AS(loaded_octree.load(path, std::span<const Triangle* const>(objects).first(10)), std::invalid_argument);
+
+        Octree<Triangle> position_octree(OctreeInsertion::Position);
+        CHECK_THROWS_AS(position_octree.load(path, objects), std::invalid_argument);
+
+        Octree<Triangle> shallow_octree(1, 1.0, 8, Eigen::Vector3d::Zero(), OctreeInsertion::BoundingBox);
+        CHECK_THROWS_AS(shallow_octree.load(path, objects), std::invalid_argument);
+
+        CHECK_THROWS_AS(octree.save(path + ".missing", std::span<const Triangle* const>(objects).first(10)), std::invalid_argument);
+        CHECK_THROWS_AS(loaded_octree.load(path + ".missing", objects), std::runtime_error);
+        CHECK_THROWS_AS(octree.save((std::filesystem::temp_directory_path() / "missing-directory" / "octree.bin").string(), objects),
+                        std::runtime_error);
+
+        // A failed load leaves the octree unchanged
+        CHECK(loaded_octree.getFlatOctree().getNodes().size() == 1);
+    }
+
+    SUBCASE("A corrupted file is rejected") {
+        std::string content;
+        {
+            std::ifstream file(path, std::ios::binary);
+            content.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        }
+        const std::string corrupted_path = path + ".corrupted";
+        auto checkRejected = [&](const std::string& corrupted_content) {
+            std::ofstream(corrupted_path, std::ios::binary | std::ios::trunc) << corrupted_content;
+            Octree<Triangle> loaded_octree;
+            CHECK_THROWS_AS(loaded_octree.load(corrupted_path, objects), std::runtime_error);
+        };
+
+        std::string wrong_magic = content;
+        wrong_magic[0] = 'X';
+        checkRejected(wrong_magic);
+
+        std::string wrong_version = content;
+        wrong_version[offsetof(FlatOctreeFileHeader, version)] = 2;
+        checkRejected(wrong_version);
+
+        checkRejected(content.substr(0, content.size() - 1));
+        checkRejected(content.substr(0, 20));
+
+        // The root pointing at itself would loop forever
+        std::string wrong_child = content;
+        const std::size_t root_offset = sizeof(FlatOctreeFileHeader);
+        std::memset(&wrong_child[root_offset + offsetof(FlatOctreeNode, child_base)], 0, sizeof(std::uint32_t));
+        checkRejected(wrong_child);
+
+        // The last primitive index points past the objects
+        std::string wrong_index = content;
+        std::memset(&wrong_index[wrong_index.size() - sizeof(std::uint32_t)], 0xff, sizeof(std::uint32_t));
+        checkRejected(wrong_index);
+        std::filesystem::remove(corrupted_path);
+    }
+
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("[Octree] testing compact nodes") {
+    std::mt19937 generator(12);
+    std::uniform_real_distribution<double> unit(-0.5, 0.5);
+    std::vector<Triangle> triangles;
+    for (int i = 0; i < 400; ++i) {
+        triangles.emplace_back(Eigen::Vector3d(10 * unit(generator), 10 * unit(generator), 10 * unit(generator)),
+                               Eigen::Vector3d(-0.2, -0.2, 0), Eigen::Vector3d(0.2, -0.2, 0.1), Eigen::Vector3d(0, 0.2, -0.1));
+    }
+    std::vector<const Triangle*> objects;
+    for (const Triangle& triangle : triangles) {
+        objects.push_back(&triangle);
+    }
+
+    SUBCASE("The packed fields") {
+        const CompactFlatOctreeNode leaf = CompactFlatOctreeNode::makeLeaf(123456, CompactFlatOctreeNode::MAX_COUNT);
+        CHECK(leaf.isLeaf());
+        CHECK(leaf.getFirst() == 123456);
+        CHECK(leaf.getCount() == CompactFlatOctreeNode::MAX_COUNT);
+        CHECK_THROWS_AS(CompactFlatOctreeNode::makeLeaf(0, CompactFlatOctreeNode::MAX_COUNT + 1), std::length_error);
+
+        const CompactFlatOctreeNode interior = CompactFlatOctreeNode::makeInterior(42, 0b10100100);
+        CHECK_FALSE(interior.isLeaf());
+        CHECK(interior.getChildBase() == 42);
+        CHECK(interior.getChildMask() == 0b10100100);
+        CHECK_FALSE(interior.hasChild(0));
+        CHECK(interior.hasChild(2));
+        CHECK(interior.getChild(2) == 42);
+        CHECK(interior.getChild(5) == 43);
+        CHECK(interior.getChild(7) == 44);
+    }
+
+    SUBCASE("The compact layout gives the same hits with half the node memory") {
+        Octree<Triangle> octree;
+        octree.build(objects);
+        Octree<Triangle, NodeArena, CompactFlatOctreeNode> compact_octree;
+        compact_octree.build(objects);
+
+        const FlatOctree<Triangle>& flat_octree = octree.getFlatOctree();
+        const FlatOctree<Triangle, CompactFlatOctreeNode>& compact_flat_octree = compact_octree.getFlatOctree();
+        REQUIRE(compact_flat_octree.getNodes().size() == flat_octree.getNodes().size());
+        for (std::size_t i = 0; i < flat_octree.getNodes().size(); ++i) {
+            const FlatOctreeNode& node = flat_octree.getNodes()[i];
+            const CompactFlatOctreeNode& compact_node = compact_flat_octree.getNodes()[i];
+            CHECK(compact_node.getChildMask() == node.getChildMask());
+            if (node.isLeaf()) {
+                CHECK(compact_node.getFirst() == node.getFirst());
+                CHECK(compact_node.getCount() == node.getCount());
+            } else {
+                CHECK(compact_node.getChildBase() == node.getChildBase());
+            }
+        }
+        CHECK(flat_octree.bytes() - compact_flat_octree.bytes() == 8 * flat_octree.getNodes().size());
+
+        unsigned int hits = 0;
+        for (int i = 0; i < 300; ++i) {
+            const Eigen::Vector3d origin(20 * unit(generator), 20 * unit(generator), -15);
+            const Ray ray(origin, Eigen::Vector3d(10 * unit(generator), 10 * unit(generator), 0) - origin);
+            double expected_distance, hit_distance;
+            const Triangle* expected = octree.traceRay(ray, expected_distance);
+            REQUIRE(compact_octree.traceRay(ray, hit_distance) == expected);
+            CHECK(compact_octree.occluded(ray, std::numeric_limits<double>::infinity()) == (expected != nullptr));
+            if (!expected) continue;
+            ++hits;
+            CHECK(hit_distance == expected_distance);
+        }
+        CHECK(hits > 50);
+
+        // The files of the two layouts are not interchangeable
+        const std::string path = (std::filesystem::temp_directory_path() / "3drenderer-compact-octree-test.bin").string();
+        compact_octree.save(path, objects);
+        Octree<Triangle, NodeArena, CompactFlatOctreeNode> loaded_octree;
+        loaded_octree.load(path, objects);
+        CHECK(loaded_octree.getFlatOctree().getNodes().size() == compact_flat_octree.getNodes().size());
+        CHECK_THROWS_AS(octree.load(path, objects), std::runtime_error);
+        std::filesystem::remove(path);
+    }
+}
+
+TEST_CASE("[Octree] testing range queries") {
+    std::mt19937 generator(21);
+    std::uniform_real_distribution<double> unit(-0.5, 0.5);
+    std::vector<Triangle> triangles;
+    for (int i = 0; i < 500; ++i) {
+        triangles.emplace_back(Eigen::Vector3d(10 * unit(generator), 10 * unit(generator), 10 * unit(generator)),
+                               Eigen::Vector3d(-0.3, -0.3, 0), Eigen::Vector3d(0.3, -0.3, 0.2), Eigen::Vector3d(0, 0.3, -0.2));
+    }
+    std::vector<const Triangle*> objects;
+    for (const Triangle& triangle : triangles) {
+        objects.push_back(&triangle);
+    }
+
+    // A pyramid looking along z from behind the triangles, cut by a near and a far plane
+    const Eigen::Vector3d apex(0.5, -0.5, -12);
+    const std::vector<Plane> frustum = {
+        Plane(Eigen::Vector3d(1, 0, 0.4), apex), Plane(Eigen::Vector3d(-1, 0, 0.4), apex),
+        Plane(Eigen::Vector3d(0, 1, 0.3), apex), Plane(Eigen::Vector3d(0, -1, 0.3), apex),
+        Plane(Eigen::Vector3d(0, 0, 1), Eigen::Vector3d(0, 0, -2)), Plane(Eigen::Vector3d(0, 0, -1), Eigen::Vector3d(0, 0, 3)),
+    };
+
+    for (OctreeInsertion insertion : {OctreeInsertion::Position, OctreeInsertion::BoundingBox}) {
+        CAPTURE(static_cast<int>(insertion));
+        Octree<Triangle> octree(insertion);
+        octree.build(objects);
+
+        // The objects of a region found by testing all of them, by bounding box or by position as in the octree
+        auto checkQuery = [&](const auto& region, const std::vector<const Triangle*>& results) {
+            std::vector<const Triangle*> expected;
+            for (const Triangle* triangle : objects) {
+                const bool in_region = insertion == OctreeInsertion::BoundingBox ? region.overlaps(triangle->getBoundingBox())
+                                                                                 : region.contains(triangle->getPosition());
+                if (in_region) expected.push_back(triangle);
+            }
+            std::vector<const Triangle*> sorted_results = results;
+            std::sort(sorted_results.begin(), sorted_results.end());
+            CHECK(sorted_results == expected);
+            return expected.size();
+        };
+
+        std::vector<const Triangle*> results;
+        std::size_t gathered = 0;
+        for (int i = 0; i < 20; ++i) {
+            const Eigen::Array3d corner(10 * unit(generator), 10 * unit(generator), 10 * unit(generator));
+            const Box box{corner, corner + Eigen::Array3d(4 * (unit(generator) + 0.5), 4 * (unit(generator) + 0.5), 4 * (unit(generator) + 0.5))};
+            octree.queryBox(box, results);
+            gathered += checkQuery(BoxRegion{box}, results);
+
+            const Eigen::Vector3d center(10 * unit(generator), 10 * unit(generator), 10 * unit(generator));
+            const double radius = 3 * (unit(generator) + 0.5);
+            octree.querySphere(center, radius, results);
+            gathered += checkQuery(SphereRegion{center, radius}, results);
+        }
+        CHECK(gathered > 100);
+
+        octree.queryFrustum(frustum, results);
+        CHECK(checkQuery(FrustumRegion{frustum}, results) > 20);
+
+        // A region holding the whole octree gathers every object once, a region away from it gathers none
+        octree.querySphere(Eigen::Vector3d::Zero(), 100.0, results);
+        CHECK(results.size() == objects.size());
+        octree.queryBox(Box{Eigen::Array3d::Constant(50), Eigen::Array3d::Constant(60)}, results);
+        CHECK(results.empty());
+
+        // A patched layout, whose subtrees no longer hold contiguous objects, gathers the same objects as a compiled one
+        for (std::size_t i = 0; i < triangles.size(); i += 37) {
+            triangles[i].translate(Eigen::Vector3d(0.2 * unit(generator), 0.2 * unit(generator), 0.2 * unit(generator)));
+            octree.update(&triangles[i]);
+        }
+        octree.finalize();
+        CHECK_FALSE(octree.getFlatOctree().isCompact());
+        octree.queryFrustum(frustum, results);
+        CHECK(checkQuery(FrustumRegion{frustum}, results) > 20);
+        octree.querySphere(Eigen::Vector3d::Zero(), 100.0, results);
+        CHECK(results.size() == objects.size());
+
+        // And so does a loaded layout
+        const std::string path = (std::filesystem::temp_directory_path() / "octree_queries.bin").string();
+        octree.save(path, objects);
+        Octree<Triangle> loaded_octree(insertion);
+        loaded_octree.load(path, objects);
+        loaded_octree.queryFrustum(frustum, results);
+        CHECK(checkQuery(FrustumRegion{frustum}, results) > 20);
+        loaded_octree.querySphere(Eigen::Vector3d::Zero(), 100.0, results);
+        CHECK(results.size() == objects.size());
+
+        // A file of a patched layout is loaded as it is, and saved again as it was loaded
+        const std::string patched_path = (std::filesystem::temp_directory_path() / "octree_queries_patched.bin").string();
+        octree.getFlatOctree().save(patched_path, objects);
+        loaded_octree.load(patched_path, objects);
+        CHECK_FALSE(loaded_octree.getFlatOctree().isCompact());
+        loaded_octree.save(path, objects);
+        Octree<Triangle> reloaded_octree(insertion);
+        reloaded_octree.load(path, objects);
+        CHECK(reloaded_octree.getFlatOctree().getNodes().size() == octree.getFlatOctree().getNodes().size());
+        reloaded_octree.queryFrustum(frustum, results);
+        CHECK(checkQuery(FrustumRegion{frustum}, results) > 20);
+        reloaded_octree.querySphere(Eigen::Vector3d::Zero(), 100.0, results);
+        CHECK(results.size() == objects.size());
+        std::filesystem::remove(path);
+        std::filesystem::remove(patched_path);
+    }
+}
+
+TEST_CASE("[Octree] testing nearest object queries") {
+    // The closest point of a triangle lies on its face, an edge or a vertex
+    Triangle triangle(Eigen::Vector3d::Zero(), Eigen::Vector3d(0, 0, 0), Eigen::Vector3d(2, 0, 0), Eigen::Vector3d(0, 2, 0));
+    auto checkClosestPoint = [&](const Eigen::Vector3d& point, const Eigen::Vector3d& expected) {
+        CHECK((triangle.closestPoint(point) - expected).norm() < 1e-12);
+    };
+    checkClosestPoint(Eigen::Vector3d(0.5, 0.5, 3), Eigen::Vector3d(0.5, 0.5, 0));
+    checkClosestPoint(Eigen::Vector3d(-1, -1, 1), Eigen::Vector3d(0, 0, 0));
+    checkClosestPoint(Eigen::Vector3d(1, -2, 0), Eigen::Vector3d(1, 0, 0));
+    checkClosestPoint(Eigen::Vector3d(2, 2, -1), Eigen::Vector3d(1, 1, 0));
+    checkClosestPoint(Eigen::Vector3d(0, 5, 0), Eigen::Vector3d(0, 2, 0));
+
+    std::mt19937 generator(22);
+    std::uniform_real_distribution<double> unit(-0.5, 0.5);
+    std::vector<Triangle> triangles;
+    for (int i = 0; i < 500; ++i) {
+        triangles.emplace_back(Eigen::Vector3d(10 * unit(generator), 10 * unit(generator), 10 * unit(generator)),
+                               Eigen::Vector3d(-0.3, -0.3, 0), Eigen::Vector3d(0.3, -0.3, 0.2), Eigen::Vector3d(0, 0.3, -0.2));
+        triangles.back().rotate(Eigen::Vector3d(unit(generator), unit(generator), unit(generator)));
+    }
+    std::vector<const Triangle*> objects;
+    for (const Triangle& triangle : triangles) {
+        objects.push_back(&triangle);
+    }
+
+    Octree<Triangle> octree(OctreeInsertion::BoundingBox);
+    octree.build(objects);
+
+    // The nearest triangle is the one found by testing all of them
+    for (int i = 0; i < 100; ++i) {
+        const Eigen::Vector3d point(14 * unit(generator), 14 * unit(generator), 14 * unit(generator));
+        double expected_distance = std::numeric_limits<double>::infinity();
+        for (const Triangle* triangle : objects) {
+            expected_distance = std::min(expected_distance, (triangle->closestPoint(point) - point).norm());
+        }
+
+        Eigen::Vector3d closest_point;
+        const Triangle* nearest = octree.nearest(point, closest_point);
+        REQUIRE(nearest != nullptr);
+        CHECK((closest_point - point).norm() == doctest::Approx(expected_distance));
+        CHECK(closest_point.isApprox(nearest->closestPoint(point)));
+
+        // A radius shorter than the distance to the nearest triangle finds nothing, a longer one finds the same distance
+        CHECK(octree.nearest(point, closest_point, expected_distance * 0.99) == nullptr);
+        REQUIRE(octree.nearest(point, closest_point, expected_distance * 1.01) != nullptr);
+        CHECK((closest_point - point).norm() == doctest::Approx(expected_distance));
+    }
+
+    // An empty octree has no nearest object
+    Octree<Triangle> empty_octree(OctreeInsertion::BoundingBox);
+    empty_octree.build({});
+    Eigen::Vector3d closest_point;
+    CHECK(empty_octree.nearest(Eigen::Vector3d::Zero(), closest_point) == nullptr);
+}
+
+TEST_CASE("[Octree] testing intersection records") {
+    std::mt19937 generator(24);
+    std::uniform_real_distribution<double> unit(-0.5, 0.5);
+    std::vector<Triangle> triangles;
+    for (int i = 0; i < 300; ++i) {
+        triangles.emplace_back(Eigen::Vector3d(6 * unit(generator), 6 * unit(generator), 6 * unit(generator)),
+                               Eigen::Vector3d(-0.3, -0.3, 0), Eigen::Vector3d(0.3, -0.3, 0.2), Eigen::Vector3d(0, 0.3, -0.2));
+        triangles.back().rotate(Eigen::Vector3d(unit(generator), unit(generator), unit(generator)));
+    }
+    std::vector<const Triangle*> objects;
+    for (const Triangle& triangle : triangles) {
+        objects.push_back(&triangle);
+    }
+    std::vector<Ray> rays;
+    for (int i = 0; i < 500; ++i) {
+        rays.emplace_back(Eigen::Vector3d(8 * unit(generator), 8 * unit(generator), -6), Eigen::Vector3d(unit(generator), unit(generator), 1));
+    }
+
+    // The record of a triangle gives its hits, with the same barycentric coordinates and distances
+    unsigned int hits = 0;
+    for (const Ray& ray : rays) {
+        for (const Triangle& triangle : triangles) {
+            float u, v, t, record_u, record_v, record_t;
+            const bool hit = triangle.intersect(ray, u, v, t);
+            REQUIRE(triangle.getIntersectionRecord().intersect(ray, record_u, record_v, record_t) == hit);
+            if (!hit) continue;
+            ++hits;
+            CHECK(record_u == u);
+            CHECK(record_v == v);
+            CHECK(record_t == t);
+
+            // The coordinates of the hit point are the ones of the hit
+            float point_u, point_v;
+            triangle.getIntersectionRecord().getCoordinates(ray.getOrigin() + ray.getDirection() * t, point_u, point_v);
+            CHECK(point_u == doctest::Approx(u).epsilon(1e-3));
+            CHECK(point_v == doctest::Approx(v).epsilon(1e-3));
+        }
+    }
+    CHECK(hits > 50);
+
+    // The coordinates of a point out of the triangle are clamped to the triangle
+    float clamped_u, clamped_v;
+    const TriangleRecord& record = triangles[0].getIntersectionRecord();
+    record.getCoordinates(record.point0 + 2 * record.edge1.cast<double>() + record.edge2.cast<double>(), clamped_u, clamped_v);
+    CHECK(clamped_u >= 0);
+    CHECK(clamped_v >= 0);
+    CHECK(clamped_u + clamped_v == doctest::Approx(1));
+    record.getCoordinates(record.point0 - record.edge2.cast<double>(), clamped_u, clamped_v);
+    CHECK(clamped_u == doctest::Approx(0));
+    CHECK(clamped_v == 0);
+
+    // A ray grazing a corner hits the record a little outside the bounding box of the triangle, after the rounding of the edges.
+    // The test of the triangle is the test of its record, without a bounding box check which would miss the hit
+    const Triangle grazed(Eigen::Vector3d(-0.52312740437358163, 0.42720908833783922, -0.4273917429620353),
+                          Eigen::Vector3d(0.85699769300042261, -0.94894425390652404, -0.4273917429620353),
+                          Eigen::Vector3d(0.43911159916236242, 0.60011465467128944, -0.4273917429620353));
+    const Ray grazing_ray(Eigen::Vector3d(-1.1239166633863726, 0.79180949588663185, 0.75645032970222492),
+                          Eigen::Vector3d(0.4623363793030964, -0.18229230857925946, -0.86776413074391778));
+    double box_distance;
+    float u, v, t;
+    CHECK_FALSE(grazed.getBoundingBox().intersect(grazing_ray, box_distance));
+    CHECK(grazed.intersect(grazing_ray, u, v, t));
+
+    // The record follows the triangle when it moves
+    Triangle moved = triangles[0];
+    moved.translate(Eigen::Vector3d(1, -2, 0.5));
+    moved.rotate(Eigen::Vector3d(0.2, 0.4, -0.1));
+    CHECK(moved.getIntersectionRecord().point0 == moved.getPoint(0));
+    CHECK(moved.getIntersectionRecord().edge1 == (moved.getPoint(1) - moved.getPoint(0)).cast<float>());
+    CHECK(moved.getIntersectionRecord().edge2 == (moved.getPoint(2) - moved.getPoint(0)).cast<float>());
+
+    // The flat octree stores one record per object of its leaves, and compiles them again when the objects move
+    Octree<Triangle> octree(OctreeInsertion::BoundingBox);
+    octree.build(objects);
+    const FlatOctree<Triangle>& flat_octree = octree.getFlatOctree();
+    CHECK(flat_octree.bytes() >= flat_octree.getPrimitives().size() * (sizeof(const Triangle*) + sizeof(TriangleRecord)));
+
+    triangles[0].setPosition(Eigen::Vector3d(0, 0, 20));
+    octree.update(&triangles[0]);
+    double hit_distance;
+    CHECK(octree.traceRay(Ray(Eigen::Vector3d(0, 0, 10), Eigen::Vector3d::UnitZ()), hit_distance) == &triangles[0]);
+    CHECK(hit_distance == doctest::Approx(10).epsilon(0.05));
+    for (const Ray& ray : rays) {
+        double expected_distance = std::numeric_limits<double>::infinity();
+        for (const Triangle& triangle : triangles) {
+            float u, v, t;
+            if (triangle.intersect(ray, u, v, t)) expected_distance = std::min(expected_distance, static_cast<double>(t));
+        }
+        const bool hit = octree.traceRay(ray, hit_distance) != nullptr;
+        CHECK(hit == std::isfinite(expected_distance));
+        if (hit) CHECK(hit_distance == expected_distance);
+    }
+}
+
+TEST_CASE("[Octree] testing SIMD leaf kernels") {
+    std::mt19937 generator(25);
+    std::uniform_real_distribution<double> unit(-0.5, 0.5);
+    std::vector<Triangle> triangles;
+    for (int i = 0; i < 400; ++i) {
+        triangles.emplace_back(Eigen::Vector3d(6 * unit(generator), 6 * unit(generator), 6 * unit(generator)),
+                               Eigen::Vector3d(-0.3, -0.3, 0), Eigen::Vector3d(0.3, -0.3, 0.2), Eigen::Vector3d(0, 0.3, -0.2));
+        triangles.back().rotate(Eigen::Vector3d(unit(generator), unit(generator), unit(generator)));
+    }
+    // Rays parallel to the last triangle and rays starting on the first one
+    triangles.emplace_back(Eigen::Vector3d(0, 0, 0), Eigen::Vector3d(-1, -1, 0), Eigen::Vector3d(1, -1, 0), Eigen::Vector3d(0, 1, 0));
+    std::vector<Ray> rays;
+    for (int i = 0; i < 300; ++i) {
+        rays.emplace_back(Eigen::Vector3d(8 * unit(generator), 8 * unit(generator), -6), Eigen::Vector3d(unit(generator), unit(generator), 1));
+    }
+    rays.emplace_back(Eigen::Vector3d(-2, 0, 0), Eigen::Vector3d::UnitX());
+    rays.emplace_back(triangles[0].getPoint(0), Eigen::Vector3d(0.2, 0.1, 1));
+
+    TriangleBlockArray blocks;
+    for (const Triangle& triangle : triangles) {
+        blocks.push_back(triangle.getIntersectionRecord());
+    }
+    REQUIRE(blocks.size() == triangles.size());
+    CHECK(blocks.bytes() == (triangles.size() + TriangleBlock::SIZE - 1) / TriangleBlock::SIZE * sizeof(TriangleBlock));
+    CHECK(blocks[17].point0 == triangles[17].getIntersectionRecord().point0);
+    CHECK(blocks[17].edge2 == triangles[17].getIntersectionRecord().edge2);
+
+    std::vector<const Triangle*> objects;
+    for (const Triangle& triangle : triangles) {
+        objects.push_back(&triangle);
+    }
+    Octree<Triangle> octree(OctreeInsertion::BoundingBox);
+    octree.build(objects);
+
+    const SimdLevel supported_level = getSupportedSimdLevel();
+    const SimdLevel initial_level = getTriangleKernelLevel();
+    CHECK(initial_level == supported_level);
+    CHECK(getSimdLevelName(SimdLevel::AVX2) == "AVX2");
+    if (supported_level != SimdLevel::AVX512) CHECK_THROWS_AS(setTriangleKernelLevel(SimdLevel::AVX512), std::invalid_argument);
+
+    // Every kernel supported by the processor gives the hits and the distances of TriangleRecord::intersect, bit for bit,
+    //      for every range of records, so the octree gives the same hits with every kernel
+    std::vector<const Triangle*> expected_hits;
+    std::vector<double> expected_distances;
+    for (SimdLevel level : {SimdLevel::Scalar, SimdLevel::SSE4, SimdLevel::AVX2, SimdLevel::AVX512}) {
+        if (level > supported_level) break;
+        CAPTURE(getSimdLevelName(level));
+        setTriangleKernelLevel(level);
+        CHECK(getTriangleKernelLevel() == level);
+
+        unsigned int hits = 0, mismatches = 0;
+        for (const Ray& ray : rays) {
+            const std::size_t first = generator() % 40, count = generator() % 200;
+            std::size_t next = first;
+            blocks.intersect(ray, first, count, [&](std::size_t index, float distance) {
+                for (; next < index; ++next) {
+                    float u, v, t;
+                    if (triangles[next].getIntersectionRecord().intersect(ray, u, v, t)) ++mismatches;
+                }
+                float u, v, t;
+                if (!triangles[index].getIntersectionRecord().intersect(ray, u, v, t) || t != distance) ++mismatches;
+                ++hits;
+                ++next;
+                return false;
+            });
+            for (; next < first + count; ++next) {
+                float u, v, t;
+                if (triangles[next].getIntersectionRecord().intersect(ray, u, v, t)) ++mismatches;
+            }
+        }
+        CHECK(hits > 20);
+        CHECK(mismatches == 0);
+
+        double hit_distance;
+        for (std::size_t i = 0; i < rays.size(); ++i) {
+            const Triangle* hit = octree.traceRay(rays[i], hit_distance);
+            if (level == SimdLevel::Scalar) {
+                expected_hits.push_back(hit);
+                expected_distances.push_back(hit_distance);
+                continue;
+            }
+            CHECK(hit == expected_hits[i]);
+            if (hit != nullptr) CHECK(hit_distance == expected_distances[i]);
+            CHECK(octree.occluded(rays[i], 100) == (hit != nullptr));
+        }
+    }
+    setTriangleKernelLevel(initial_level);
+}
+
+TEST_CASE("[Octree] testing single precision") {
+    // The primitives of the geometry convert between the two precisions
+    const Ray ray(Eigen::Vector3d(0.5, -4, 0.25), Eigen::Vector3d(0.1, 1, 0.05));
+    const RayF ray_f = ray.cast<float>();
+    CHECK(ray_f.getOrigin() == Eigen::Vector3f(0.5f, -4, 0.25f));
+    CHECK(ray_f.getDirection().isApprox(ray.getDirection().cast<float>()));
+    const BoxF box = Box{Eigen::Array3d(-1, -1, -1), Eigen::Array3d(1, 1, 1)}.cast<float>();
+    float enter_f, exit_f;
+    double enter, exit;
+    REQUIRE(box.intersect(ray_f, enter_f, exit_f));
+    REQUIRE(box.cast<double>().intersect(ray, enter, exit));
+    CHECK(enter_f == doctest::Approx(enter).epsilon(1e-5));
+    CHECK(exit_f == doctest::Approx(exit).epsilon(1e-5));
+
+    const CameraF camera(Eigen::Vector3d::Zero(), 1.7, 1.7, 20, 10, 1.0);
+    const Camera camera_d(Eigen::Vector3d::Zero(), 1.7, 1.7, 20, 10, 1.0);
+    REQUIRE(camera.getRays().size() == 200);
+    CHECK(camera.getRay(3, 7).getDirection().isApprox(camera_d.getRay(3, 7).getDirection().cast<float>()));
+
+    std::mt19937 generator(26);
+    std::uniform_real_distribution<double> unit(-0.5, 0.5);
+    std::vector<Triangle> triangles;
+    for (int i = 0; i < 2000; ++i) {
+        triangles.emplace_back(Eigen::Vector3d(20 * unit(generator), 20 * unit(generator), 20 * unit(generator)),
+                               Eigen::Vector3d(-0.3, -0.3, 0), Eigen::Vector3d(0.3, -0.3, 0.2), Eigen::Vector3d(0, 0.3, -0.2));
+        triangles.back().rotate(Eigen::Vector3d(unit(generator), unit(generator), unit(generator)));
+    }
+    std::vector<const Triangle*> objects;
+    for (const Triangle& triangle : triangles) {
+        objects.push_back(&triangle);
+    }
+
+    // The single precision blocks give the hits of the single precision records on every kernel, bit for bit
+    TriangleBlockArrayF blocks;
+    for (const Triangle& triangle : triangles) {
+        blocks.push_back(triangle.getIntersectionRecord());
+    }
+    CHECK(blocks.bytes() == (triangles.size() + TriangleBlock::SIZE - 1) / TriangleBlock::SIZE * sizeof(TriangleBlockArrayF::Block));
+    CHECK(sizeof(TriangleBlockArrayF::Block) < sizeof(TriangleBlock));
+    std::vector<RayF> rays;
+    for (int i = 0; i < 400; ++i) {
+        rays.emplace_back(Eigen::Vector3f(0, 0, -15) + 4 * Eigen::Vector3f(unit(generator), unit(generator), 0),
+                          Eigen::Vector3f(unit(generator), unit(generator), 1));
+    }
+    const SimdLevel initial_level = getTriangleKernelLevel();
+    for (SimdLevel level : {SimdLevel::Scalar, SimdLevel::SSE4, SimdLevel::AVX2, SimdLevel::AVX512}) {
+        if (level > getSupportedSimdLevel()) break;
+        CAPTURE(getSimdLevelName(level));
+        setTriangleKernelLevel(level);
+        unsigned int hits = 0, mismatches = 0;
+        for (const RayF& ray_f : rays) {
+            std::vector<bool> hit(triangles.size(), false);
+            blocks.intersect(ray_f, 0, triangles.size(), [&](std::size_t index, float distance) {
+                float u, v, t;
+                const TriangleRecordF record = triangles[index].getIntersectionRecord().cast<float>();
+                if (!record.intersect(ray_f, u, v, t) || t != distance) ++mismatches;
+                hit[index] = true;
+                ++hits;
+                return false;
+            });
+            for (std::size_t i = 0; i < triangles.size(); i += 7) {
+                float u, v, t;
+                if (!hit[i] && triangles[i].getIntersectionRecord().cast<float>().intersect(ray_f, u, v, t)) ++mismatches;
+            }
+        }
+        CHECK(hits > 100);
+        CHECK(mismatches == 0);
+    }
+    setTriangleKernelLevel(initial_level);
+
+    // A single precision octree finds the hits of the double precision one, up to the rounding of the rays and of the first points
+    Octree<Triangle> octree(OctreeInsertion::BoundingBox);
+    Octree<Triangle, NodeArena, FlatOctreeNode, float> octree_f(OctreeInsertion::BoundingBox);
+    octree.build(objects);
+    octree_f.build(objects);
+    CHECK(octree_f.getFlatOctree().getNodes().size() == octree.getFlatOctree().getNodes().size());
+    CHECK(octree_f.getFlatOctree().bytes() < octree.getFlatOctree().bytes());
+
+    unsigned int hits = 0, mismatches = 0;
+    for (const RayF& ray_f : rays) {
+        const Ray ray_d = ray_f.cast<double>();
+        double distance;
+        float distance_f;
+        const Triangle* hit = octree.traceRay(ray_d, distance);
+        const Triangle* hit_f = octree_f.traceRay(ray_f, distance_f);
+        if (hit != hit_f) {
+            ++mismatches;
+            continue;
+        }
+        if (hit == nullptr) continue;
+        ++hits;
+        CHECK(distance_f == doctest::Approx(distance).epsilon(1e-4));
+
+        // A ray of the scene is rounded by the single precision octree, and the maximum distance is respected
+        double distance_d;
+        CHECK(octree_f.traceRay(ray_d, distance_d) == hit);
+        CHECK(distance_d == doctest::Approx(distance_f).epsilon(1e-6));
+        CHECK(octree_f.occluded(ray_f, distance_f * 1.01f));
+        CHECK(octree_f.occluded(ray_d, distance * 1.01));
+        CHECK_FALSE(octree_f.occluded(ray_f, distance_f * 0.99f));
+        CHECK(octree_f.traceRay(ray_f, distance_f, distance_f / 2) == nullptr);
+    }
+    CHECK(hits > 100);
+    CHECK(mismatches <= rays.size() / 100);
+}
+
+TEST_CASE("[Octree] testing tile frustum culling") {
+    std::mt19937 generator(27);
+    std::uniform_real_distribution<double> unit(-0.5, 0.5);
+    std::vector<Triangle> triangles;
+    for (int i = 0; i < 3000; ++i) {
+        triangles.emplace_back(Eigen::Vector3d(30 * unit(generator), 15 + 30 * unit(generator), 30 * unit(generator)),
+                               Eigen::Vector3d(-0.4, -0.4, 0), Eigen::Vector3d(0.4, -0.4, 0.3), Eigen::Vector3d(0, 0.4, -0.3));
+        triangles.back().rotate(Eigen::Vector3d(unit(generator), unit(generator), unit(generator)));
+    }
+    std::vector<const Triangle*> objects;
+    for (const Triangle& triangle : triangles) {
+        objects.push_back(&triangle);
+    }
+
+    // The frustum of a rectangle of pixels contains its rays, and it is not flat for a single column
+    Camera camera(Eigen::Vector3d(0, -2, 0.5), 1.7, 1.7, 48, 40, 1.0);
+    camera.rotate(Eigen::Vector3d::UnitZ(), 0.3);
+    for (auto [first_row, first_column, last_row, last_column] : {std::array<unsigned int, 4>{0, 0, 40, 48}, {8, 16, 16, 24}, {33, 47, 40, 48}}) {
+        const std::array<Plane, 4> planes = camera.getFrustum(first_row, first_column, last_row, last_column);
+        const FrustumRegion frustum{planes};
+        for (unsigned int i = first_row; i < last_row; ++i) {
+            for (unsigned int j = first_column; j < last_column; ++j) {
+                const Ray& ray = camera.getRay(i, j);
+                CHECK(frustum.contains(ray.getOrigin() + ray.getDirection()));
+                CHECK(frustum.contains(ray.getOrigin() + 100 * ray.getDirection()));
+            }
+        }
+        CHECK_FALSE(frustum.contains(2 * camera.getPosition() - camera.getRay(first_row, first_column).getOrigin() - camera.getRay(first_row, first_column).getDirection()));
+    }
+
+    // The rays of each tile traced from the entry points of its frustum get the hits of the traversal from the root
+    for (OctreeInsertion insertion : {OctreeInsertion::Position, OctreeInsertion::BoundingBox}) {
+        const std::string insertion_name = insertion == OctreeInsertion::Position ? "position" : "bounding box";
+        CAPTURE(insertion_name);
+        Octree<Triangle> octree(12, 1.0, 6, Eigen::Vector3d::Zero(), insertion);
+        octree.build(objects);
+
+        constexpr unsigned int TILE_SIZE = 8;
+        unsigned int culled_tiles = 0, hits = 0, mismatches = 0;
+        OctreeEntryPoints entry_points;
+        for (unsigned int first_row = 0; first_row < 40; first_row += TILE_SIZE) {
+            for (unsigned int first_column = 0; first_column < 48; first_column += TILE_SIZE) {
+                const unsigned char signs = getDirectionOctant(camera.getRay(first_row, first_column).getDirection());
+                octree.cullFrustum(camera.getFrustum(first_row, first_column, first_row + TILE_SIZE, first_column + TILE_SIZE), signs, entry_points, 12);
+                REQUIRE(entry_points.culled);
+                CHECK(entry_points.signs == signs);
+                CHECK(entry_points.nodes.size() <= 12);
+                culled_tiles += entry_points.nodes.size() > 1;
+
+                for (unsigned int i = first_row; i < first_row + TILE_SIZE; i += 2) {
+                    for (unsigned int j = first_column; j < first_column + TILE_SIZE; j += 2) {
+                        RayPacket<4> packet;
+                        for (unsigned int lane = 0; lane < 4; ++lane) {
+                            packet.set(lane, camera.getRay(i + lane / 2, j + lane % 2));
+                        }
+                        RayPacket<4>::Lanes packet_distances, culled_packet_distances;
+                        const std::array<const Triangle*, 4> packet_hits = octree.traceRays(packet, packet_distances);
+                        const std::array<const Triangle*, 4> culled_packet_hits = octree.traceRays(packet, culled_packet_distances, entry_points);
+                        for (unsigned int lane = 0; lane < 4; ++lane) {
+                            const Ray& ray = *packet.rays[lane];
+                            double distance, culled_distance;
+                            const Triangle* hit = octree.traceRay(ray, distance);
+                            const Triangle* culled_hit = octree.traceRay(ray, culled_distance, entry_points);
+                            if (hit != nullptr) ++hits;
+                            if (culled_hit != hit || culled_packet_hits[lane] != packet_hits[lane]) {
+                                ++mismatches;
+                                continue;
+                            }
+                            if (hit != nullptr) {
+                                CHECK(culled_distance == distance);
+                                CHECK(culled_packet_distances[lane] == packet_distances[lane]);
+                            }
+                        }
+                    }
+                }
+            }
+        }
+        CHECK(culled_tiles > 10);
+        CHECK(hits > 200);
+        CHECK(mismatches == 0);
+
+        // A frustum missing the octree leaves no entry point, and rays going towards another octant are traced from the root
+        const std::array<Plane, 1> behind{Plane(-Eigen::Vector3d::UnitY(), Eigen::Vector3d(0, -100, 0))};
+        octree.cullFrustum(behind, 0, entry_points);
+        CHECK(entry_points.culled);
+        CHECK(entry_points.nodes.empty());
+        const Ray ray(Eigen::Vector3d(0, -2, 0), Eigen::Vector3d(0.01, 1, 0.02));
+        double distance, culled_distance;
+        CHECK(octree.traceRay(ray, culled_distance, entry_points) == nullptr);
+        entry_points.signs = 7;
+        CHECK(octree.traceRay(ray, culled_distance, entry_points) == octree.traceRay(ray, distance));
+    }
+}
@@ -0,0 +1,594 @@
+#include "scene-test.hpp"
+
+#include <atomic>
+#include <cmath>
+#include <filesystem>
+#include <limits>
+#include <random>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+TEST_CASE("[ThreadPool] testing task execution") {
+    ThreadPool pool(4);
+    CHECK(pool.getThreadCount() == 4);
+
+    SUBCASE("Every task runs exactly once") {
+        std::vector<std::atomic<int>> runs(1000);
+        for (std::atomic<int>& run : runs) run = 0;
+
+        pool.run(runs.size(), [&](std::size_t task_index, unsigned int worker_index) {
+            CHECK(worker_index < 4);
+            ++runs[task_index];
+        });
+
+        for (const std::atomic<int>& run : runs) {
+            CHECK(run == 1);
+        }
+    }
+
+    SUBCASE("The pool can run several batches") {
+        std::atomic<int> total = 0;
+        for (int batch = 0; batch < 10; ++batch) {
+            pool.run(batch, [&](std::size_t, unsigned int) { ++total; });
+        }
+        CHECK(total == 45);
+    }
+
+    SUBCASE("Exceptions thrown by a task are propagated") {
+        CHECK_THROWS_AS(pool.run(10, [](std::size_t task_index, unsigned int) {
+            if (task_index == 7) throw std::runtime_error("Task failed");
+        }), std::runtime_error);
+    }
+
+    SUBCASE("Concurrent batches do not overlap") {
+        // Each caller checks that its batch ran all its tasks and none of the other caller's
+        std::vector<std::thread> callers;
+        std::atomic<int> failures = 0;
+        for (int caller = 0; caller < 2; ++caller) {
+            callers.emplace_back([&, caller]() {
+                for (int batch = 0; batch < 50; ++batch) {
+                    std::vector<std::atomic<int>> runs(200 + caller);
+                    for (std::atomic<int>& run : runs) run = 0;
+                    pool.run(runs.size(), [&](std::size_t task_index, unsigned int) { ++runs[task_index]; });
+                    for (const std::atomic<int>& run : runs) {
+                        if (run != 1) ++failures;
+                    }
+                }
+            });
+        }
+        for (std::thread& caller : callers) caller.join();
+        CHECK(failures == 0);
+    }
+
+    SUBCASE("A task cannot run a batch on its own pool") {
+        CHECK_THROWS_AS(pool.run(4, [&](std::size_t, unsigned int) { pool.run(1, [](std::size_t, unsigned int) {}); }), std::logic_error);
+        std::atomic<int> total = 0;
+        pool.run(8, [&](std::size_t, unsigned int) { ++total; });
+        CHECK(total == 8);
+    }
+}
+
+TEST_CASE("[Scene] testing parallel rendering") {
+    Camera camera(Eigen::Vector3d::Zero(), 1.7, 1.7, 67, 45, 1.0);
+    LightSource light(Eigen::Vector3d(0, 5, 0), Eigen::Vector3d(1, 1, 1), 255);
+
+    Eigen::Vector3d position(0, 0, 3);
+    Triangle triangle(position, Eigen::Vector3d(-1, 1, 0), Eigen::Vector3d(1, 1, 0), Eigen::Vector3d(1, -1, 0), true);
+    Triangle triangle2(position, Eigen::Vector3d(-1, 1, 0), Eigen::Vector3d(1, -1, 0), Eigen::Vector3d(-1, -1, 0), true);
+    triangle2.rotate(Eigen::Vector3d::UnitX(), M_PI / 4);
+
+    Scene scene(&camera, 5, 2.5, 3);
+    scene.setLightSource(&light);
+    scene.addTriangle(&triangle);
+    scene.addTriangle(&triangle2);
+
+    CHECK(scene.getThreadCount() == 1);
+    Render serial_render = scene.getRender();
+    CHECK(serial_render.render.cast<int>().sum() > 0); // The triangles are visible
+
+    SUBCASE("The tiled render is identical to the serial render") {
+        // Tile sizes that do not divide the resolution test the partial tiles on the borders
+        for (unsigned int tile_size : {1u, 7u, 16u, 100u}) {
+            scene.setThreadCount(3);
+            scene.setTileSize(tile_size);
+            CHECK(scene.getThreadCount() == 3);
+
+            Render tiled_render = scene.getRender();
+            CHECK(tiled_render.render == serial_render.render);
+        }
+    }
+
+    SUBCASE("The scene can go back to serial rendering") {
+        scene.setThreadCount(2);
+        scene.setThreadCount(1);
+        CHECK(scene.getThreadCount() == 1);
+        CHECK(scene.getRender().render == serial_render.render);
+    }
+
+    SUBCASE("Invalid tile size") {
+        CHECK_THROWS_AS(scene.setTileSize(0), std::invalid_argument);
+    }
+}
+
+TEST_CASE("[Scene] testing bulk triangle insertion") {
+    Camera camera(Eigen::Vector3d::Zero(), 1.7, 1.7, 40, 30, 1.0);
+    LightSource light(Eigen::Vector3d(0, 5, 0), Eigen::Vector3d(1, 1, 1), 255);
+
+    std::vector<Triangle> triangles;
+    for (int i = 0; i < 50; ++i) {
+        Eigen::Vector3d position(-2 + 0.08 * i, 1.5 * std::sin(0.7 * i), 3 + 0.05 * i);
+        triangles.emplace_back(position, Eigen::Vector3d(-0.3, -0.3, 0), Eigen::Vector3d(0.3, -0.3, 0.1), Eigen::Vector3d(0, 0.4, -0.1), true);
+    }
+    std::vector<Triangle*> triangle_pointers;
+    for (Triangle& triangle : triangles) {
+        triangle_pointers.push_back(&triangle);
+    }
+
+    Scene inserted_scene(&camera, 8, 2.5, 3);
+    inserted_scene.setLightSource(&light);
+    for (Triangle* triangle : triangle_pointers) {
+        inserted_scene.addTriangle(triangle);
+    }
+    Render inserted_render = inserted_scene.getRender();
+    CHECK(inserted_render.render.cast<int>().sum() > 0);
+
+    // Half the triangles one by one, then the other half at once, with and without threads
+    for (unsigned int thread_count : {1u, 3u}) {
+        Scene built_scene(&camera, 8, 2.5, 3);
+        built_scene.setLightSource(&light);
+        built_scene.setThreadCount(thread_count);
+        for (std::size_t i = 0; i < triangle_pointers.size() / 2; ++i) {
+            built_scene.addTriangle(triangle_pointers[i]);
+        }
+        built_scene.addTriangles(std::span<Triangle* const>(triangle_pointers).subspan(triangle_pointers.size() / 2));
+
+        CHECK(built_scene.getRender().render == inserted_render.render);
+    }
+}
+
+TEST_CASE("[Scene] testing duplicate triangles") {
+    Camera camera(Eigen::Vector3d::Zero(), 1.7, 1.7, 40, 30, 1.0);
+    LightSource light(Eigen::Vector3d(0, 5, 0), Eigen::Vector3d(1, 1, 1), 255);
+
+    std::vector<Triangle> triangles;
+    for (int i = 0; i < 20; ++i) {
+        Eigen::Vector3d position(-2 + 0.2 * i, 1.5 * std::sin(0.7 * i), 3 + 0.05 * i);
+        triangles.emplace_back(position, Eigen::Vector3d(-0.3, -0.3, 0), Eigen::Vector3d(0.3, -0.3, 0.1), Eigen::Vector3d(0, 0.4, -0.1), true);
+    }
+    std::vector<Triangle*> triangle_pointers;
+    for (Triangle& triangle : triangles) {
+        triangle_pointers.push_back(&triangle);
+    }
+
+    // The expected image, without the first triangle
+    Scene expected_scene(&camera, 8, 2.5, 3);
+    expected_scene.setLightSource(&light);
+    expected_scene.addTriangles(std::span<Triangle* const>(triangle_pointers).subspan(1));
+    Render expected_render = expected_scene.getRender();
+
+    Scene octree_scene(&camera, 8, 2.5, 3);
+    Scene bvh_scene(&camera, 4, 16);
+    for (Scene* scene_pointer : {&octree_scene, &bvh_scene}) {
+        Scene& scene = *scene_pointer;
+        CAPTURE(scene.usesBvh());
+        scene.setLightSource(&light);
+
+        // A triangle already in the scene is ignored, one by one or at once
+        CHECK(scene.addTriangle(triangle_pointers[0]));
+        CHECK_FALSE(scene.addTriangle(triangle_pointers[0]));
+        std::vector<Triangle*> repeated_pointers = triangle_pointers;
+        repeated_pointers.insert(repeated_pointers.end(), triangle_pointers.begin(), triangle_pointers.begin() + 5);
+        scene.addTriangles(repeated_pointers);
+        CHECK_FALSE(scene.addTriangle(triangle_pointers[3]));
+
+        // Removing it once removes it from the acceleration structure
+        CHECK(scene.removeTriangle(triangle_pointers[0]));
+        CHECK_FALSE(scene.removeTriangle(triangle_pointers[0]));
+        CHECK(scene.getRender().render == expected_render.render);
+    }
+}
+
+TEST_CASE("[Scene] testing saved acceleration structures") {
+    Camera camera(Eigen::Vector3d::Zero(), 1.7, 1.7, 40, 30, 1.0);
+    LightSource light(Eigen::Vector3d(0, 5, 0), Eigen::Vector3d(1, 1, 1), 255);
+
+    std::vector<Triangle> triangles;
+    for (int i = 0; i < 50; ++i) {
+        Eigen::Vector3d position(-2 + 0.08 * i, 1.5 * std::sin(0.7 * i), 3 + 0.05 * i);
+        triangles.emplace_back(position, Eigen::Vector3d(-0.3, -0.3, 0), Eigen::Vector3d(0.3, -0.3, 0.1), Eigen::Vector3d(0, 0.4, -0.1), true);
+    }
+    std::vector<Triangle*> triangle_pointers;
+    for (Triangle& triangle : triangles) {
+        triangle_pointers.push_back(&triangle);
+    }
+    const std::string path = (std::filesystem::temp_directory_path() / "3drenderer-scene-test.bin").string();
+
+    Scene built_scene(&camera);
+    built_scene.setLightSource(&light);
+    built_scene.addTriangles(triangle_pointers);
+    built_scene.saveAccelerationStructure(path);
+    Render built_render = built_scene.getRender();
+    CHECK(built_render.render.cast<int>().sum() > 0);
+
+    // The loaded scene renders the same image, and its triangles can still be moved
+    Scene loaded_scene(&camera);
+    loaded_scene.setLightSource(&light);
+    loaded_scene.loadTriangles(triangle_pointers, path);
+    CHECK(loaded_scene.getRender().render == built_render.render);
+
+    triangles[10].translate(Eigen::Vector3d(0, 0.5, 0));
+    built_scene.updateTriangle(&triangles[10]);
+    loaded_scene.updateTriangle(&triangles[10]);
+    CHECK(loaded_scene.getRender().render == built_scene.getRender().render);
+
+    // Only an octree is saved, and only with the triangles it was saved with
+    Scene bvh_scene(&camera, 4, 16);
+    CHECK_THROWS_AS(bvh_scene.saveAccelerationStructure(path), std::invalid_argument);
+    CHECK_THROWS_AS(bvh_scene.loadTriangles(triangle_pointers, path), std::invalid_argument);
+    Scene partial_scene(&camera);
+    CHECK_THROWS_AS(partial_scene.loadTriangles(std::span<Triangle* const>(triangle_pointers).first(10), path), std::invalid_argument);
+    std::vector<Triangle*> repeated_pointers = triangle_pointers;
+    repeated_pointers[1] = repeated_pointers[0];
+    CHECK_THROWS_AS(partial_scene.loadTriangles(repeated_pointers, path), std::invalid_argument);
+    CHECK_THROWS_AS(loaded_scene.loadTriangles(std::span<Triangle* const>(triangle_pointers).first(1), path), std::invalid_argument);
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("[Scene] testing the acceleration structures") {
+    Camera camera(Eigen::Vector3d::Zero(), 1.7, 1.7, 40, 30, 1.0);
+    LightSource light(Eigen::Vector3d(0, 5, 0), Eigen::Vector3d(1, 1, 1), 255);
+
+    std::vector<Triangle> triangles;
+    for (int i = 0; i < 50; ++i) {
+        Eigen::Vector3d position(-2 + 0.08 * i, 1.5 * std::sin(0.7 * i), 3 + 0.05 * i);
+        triangles.emplace_back(position, Eigen::Vector3d(-0.3, -0.3, 0), Eigen::Vector3d(0.3, -0.3, 0.1), Eigen::Vector3d(0, 0.4, -0.1), true);
+    }
+    std::vector<Triangle*> triangle_pointers;
+    for (Triangle& triangle : triangles) {
+        triangle_pointers.push_back(&triangle);
+    }
+
+    Scene octree_scene(&camera, 8, 2.5, 3);
+    octree_scene.setLightSource(&light);
+    octree_scene.addTriangles(triangle_pointers);
+    CHECK_FALSE(octree_scene.usesBvh());
+    Render octree_render = octree_scene.getRender();
+    CHECK(octree_render.render.cast<int>().sum() > 0);
+
+    // The hierarchy gives the same image, whether the triangles are added one by one or at once
+    Scene bvh_scene(&camera, 4, 16);
+    bvh_scene.setLightSource(&light);
+    CHECK(bvh_scene.usesBvh());
+    for (Triangle* triangle : triangle_pointers) {
+        bvh_scene.addTriangle(triangle);
+    }
+    CHECK(bvh_scene.getRender().render == octree_render.render);
+
+    Scene bulk_bvh_scene(&camera, 4, 16);
+    bulk_bvh_scene.setLightSource(&light);
+    bulk_bvh_scene.setThreadCount(2);
+    bulk_bvh_scene.addTriangles(triangle_pointers);
+    CHECK(bulk_bvh_scene.getRender().render == octree_render.render);
+
+    // So does an octree configured by its cost model, without manual parameters
+    for (bool bulk : {false, true}) {
+        Scene automatic_scene(&camera);
+        automatic_scene.setLightSource(&light);
+        CHECK_FALSE(automatic_scene.usesBvh());
+        if (bulk) {
+            automatic_scene.addTriangles(triangle_pointers);
+        } else {
+            for (Triangle* triangle : triangle_pointers) automatic_scene.addTriangle(triangle);
+        }
+        CHECK(automatic_scene.getRender().render == octree_render.render);
+    }
+}
+
+TEST_CASE("[Scene] testing shadows") {
+    Camera camera(Eigen::Vector3d::Zero(), 1.7, 1.7, 41, 41, 1.0);
+    LightSource light(Eigen::Vector3d(2, 0, 1), Eigen::Vector3d(1, 1, 1), 255);
+
+    // A wall facing the camera, and a small triangle between the light and the middle of the wall, out of the view of the middle pixel
+    Eigen::Vector3d wall_position(0, 0, 5);
+    Triangle wall(wall_position, Eigen::Vector3d(-10, -10, 0), Eigen::Vector3d(10, -10, 0), Eigen::Vector3d(0, 10, 0));
+    Triangle occluder(Eigen::Vector3d(1, 0, 3), Eigen::Vector3d(-0.3, -0.3, 0), Eigen::Vector3d(0.3, -0.3, 0), Eigen::Vector3d(0, 0.3, 0));
+    const unsigned int middle_pixel = 20 * 41 + 20;
+    const unsigned int side_pixel = 20 * 41 + 30;
+
+    Scene octree_scene(&camera, 8, 2.5, 3);
+    Scene bvh_scene(&camera, 4, 16);
+    for (Scene* scene_pointer : {&octree_scene, &bvh_scene}) {
+        Scene& scene = *scene_pointer;
+        scene.setLightSource(&light);
+        scene.addTriangle(&wall);
+
+        Render lit_render = scene.getRender();
+        CHECK(lit_render.render(middle_pixel, 1) > 0); // The wall faces the light
+        CHECK(lit_render.render(side_pixel, 1) > 0);
+
+        scene.addTriangle(&occluder);
+        Render shadowed_render = scene.getRender();
+        CHECK(shadowed_render.render(middle_pixel, 0) == 50);
+        CHECK(shadowed_render.render(middle_pixel, 1) == 0);
+
+        // The rest of the wall is still lit
+        CHECK(shadowed_render.render(side_pixel, 1) == lit_render.render(side_pixel, 1));
+    }
+}
+
+TEST_CASE("[Scene] testing moved and removed triangles") {
+    Camera camera(Eigen::Vector3d::Zero(), 1.7, 1.7, 40, 30, 1.0);
+    LightSource light(Eigen::Vector3d(0, 5, 0), Eigen::Vector3d(1, 1, 1), 255);
+
+    auto makeTriangles = []() {
+        std::vector<Triangle> triangles;
+        for (int i = 0; i < 50; ++i) {
+            Eigen::Vector3d position(-2 + 0.08 * i, 1.5 * std::sin(0.7 * i), 3 + 0.05 * i);
+            triangles.emplace_back(position, Eigen::Vector3d(-0.3, -0.3, 0), Eigen::Vector3d(0.3, -0.3, 0.1), Eigen::Vector3d(0, 0.4, -0.1), true);
+        }
+        return triangles;
+    };
+
+    // The expected image: the triangles already at their final positions, without the removed ones
+    std::vector<Triangle> final_triangles = makeTriangles();
+    for (int i = 0; i < 50; i += 4) {
+        final_triangles[i].translate(Eigen::Vector3d(0.4, -0.2, 0.5));
+    }
+    Scene expected_scene(&camera, 8, 2.5, 3);
+    expected_scene.setLightSource(&light);
+    for (int i = 0; i < 50; ++i) {
+        if (i % 7 != 3) expected_scene.addTriangle(&final_triangles[i]);
+    }
+    Render expected_render = expected_scene.getRender();
+    CHECK(expected_render.render.cast<int>().sum() > 0);
+
+    // Scenes with an octree and a hierarchy, whose triangles move after a first render
+    std::vector<Triangle> octree_triangles = makeTriangles();
+    std::vector<Triangle> bvh_triangles = makeTriangles();
+    Scene octree_scene(&camera, 8, 2.5, 3);
+    Scene bvh_scene(&camera, 4, 16);
+    for (auto [scene_pointer, triangles] : {std::pair{&octree_scene, &octree_triangles}, std::pair{&bvh_scene, &bvh_triangles}}) {
+        Scene& scene = *scene_pointer;
+        CAPTURE(scene.usesBvh());
+        scene.setLightSource(&light);
+        for (Triangle& triangle : *triangles) {
+            scene.addTriangle(&triangle);
+        }
+        Render first_render = scene.getRender();
+
+        for (int i = 0; i < 50; i += 4) {
+            (*triangles)[i].translate(Eigen::Vector3d(0.4, -0.2, 0.5));
+            scene.updateTriangle(&(*triangles)[i]);
+        }
+        for (int i = 3; i < 50; i += 7) {
+            CHECK(scene.removeTriangle(&(*triangles)[i]));
+        }
+        CHECK_FALSE(scene.removeTriangle(&(*triangles)[3]));
+
+        Render moved_render = scene.getRender();
+        CHECK(moved_render.render != first_render.render);
+        CHECK(moved_render.render == expected_render.render);
+    }
+}
+
+TEST_CASE("[Scene] testing invalid triangle updates") {
+    Camera camera(Eigen::Vector3d::Zero(), 1.7, 1.7, 40, 30, 1.0);
+    LightSource light(Eigen::Vector3d(0, 5, 0), Eigen::Vector3d(1, 1, 1), 255);
+
+    std::vector<Triangle> triangles;
+    for (int i = 0; i < 20; ++i) {
+        Eigen::Vector3d position(-1.5 + 0.15 * i, 1.2 * std::sin(0.9 * i), 3 + 0.05 * i);
+        triangles.emplace_back(position, Eigen::Vector3d(-0.3, -0.3, 0), Eigen::Vector3d(0.3, -0.3, 0.1), Eigen::Vector3d(0, 0.4, -0.1), true);
+    }
+    Scene scene(&camera, 8, 2.5, 3);
+    scene.setLightSource(&light);
+    for (Triangle& triangle : triangles) {
+        scene.addTriangle(&triangle);
+    }
+    Render first_render = scene.getRender();
+
+    // A triangle which is not in the scene is rejected at once
+    Triangle outsider(Eigen::Vector3d(0, 0, 3), Eigen::Vector3d(-0.3, -0.3, 0), Eigen::Vector3d(0.3, -0.3, 0), Eigen::Vector3d(0, 0.4, 0), true);
+    CHECK_THROWS_AS(scene.updateTriangle(&outsider), std::invalid_argument);
+    CHECK(scene.getRender().render == first_render.render);
+
+    // A triangle marked twice is updated once, and a triangle moved beyond the maximum depth of the octree fails to update
+    triangles[0].translate(Eigen::Vector3d(0.5, 0.3, 0.2));
+    scene.updateTriangle(&triangles[0]);
+    scene.updateTriangle(&triangles[0]);
+    triangles[1].translate(Eigen::Vector3d(1e6, 0, 0));
+    scene.updateTriangle(&triangles[1]);
+    triangles[2].translate(Eigen::Vector3d(-0.4, 0.2, 0.3));
+    scene.updateTriangle(&triangles[2]);
+    CHECK_THROWS_AS(scene.getRender(), std::length_error);
+
+    // The next render updates the triangles left and does not fail again
+    Scene expected_scene(&camera, 8, 2.5, 3);
+    expected_scene.setLightSource(&light);
+    for (Triangle& triangle : triangles) {
+        if (&triangle != &triangles[1]) expected_scene.addTriangle(&triangle);
+    }
+    Render moved_render = scene.getRender();
+    CHECK(moved_render.render == expected_scene.getRender().render);
+    CHECK(moved_render.render != first_render.render);
+
+    // The triangle that failed to move is still in the octree, and moves with the next update
+    triangles[1].translate(Eigen::Vector3d(-1e6, 0, 0));
+    scene.updateTriangle(&triangles[1]);
+    Scene back_scene(&camera, 8, 2.5, 3);
+    back_scene.setLightSource(&light);
+    for (Triangle& triangle : triangles) {
+        back_scene.addTriangle(&triangle);
+    }
+    CHECK(scene.getRender().render == back_scene.getRender().render);
+    CHECK(scene.removeTriangle(&triangles[1]));
+    CHECK(scene.getRender().render == moved_render.render);
+}
+
+TEST_CASE("[Scene] testing instanced meshes") {
+    Camera camera(Eigen::Vector3d::Zero(), 1.7, 1.7, 40, 30, 1.0);
+    LightSource light(Eigen::Vector3d(0, 5, 0), Eigen::Vector3d(1, 1, 1), 255);
+
+    // A small mesh made of a few triangles around its origin
+    std::vector<Triangle> mesh_triangles;
+    for (int i = 0; i < 6; ++i) {
+        Eigen::Vector3d position(0.2 * std::cos(i), 0.2 * std::sin(i), 0.1 * i);
+        mesh_triangles.emplace_back(position, Eigen::Vector3d(-0.3, -0.3, 0), Eigen::Vector3d(0.3, -0.3, 0.1), Eigen::Vector3d(0, 0.4, -0.1));
+    }
+    std::vector<const Triangle*> mesh_objects;
+    for (const Triangle& triangle : mesh_triangles) {
+        mesh_objects.push_back(&triangle);
+    }
+    Mesh mesh(mesh_objects);
+
+    // The expected images: the copies of the mesh as plain triangles of the scene
+    auto placeCopies = [&](std::vector<Triangle>& copies, const Eigen::Vector3d& position, double angle) {
+        for (const Triangle& triangle : mesh_triangles) {
+            Triangle& copy = copies.emplace_back(position, triangle.getPoint(0), triangle.getPoint(1), triangle.getPoint(2));
+            copy.rotate(Eigen::Vector3d::UnitY(), angle);
+        }
+    };
+    std::vector<Triangle> copies;
+    copies.reserve(10 * mesh_triangles.size());
+    for (int i = 0; i < 10; ++i) {
+        placeCopies(copies, Eigen::Vector3d(-1.5 + 0.35 * i, 0.8 * std::sin(i), 3 + 0.2 * i), 0.3 * i);
+    }
+
+    // The same copies as instances of the mesh, in scenes with and without other triangles
+    Triangle floor(Eigen::Vector3d(0, -3, 6), Eigen::Vector3d(-20, 0, -20), Eigen::Vector3d(20, 0, -20), Eigen::Vector3d(0, 0, 20), true);
+    for (bool with_floor : {false, true}) {
+        CAPTURE(with_floor);
+        Scene expected_scene(&camera, 8, 2.5, 3);
+        expected_scene.setLightSource(&light);
+        for (Triangle& copy : copies) {
+            expected_scene.addTriangle(&copy);
+        }
+        if (with_floor) expected_scene.addTriangle(&floor);
+        Render expected_render = expected_scene.getRender();
+        CHECK(expected_render.render.cast<int>().sum() > 0);
+
+        std::vector<Instance> instances;
+        instances.reserve(10);
+        Scene scene(&camera, 4, 16);
+        scene.setLightSource(&light);
+        for (int i = 0; i < 10; ++i) {
+            // The instances start elsewhere and are moved to the placement of the copies
+            Instance& instance = instances.emplace_back(mesh, Eigen::Vector3d(5, 5, 5));
+            scene.addInstance(&instance);
+        }
+        if (with_floor) scene.addTriangle(&floor);
+        scene.getRender();
+
+        for (int i = 0; i < 10; ++i) {
+            instances[i].setPosition(Eigen::Vector3d(-1.5 + 0.35 * i, 0.8 * std::sin(i), 3 + 0.2 * i));
+            instances[i].rotate(Eigen::Vector3d::UnitY(), 0.3 * i);
+            scene.updateInstance(&instances[i]);
+        }
+        Render render = scene.getRender();
+        CHECK((render.render.cast<int>() - expected_render.render.cast<int>()).cwiseAbs().maxCoeff() <= 1);
+
+        CHECK(scene.removeInstance(&instances[4]));
+        CHECK_FALSE(scene.removeInstance(&instances[4]));
+        CHECK_THROWS_AS(scene.updateInstance(&instances[4]), std::invalid_argument);
+        CHECK(scene.getRender().render != render.render);
+    }
+}
+
+TEST_CASE("[Scene] testing ray casts") {
+    Camera camera(Eigen::Vector3d::Zero(), 1.7, 1.7, 40, 30, 1.0);
+
+    std::mt19937 generator(23);
+    std::uniform_real_distribution<double> unit(-0.5, 0.5);
+    std::vector<Triangle> triangles;
+    for (int i = 0; i < 300; ++i) {
+        triangles.emplace_back(Eigen::Vector3d(8 * unit(generator), 8 * unit(generator), 8 * unit(generator)),
+                               Eigen::Vector3d(-0.3, -0.3, 0), Eigen::Vector3d(0.3, -0.3, 0.2), Eigen::Vector3d(0, 0.3, -0.2));
+    }
+    std::vector<Triangle*> objects;
+    for (Triangle& triangle : triangles) {
+        objects.push_back(&triangle);
+    }
+
+    std::vector<Triangle> mesh_triangles;
+    for (int i = 0; i < 6; ++i) {
+        mesh_triangles.emplace_back(Eigen::Vector3d(0.2 * std::cos(i), 0.2 * std::sin(i), 0.1 * i),
+                                    Eigen::Vector3d(-0.3, -0.3, 0), Eigen::Vector3d(0.3, -0.3, 0.1), Eigen::Vector3d(0, 0.4, -0.1));
+    }
+    std::vector<const Triangle*> mesh_objects;
+    for (const Triangle& triangle : mesh_triangles) {
+        mesh_objects.push_back(&triangle);
+    }
+    Mesh mesh(mesh_objects);
+    std::vector<Instance> instances;
+    for (int i = 0; i < 10; ++i) {
+        instances.emplace_back(mesh, Eigen::Vector3d(8 * unit(generator), 8 * unit(generator), 8 * unit(generator)));
+        instances.back().rotate(Eigen::Vector3d::UnitY(), 0.3 * i);
+    }
+
+    // Rays from random points in random directions, more than one batch of the thread pool
+    std::vector<Ray> rays;
+    for (int i = 0; i < 40000; ++i) {
+        rays.emplace_back(Eigen::Vector3d(10 * unit(generator), 10 * unit(generator), 10 * unit(generator)),
+                          Eigen::Vector3d(unit(generator), unit(generator), unit(generator)));
+    }
+
+    // The closest hits of some rays found by testing all the triangles and instances, the other rays are compared between the scenes
+    std::vector<double> expected_distances(rays.size(), std::numeric_limits<double>::infinity());
+    for (std::size_t i = 0; i < rays.size(); i += 10) {
+        float u, v, t;
+        for (const Triangle& triangle : triangles) {
+            if (triangle.intersect(rays[i], u, v, t)) expected_distances[i] = std::min(expected_distances[i], static_cast<double>(t));
+        }
+        for (const Instance& instance : instances) {
+            if (instance.intersect(rays[i], u, v, t)) expected_distances[i] = std::min(expected_distances[i], static_cast<double>(t));
+        }
+    }
+
+    std::vector<Hit> first_hits;
+    for (bool bvh : {false, true}) {
+        for (unsigned int thread_count : {1u, 4u}) {
+            CAPTURE(bvh);
+            CAPTURE(thread_count);
+            Scene scene = bvh ? Scene(&camera, 4, 16) : Scene(&camera);
+            scene.setThreadCount(thread_count);
+            scene.addTriangles(objects);
+            for (Instance& instance : instances) {
+                scene.addInstance(&instance);
+            }
+
+            std::vector<Hit> hits(rays.size());
+            scene.castRays(rays, hits);
+
+            if (first_hits.empty()) first_hits = hits;
+
+            unsigned int triangle_hits = 0, instance_hits = 0;
+            for (std::size_t i = 0; i < rays.size(); ++i) {
+                const Hit& hit = hits[i];
+                CHECK(hit.triangle == first_hits[i].triangle);
+                CHECK(hit.instance == first_hits[i].instance);
+                if (i % 10 == 0) CHECK(hit.isHit() == std::isfinite(expected_distances[i]));
+                if (!hit.isHit()) {
+                    CHECK(hit.instance == nullptr);
+                    continue;
+                }
+                hit.instance ? ++instance_hits : ++triangle_hits;
+                if (i % 10 == 0) CHECK(hit.distance == doctest::Approx(expected_distances[i]).epsilon(1e-5));
+
+                // The barycentric coordinates give the hit point, in the frame of the mesh for an instance
+                const Ray ray = hit.instance ? hit.instance->toMeshFrame(rays[i]) : rays[i];
+                const Eigen::Vector3d barycentric_point = hit.triangle->getPoint(0) + hit.u * (hit.triangle->getPoint(1) - hit.triangle->getPoint(0))
+                                                          + hit.v * (hit.triangle->getPoint(2) - hit.triangle->getPoint(0));
+                CHECK((barycentric_point - (ray.getOrigin() + hit.distance * ray.getDirection())).norm() < 1e-4);
+
+                const Eigen::Vector3d normal = hit.instance ? hit.instance->toGlobalFrame(hit.triangle->getNormal()) : hit.triangle->getNormal();
+                CHECK(hit.normal.isApprox(normal));
+            }
+            CHECK(triangle_hits > 100);
+            CHECK(instance_hits > 10);
+
+            std::vector<Hit> missing_hits(rays.size() - 1);
+            CHECK_THROWS_AS(scene.castRays(rays, missing_hits), std::invalid_argument);
+        }
+    }
+}